@@ -1,82 +1,289 @@
-/**
- * @file RAK12037-co2.cpp
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief Initialize and read values from the SCD30 sensor
- * @version 0.1
- * @date 2022-04-11
- * 
- * @copyright Copyright (c) 2022
- * 
- */
-#include "main.h"
-#include <SparkFun_SCD30_Arduino_Library.h> //Click here to get the library: http://librarymanager/All#SparkFun_SCD30
-
-/** Sensor instance */
-SCD30 scd30;
-
-/**
- * @brief Initialize MQ2 gas sensor
- *
- * @return true success
- * @return false failed
- */
-bool init_rak12037(void)
-{
-	// Enable power
-	pinMode(WB_IO2, OUTPUT);
-	digitalWrite(WB_IO2, HIGH); // power on RAK12037
-
-		Wire.begin();
-		if (!scd30.begin(Wire))
-		{
-			// MYLOG("SCD30", "SCD30 not found");
-			digitalWrite(WB_IO2, LOW); // power down RAK12004
-			return false;
-		}
-
-	//**************init SCD30 sensor *****************************************************
-	// Change number of seconds between measurements: 2 to 1800 (30 minutes), stored in non-volatile memory of SCD30
-	scd30.setMeasurementInterval(10000);
-
-	// Enable self calibration
-	scd30.setAutoSelfCalibration(true);
-
-	// Start the measurements
-	scd30.beginMeasuring();
-
-	return true;
-}
-
-/**
- * @brief Read CO2 sensor data
- *     Data is added to Cayenne LPP payload as channels
- *     LPP_CHANNEL_CO2_2, LPP_CHANNEL_CO2_Temp_2 and LPP_CHANNEL_CO2_HUMID_2
- *
- */
-void read_rak12037(void)
-{
-	time_t start_time = millis();
-	while (!scd30.dataAvailable())
-	{
-		// MYLOG("SCD30", "Waiting for data");
-		delay(500);
-		if ((millis() - start_time) > 5000)
-		{
-			// timeout, no data available
-			// MYLOG("SCD30", "Timeout");
-			return;
-		}
-	}
-
-	// uint16_t co2_reading = scd30.getCO2();
-	// float temp_reading = scd30.getTemperature();
-	// float humid_reading = scd30.getHumidity();
-
-	// MYLOG("SCD30", "CO2 level %dppm", co2_reading);
-	// MYLOG("SCD30", "Temperature %.2f", temp_reading);
-	// MYLOG("SCD30", "Humidity %.2f", humid_reading);
-
-	g_solution_data.addConcentration(LPP_CHANNEL_CO2_2, scd30.getCO2());
-	g_solution_data.addTemperature(LPP_CHANNEL_CO2_Temp_2, scd30.getTemperature());
-	g_solution_data.addRelativeHumidity(LPP_CHANNEL_CO2_HUMID_2, scd30.getHumidity());
+/**
+ * @file RAK12037-co2.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Initialize and read values from the SCD30 sensor
+ * @version 0.1
+ * @date 2022-04-11
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#include "main.h"
+#include <SparkFun_SCD30_Arduino_Library.h> //Click here to get the library: http://librarymanager/All#SparkFun_SCD30
+
+/** Sensor instance */
+SCD30 scd30;
+
+/** Measurement interval of the SCD30 in seconds */
+uint16_t co2_interval = SCD30_INTERVAL;
+
+/** Number of polls without new data in the current cycle */
+uint8_t co2_poll_retries = 0;
+
+/** Measurement cycle of the sensor is aligned with the TX slots */
+bool co2_aligned = false;
+
+/** millis() of the last alignment of the measurement cycle */
+uint32_t co2_align_time = 0;
+
+/** Time in ms from the poll to the TX slot, of the next poll and of the last alignment */
+uint32_t co2_poll_lead = 0;
+uint32_t co2_aligned_lead = 0;
+
+/** Next run of the poll job restarts the measurement cycle */
+bool co2_align_pending = false;
+
+/** Time in ms from the alignment to the poll */
+uint32_t co2_align_to_poll = 0;
+
+/** The poll after the alignment can expect a new measurement */
+bool co2_expect_data = true;
+
+// Forward declaration
+void poll_rak12037(void *);
+
+/**
+ * @brief Calculate the SCD30 measurement interval for a send interval
+ *        The interval is chosen so that the fewest measurements cover
+ *        the send interval. The measurements are rounded up to whole
+ *        seconds, if the send interval is not a multiple of them the
+ *        cycle of the sensor is a bit late after each uplink and is
+ *        realigned by the poll.
+ *
+ * @param send_interval send interval in milliseconds, 0 = sending off
+ * @return uint16_t measurement interval in seconds, 2 to 1800
+ */
+uint16_t scd30_interval_for(uint32_t send_interval)
+{
+	if (send_interval == 0)
+	{
+		// No uplinks, measure as seldom as possible
+		return SCD30_INTERVAL_MAX;
+	}
+	uint32_t window = (send_interval + 999) / 1000;
+	// Number of measurements needed to cover the send interval within the max interval
+	uint32_t cycles = (window + SCD30_INTERVAL_MAX - 1) / SCD30_INTERVAL_MAX;
+	uint32_t interval = (window + cycles - 1) / cycles;
+	if (interval < SCD30_INTERVAL_MIN)
+	{
+		interval = SCD30_INTERVAL_MIN;
+	}
+	return (uint16_t)interval;
+}
+
+/**
+ * @brief Initialize MQ2 gas sensor
+ *
+ * @return true success
+ * @return false failed
+ */
+bool init_rak12037(void)
+{
+	// Enable power
+	pinMode(WB_IO2, OUTPUT);
+	digitalWrite(WB_IO2, HIGH); // power on RAK12037
+
+	Wire.begin();
+	if (!scd30.begin(Wire))
+	{
+		// MYLOG("SCD30", "SCD30 not found");
+		return false;
+	}
+
+	//**************init SCD30 sensor *****************************************************
+	// Change number of seconds between measurements: 2 to 1800 (30 minutes), stored in non-volatile memory of SCD30
+	// Only write the interval if the sensor has a different one stored
+	co2_interval = scd30_interval_for(g_lorawan_settings.send_repeat_time);
+	uint16_t stored_interval = 0;
+	if (!scd30.getMeasurementInterval(&stored_interval) || (stored_interval != co2_interval))
+	{
+		scd30.setMeasurementInterval(co2_interval);
+	}
+
+	// Enable self calibration
+	scd30.setAutoSelfCalibration(true);
+
+	// Start the measurements, the cycle is aligned with the TX slots before the first poll
+	scd30.beginMeasuring();
+	co2_aligned = false;
+
+	// Poll the sensor shortly before each uplink, the uplink only uses the cached values
+	sched_create(SCHED_CO2_POLL, poll_rak12037, SCHED_SLACK_POLL);
+
+	return true;
+}
+
+/**
+ * @brief Adjust the SCD30 measurement interval to the send interval
+ *        and schedule the poll before the next uplink
+ *        If the measurement cycle has to be aligned, the poll job runs
+ *        first at a time where a restarted cycle finishes a measurement
+ *        SCD30_SAMPLE_LEAD seconds before the poll
+ *        Called after each uplink and when the send interval changed
+ *
+ */
+void co2_schedule(void)
+{
+	if (!found_sensors[CO2_ID].found_sensor)
+	{
+		return;
+	}
+
+	uint16_t new_interval = scd30_interval_for(g_lorawan_settings.send_repeat_time);
+	if (new_interval != co2_interval)
+	{
+		// The interval is stored in the sensor NV memory, only write it if it changed
+		co2_interval = new_interval;
+		scd30.setMeasurementInterval(co2_interval);
+		co2_aligned = false;
+		MYLOG("SCD30", "Interval %d s", co2_interval);
+	}
+
+	// A poll that needed a retry, even one cancelled by the uplink, shows a slow sensor clock
+	if (co2_poll_retries != 0)
+	{
+		co2_aligned = false;
+	}
+
+	// The acquisition before the TX slot encodes the polled values
+	co2_poll_lead = acquisition_lead() + SCD30_POLL_LEAD;
+	// A longer acquisition lead moves the poll before the measurement, a shorter one makes the values older
+	if ((co2_poll_lead > co2_aligned_lead + SCD30_SAMPLE_LEAD * 500) || (co2_poll_lead + SCD30_SAMPLE_LEAD * 1000 < co2_aligned_lead))
+	{
+		co2_aligned = false;
+	}
+
+	sched_stop(SCHED_CO2_POLL);
+	co2_poll_retries = 0;
+	co2_align_pending = false;
+	co2_expect_data = true;
+	if (g_lorawan_settings.send_repeat_time <= co2_poll_lead)
+	{
+		return;
+	}
+	uint32_t poll_delay = g_lorawan_settings.send_repeat_time - co2_poll_lead;
+	if (co2_aligned || (poll_delay < SCD30_SAMPLE_LEAD * 1000))
+	{
+		sched_start(SCHED_CO2_POLL, poll_delay, 0);
+		return;
+	}
+
+	// Restart the cycle a whole number of intervals before the measurement that is polled
+	uint32_t interval_ms = (uint32_t)co2_interval * 1000;
+	uint32_t measurement_delay = poll_delay - SCD30_SAMPLE_LEAD * 1000;
+	co2_align_to_poll = poll_delay - measurement_delay % interval_ms;
+	// Restart right before the measurement, the first one is finished after this poll
+	co2_expect_data = measurement_delay >= interval_ms;
+	co2_align_pending = true;
+	sched_start(SCHED_CO2_POLL, poll_delay - co2_align_to_poll, 0);
+}
+
+/**
+ * @brief Request a new alignment of the SCD30 measurement cycle
+ *        before the next poll, called when the TX slots were moved
+ *
+ */
+void co2_realign(void)
+{
+	co2_aligned = false;
+}
+
+/**
+ * @brief Restart the measurement cycle of the sensor
+ *        beginMeasuring() is a write to the NV memory of the sensor,
+ *        it is only called if the cycle is not aligned or has drifted
+ *
+ */
+static void co2_align(void)
+{
+	scd30.beginMeasuring();
+	co2_aligned = true;
+	co2_align_time = millis();
+	co2_aligned_lead = co2_poll_lead;
+	MYLOG("SCD30", "Measurement cycle aligned");
+}
+
+/**
+ * @brief Check if the SCD30 has new data and publish it in the sensor snapshot
+ *        Called by a timer SCD30_POLL_LEAD ms before each acquisition
+ *        The measurement cycle is aligned with the TX slots once and
+ *        again only if it drifted:
+ *        - sensor clock slow, the poll needed a retry, the measurement
+ *          was more than SCD30_SAMPLE_LEAD seconds late
+ *        - sensor clock fast, not visible at the poll, the cycle is
+ *          realigned after SCD30_REALIGN_TIME
+ *        The alignment is done by co2_schedule() before the next poll
+ *
+ */
+void poll_rak12037(void *)
+{
+	if (co2_align_pending)
+	{
+		co2_align_pending = false;
+		co2_align();
+		sched_start(SCHED_CO2_POLL, co2_align_to_poll, 0);
+		return;
+	}
+
+	if (!scd30.dataAvailable())
+	{
+		if (!co2_expect_data)
+		{
+			// Cycle was just restarted, the uplink uses the last values
+			return;
+		}
+		// MYLOG("SCD30", "No new data");
+		if (co2_poll_retries < SCD30_POLL_RETRIES)
+		{
+			// Sensor clock is a bit behind, try again
+			co2_poll_retries++;
+			sched_start(SCHED_CO2_POLL, 1000, 0);
+		}
+		return;
+	}
+
+	// getCO2() reads all three values from the sensor
+	sensor_snapshot_t *values = snapshot_edit();
+	values->co2 = scd30.getCO2();
+	values->co2_temperature = scd30.getTemperature();
+	values->co2_humidity = scd30.getHumidity();
+	values->co2_timestamp = millis();
+	values->co2_valid = true;
+	snapshot_publish();
+
+	// Realign the measurement cycle before the next poll after a long time
+	if ((millis() - co2_align_time) >= SCD30_REALIGN_TIME)
+	{
+		co2_aligned = false;
+	}
+
+	MYLOG("SCD30", "CO2 %dppm T %.2f H %.2f", values->co2, values->co2_temperature, values->co2_humidity);
+}
+
+/**
+ * @brief Add the latest CO2 sensor data to the payload
+ *     Data is added to Cayenne LPP payload as channels
+ *     LPP_CHANNEL_CO2_2, LPP_CHANNEL_CO2_Temp_2 and LPP_CHANNEL_CO2_HUMID_2
+ *     Does not access the sensor, the values are read by poll_rak12037()
+ *
+ * @param values snapshot with the values of poll_rak12037()
+ */
+void encode_rak12037(const sensor_snapshot_t &values)
+{
+	if (!values.co2_valid)
+	{
+		MYLOG("SCD30", "No CO2 data yet");
+		return;
+	}
+
+	// Skip values that were not updated for several measurement intervals
+	if ((millis() - values.co2_timestamp) > (uint32_t)co2_interval * 1000 * SCD30_MAX_AGE_INTERVALS)
+	{
+		MYLOG("SCD30", "CO2 data too old");
+		return;
+	}
+
+	g_solution_data.addConcentration(LPP_CHANNEL_CO2_2, values.co2);
+	g_solution_data.addTemperature(LPP_CHANNEL_CO2_Temp_2, values.co2_temperature);
+	g_solution_data.addRelativeHumidity(LPP_CHANNEL_CO2_HUMID_2, values.co2_humidity);
 }
\ No newline at end of file
@@ -1,200 +1,500 @@
-/**
- * @file RAK12047_voc.cpp
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief Read values from the RAK12047 VOC sensor
- * @version 0.1
- * @date 2022-04-11
- * 
- * @copyright Copyright (c) 2022
- * 
- */
-#include "main.h"
-#include <SensirionI2CSgp40.h>
-#include <VOCGasIndexAlgorithm.h>
-
-/** Sampling interval for the algorithm */
-int32_t sampling_interval = 10;
-/** Instance for the VOC sensor */
-SensirionI2CSgp40 sgp40;
-/** Instance for the VOC algorithm */
-VOCGasIndexAlgorithm voc_algorithm(sampling_interval);
-
-/** Calculated VOC index */
-int32_t voc_index = 0;
-
-/** Flag if the VOC index is valid */
-bool voc_valid = false;
-
-/** Buffer for debug output */
-char errorMessage[256];
-
-/** Counter to discard the first 100 readings */
-uint16_t discard_counter = 0;
-
-// Forward declaration
-void do_read_rak12047(void *);
-
-/**
- * @brief Initialize the sensor
- *
- * @return true success
- * @return false failed
- */
-bool init_rak12047(void)
-{
-	sgp40.begin(Wire);
-
-	uint16_t serialNumber[3];
-	uint8_t serialNumberSize = 3;
-
-	uint16_t error = sgp40.getSerialNumber(serialNumber, serialNumberSize);
-
-	if (error)
-	{
-		// errorToString(error, errorMessage, 256);
-		// MYLOG("VOC", "Error trying to execute getSerialNumber() %s", errorMessage);
-		return false;
-	}
-	else
-	{
-// #if MY_DEBUG > 0
-// 		Serial.print("SerialNumber:");
-// 		Serial.print("0x");
-// 		for (size_t i = 0; i < serialNumberSize; i++)
-// 		{
-// 			uint16_t value = serialNumber[i];
-// 			Serial.print(value < 4096 ? "0" : "");
-// 			Serial.print(value < 256 ? "0" : "");
-// 			Serial.print(value < 16 ? "0" : "");
-// 			Serial.print(value, HEX);
-// 		}
-// 		Serial.println();
-// #endif
-	}
-
-	uint16_t testResult;
-	error = sgp40.executeSelfTest(testResult);
-	if (error)
-	{
-		// errorToString(error, errorMessage, 256);
-		// MYLOG("VOC", "Error trying to execute executeSelfTest() %s", errorMessage);
-		return false;
-	}
-	else if (testResult != 0xD400)
-	{
-		// MYLOG("VOC", "executeSelfTest failed with error %d", testResult);
-		return false;
-	}
-
-	int32_t index_offset;
-	int32_t learning_time_offset_hours;
-	int32_t learning_time_gain_hours;
-	int32_t gating_max_duration_minutes;
-	int32_t std_initial;
-	int32_t gain_factor;
-	voc_algorithm.get_tuning_parameters(
-		index_offset, learning_time_offset_hours, learning_time_gain_hours,
-		gating_max_duration_minutes, std_initial, gain_factor);
-
-	// Reset discard counter
-	discard_counter = 0;
-
-	// Set VOC reading interval to 10 seconds
-	// Create a unified timer
-	api.system.timer.create(RAK_TIMER_1,do_read_rak12047,RAK_TIMER_PERIODIC);
-	// Start a unified C timer
-	api.system.timer.start(RAK_TIMER_1, sampling_interval*1000, NULL);
-
-	return true;
-}
-
-/**
- * @brief Read the last VOC index
- *     Data is added to Cayenne LPP payload as channel
- *     LPP_CHANNEL_VOC
- *
- */
-void read_rak12047(void)
-{
-	// MYLOG("VOC", "Get VOC");
-	if (voc_valid)
-	{
-		// MYLOG("VOC", "VOC Index: %ld", voc_index);
-
-		g_solution_data.addVoc_index(LPP_CHANNEL_VOC, voc_index);
-	}
-	else
-	{
-		// MYLOG("VOC", "No valid VOC available");
-	}
-}
-
-/**
- * @brief Read the current VOC and feed it to the
- *        VOC algorithm
- *        Called every 1 second by a timer
- *
- */
-void do_read_rak12047(void *)
-{
-#if MY_DEBUG > 0
-	digitalWrite(LED_BLUE, HIGH);
-#endif
-	uint16_t error;
-	uint16_t srawVoc = 0;
-	uint16_t defaultRh = 0x8000; // %RH
-	uint16_t defaultT = 0x6666;	 // degreeC
-	float t_h_values[2] = {0.0};
-
-	if (found_sensors[ENV_ID].found_sensor)
-	{
-		get_rak1906_values(t_h_values);
-		// MYLOG("VOC", "Rh: %.2f T: %.2f", humidity, temperature);
-
-		if ((t_h_values[0] != 0.0) && (t_h_values[1] != 0.0))
-		{
-			defaultRh = (uint16_t)(t_h_values[0] * 65535 / 100);
-			defaultT = (uint16_t)((t_h_values[1] + 45) * 65535 / 175);
-		}
-	}
-
-	// 2. Measure SGP4x signals
-	error = sgp40.measureRawSignal(defaultRh, defaultT,
-								   srawVoc);
-	// MYLOG("VOC", "VOC: %d", srawVoc);
-
-	// 3. Process raw signals by Gas Index Algorithm to get the VOC index values
-	if (error)
-	{
-		// errorToString(error, errorMessage, 256);
-		// MYLOG("VOC", "SGP40 - Error trying to execute measureRawSignals(): %s", errorMessage);
-	}
-	else
-	{
-		if (discard_counter <= 100)
-		{
-			// Discard the first 100 readings
-			voc_algorithm.process(srawVoc);
-			discard_counter++;
-			// MYLOG("VOC", "Discard reading %d", discard_counter);
-		}
-		else if (discard_counter == 101)
-		{
-			// First accepted reading
-			voc_index = voc_algorithm.process(srawVoc);
-			discard_counter++;
-			// MYLOG("VOC", "First good reading: %ld", voc_index);
-		}
-		else
-		{
-			// uint32_t new_voc_index = voc_algorithm.process(srawVoc);
-			voc_index = ((voc_index + voc_algorithm.process(srawVoc)) / 2);
-		}
-		// MYLOG("VOC", "VOC Index: %ld", voc_index);
-		voc_valid = true;
-	}
-
-#if MY_DEBUG > 0
-	digitalWrite(LED_BLUE, LOW);
-#endif
-}
+/**
+ * @file RAK12047_voc.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Read values from the RAK12047 VOC sensor
+ * @version 0.1
+ * @date 2022-04-11
+ * 
+ * @copyright Copyright (c) 2022
+ * 
+ */
+#include "main.h"
+#include <SensirionI2CSgp40.h>
+#include <VOCGasIndexAlgorithm.h>
+#include <new>
+
+/** Time between two VOC readings in seconds */
+int32_t sampling_interval = 10;
+/** Sampling interval the algorithm is set up for, average time between two readings in seconds */
+int32_t voc_algorithm_interval = 10;
+/** Instance for the VOC sensor */
+SensirionI2CSgp40 sgp40;
+/** Instance for the VOC algorithm */
+VOCGasIndexAlgorithm voc_algorithm(voc_algorithm_interval);
+
+/** Calculated VOC index */
+int32_t voc_index = 0;
+
+/** Flag if the VOC index is valid */
+bool voc_valid = false;
+
+/** Buffer for debug output */
+char errorMessage[256];
+
+/** Algorithm time in seconds left before the VOC index is used, counts down with every reading */
+int32_t voc_warmup_left = VOC_WARMUP_TIME;
+
+/** Time in seconds the algorithm has learned, survives a reboot with the saved state */
+uint32_t voc_learned_time = 0;
+/** millis() of the last checkpoint of the algorithm state */
+uint32_t voc_checkpoint_time = 0;
+
+/** Marker and layout version of the VOC state stored in flash */
+#define VOC_STATE_MARKER 0xC2
+/** Size of the VOC state in flash, marker + 2 states + learned time + CRC */
+#define VOC_STATE_SIZE 15
+/** Save the algorithm state every 6 hours */
+#define VOC_CHECKPOINT_INTERVAL (6 * 3600 * 1000UL)
+/** The state is only saved and restored after 3 hours of learning */
+#define VOC_MIN_LEARNED_TIME (3 * 3600UL)
+/** Warm-up time in seconds after a restore, covers the 45 s initial blackout of the algorithm */
+#define VOC_RESTORE_WARMUP 50
+
+/** VOC sampling mode, VOC_MODE_CONTINUOUS or VOC_MODE_BURST */
+uint8_t g_voc_mode = VOC_MODE_CONTINUOUS;
+/** Readings left in the current burst */
+uint8_t voc_burst_left = 0;
+/** Number of wake ups for VOC readings since power up */
+uint32_t g_voc_wakeups = 0;
+
+// Forward declaration
+void do_read_rak12047(void *);
+void voc_th_ready(void *);
+void voc_burst_start(void *);
+
+/**
+ * @brief Restore the learned state of the VOC algorithm from flash
+ *
+ * @return true if a valid state was restored
+ * @return false if no state, CRC error or not enough learning time
+ */
+bool load_voc_state(void)
+{
+	uint8_t flash_value[VOC_STATE_SIZE];
+	if (!api.system.flash.get(VOC_STATE_OFFSET, flash_value, VOC_STATE_SIZE))
+	{
+		return false;
+	}
+	if (flash_value[0] != VOC_STATE_MARKER)
+	{
+		return false;
+	}
+	uint16_t crc = flash_value[VOC_STATE_SIZE - 2] | (flash_value[VOC_STATE_SIZE - 1] << 8);
+	if (crc != flash_crc16(flash_value, VOC_STATE_SIZE - 2))
+	{
+		MYLOG("VOC", "Stored state CRC error");
+		return false;
+	}
+
+	float state0;
+	float state1;
+	uint32_t learned_time;
+	memcpy(&state0, &flash_value[1], 4);
+	memcpy(&state1, &flash_value[5], 4);
+	memcpy(&learned_time, &flash_value[9], 4);
+
+	// Without RTC the time since the checkpoint is unknown, only restore a baseline that had enough learning time
+	if ((learned_time < VOC_MIN_LEARNED_TIME) || isnan(state0) || isnan(state1))
+	{
+		MYLOG("VOC", "Stored state not usable");
+		return false;
+	}
+
+	voc_algorithm.set_states(state0, state1);
+	voc_learned_time = learned_time;
+	return true;
+}
+
+/**
+ * @brief Save the learned state of the VOC algorithm to flash
+ *
+ * @return true if write to flash was successful
+ * @return false if write to flash failed
+ */
+bool save_voc_state(void)
+{
+	float state0;
+	float state1;
+	voc_algorithm.get_states(state0, state1);
+
+	uint8_t flash_value[VOC_STATE_SIZE];
+	flash_value[0] = VOC_STATE_MARKER;
+	memcpy(&flash_value[1], &state0, 4);
+	memcpy(&flash_value[5], &state1, 4);
+	memcpy(&flash_value[9], &voc_learned_time, 4);
+	uint16_t crc = flash_crc16(flash_value, VOC_STATE_SIZE - 2);
+	flash_value[VOC_STATE_SIZE - 2] = (uint8_t)(crc);
+	flash_value[VOC_STATE_SIZE - 1] = (uint8_t)(crc >> 8);
+	return api.system.flash.set(VOC_STATE_OFFSET, flash_value, VOC_STATE_SIZE);
+}
+
+/**
+ * @brief Set up the algorithm for the average time between two readings
+ *        Continuous mode reads every sampling_interval seconds. Burst
+ *        mode reads VOC_BURST_SAMPLES times per send interval, the
+ *        algorithm learns with the send interval / VOC_BURST_SAMPLES.
+ *        The baseline learning, the gating and the slow filters of the
+ *        algorithm count their time constants in readings times this
+ *        interval. With the 10 s between the readings of a burst they
+ *        would run 15 times slower than the real time at a 15 minute
+ *        send interval, the average keeps them on the real time. The
+ *        fast filter smooths less within a burst, the readings of a
+ *        burst look further apart than they are.
+ *        The library has no setter for the sampling interval, the
+ *        algorithm is constructed again and keeps the learned states.
+ *
+ */
+void voc_update_algorithm_interval(void)
+{
+	int32_t interval = sampling_interval;
+	if (g_voc_mode == VOC_MODE_BURST)
+	{
+		int32_t burst_interval = g_lorawan_settings.send_repeat_time / 1000 / VOC_BURST_SAMPLES;
+		if (burst_interval > interval)
+		{
+			interval = burst_interval;
+		}
+	}
+	if (interval == voc_algorithm_interval)
+	{
+		return;
+	}
+
+	bool keep_states = voc_valid || (voc_learned_time >= VOC_MIN_LEARNED_TIME);
+	float state0;
+	float state1;
+	voc_algorithm.get_states(state0, state1);
+	voc_algorithm.~VOCGasIndexAlgorithm();
+	new (&voc_algorithm) VOCGasIndexAlgorithm(interval);
+	voc_algorithm_interval = interval;
+	if (keep_states)
+	{
+		voc_algorithm.set_states(state0, state1);
+	}
+	else
+	{
+		// Nothing learned yet, start over with the new interval
+		voc_warmup_left = VOC_WARMUP_TIME;
+		voc_learned_time = 0;
+	}
+	MYLOG("VOC", "Algorithm sampling interval %ld s", interval);
+}
+
+/**
+ * @brief Initialize the sensor
+ *
+ * @return true success
+ * @return false failed
+ */
+bool init_rak12047(void)
+{
+	sgp40.begin(Wire);
+
+	uint16_t serialNumber[3];
+	uint8_t serialNumberSize = 3;
+
+	uint16_t error = sgp40.getSerialNumber(serialNumber, serialNumberSize);
+
+	if (error)
+	{
+		// errorToString(error, errorMessage, 256);
+		// MYLOG("VOC", "Error trying to execute getSerialNumber() %s", errorMessage);
+		return false;
+	}
+	else
+	{
+// #if MY_DEBUG > 0
+// 		Serial.print("SerialNumber:");
+// 		Serial.print("0x");
+// 		for (size_t i = 0; i < serialNumberSize; i++)
+// 		{
+// 			uint16_t value = serialNumber[i];
+// 			Serial.print(value < 4096 ? "0" : "");
+// 			Serial.print(value < 256 ? "0" : "");
+// 			Serial.print(value < 16 ? "0" : "");
+// 			Serial.print(value, HEX);
+// 		}
+// 		Serial.println();
+// #endif
+	}
+
+	uint16_t testResult;
+	error = sgp40.executeSelfTest(testResult);
+	if (error)
+	{
+		// errorToString(error, errorMessage, 256);
+		// MYLOG("VOC", "Error trying to execute executeSelfTest() %s", errorMessage);
+		return false;
+	}
+	else if (testResult != 0xD400)
+	{
+		// MYLOG("VOC", "executeSelfTest failed with error %d", testResult);
+		return false;
+	}
+
+	int32_t index_offset;
+	int32_t learning_time_offset_hours;
+	int32_t learning_time_gain_hours;
+	int32_t gating_max_duration_minutes;
+	int32_t std_initial;
+	int32_t gain_factor;
+	voc_algorithm.get_tuning_parameters(
+		index_offset, learning_time_offset_hours, learning_time_gain_hours,
+		gating_max_duration_minutes, std_initial, gain_factor);
+
+	// Reset warm-up time
+	voc_warmup_left = VOC_WARMUP_TIME;
+	voc_learned_time = 0;
+	voc_checkpoint_time = millis();
+
+	// Set up the algorithm for the cadence of the sampling mode before the state is restored
+	voc_update_algorithm_interval();
+
+	// Warm start with the learned baseline from flash
+	if (load_voc_state())
+	{
+		// Only skip the blackout time of the algorithm
+		voc_warmup_left = VOC_RESTORE_WARMUP;
+		MYLOG("VOC", "Restored state, learned %ld s", voc_learned_time);
+	}
+
+	// Set VOC reading interval to 10 seconds
+	sched_create(SCHED_VOC, do_read_rak12047, SCHED_SLACK_VOC);
+	// One-shot job to read the VOC when the T/RH conversion is finished
+	sched_create(SCHED_VOC_TH, voc_th_ready, 0);
+	// One-shot job to start the burst before the next uplink
+	sched_create(SCHED_VOC_BURST, voc_burst_start, SCHED_SLACK_VOC);
+	if (g_voc_mode == VOC_MODE_BURST)
+	{
+		// First burst right away
+		voc_burst_start(NULL);
+	}
+	else
+	{
+		sched_start(SCHED_VOC, sampling_interval * 1000, sampling_interval * 1000);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Start a burst of VOC readings
+ *        The readings are taken every sampling_interval
+ *        seconds, same as in continuous mode. The algorithm
+ *        is set up for the average time between the readings,
+ *        see voc_update_algorithm_interval()
+ *
+ */
+void voc_burst_start(void *)
+{
+	voc_burst_left = VOC_BURST_SAMPLES;
+	sched_start(SCHED_VOC, sampling_interval * 1000, sampling_interval * 1000);
+	do_read_rak12047(NULL);
+}
+
+/**
+ * @brief Schedule the next VOC burst so that it ends
+ *        just before the acquisition of the next uplink
+ *        Called after each uplink and when the send interval changed
+ *
+ */
+void voc_schedule_burst(void)
+{
+	if ((g_voc_mode != VOC_MODE_BURST) || !found_sensors[VOC_ID].found_sensor)
+	{
+		return;
+	}
+	voc_update_algorithm_interval();
+	// The acquisition before the TX slot encodes the last reading of the burst
+	uint32_t burst_time = (VOC_BURST_SAMPLES - 1) * sampling_interval * 1000 + acquisition_lead() + VOC_BURST_LEAD;
+	sched_stop(SCHED_VOC_BURST);
+	if (g_lorawan_settings.send_repeat_time > burst_time)
+	{
+		sched_start(SCHED_VOC_BURST, g_lorawan_settings.send_repeat_time - burst_time, 0);
+	}
+	else if (voc_burst_left == 0)
+	{
+		// Send interval shorter than a burst, start the next burst right away
+		voc_burst_start(NULL);
+	}
+}
+
+/**
+ * @brief Switch to the sampling mode in g_voc_mode
+ *        Accesses the sensor, must run from loop(),
+ *        AT commands queue it with bus_post()
+ *
+ */
+void voc_apply_mode(void)
+{
+	if (!found_sensors[VOC_ID].found_sensor)
+	{
+		return;
+	}
+	sched_stop(SCHED_VOC);
+	sched_stop(SCHED_VOC_BURST);
+	voc_burst_left = 0;
+	voc_update_algorithm_interval();
+	if (g_voc_mode == VOC_MODE_BURST)
+	{
+		sgp40.turnHeaterOff();
+		voc_schedule_burst();
+	}
+	else
+	{
+		sched_start(SCHED_VOC, sampling_interval * 1000, sampling_interval * 1000);
+	}
+}
+
+/**
+ * @brief Add the last VOC index to the payload
+ *     Data is added to Cayenne LPP payload as channel
+ *     LPP_CHANNEL_VOC
+ *
+ */
+void encode_rak12047(const sensor_snapshot_t &values)
+{
+	// MYLOG("VOC", "Get VOC");
+	if (values.voc_valid)
+	{
+		// MYLOG("VOC", "VOC Index: %ld", values.voc_index);
+
+		g_solution_data.addVoc_index(LPP_CHANNEL_VOC, values.voc_index);
+	}
+	else
+	{
+		// MYLOG("VOC", "No valid VOC available");
+	}
+}
+
+/**
+ * @brief Read the current VOC and feed it to the
+ *        VOC algorithm
+ *
+ */
+static void measure_rak12047(void)
+{
+#if MY_DEBUG > 0
+	digitalWrite(LED_BLUE, HIGH);
+#endif
+	uint16_t error;
+	uint16_t srawVoc = 0;
+	uint16_t defaultRh = 0x8000; // %RH
+	uint16_t defaultT = 0x6666;	 // degreeC
+	float t_h_values[2] = {0.0};
+
+	if (found_sensors[ENV_ID].found_sensor)
+	{
+		get_rak1906_values(t_h_values);
+		// MYLOG("VOC", "Rh: %.2f T: %.2f", humidity, temperature);
+
+		if ((t_h_values[0] != 0.0) && (t_h_values[1] != 0.0))
+		{
+			defaultRh = (uint16_t)(t_h_values[1] * 65535 / 100);
+			defaultT = (uint16_t)((t_h_values[0] + 45) * 65535 / 175);
+		}
+	}
+
+	// 2. Measure SGP4x signals
+	error = sgp40.measureRawSignal(defaultRh, defaultT,
+								   srawVoc);
+	// MYLOG("VOC", "VOC: %d", srawVoc);
+
+	// 3. Process raw signals by Gas Index Algorithm to get the VOC index values
+	if (error)
+	{
+		// errorToString(error, errorMessage, 256);
+		// MYLOG("VOC", "SGP40 - Error trying to execute measureRawSignals(): %s", errorMessage);
+	}
+	else
+	{
+		if (voc_warmup_left > 0)
+		{
+			// Discard the readings of the warm-up time, same time in both sampling modes
+			voc_algorithm.process(srawVoc);
+			voc_warmup_left -= voc_algorithm_interval;
+			// MYLOG("VOC", "Discard reading, warm-up %ld s left", voc_warmup_left);
+		}
+		else if (!voc_valid)
+		{
+			// First accepted reading
+			voc_index = voc_algorithm.process(srawVoc);
+			voc_valid = true;
+			// MYLOG("VOC", "First good reading: %ld", voc_index);
+		}
+		else
+		{
+			// uint32_t new_voc_index = voc_algorithm.process(srawVoc);
+			voc_index = ((voc_index + voc_algorithm.process(srawVoc)) / 2);
+		}
+		// MYLOG("VOC", "VOC Index: %ld", voc_index);
+		if (voc_valid)
+		{
+			sensor_snapshot_t *values = snapshot_edit();
+			values->voc_index = voc_index;
+			values->voc_valid = true;
+			snapshot_publish();
+		}
+
+		// Checkpoint the learned baseline
+		voc_learned_time += voc_algorithm_interval;
+		if (((millis() - voc_checkpoint_time) >= VOC_CHECKPOINT_INTERVAL) && (voc_learned_time >= VOC_MIN_LEARNED_TIME))
+		{
+			voc_checkpoint_time = millis();
+			MYLOG("VOC", "Save state %s", save_voc_state() ? "OK" : "NOK");
+		}
+	}
+
+	if ((g_voc_mode == VOC_MODE_BURST) && (voc_burst_left != 0))
+	{
+		voc_burst_left--;
+		if (voc_burst_left == 0)
+		{
+			// Burst finished, keep the hotplate cold until the next one
+			sched_stop(SCHED_VOC);
+			sgp40.turnHeaterOff();
+		}
+	}
+
+#if MY_DEBUG > 0
+	digitalWrite(LED_BLUE, LOW);
+#endif
+}
+
+/**
+ * @brief VOC reading, called every sampling_interval seconds by the scheduler
+ *        If the temperature and humidity for the compensation are too old,
+ *        a T/RH conversion is started and the VOC is read by voc_th_ready()
+ *        when it is finished. The MCU sleeps during the conversion.
+ *
+ */
+void do_read_rak12047(void *)
+{
+	g_voc_wakeups++;
+	if (found_sensors[ENV_ID].found_sensor)
+	{
+		uint32_t conversion_time = start_rak1906_th();
+		if (conversion_time != 0)
+		{
+			sched_start(SCHED_VOC_TH, conversion_time, 0);
+			return;
+		}
+	}
+	measure_rak12047();
+}
+
+/**
+ * @brief Read the VOC after the T/RH conversion started by do_read_rak12047()
+ *
+ */
+void voc_th_ready(void *)
+{
+	g_voc_wakeups++;
+	if (!collect_rak1906_th() && rak1906_th_running())
+	{
+		// Conversion not finished yet, read the VOC when it is
+		sched_start(SCHED_VOC_TH, CONVERSION_RETRY_TIME, 0);
+		return;
+	}
+	measure_rak12047();
+}
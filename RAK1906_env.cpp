@@ -1,216 +1,548 @@
-/**
- * @file RAK1906_env.cpp
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief BME680 sensor functions
- * @version 0.1
- * @date 2022-04-10
- *
- * @copyright Copyright (c) 2022
- *
- */
-#include "main.h"
-#ifndef _VARIANT_RAK3172_
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BME680.h>
-
-/** BME680 instance for Wire */
-Adafruit_BME680 bme(&Wire);
-
-// /** Mean Sea Level Pressure */
-// float mean_seal_level_press = 1013.25;
-
-/**
- * @brief Initialize the BME680 sensor
- *
- * @return true if sensor was found
- * @return false if sensor was not found
- */
-bool init_rak1906(void)
-{
-	Wire.begin();
-
-	if (!bme.begin(0x76))
-	{
-		// MYLOG("BME", "Could not find a valid BME680 sensor, check wiring!");
-		return false;
-	}
-
-	// Set up oversampling and filter initialization
-	bme.setTemperatureOversampling(BME680_OS_8X);
-	bme.setHumidityOversampling(BME680_OS_2X);
-	bme.setPressureOversampling(BME680_OS_4X);
-	bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
-	bme.setGasHeater(320, 150); // 320*C for 150 ms
-
-	return true;
-}
-
-/**
- * @brief Read environment data from BME680
- *     Data is added to Cayenne LPP payload as channels
- *     LPP_CHANNEL_HUMID_2, LPP_CHANNEL_TEMP_2,
- *     LPP_CHANNEL_PRESS_2 and LPP_CHANNEL_GAS_2
- *
- *
- * @return true if reading was successful
- * @return false if reading failed
- */
-bool read_rak1906()
-{
-	// MYLOG("BME", "Reading BME680");
-	bme.beginReading();
-	time_t wait_start = millis();
-	bool read_success = false;
-	while ((millis() - wait_start) < 5000)
-	{
-		if (bme.endReading())
-		{
-			read_success = true;
-			break;
-		}
-	}
-
-	if (!read_success)
-	{
-		// MYLOG("BME", "BME reading timeout");
-		return false;
-	}
-
-	MYLOG("BME", "Temperature: %.2f", bme.humidity);
-	MYLOG("BME", "Humidity: %.2f", bme.humidity);
-	MYLOG("BME", "Barometer: %.2f", bme.pressure / 100.0);
-	MYLOG("BME", "Gas resistance: %.2f", (float)(bme.gas_resistance / 1000.0));
-
-	g_solution_data.addRelativeHumidity(LPP_CHANNEL_HUMID_2, bme.humidity);
-	g_solution_data.addTemperature(LPP_CHANNEL_TEMP_2, bme.temperature);
-	g_solution_data.addBarometricPressure(LPP_CHANNEL_PRESS_2, bme.pressure / 100.0);
-	g_solution_data.addAnalogInput(LPP_CHANNEL_GAS_2, (float)(bme.gas_resistance) / 1000.0);
-
-	return true;
-}
-
-/**
- * @brief Returns the latest values from the sensor
- *        or starts a new reading
- *
- * @param values array for temperature [0] and humidity [1]
- */
-void get_rak1906_values(float *values)
-{
-	values[0] = bme.temperature;
-	values[1] = bme.humidity;
-	return;
-}
-
-#else // _VARIANT_RAK3172_
-#include "rak1906.h"
-
-#pragma message("RAK3172")
-
-/** BME680 instance for Wire */
-rak1906 bme;
-
-/** Last temperature read */
-float _last_bme_temp = 0;
-/** Last humidity read */
-float _last_bme_humid = 0;
-/** Flag if values were read already (used by RAK12047 VOC sensor) */
-bool _has_last_bme_values = false;
-
-/**
- * @brief Initialize the BME680 sensor
- *
- * @return true if sensor was found
- * @return false if sensor was not found
- */
-bool init_rak1906(void)
-{
-	Wire.begin();
-
-	if (!bme.init())
-	{
-		MYLOG("BME", "Could not find a valid BME680 sensor, check wiring!");
-		return false;
-	}
-
-	// Set up oversampling and filter initialization
-	/// \todo Needs to be implemented in the RUI3 RAK1906 library!!!!
-	bme.setOversampling(TemperatureSensor, Oversample8);
-	bme.setOversampling(HumiditySensor, Oversample2);
-	bme.setOversampling(PressureSensor, Oversample4);
-	bme.setIIRFilter(IIR4);
-	bme.setGas(320, 150); // 320*C for 150 ms
-
-	return true;
-}
-
-/**
- * @brief Read environment data from BME680
- *     Data is added to Cayenne LPP payload as channels
- *     LPP_CHANNEL_HUMID_2, LPP_CHANNEL_TEMP_2,
- *     LPP_CHANNEL_PRESS_2 and LPP_CHANNEL_GAS_2
- *
- *
- * @return true if reading was successful
- * @return false if reading failed
- */
-bool read_rak1906()
-{
-	MYLOG("BME", "Reading BME680");
-	if (!bme.update())
-	{
-		MYLOG("BME", "BME reading timeout");
-		return false;
-	}
-
-#if MY_DEBUG > 0
-	int16_t temp_int = (int16_t)(bme.temperature() * 10.0);
-	uint16_t humid_int = (uint16_t)(bme.humidity() * 2);
-	uint16_t press_int = (uint16_t)(bme.pressure() * 100);
-	uint16_t gasres_int = (uint16_t)(bme.gas() / 10);
-#endif
-
-	g_solution_data.addRelativeHumidity(LPP_CHANNEL_HUMID_2, bme.humidity());
-	g_solution_data.addTemperature(LPP_CHANNEL_TEMP_2, bme.temperature());
-	g_solution_data.addBarometricPressure(LPP_CHANNEL_PRESS_2, bme.pressure());
-	g_solution_data.addAnalogInput(LPP_CHANNEL_GAS_2, (float)(bme.gas()) / 1000.0);
-
-#if MY_DEBUG > 0
-	MYLOG("BME", "RH= %.2f T= %.2f", bme.humidity(), bme.temperature());
-	MYLOG("BME", "P= %.2f R= %.2f", bme.pressure(), (float)(bme.gas()) / 1000.0);
-#endif
-
-	_last_bme_temp = bme.humidity();
-	_last_bme_humid = bme.temperature();
-	_has_last_bme_values = true;
-
-	return true;
-}
-
-/**
- * @brief Returns the latest values from the sensor
- *        or starts a new reading
- *
- * @param values array for temperature [0] and humidity [1]
- */
-void get_rak1906_values(float *values)
-{
-	if (_has_last_bme_values)
-	{
-		_has_last_bme_values = false;
-		values[0] = _last_bme_temp;
-		values[1] = _last_bme_humid;
-		return;
-	}
-	else
-	{
-		// start_rak1906();
-		// delay(100);
-		read_rak1906();
-		values[0] = _last_bme_temp;
-		values[1] = _last_bme_humid;
-	}
-	return;
-}
-
+/**
+ * @file RAK1906_env.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief BME680 sensor functions
+ * @version 0.1
+ * @date 2022-04-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "main.h"
+
+/** Maximum age of the cached temperature and humidity in milliseconds */
+uint32_t g_bme_th_max_age = BME_TH_MAX_AGE;
+
+/** Shared temperature and humidity sample, used for the payload and the VOC compensation */
+struct bme_th_cache_s
+{
+	int32_t temp_centi = 0;	 // Temperature in 0.01 °C
+	int32_t humid_milli = 0; // Humidity in 0.001 %RH
+	uint32_t timestamp = 0;	 // millis() when the sample was taken
+	bool valid = false;		 // Flag if a sample was taken already
+	uint32_t hits = 0;		 // Requests served from the cache
+	uint32_t misses = 0;	 // Requests that needed a new conversion
+} bme_th_cache;
+
+/** Flag if a forced measurement started by start_rak1906() is running */
+volatile bool bme_conversion_running = false;
+/** Flag if a temperature and humidity conversion started by start_rak1906_th() is running */
+bool bme_th_running = false;
+/** millis() when the temperature and humidity conversion is finished */
+uint32_t bme_th_end = 0;
+/** Flag if start_rak1906() waits for the end of the temperature and humidity conversion */
+bool bme_payload_pending = false;
+/** Conversion time in ms of the last forced measurement with gas */
+uint32_t bme_payload_time = 0;
+
+/**
+ * @brief Store a new temperature and humidity sample in the cache
+ *
+ * @param temp_centi temperature in 0.01 °C
+ * @param humid_milli humidity in 0.001 %RH
+ */
+static void store_rak1906_values(int32_t temp_centi, int32_t humid_milli)
+{
+	bme_th_cache.temp_centi = temp_centi;
+	bme_th_cache.humid_milli = humid_milli;
+	bme_th_cache.timestamp = millis();
+	bme_th_cache.valid = true;
+}
+
+// Variant specific forced measurements, with gas for the payload, temperature and humidity only for the VOC compensation
+static uint32_t start_payload_conversion(void);
+static bool collect_payload_conversion(void);
+static uint32_t start_th_conversion(void);
+static bool collect_th_conversion(void);
+
+/**
+ * @brief Returns the latest temperature and humidity from the cache
+ *        The cache is refreshed by the payload measurement and
+ *        by start_rak1906_th() / collect_rak1906_th()
+ *
+ * @param values array for temperature [0] and humidity [1], 0.0 if there are no values yet
+ */
+void get_rak1906_values(float *values)
+{
+	if (!bme_th_cache.valid)
+	{
+		values[0] = 0.0;
+		values[1] = 0.0;
+		return;
+	}
+	values[0] = bme_th_cache.temp_centi / 100.0;
+	values[1] = bme_th_cache.humid_milli / 1000.0;
+}
+
+/**
+ * @brief Start a temperature and humidity conversion with the gas heater off
+ *        if the cached values are older than g_bme_th_max_age
+ *        The results are read with collect_rak1906_th() after the
+ *        returned time has passed
+ *
+ * @return uint32_t time in ms until the conversion is finished
+ *         0 if the cached values are used
+ */
+uint32_t start_rak1906_th(void)
+{
+	if (bme_th_cache.valid && ((millis() - bme_th_cache.timestamp) <= g_bme_th_max_age))
+	{
+		bme_th_cache.hits++;
+		return 0;
+	}
+	bme_th_cache.misses++;
+	// Do not disturb a running measurement, use the last values instead
+	if (bme_conversion_running || bme_th_running)
+	{
+		return 0;
+	}
+	uint32_t conversion_time = start_th_conversion();
+	if (conversion_time == 0)
+	{
+		MYLOG("BME", "T/RH refresh failed");
+		return 0;
+	}
+	bme_th_running = true;
+	bme_th_end = millis() + conversion_time;
+	return conversion_time;
+}
+
+/**
+ * @brief Read the results of the conversion started with start_rak1906_th()
+ *        into the cache and start a payload measurement that was
+ *        requested in the meantime
+ *        A conversion that is not finished yet stays running, call
+ *        again after CONVERSION_RETRY_TIME. It is given up
+ *        BME_TH_TIMEOUT ms after its expected end.
+ *
+ * @return true if the cache was refreshed
+ * @return false if no conversion was running, it is not finished or reading failed
+ */
+bool collect_rak1906_th(void)
+{
+	if (!bme_th_running)
+	{
+		return false;
+	}
+	bool result = collect_th_conversion();
+	if (!result)
+	{
+		if ((int32_t)(millis() - bme_th_end) < BME_TH_TIMEOUT)
+		{
+			// Sensor is still measuring, a new trigger would disturb it
+			return false;
+		}
+		MYLOG("BME", "T/RH refresh failed");
+	}
+	bme_th_running = false;
+	if (bme_payload_pending)
+	{
+		bme_payload_pending = false;
+		start_payload_conversion();
+	}
+	return result;
+}
+
+/**
+ * @brief Check if a conversion started with start_rak1906_th() is not collected yet
+ *
+ * @return true if the conversion is running
+ */
+bool rak1906_th_running(void)
+{
+	return bme_th_running;
+}
+
+/**
+ * @brief Start a measurement of the BME680
+ *        The results are read with collect_rak1906()
+ *        after the returned time has passed
+ *        A running temperature and humidity conversion is not
+ *        disturbed, the measurement starts when it is collected
+ *
+ * @return uint32_t time in ms until the conversion is finished
+ */
+uint32_t start_rak1906(void)
+{
+	if (bme_th_running)
+	{
+		bme_payload_pending = true;
+		bme_conversion_running = true;
+		int32_t th_left = (int32_t)(bme_th_end - millis());
+		return (th_left > 0 ? th_left : 0) + bme_payload_time;
+	}
+	return start_payload_conversion();
+}
+
+/**
+ * @brief Read the results of the measurement from BME680
+ *     The measurement must have been started with start_rak1906()
+ *
+ * @return true if reading was successful
+ * @return false if reading failed or the conversion is not finished yet
+ */
+bool collect_rak1906(void)
+{
+	if (bme_payload_pending)
+	{
+		// The temperature and humidity conversion was not collected yet, do it now and start the measurement
+		collect_rak1906_th();
+		return false;
+	}
+	return collect_payload_conversion();
+}
+
+/**
+ * @brief Get the usage counters of the temperature and humidity cache
+ *
+ * @param hits requests served from the cache
+ * @param misses requests that needed a new conversion
+ */
+void get_rak1906_cache_stats(uint32_t &hits, uint32_t &misses)
+{
+	hits = bme_th_cache.hits;
+	misses = bme_th_cache.misses;
+}
+
+/**
+ * @brief Add the environment data to the payload
+ *     Data is added to Cayenne LPP payload as channels
+ *     LPP_CHANNEL_HUMID_2, LPP_CHANNEL_TEMP_2,
+ *     LPP_CHANNEL_PRESS_2 and LPP_CHANNEL_GAS_2
+ *
+ * @param values snapshot with the values of collect_rak1906()
+ */
+void encode_rak1906(const sensor_snapshot_t &values)
+{
+	if (!values.env_valid)
+	{
+		return;
+	}
+	// Scale to the LPP resolution, same values as the float functions of CayenneLPP
+	g_solution_data.addRelativeHumidity_x2(LPP_CHANNEL_HUMID_2, (uint8_t)(values.env_humidity / 500));
+	g_solution_data.addTemperature_x10(LPP_CHANNEL_TEMP_2, (int16_t)(values.env_temperature / 10));
+	g_solution_data.addBarometricPressure_x10(LPP_CHANNEL_PRESS_2, (uint16_t)(values.env_pressure / 10));
+	// Gas resistance in kOhm with 0.01 resolution like the README and the decoders, clean air can be above the int16 range
+	// The float path of the RAK3172 sent 1 kOhm resolution (rak1906::gas() is Ohm / 100), the RAK4631 already used 0.01 kOhm
+	uint32_t gasres_x100 = values.env_gas / 10;
+	if (gasres_x100 > INT16_MAX)
+	{
+		gasres_x100 = INT16_MAX;
+	}
+	g_solution_data.addAnalogInput_x100(LPP_CHANNEL_GAS_2, (int16_t)gasres_x100);
+}
+
+#ifndef _VARIANT_RAK3172_
+#include <Adafruit_Sensor.h>
+#include <Adafruit_BME680.h>
+
+/** BME680 instance for Wire */
+Adafruit_BME680 bme(&Wire);
+
+// /** Mean Sea Level Pressure */
+// float mean_seal_level_press = 1013.25;
+
+/**
+ * @brief Initialize the BME680 sensor
+ *
+ * @return true if sensor was found
+ * @return false if sensor was not found
+ */
+bool init_rak1906(void)
+{
+	Wire.begin();
+
+	if (!bme.begin(0x76))
+	{
+		// MYLOG("BME", "Could not find a valid BME680 sensor, check wiring!");
+		return false;
+	}
+
+	// Set up oversampling and filter initialization
+	bme.setTemperatureOversampling(BME680_OS_8X);
+	bme.setHumidityOversampling(BME680_OS_2X);
+	bme.setPressureOversampling(BME680_OS_4X);
+	bme.setIIRFilterSize(BME680_FILTER_SIZE_3);
+	bme.setGasHeater(320, 150); // 320*C for 150 ms
+
+	return true;
+}
+
+/**
+ * @brief Start a forced measurement of the BME680
+ *        The results are read with collect_payload_conversion()
+ *        after the returned time has passed
+ *
+ * @return uint32_t time in ms until the conversion is finished
+ */
+static uint32_t start_payload_conversion(void)
+{
+	unsigned long reading_end = bme.beginReading();
+	if (reading_end == 0)
+	{
+		// MYLOG("BME", "Could not start BME680 reading");
+		return 0;
+	}
+	bme_conversion_running = true;
+	unsigned long now = millis();
+	bme_payload_time = (reading_end > now) ? (uint32_t)(reading_end - now) : 0;
+	return bme_payload_time;
+}
+
+/**
+ * @brief Read the results of the forced measurement from BME680
+ *
+ * @return true if reading was successful
+ * @return false if reading failed
+ */
+static bool collect_payload_conversion(void)
+{
+	// MYLOG("BME", "Reading BME680");
+	bool result = bme.endReading();
+	bme_conversion_running = false;
+	if (!result)
+	{
+		// MYLOG("BME", "BME reading failed");
+		return false;
+	}
+
+	MYLOG("BME", "Temperature: %.2f", bme.temperature);
+	MYLOG("BME", "Humidity: %.2f", bme.humidity);
+	MYLOG("BME", "Barometer: %.2f", bme.pressure / 100.0);
+	MYLOG("BME", "Gas resistance: %.2f", (float)(bme.gas_resistance / 1000.0));
+
+	store_rak1906_values((int32_t)(bme.temperature * 100.0), (int32_t)(bme.humidity * 1000.0));
+
+	sensor_snapshot_t *values = snapshot_edit();
+	values->env_temperature = (int32_t)(bme.temperature * 100.0);
+	values->env_humidity = (int32_t)(bme.humidity * 1000.0);
+	values->env_pressure = (int32_t)bme.pressure;
+	values->env_gas = bme.gas_resistance;
+	values->env_valid = true;
+	snapshot_publish();
+
+	return true;
+}
+
+/**
+ * @brief Start a temperature and humidity conversion with the gas heater off
+ *        The heater is switched on again in collect_th_conversion(),
+ *        changing it earlier would abort the conversion
+ *
+ * @return uint32_t time in ms until the conversion is finished, 0 if it failed
+ */
+static uint32_t start_th_conversion(void)
+{
+	bme.setGasHeater(0, 0);
+	unsigned long reading_end = bme.beginReading();
+	if (reading_end == 0)
+	{
+		bme.setGasHeater(320, 150); // 320*C for 150 ms
+		return 0;
+	}
+	unsigned long now = millis();
+	return (reading_end > now) ? (uint32_t)(reading_end - now) : 1;
+}
+
+/**
+ * @brief Read the temperature and humidity conversion into the cache
+ *
+ * @return true if reading was successful
+ * @return false if reading failed
+ */
+static bool collect_th_conversion(void)
+{
+	bool result = bme.endReading();
+	bme.setGasHeater(320, 150); // 320*C for 150 ms
+	if (!result)
+	{
+		return false;
+	}
+	store_rak1906_values((int32_t)(bme.temperature * 100.0), (int32_t)(bme.humidity * 1000.0));
+	return true;
+}
+
+#else // _VARIANT_RAK3172_
+#include "rak1906.h"
+
+#pragma message("RAK3172")
+
+/** BME680 instance for Wire */
+rak1906 bme;
+
+/** Marker and layout version of the calibration stored in flash */
+#define BME_CALIB_MARKER 0xB1
+/** Size of the calibration in flash, marker + coefficients + CRC */
+#define BME_CALIB_SIZE (sizeof(rak1906_calib_t) + 3)
+
+static_assert(BME_CALIB_SIZE <= 48, "BME680 calibration does not fit into the reserved flash space");
+
+/**
+ * @brief Read the calibration of the BME680 from flash
+ *
+ * @param calib structure for the calibration
+ * @return true if a valid calibration was found
+ * @return false if no calibration or the CRC does not match
+ */
+bool load_bme_calibration(rak1906_calib_t &calib)
+{
+	uint8_t flash_value[BME_CALIB_SIZE];
+	if (!api.system.flash.get(BME_CALIB_OFFSET, flash_value, BME_CALIB_SIZE))
+	{
+		return false;
+	}
+	if (flash_value[0] != BME_CALIB_MARKER)
+	{
+		return false;
+	}
+	uint16_t crc = flash_value[BME_CALIB_SIZE - 2] | (flash_value[BME_CALIB_SIZE - 1] << 8);
+	if (crc != flash_crc16(flash_value, BME_CALIB_SIZE - 2))
+	{
+		MYLOG("BME", "Stored calibration CRC error");
+		return false;
+	}
+	memcpy(&calib, &flash_value[1], sizeof(rak1906_calib_t));
+	return true;
+}
+
+/**
+ * @brief Save the calibration of the BME680 to flash
+ *
+ * @param calib calibration read from the sensor
+ * @return true if write to flash was successful
+ * @return false if write to flash failed
+ */
+bool save_bme_calibration(const rak1906_calib_t &calib)
+{
+	uint8_t flash_value[BME_CALIB_SIZE];
+	flash_value[0] = BME_CALIB_MARKER;
+	memcpy(&flash_value[1], &calib, sizeof(rak1906_calib_t));
+	uint16_t crc = flash_crc16(flash_value, BME_CALIB_SIZE - 2);
+	flash_value[BME_CALIB_SIZE - 2] = (uint8_t)(crc);
+	flash_value[BME_CALIB_SIZE - 1] = (uint8_t)(crc >> 8);
+	return api.system.flash.set(BME_CALIB_OFFSET, flash_value, BME_CALIB_SIZE);
+}
+
+/**
+ * @brief Initialize the BME680 sensor
+ *
+ * @return true if sensor was found
+ * @return false if sensor was not found
+ */
+bool init_rak1906(void)
+{
+	Wire.begin();
+
+	// Use the calibration from flash if it belongs to this sensor
+	rak1906_calib_t calib;
+	bool has_calib = load_bme_calibration(calib);
+	if (!bme.init(has_calib ? &calib : NULL))
+	{
+		MYLOG("BME", "Could not find a valid BME680 sensor, check wiring!");
+		return false;
+	}
+
+	if (!bme.calibrationFromCache())
+	{
+		// New sensor or no valid calibration in flash
+		bme.getCalibrationData(calib);
+		MYLOG("BME", "Save calibration %s", save_bme_calibration(calib) ? "OK" : "NOK");
+	}
+	else
+	{
+		MYLOG("BME", "Calibration from flash");
+	}
+
+	// Set up oversampling and filter initialization
+	/// \todo Needs to be implemented in the RUI3 RAK1906 library!!!!
+	bme.setOversampling(TemperatureSensor, Oversample8);
+	bme.setOversampling(HumiditySensor, Oversample2);
+	bme.setOversampling(PressureSensor, Oversample4);
+	bme.setIIRFilter(IIR4);
+	bme.setGas(320, 150); // 320*C for 150 ms
+	// Write the changed settings in one burst
+	bme.flushConfig();
+
+	MYLOG("BME", "Init I2C transactions %ld", bme.i2cTransactions());
+	bme.resetI2cTransactions();
+
+	return true;
+}
+
+/**
+ * @brief Start a forced measurement of the BME680
+ *        The results are read with collect_payload_conversion()
+ *        after the returned time has passed
+ *
+ * @return uint32_t time in ms until the conversion is finished
+ */
+static uint32_t start_payload_conversion(void)
+{
+	bme_conversion_running = true;
+	bme_payload_time = bme.startMeasurement();
+	return bme_payload_time;
+}
+
+/**
+ * @brief Read the results of the forced measurement from BME680
+ *
+ * @return true if reading was successful
+ * @return false if the conversion is not finished
+ */
+static bool collect_payload_conversion(void)
+{
+	MYLOG("BME", "Reading BME680");
+	if (!bme.collect())
+	{
+		MYLOG("BME", "BME conversion not finished");
+		return false;
+	}
+	bme_conversion_running = false;
+
+#if MY_DEBUG > 0
+	MYLOG("BME", "RH= %ld x0.001%% T= %ld x0.01C", bme.humidityMilli(), bme.temperatureCenti());
+	MYLOG("BME", "P= %ld Pa R= %ld Ohm", bme.pressurePa(), bme.gasOhm());
+	MYLOG("BME", "I2C transactions %ld", bme.i2cTransactions());
+	bme.resetI2cTransactions();
+#endif
+
+	store_rak1906_values(bme.temperatureCenti(), bme.humidityMilli());
+
+	sensor_snapshot_t *values = snapshot_edit();
+	values->env_temperature = bme.temperatureCenti();
+	values->env_humidity = bme.humidityMilli();
+	values->env_pressure = bme.pressurePa();
+	values->env_gas = bme.gasOhm();
+	values->env_valid = true;
+	snapshot_publish();
+
+	return true;
+}
+
+/**
+ * @brief Start a temperature and humidity conversion with the gas heater off
+ *
+ * @return uint32_t time in ms until the conversion is finished
+ */
+static uint32_t start_th_conversion(void)
+{
+	return bme.startMeasurementNoGas();
+}
+
+/**
+ * @brief Read the temperature and humidity conversion into the cache
+ *
+ * @return true if reading was successful
+ * @return false if the conversion is not finished
+ */
+static bool collect_th_conversion(void)
+{
+	if (!bme.collect())
+	{
+		return false;
+	}
+	store_rak1906_values(bme.temperatureCenti(), bme.humidityMilli());
+	return true;
+}
+
 #endif // _VARIANT_RAK3172_
\ No newline at end of file
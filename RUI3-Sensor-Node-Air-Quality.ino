@@ -1,204 +1,551 @@
-/**
- * @file WisBlock-Sensor-Node.ino
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief RUI3 based code for easy testing of WisBlock I2C modules
- * @version 0.1
- * @date 2022-04-10
- *
- * @copyright Copyright (c) 2022
- *
- */
-#include "main.h"
-#include "udrv_timer.h"
-
-/** Initialization results */
-bool ret;
-
-/** LoRaWAN packet */
-WisCayenne g_solution_data(255);
-
-/** Set the device name, max length is 10 characters */
-char g_dev_name[64] = "RUI3 Sensor Node                                              ";
-
-/** Device settings */
-s_lorawan_settings g_lorawan_settings;
-s_lorawan_settings check_settings;
-
-/** OTAA Device EUI MSB */
-uint8_t node_device_eui[8] = {0}; // ac1f09fff8683172
-/** OTAA Application EUI MSB */
-uint8_t node_app_eui[8] = {0}; // ac1f09fff8683172
-/** OTAA Application Key MSB */
-uint8_t node_app_key[16] = {0}; // efadff29c77b4829acf71e1a6e76f713
-
-/**
- * @brief Callback after packet was received
- *
- * @param data Structure with the received data
- */
-void receiveCallback(SERVICE_LORA_RECEIVE_T *data)
-{
-	MYLOG("RX-CB", "RX, fP %d, DR %d, RSSI %d, SNR %d", data->Port, data->RxDatarate, data->Rssi, data->Snr);
-	for (int i = 0; i < data->BufferSize; i++)
-	{
-		Serial.printf("%02X", data->Buffer[i]);
-	}
-	Serial.print("\r\n");
-}
-
-/**
- * @brief Callback after TX is finished
- *
- * @param status TX status
- */
-void sendCallback(int32_t status)
-{
-	MYLOG("TX-CB", "TX %d", status);
-	digitalWrite(LED_BLUE, LOW);
-}
-
-/**
- * @brief Callback after join request cycle
- *
- * @param status Join result
- */
-void joinCallback(int32_t status)
-{
-	// MYLOG("JOIN-CB", "Join result %d", status);
-	if (status != 0)
-	{
-		if (!(ret = api.lorawan.join()))
-		{
-			MYLOG("J-CB", "Fail! \r\n");
-		}
-	}
-	else
-	{
-		MYLOG("J-CB", "DR  %s", api.lorawan.dr.set(g_lorawan_settings.data_rate) ? "OK" : "NOK");
-		MYLOG("J-CB", "ADR  %s", api.lorawan.adr.set(g_lorawan_settings.adr_enabled ? 1 : 0) ? "OK" : "NOK");
-		MYLOG("J-CB", "Joined\r\n");
-		digitalWrite(LED_BLUE, LOW);
-	}
-}
-
-/**
- * @brief Arduino setup, called once after reboot/power-up
- *
- */
-void setup()
-{
-	// Setup the callbacks for joined and send finished
-	api.lorawan.registerRecvCallback(receiveCallback);
-	api.lorawan.registerSendCallback(sendCallback);
-	api.lorawan.registerJoinCallback(joinCallback);
-
-	pinMode(LED_GREEN, OUTPUT);
-	digitalWrite(LED_GREEN, HIGH);
-	pinMode(LED_BLUE, OUTPUT);
-	digitalWrite(LED_BLUE, HIGH);
-
-	pinMode(WB_IO2, OUTPUT);
-	digitalWrite(WB_IO2, HIGH);
-
-	// Use RAK_CUSTOM_MODE supresses AT command and default responses from RUI3
-	// Serial.begin(115200, RAK_CUSTOM_MODE);
-	// Use "normal" mode to have AT commands available
-	Serial.begin(115200);
-
-#ifdef _VARIANT_RAK4630_
-	time_t serial_timeout = millis();
-	// On nRF52840 the USB serial is not available immediately
-	while (!Serial.available())
-	{
-		if ((millis() - serial_timeout) < 5000)
-		{
-			delay(100);
-			digitalWrite(LED_GREEN, !digitalRead(LED_GREEN));
-		}
-		else
-		{
-			break;
-		}
-	}
-#else
-	// For RAK3172 just wait a little bit for the USB to be ready
-	delay(5000);
-#endif
-
-	// Add custom status AT command
-	init_status_at();
-
-	MYLOG("SETUP", "RAKwireless %s Node", g_dev_name);
-	MYLOG("SETUP", "Setup the device with AT commands first");
-
-	// Search for modules
-	find_modules();
-	
-	// Get saved sending frequency from flash
-	get_at_setting(SEND_INT_OFFSET);
-
-	// Create a unified timer
-	api.system.timer.create(RAK_TIMER_0,sensor_handler,RAK_TIMER_PERIODIC);
-	if (g_lorawan_settings.send_repeat_time != 0)
-	{
-		// Start a unified C timer
-		api.system.timer.start(RAK_TIMER_0, g_lorawan_settings.send_repeat_time, NULL);
-	}
-
-	// Register the custom AT command to set the send interval
-	MYLOG("SETUP", "Add custom AT command %s", init_send_interval_at() ? "Success" : "Fail");
-
-	// Show found modules
-	announce_modules();
-}
-
-/**
- * @brief sensor_handler is a timer function called every
- * g_lorawan_settings.send_repeat_time milliseconds. Default is 120000. Can be
- * changed in main.h
- *
- */
-void sensor_handler(void *)
-{
-	// MYLOG("SENS", "Start");
-	digitalWrite(LED_BLUE, HIGH);
-
-	// Check if the node has joined the network
-	if (!api.lorawan.njs.get())
-	{
-		// MYLOG("UPL", "Not joined, skip sending");
-		return;
-	}
-
-	// Clear payload
-	g_solution_data.reset();
-
-	// Read sensor data
-	get_sensor_values();
-
-	// Add battery voltage
-	g_solution_data.addVoltage(LPP_CHANNEL_BATT, api.system.bat.get());
-	// MYLOG("UPL", "Bat %.4f", api.system.bat.get());
-	// MYLOG("UPL", "Send %d", g_solution_data.getSize());
-
-	// Send the packet
-	if (api.lorawan.send(g_solution_data.getSize(), g_solution_data.getBuffer(), 2, g_lorawan_settings.confirmed_msg_enabled))
-	{
-		MYLOG("UPL", "Enqueued");
-	}
-	else
-	{
-		MYLOG("UPL", "Send fail");
-	}
-}
-
-/**
- * @brief This example is complete timer
- * driven. The loop() does nothing than
- * sleep.
- *
- */
-void loop()
-{
-	api.system.sleep.all();
+/**
+ * @file WisBlock-Sensor-Node.ino
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief RUI3 based code for easy testing of WisBlock I2C modules
+ * @version 0.1
+ * @date 2022-04-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "main.h"
+#include "udrv_timer.h"
+
+/** Initialization results */
+bool ret;
+
+/** LoRaWAN packet */
+WisCayenne g_solution_data(255);
+
+/** Set the device name, max length is 10 characters */
+char g_dev_name[64] = "RUI3 Sensor Node                                              ";
+
+/** Device settings */
+s_lorawan_settings g_lorawan_settings;
+s_lorawan_settings check_settings;
+
+/** State of the payload for the next TX slot */
+enum
+{
+	PAYLOAD_IDLE = 0, // No acquisition for the next TX slot
+	PAYLOAD_RUNNING,  // Sensors are read
+	PAYLOAD_READY	  // Payload is encoded and waits for the TX slot
+} payload_state = PAYLOAD_IDLE;
+
+/** Flag if the TX slot passed while the payload was not ready */
+bool tx_slot_missed = false;
+/** millis() of the TX slot the payload is for */
+uint32_t tx_slot_time = 0;
+
+/** Sensor values and battery voltage of the prepared payload, queued if it cannot be sent */
+sensor_snapshot_t payload_values;
+float payload_battery = 0.0;
+
+/** Time in ms until the next try to send queued samples */
+uint32_t sf_drain_interval = SF_DRAIN_INTERVAL;
+
+/** OTAA Device EUI MSB */
+uint8_t node_device_eui[8] = {0}; // ac1f09fff8683172
+/** OTAA Application EUI MSB */
+uint8_t node_app_eui[8] = {0}; // ac1f09fff8683172
+/** OTAA Application Key MSB */
+uint8_t node_app_key[16] = {0}; // efadff29c77b4829acf71e1a6e76f713
+
+/**
+ * @brief Callback after packet was received
+ *
+ * @param data Structure with the received data
+ */
+void receiveCallback(SERVICE_LORA_RECEIVE_T *data)
+{
+	MYLOG("RX-CB", "RX, fP %d, DR %d, RSSI %d, SNR %d", data->Port, data->RxDatarate, data->Rssi, data->Snr);
+	for (int i = 0; i < data->BufferSize; i++)
+	{
+		Serial.printf("%02X", data->Buffer[i]);
+	}
+	Serial.print("\r\n");
+
+	if (data->Port == DELTA_FPORT)
+	{
+		// Decoder lost the keyframe
+		delta_request_keyframe();
+	}
+}
+
+/**
+ * @brief Callback after TX is finished
+ *
+ * @param status TX status
+ */
+void sendCallback(int32_t status)
+{
+	MYLOG("TX-CB", "TX %d", status);
+	digitalWrite(LED_BLUE, LOW);
+}
+
+/**
+ * @brief Callback after join request cycle
+ *
+ * @param status Join result
+ */
+void joinCallback(int32_t status)
+{
+	// MYLOG("JOIN-CB", "Join result %d", status);
+	if (status != 0)
+	{
+		if (!(ret = api.lorawan.join()))
+		{
+			MYLOG("J-CB", "Fail! \r\n");
+		}
+	}
+	else
+	{
+		MYLOG("J-CB", "DR  %s", api.lorawan.dr.set(g_lorawan_settings.data_rate) ? "OK" : "NOK");
+		MYLOG("J-CB", "ADR  %s", api.lorawan.adr.set(g_lorawan_settings.adr_enabled ? 1 : 0) ? "OK" : "NOK");
+		MYLOG("J-CB", "Joined\r\n");
+		digitalWrite(LED_BLUE, LOW);
+	}
+}
+
+/**
+ * @brief Arduino setup, called once after reboot/power-up
+ *
+ */
+void setup()
+{
+	// Setup the callbacks for joined and send finished
+	api.lorawan.registerRecvCallback(receiveCallback);
+	api.lorawan.registerSendCallback(sendCallback);
+	api.lorawan.registerJoinCallback(joinCallback);
+
+	pinMode(LED_GREEN, OUTPUT);
+	digitalWrite(LED_GREEN, HIGH);
+	pinMode(LED_BLUE, OUTPUT);
+	digitalWrite(LED_BLUE, HIGH);
+
+	pinMode(WB_IO2, OUTPUT);
+	digitalWrite(WB_IO2, HIGH);
+
+	// Use RAK_CUSTOM_MODE supresses AT command and default responses from RUI3
+	// Serial.begin(115200, RAK_CUSTOM_MODE);
+	// Use "normal" mode to have AT commands available
+	Serial.begin(115200);
+
+#ifdef _VARIANT_RAK4630_
+	time_t serial_timeout = millis();
+	// On nRF52840 the USB serial is not available immediately
+	while (!Serial.available())
+	{
+		if ((millis() - serial_timeout) < 5000)
+		{
+			delay(100);
+			digitalWrite(LED_GREEN, !digitalRead(LED_GREEN));
+		}
+		else
+		{
+			break;
+		}
+	}
+#else
+	// For RAK3172 just wait a little bit for the USB to be ready
+	delay(5000);
+#endif
+
+	// Add custom status AT command
+	init_status_at();
+
+	MYLOG("SETUP", "RAKwireless %s Node", g_dev_name);
+	MYLOG("SETUP", "Setup the device with AT commands first");
+
+	// All timed jobs run on one timer, must be ready before the sensors are initialized
+	sched_init();
+
+	// Get saved VOC sampling mode from flash, needed before the sensor is initialized
+	get_at_setting(VOC_MODE_OFFSET);
+
+	// Search for modules
+	find_modules();
+	
+	// Get saved sending frequency from flash
+	get_at_setting(SEND_INT_OFFSET);
+	// Get saved max age of the cached T/RH values from flash
+	get_at_setting(TH_AGE_OFFSET);
+	// Get saved minimum acquisition lead time from flash
+	get_at_setting(ACQ_LEAD_OFFSET);
+	// Get saved number of samples per uplink from flash
+	get_at_setting(BATCH_OFFSET);
+	// Get saved report-by-exception settings from flash
+	get_at_setting(SOD_OFFSET);
+	get_at_setting(DEADBAND_OFFSET);
+	// Get saved payload format from flash
+	get_at_setting(PAYLOAD_FORMAT_OFFSET);
+	get_at_setting(KEYFRAME_OFFSET);
+	// Get saved payload priorities from flash
+	get_at_setting(PRIORITY_OFFSET);
+
+	// Create the job for the TX slots, no slack, it has to be on time
+	sched_create(SCHED_UPLINK, uplink_handler, 0);
+	// Create a one-shot job to start the sensor readings before the TX slot
+	sched_create(SCHED_SENSOR, sensor_handler, SCHED_SLACK_SENSOR);
+	// Create a one-shot job to collect the sensor values after the conversions are finished
+	sched_create(SCHED_COLLECT, send_handler, 0);
+	// Create a one-shot job to send the samples queued while the node was not joined
+	sched_create(SCHED_DRAIN, drain_handler, SCHED_SLACK_DRAIN);
+	// Start the TX slots and place the first acquisition, VOC burst and CO2 measurement
+	schedule_uplinks();
+
+	// Register the custom AT command to set the send interval
+	MYLOG("SETUP", "Add custom AT command %s", init_send_interval_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_th_max_age_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_voc_mode_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_inventory_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_driver_stats_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_tx_lead_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_sf_queue_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_batch_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_sod_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_payload_format_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_keyframe_at() ? "Success" : "Fail");
+	MYLOG("SETUP", "Add custom AT command %s", init_plan_at() ? "Success" : "Fail");
+
+	// Show found modules
+	announce_modules();
+
+	// From now on log messages are queued and printed before the MCU sleeps
+	log_set_deferred(true);
+}
+
+/**
+ * @brief Start the TX slots with the current send interval
+ *        and place the first acquisition before the first slot
+ *        Called from setup() and when the send interval changed
+ *
+ */
+void schedule_uplinks(void)
+{
+	sched_stop(SCHED_UPLINK);
+	sched_stop(SCHED_SENSOR);
+	if (g_lorawan_settings.send_repeat_time != 0)
+	{
+		// Start the periodic TX slots
+		sched_start(SCHED_UPLINK, g_lorawan_settings.send_repeat_time, g_lorawan_settings.send_repeat_time);
+		// Payload has to be ready before the first TX slot
+		sched_start(SCHED_SENSOR, g_lorawan_settings.send_repeat_time - acquisition_lead(), 0);
+	}
+	// Place the VOC burst and the CO2 measurement before the next TX slot
+	voc_schedule_burst();
+	co2_realign();
+	co2_schedule();
+}
+
+/**
+ * @brief Send the prepared payload
+ *
+ * @param late true if the payload was not ready at the TX slot
+ */
+void send_payload(bool late)
+{
+	payload_state = PAYLOAD_IDLE;
+
+	// Skip samples without relevant changes, batches need regular samples
+	if ((g_batch_samples <= 1) && !sod_check(payload_values, payload_battery))
+	{
+		// MYLOG("UPL", "No change, skip uplink");
+		digitalWrite(LED_BLUE, LOW);
+		return;
+	}
+
+	// Keep the sample until the node is joined
+	if (!api.lorawan.njs.get())
+	{
+		// MYLOG("UPL", "Not joined, queue sample");
+		sf_push(payload_values, payload_battery);
+		digitalWrite(LED_BLUE, LOW);
+		return;
+	}
+
+	if (g_batch_samples > 1)
+	{
+		// Collect the sample, the uplink is sent when the batch is full
+		batch_add(payload_values, payload_battery);
+		if (!send_batch(late))
+		{
+			digitalWrite(LED_BLUE, LOW);
+		}
+		return;
+	}
+
+	// Send the packet, values that do not fit into the max payload of the data rate are left out
+	uint8_t max_size = max_payload_size();
+	uint8_t format = g_payload_format;
+	uint8_t delta_size = 0;
+	if (format == PAYLOAD_DELTA)
+	{
+		delta_size = delta_encode(payload_values, payload_battery);
+		if (delta_size > max_size)
+		{
+			// Keyframe or delta does not fit, send the LPP payload
+			format = PAYLOAD_LPP;
+		}
+	}
+
+	bool sent = false;
+	// Values in the uplink, the planner can leave some out
+	uint16_t channels = SOD_ALL_CHANNELS;
+	if (format == PAYLOAD_PACKED)
+	{
+		uint8_t size = packed_encode(payload_values, payload_battery, max_size);
+		channels = plan_sent_channels();
+		sent = api.lorawan.send(size, packed_payload(), PACKED_FPORT, g_lorawan_settings.confirmed_msg_enabled);
+	}
+	else if (format == PAYLOAD_DELTA)
+	{
+		sent = api.lorawan.send(delta_size, delta_payload(), DELTA_FPORT, g_lorawan_settings.confirmed_msg_enabled);
+		if (sent)
+		{
+			delta_sent();
+		}
+	}
+	else if (plan_lpp_payload(max_size))
+	{
+		channels = plan_sent_channels();
+		sent = api.lorawan.send(g_solution_data.getSize(), g_solution_data.getBuffer(), 2, g_lorawan_settings.confirmed_msg_enabled);
+	}
+	record_tx_jitter(millis() - tx_slot_time, late);
+
+	if (sent)
+	{
+		MYLOG("UPL", "Enqueued");
+		// Sent values are the reference of the report-by-exception
+		sod_sent(channels);
+		if (g_first_uplink_time == 0)
+		{
+			// Boot time statistics, compare cached inventory and full probe
+			g_first_uplink_time = millis();
+			MYLOG("UPL", "First uplink %ld ms after boot, %s inventory", g_first_uplink_time, g_inventory_cached ? "cached" : "probed");
+		}
+		// Network is reachable, send the queued samples after this uplink
+		if ((sf_depth() != 0) && !sched_active(SCHED_DRAIN))
+		{
+			sched_start(SCHED_DRAIN, sf_drain_interval, 0);
+		}
+	}
+	else
+	{
+		MYLOG("UPL", "Send fail");
+		sf_push(payload_values, payload_battery);
+		digitalWrite(LED_BLUE, LOW);
+	}
+}
+
+/**
+ * @brief Send the collected samples in one uplink
+ *        if the batch is full or does not fit into
+ *        the max payload of the data rate anymore
+ *
+ * @param late true if the payload was not ready at the TX slot
+ * @return true if an uplink was started
+ * @return false if the batch is not full or the uplink failed
+ */
+bool send_batch(bool late)
+{
+	uint8_t count = batch_count();
+	uint16_t size = batch_encode(count);
+	if ((size > max_payload_size()) && (count > 1))
+	{
+		// Last sample does not fit, it starts the next batch
+		count--;
+		size = batch_encode(count);
+	}
+	else if (count < g_batch_samples)
+	{
+		return false;
+	}
+	if (size > max_payload_size())
+	{
+		// A single sample does not fit at this data rate, keep it in the queue
+		MYLOG("UPL", "Batch of %d bytes does not fit", size);
+		batch_to_queue();
+		return false;
+	}
+
+	bool sent = api.lorawan.send(size, batch_payload(), BATCH_FPORT, g_lorawan_settings.confirmed_msg_enabled);
+	record_tx_jitter(millis() - tx_slot_time, late);
+	if (!sent)
+	{
+		MYLOG("UPL", "Batch send fail");
+		batch_to_queue();
+		return false;
+	}
+	MYLOG("UPL", "Batch of %d samples, %d bytes", count, size);
+	batch_release(count);
+	if ((sf_depth() != 0) && !sched_active(SCHED_DRAIN))
+	{
+		sched_start(SCHED_DRAIN, sf_drain_interval, 0);
+	}
+	return true;
+}
+
+/**
+ * @brief drain_handler sends the queued samples in batches
+ * on SF_FPORT. If the uplink is blocked, e.g. by the duty
+ * cycle, the time to the next try is doubled.
+ *
+ */
+void drain_handler(void *)
+{
+	if ((sf_depth() == 0) || !api.lorawan.njs.get())
+	{
+		// Restarted after the next successful uplink
+		sf_drain_interval = SF_DRAIN_INTERVAL;
+		return;
+	}
+	if (payload_state == PAYLOAD_READY)
+	{
+		// Do not overwrite the payload waiting for its TX slot
+		sched_start(SCHED_DRAIN, sf_drain_interval, 0);
+		return;
+	}
+
+	uint8_t batch = sf_build_batch(max_payload_size());
+	if (batch == 0)
+	{
+		// Oldest sample does not fit at this data rate, wait for a higher one
+		MYLOG("SF", "Sample does not fit, retry in %ld s", SF_DRAIN_INTERVAL_MAX / 1000);
+		sched_start(SCHED_DRAIN, SF_DRAIN_INTERVAL_MAX, 0);
+		return;
+	}
+	if (api.lorawan.send(g_solution_data.getSize(), g_solution_data.getBuffer(), SF_FPORT, false))
+	{
+		MYLOG("SF", "Sent %d samples, %d waiting", batch, sf_depth() - batch);
+		sf_release(batch);
+		sf_drain_interval = SF_DRAIN_INTERVAL;
+	}
+	else
+	{
+		// Back off while the uplinks are blocked
+		sf_drain_interval *= 2;
+		if (sf_drain_interval > SF_DRAIN_INTERVAL_MAX)
+		{
+			sf_drain_interval = SF_DRAIN_INTERVAL_MAX;
+		}
+		MYLOG("SF", "Send fail, retry in %ld s", sf_drain_interval / 1000);
+	}
+	if (sf_depth() != 0)
+	{
+		sched_start(SCHED_DRAIN, sf_drain_interval, 0);
+	}
+}
+
+/**
+ * @brief uplink_handler is a timer function called every
+ * g_lorawan_settings.send_repeat_time milliseconds at the TX slot.
+ * The payload was prepared by the acquisition started
+ * acquisition_lead() ms earlier and is sent right away.
+ *
+ */
+void uplink_handler(void *)
+{
+	tx_slot_time = sched_due_time();
+
+	// Next acquisition, VOC burst and CO2 measurement have to finish before the next TX slot
+	if (g_lorawan_settings.send_repeat_time != 0)
+	{
+		sched_start(SCHED_SENSOR, g_lorawan_settings.send_repeat_time - acquisition_lead(), 0);
+	}
+	voc_schedule_burst();
+	co2_schedule();
+
+	if (payload_state == PAYLOAD_READY)
+	{
+		send_payload(false);
+	}
+	else if (payload_state == PAYLOAD_RUNNING)
+	{
+		// Acquisition took longer than the lead time, send when it is finished
+		MYLOG("UPL", "Payload not ready");
+		tx_slot_missed = true;
+	}
+}
+
+/**
+ * @brief sensor_handler is called acquisition_lead() ms before
+ * each TX slot. It starts the sensor conversions, the payload
+ * is encoded by send_handler and sent by uplink_handler.
+ *
+ */
+void sensor_handler(void *)
+{
+	// MYLOG("SENS", "Start");
+	digitalWrite(LED_BLUE, HIGH);
+
+	// Sensors are read even if the node is not joined, the sample is queued then
+	payload_state = PAYLOAD_RUNNING;
+	tx_slot_missed = false;
+
+	// Start the sensor conversions, the MCU can sleep until they are finished
+	uint32_t conversion_time = start_sensors();
+	if (conversion_time == 0)
+	{
+		send_handler(NULL);
+		return;
+	}
+	sched_start(SCHED_COLLECT, conversion_time + CONVERSION_MARGIN, 0);
+}
+
+/**
+ * @brief send_handler is called after the sensor conversions
+ * started by sensor_handler are finished. It collects the
+ * sensor values and prepares the packet for the TX slot.
+ *
+ */
+void send_handler(void *)
+{
+	// Collect the conversion results, check again later if a sensor is not finished
+	if (!collect_sensors())
+	{
+		sched_start(SCHED_COLLECT, CONVERSION_RETRY_TIME, 0);
+		return;
+	}
+
+	// Clear payload
+	g_solution_data.reset();
+
+	// Read sensor data
+	get_sensor_values();
+
+	// Add battery voltage
+	payload_battery = api.system.bat.get();
+	g_solution_data.addVoltage(LPP_CHANNEL_BATT, payload_battery);
+	// Keep the values in case the payload cannot be sent
+	payload_values = *snapshot_get();
+	// MYLOG("UPL", "Bat %.4f", api.system.bat.get());
+	// MYLOG("UPL", "Send %d", g_solution_data.getSize());
+
+	payload_state = PAYLOAD_READY;
+	if (tx_slot_missed)
+	{
+		// TX slot has passed already
+		tx_slot_missed = false;
+		send_payload(true);
+	}
+}
+
+/**
+ * @brief This example is complete timer
+ * driven. The loop() runs the jobs queued by
+ * AT commands and the due timer jobs, so all
+ * I2C transfers run in one context. Then it prints the queued debug output and sleeps
+ * until the next job or another event.
+ *
+ */
+void loop()
+{
+	// Run the sensor jobs queued by AT commands
+	bus_run();
+	// Run the due jobs and arm the timer for the next one
+	sched_run();
+	// Write queued debug output before going to sleep
+	log_flush();
+	api.system.sleep.all();
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+/**
+ * @file bus_access.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Queue for sensor bus jobs requested outside of loop()
+ *        All I2C transfers run from loop(), the sensor jobs of
+ *        the scheduler are called there too. AT command handlers
+ *        run in a different context, they put their sensor or
+ *        scheduler changes into this queue instead of calling
+ *        Wire directly.
+ *        Single producer (AT command context), single consumer
+ *        (loop()), no locks needed.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Queued jobs */
+static bus_job_t bus_queue[BUS_QUEUE_SIZE];
+/** Next free slot, only changed by bus_post() */
+static volatile uint8_t bus_head = 0;
+/** Next job to run, only changed by bus_run() */
+static volatile uint8_t bus_tail = 0;
+
+/**
+ * @brief Queue a job for loop()
+ *
+ * @param job function to call
+ * @return true if the job was queued
+ * @return false if the queue is full
+ */
+bool bus_post(bus_job_t job)
+{
+	uint8_t next_head = (bus_head + 1) % BUS_QUEUE_SIZE;
+	if (next_head == bus_tail)
+	{
+		return false;
+	}
+	bus_queue[bus_head] = job;
+	// Job must be in the queue before the consumer sees the new head
+	__sync_synchronize();
+	bus_head = next_head;
+	return true;
+}
+
+/**
+ * @brief Run all queued jobs
+ *        Called from loop() before the scheduler jobs
+ *
+ */
+void bus_run(void)
+{
+	while (bus_tail != bus_head)
+	{
+		__sync_synchronize();
+		bus_job_t job = bus_queue[bus_tail];
+		bus_tail = (bus_tail + 1) % BUS_QUEUE_SIZE;
+		job();
+	}
+}
@@ -0,0 +1,27 @@
+/**
+ * @file bus_access.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Queue for sensor bus jobs requested outside of loop()
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef BUS_ACCESS_H
+#define BUS_ACCESS_H
+
+#include <Arduino.h>
+
+/** Number of jobs that can wait for loop() */
+#ifndef BUS_QUEUE_SIZE
+#define BUS_QUEUE_SIZE 8
+#endif
+
+/** Job that accesses the I2C bus or the scheduler */
+typedef void (*bus_job_t)(void);
+
+bool bus_post(bus_job_t job);
+void bus_run(void);
+
+#endif // BUS_ACCESS_H
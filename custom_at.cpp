@@ -1,297 +1,1518 @@
-/**
- * @file custom_at.cpp
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief
- * @version 0.1
- * @date 2022-05-12
- *
- * @copyright Copyright (c) 2022
- *
- */
-#include "main.h"
-
-// Forward declarations
-int send_interval_handler(SERIAL_PORT port, char *cmd, stParam *param);
-int status_handler(SERIAL_PORT port, char *cmd, stParam *param);
-
-#ifdef _VARIANT_RAK4630_
-#define AT_PRINTF(...)                                           \
-	do                                                           \
-	{                                                            \
-		Serial.printf(__VA_ARGS__);                              \
-		Serial.printf("\n");                                     \
-		char dbg_str[255];                                       \
-		uint16_t dbg_size = snprintf(dbg_str, 254, __VA_ARGS__); \
-		api.ble.uart.write((uint8_t *)dbg_str, dbg_size);        \
-		dbg_size = snprintf(dbg_str, 254, "\r\n");               \
-		api.ble.uart.write((uint8_t *)dbg_str, dbg_size);        \
-	} while (0)
-
-#elif defined _VARIANT_RAK3172_ || defined _VARIANT_RAK3172_SIP_
-#define AT_PRINTF(...)              \
-	do                              \
-	{                               \
-		Serial.printf(__VA_ARGS__); \
-		Serial.printf("\n");        \
-	} while (0)
-#endif
-
-/**
- * @brief Add send interval AT command
- *
- * @return true if success
- * @return false if failed
- */
-bool init_send_interval_at(void)
-{
-	return api.system.atMode.add((char *)"SENDINT",
-								 (char *)"Set/Get the sending interval time values in seconds 0 = off, max 2,147,483 seconds",
-								 (char *)"SENDINT", send_interval_handler);
-}
-
-/**
- * @brief Handler for send interval AT commands
- *
- * @param port Serial port used
- * @param cmd char array with the received AT command
- * @param param char array with the received AT command parameters
- * @return int result of command parsing
- * 			AT_OK AT command & parameters valid
- * 			AT_PARAM_ERROR command or parameters invalid
- */
-int send_interval_handler(SERIAL_PORT port, char *cmd, stParam *param)
-{
-	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
-	{
-		// Serial.print(cmd);
-		// Serial.printf("=%lds\r\n", g_send_repeat_time / 1000);
-		AT_PRINTF(cmd);
-		AT_PRINTF("=%lds\r\n", g_lorawan_settings.send_repeat_time / 1000);
-	}
-	else if (param->argc == 1)
-	{
-		// MYLOG("AT_CMD", "param->argv[0] >> %s", param->argv[0]);
-		for (int i = 0; i < strlen(param->argv[0]); i++)
-		{
-			if (!isdigit(*(param->argv[0] + i)))
-			{
-				MYLOG("AT_CMD", "%d is no digit", i);
-				return AT_PARAM_ERROR;
-			}
-		}
-
-		uint32_t new_send_interval = strtoul(param->argv[0], NULL, 10);
-
-		// MYLOG("AT_CMD", "Requested interval %ld", new_send_interval);
-
-		g_lorawan_settings.send_repeat_time = new_send_interval * 1000;
-
-		// MYLOG("AT_CMD", "New interval %ld", g_lorawan_settings.send_repeat_time);
-		// Stop the timer
-		api.system.timer.stop(RAK_TIMER_0);
-
-		if (g_lorawan_settings.send_repeat_time != 0)
-		{
-			// Restart the timer
-			api.system.timer.start(RAK_TIMER_0, g_lorawan_settings.send_repeat_time, NULL);
-		}
-		// Save custom settings
-		save_at_setting(SEND_INT_OFFSET);
-	}
-	else
-	{
-		return AT_PARAM_ERROR;
-	}
-
-	return AT_OK;
-}
-
-/**
- * @brief Add custom Status AT commands
- *
- * @return true AT commands were added
- * @return false AT commands couldn't be added
- */
-bool init_status_at(void)
-{
-	return api.system.atMode.add((char *)"STATUS",
-								 (char *)"Get device information",
-								 (char *)"STATUS", status_handler);
-}
-
-/** Regions as text array */
-char *regions_list[] = {"EU433", "CN470", "RU864", "IN865", "EU868", "US915", "AU915", "KR920", "AS923", "AS923-2", "AS923-3", "AS923-4"};
-/** Network modes as text array*/
-char *nwm_list[] = {"P2P", "LoRaWAN", "FSK"};
-
-/**
- * @brief Print device status over Serial
- *
- * @param port Serial port used
- * @param cmd char array with the received AT command
- * @param param char array with the received AT command parameters
- * @return int result of command parsing
- * 			AT_OK AT command & parameters valid
- * 			AT_PARAM_ERROR command or parameters invalid
- */
-int status_handler(SERIAL_PORT port, char *cmd, stParam *param)
-{
-	String value_str = "";
-	int nw_mode = 0;
-	int region_set = 0;
-	uint8_t key_eui[16] = {0}; // efadff29c77b4829acf71e1a6e76f713
-
-	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
-	{
-		AT_PRINTF("Device Status:");
-		value_str = api.system.modelId.get();
-		value_str.toUpperCase();
-		AT_PRINTF("Module: %s", value_str.c_str());
-		AT_PRINTF("Version: %s", api.system.firmwareVersion.get().c_str());
-		AT_PRINTF("Send time: %d s", g_lorawan_settings.send_repeat_time / 1000);
-		nw_mode = api.lorawan.nwm.get();
-		AT_PRINTF("Network mode %s", nwm_list[nw_mode]);
-		if (nw_mode == 1)
-		{
-			AT_PRINTF("Network %s", api.lorawan.njs.get() ? "joined" : "not joined");
-			region_set = api.lorawan.band.get();
-			AT_PRINTF("Region: %d", region_set);
-			AT_PRINTF("Region: %s", regions_list[region_set]);
-			if (api.lorawan.njm.get())
-			{
-				AT_PRINTF("OTAA mode");
-				api.lorawan.deui.get(key_eui, 8);
-				AT_PRINTF("DevEUI = %02X%02X%02X%02X%02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
-						  key_eui[4], key_eui[5], key_eui[6], key_eui[7]);
-				api.lorawan.appeui.get(key_eui, 8);
-				AT_PRINTF("AppEUI = %02X%02X%02X%02X%02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
-						  key_eui[4], key_eui[5], key_eui[6], key_eui[7]);
-				api.lorawan.appkey.get(key_eui, 16);
-				AT_PRINTF("AppKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
-						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
-						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
-						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
-			}
-			else
-			{
-				AT_PRINTF("ABP mode");
-				api.lorawan.appskey.get(key_eui, 16);
-				AT_PRINTF("AppsKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
-						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
-						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
-						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
-				api.lorawan.nwkskey.get(key_eui, 16);
-				AT_PRINTF("NwsKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
-						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
-						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
-						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
-				api.lorawan.daddr.set(key_eui, 4);
-				AT_PRINTF("DevAddr = %02X%02X%02X%02X",
-						  key_eui[0], key_eui[1], key_eui[2], key_eui[3]);
-			}
-		}
-		else if (nw_mode == 0)
-		{
-			AT_PRINTF("Frequency = %d\r\n", api.lorawan.pfreq.get());
-			AT_PRINTF("SF = %d", api.lorawan.psf.get());
-			AT_PRINTF("BW = %d", api.lorawan.pbw.get());
-			AT_PRINTF("CR = %d", api.lorawan.pcr.get());
-			AT_PRINTF("Preamble length = %d", api.lorawan.ppl.get());
-			AT_PRINTF("TX power = %d", api.lorawan.ptp.get());
-		}
-		else
-		{
-			AT_PRINTF("Frequency = %d", api.lorawan.pfreq.get());
-			AT_PRINTF("Bitrate = %d", api.lorawan.pbr.get());
-			AT_PRINTF("Deviaton = %d", api.lorawan.pfdev.get());
-		}
-	}
-	else
-	{
-		return AT_PARAM_ERROR;
-	}
-	return AT_OK;
-}
-
-/**
- * @brief Get setting from flash
- *
- * @param setting_type type of setting, valid values
- * 			SEND_INT_OFFSET for send interval setting
- * @return true read from flash was successful
- * @return false read from flash failed or invalid settings type
- */
-bool get_at_setting(uint32_t setting_type)
-{
-	uint8_t flash_value[16];
-	switch (setting_type)
-	{
-	case SEND_INT_OFFSET:
-		if (!api.system.flash.get(SEND_INT_OFFSET, flash_value, 5))
-		{
-			// MYLOG("AT_CMD", "Failed to read send interval from Flash");
-			return false;
-		}
-		if (flash_value[4] != 0xAA)
-		{
-			// MYLOG("AT_CMD", "No valid send interval found, set to default, read 0X%02X 0X%02X 0X%02X 0X%02X",
-			// 	  flash_value[0], flash_value[1],
-			// 	  flash_value[2], flash_value[3]);
-			g_lorawan_settings.send_repeat_time = 60000;
-			save_at_setting(SEND_INT_OFFSET);
-			return false;
-		}
-		// MYLOG("AT_CMD", "Read send interval 0X%02X 0X%02X 0X%02X 0X%02X",
-		// 	  flash_value[0], flash_value[1],
-		// 	  flash_value[2], flash_value[3]);
-		g_lorawan_settings.send_repeat_time = 0;
-		g_lorawan_settings.send_repeat_time |= flash_value[0] << 0;
-		g_lorawan_settings.send_repeat_time |= flash_value[1] << 8;
-		g_lorawan_settings.send_repeat_time |= flash_value[2] << 16;
-		g_lorawan_settings.send_repeat_time |= flash_value[3] << 24;
-		// MYLOG("AT_CMD", "send interval found %ld", g_lorawan_settings.send_repeat_time);
-		return true;
-		break;
-	default:
-		return false;
-	}
-}
-
-/**
- * @brief Save setting to flash
- *
- * @param setting_type type of setting, valid values
- * 			SEND_INT_OFFSET for send interval setting
- * @return true write to flash was successful
- * @return false write to flash failed or invalid settings type
- */
-bool save_at_setting(uint32_t setting_type)
-{
-	uint8_t flash_value[16] = {0};
-	bool wr_result = false;
-	switch (setting_type)
-	{
-	case SEND_INT_OFFSET:
-		flash_value[0] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 0);
-		flash_value[1] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 8);
-		flash_value[2] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 16);
-		flash_value[3] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 24);
-		flash_value[4] = 0xAA;
-		// MYLOG("AT_CMD", "Writing send interval 0X%02X 0X%02X 0X%02X 0X%02X ",
-		// 	  flash_value[0], flash_value[1],
-		// 	  flash_value[2], flash_value[3]);
-		wr_result = api.system.flash.set(SEND_INT_OFFSET, flash_value, 5);
-		// MYLOG("AT_CMD", "Writing %s", wr_result ? "Success" : "Fail");
-		return wr_result;
-		break;
-	default:
-		return false;
-		break;
-	}
-	return false;
-}
+/**
+ * @file custom_at.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief
+ * @version 0.1
+ * @date 2022-05-12
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "main.h"
+
+// Forward declarations
+int send_interval_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int status_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int th_max_age_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int voc_mode_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int inventory_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int driver_stats_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int tx_lead_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int sf_queue_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int batch_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int sod_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int deadband_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int payload_format_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int keyframe_handler(SERIAL_PORT port, char *cmd, stParam *param);
+int priority_handler(SERIAL_PORT port, char *cmd, stParam *param);
+
+#ifdef _VARIANT_RAK4630_
+#define AT_PRINTF(...)                                           \
+	do                                                           \
+	{                                                            \
+		Serial.printf(__VA_ARGS__);                              \
+		Serial.printf("\n");                                     \
+		char dbg_str[255];                                       \
+		uint16_t dbg_size = snprintf(dbg_str, 254, __VA_ARGS__); \
+		api.ble.uart.write((uint8_t *)dbg_str, dbg_size);        \
+		dbg_size = snprintf(dbg_str, 254, "\r\n");               \
+		api.ble.uart.write((uint8_t *)dbg_str, dbg_size);        \
+	} while (0)
+
+#elif defined _VARIANT_RAK3172_ || defined _VARIANT_RAK3172_SIP_
+#define AT_PRINTF(...)              \
+	do                              \
+	{                               \
+		Serial.printf(__VA_ARGS__); \
+		Serial.printf("\n");        \
+	} while (0)
+#endif
+
+/**
+ * @brief Add send interval AT command
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_send_interval_at(void)
+{
+	return api.system.atMode.add((char *)"SENDINT",
+								 (char *)"Set/Get the sending interval time values in seconds 0 = off, max 2,147,483 seconds",
+								 (char *)"SENDINT", send_interval_handler);
+}
+
+/**
+ * @brief Queue the job that applies a changed setting from loop()
+ *        While the job is queued, further changes of the setting are
+ *        applied by the same job. A command that gets AT_BUSY_ERROR
+ *        leaves no job that would apply its value.
+ *
+ * @param queued bits of the changed values, not 0 while the job is queued
+ * @param bits bits of the values changed by the AT command
+ * @param job applies the changed values, clears queued first
+ * @return true if the job is queued
+ * @return false if the queue is full
+ */
+static bool post_setting(volatile uint16_t *queued, uint16_t bits, bus_job_t job)
+{
+	if (__sync_fetch_and_or(queued, bits) != 0)
+	{
+		// Job is already queued
+		return true;
+	}
+	if (!bus_post(job))
+	{
+		__sync_fetch_and_and(queued, 0);
+		return false;
+	}
+	return true;
+}
+
+/** Send interval of the last AT command in ms, applied from loop() */
+static uint32_t at_send_interval;
+/** Not 0 while apply_send_interval() is queued */
+static volatile uint16_t at_send_interval_queued = 0;
+
+/**
+ * @brief Set the send interval of the AT command and restart the sensor timer
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_send_interval(void)
+{
+	__sync_fetch_and_and(&at_send_interval_queued, 0);
+	g_lorawan_settings.send_repeat_time = at_send_interval;
+
+	// Restart the TX slots, the acquisition, the VOC burst and the CO2 measurement
+	schedule_uplinks();
+
+	// Save custom settings
+	save_at_setting(SEND_INT_OFFSET);
+}
+
+/**
+ * @brief Handler for send interval AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int send_interval_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		// Serial.print(cmd);
+		// Serial.printf("=%lds\r\n", g_send_repeat_time / 1000);
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%lds\r\n", g_lorawan_settings.send_repeat_time / 1000);
+	}
+	else if (param->argc == 1)
+	{
+		// MYLOG("AT_CMD", "param->argv[0] >> %s", param->argv[0]);
+		for (int i = 0; i < strlen(param->argv[0]); i++)
+		{
+			if (!isdigit(*(param->argv[0] + i)))
+			{
+				MYLOG("AT_CMD", "%d is no digit", i);
+				return AT_PARAM_ERROR;
+			}
+		}
+
+		uint32_t new_send_interval = strtoul(param->argv[0], NULL, 10);
+
+		// MYLOG("AT_CMD", "Requested interval %ld", new_send_interval);
+
+		at_send_interval = new_send_interval * 1000;
+
+		// MYLOG("AT_CMD", "New interval %ld", at_send_interval);
+		// Timers and sensors are changed from loop()
+		if (!post_setting(&at_send_interval_queued, 1, apply_send_interval))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the maximum age of the cached temperature and humidity
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_th_max_age_at(void)
+{
+	return api.system.atMode.add((char *)"THAGE",
+								 (char *)"Set/Get the max age of the cached BME680 temperature and humidity in seconds",
+								 (char *)"THAGE", th_max_age_handler);
+}
+
+/** T/RH max age of the last AT command, applied from loop() */
+static uint32_t at_th_max_age;
+/** Not 0 while apply_th_max_age() is queued */
+static volatile uint16_t at_th_max_age_queued = 0;
+
+/**
+ * @brief Set the T/RH max age of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_th_max_age(void)
+{
+	__sync_fetch_and_and(&at_th_max_age_queued, 0);
+	g_bme_th_max_age = at_th_max_age;
+
+	// Save custom settings
+	save_at_setting(TH_AGE_OFFSET);
+}
+
+/**
+ * @brief Handler for the T/RH max age AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int th_max_age_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		uint32_t hits;
+		uint32_t misses;
+		get_rak1906_cache_stats(hits, misses);
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%lds hits %ld misses %ld\r\n", g_bme_th_max_age / 1000, hits, misses);
+	}
+	else if (param->argc == 1)
+	{
+		for (int i = 0; i < strlen(param->argv[0]); i++)
+		{
+			if (!isdigit(*(param->argv[0] + i)))
+			{
+				MYLOG("AT_CMD", "%d is no digit", i);
+				return AT_PARAM_ERROR;
+			}
+		}
+
+		uint32_t new_max_age = strtoul(param->argv[0], NULL, 10);
+		if (new_max_age > 3600)
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_th_max_age = new_max_age * 1000;
+		// The cache is used by the acquisition in loop()
+		if (!post_setting(&at_th_max_age_queued, 1, apply_th_max_age))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the VOC sampling mode
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_voc_mode_at(void)
+{
+	return api.system.atMode.add((char *)"VOCMODE",
+								 (char *)"Set/Get the VOC sampling mode 0 = continuous, 1 = burst before each uplink",
+								 (char *)"VOCMODE", voc_mode_handler);
+}
+
+/** VOC mode of the last AT command, applied from loop() */
+static uint8_t at_voc_mode;
+/** Not 0 while apply_voc_mode() is queued */
+static volatile uint16_t at_voc_mode_queued = 0;
+
+/**
+ * @brief Switch the VOC sensor to the mode of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_voc_mode(void)
+{
+	__sync_fetch_and_and(&at_voc_mode_queued, 0);
+	g_voc_mode = at_voc_mode;
+	voc_apply_mode();
+
+	// Save custom settings
+	save_at_setting(VOC_MODE_OFFSET);
+}
+
+/**
+ * @brief Handler for the VOC mode AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int voc_mode_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d wakeups %ld\r\n", g_voc_mode, g_voc_wakeups);
+	}
+	else if (param->argc == 1)
+	{
+		if ((strlen(param->argv[0]) != 1) ||
+			((param->argv[0][0] != '0') && (param->argv[0][0] != '1')))
+		{
+			return AT_PARAM_ERROR;
+		}
+
+		at_voc_mode = (param->argv[0][0] == '1') ? VOC_MODE_BURST : VOC_MODE_CONTINUOUS;
+		// The sensor is switched from loop()
+		if (!post_setting(&at_voc_mode_queued, 1, apply_voc_mode))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the module inventory
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_inventory_at(void)
+{
+	return api.system.atMode.add((char *)"MODINV",
+								 (char *)"Get the module inventory, 0 = probe all modules on next boot",
+								 (char *)"MODINV", inventory_handler);
+}
+
+/**
+ * @brief Handler for the module inventory AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int inventory_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		uint64_t inventory = get_inventory();
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%08lX%08lX %s scan %ld ms first uplink %ld ms\r\n",
+				  (uint32_t)(inventory >> 32), (uint32_t)inventory,
+				  g_inventory_cached ? "cached" : "probed",
+				  g_module_scan_time, g_first_uplink_time);
+	}
+	else if (param->argc == 1 && !strcmp(param->argv[0], "0"))
+	{
+		if (!clear_inventory())
+		{
+			return AT_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the sensor driver statistics
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_driver_stats_at(void)
+{
+	return api.system.atMode.add((char *)"DRVSTAT",
+								 (char *)"Get the timing statistics of the sensor drivers",
+								 (char *)"DRVSTAT", driver_stats_handler);
+}
+
+/**
+ * @brief Handler for the sensor driver statistics AT command
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int driver_stats_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("Acquisition: %ld ms, awake %ld us (max %ld us), %ld retries",
+				  acquisition_stats.wall_time, acquisition_stats.awake_time,
+				  acquisition_stats.max_awake_time, acquisition_stats.retries);
+		for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+		{
+			if (!found_sensors[sensor_drivers[drv].module_id].found_sensor && (driver_stats[drv].failures == 0))
+			{
+				continue;
+			}
+			AT_PRINTF("%s: init %ld ms, read %ld us (max %ld us), %ld reads, %ld failures",
+					  sensor_drivers[drv].name, driver_stats[drv].init_time,
+					  driver_stats[drv].read_time, driver_stats[drv].max_read_time,
+					  driver_stats[drv].reads, driver_stats[drv].failures);
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the acquisition lead time and the TX timing
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_tx_lead_at(void)
+{
+	return api.system.atMode.add((char *)"TXLEAD",
+								 (char *)"Set/Get the minimum acquisition lead time before the TX slot in ms, get the TX jitter",
+								 (char *)"TXLEAD", tx_lead_handler);
+}
+
+/** Acquisition lead time of the last AT command, applied from loop() */
+static uint32_t at_acq_lead_min;
+/** Not 0 while apply_acq_lead() is queued */
+static volatile uint16_t at_acq_lead_queued = 0;
+
+/**
+ * @brief Set the acquisition lead time of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_acq_lead(void)
+{
+	__sync_fetch_and_and(&at_acq_lead_queued, 0);
+	// Used for the next acquisition
+	g_acq_lead_min = at_acq_lead_min;
+
+	// Save custom settings
+	save_at_setting(ACQ_LEAD_OFFSET);
+}
+
+/**
+ * @brief Handler for the acquisition lead time AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int tx_lead_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%ldms", g_acq_lead_min);
+		AT_PRINTF("Lead: %ld ms, acquisition avg %ld ms dev %ld ms",
+				  uplink_stats.lead, uplink_stats.latency_avg, uplink_stats.latency_dev);
+		AT_PRINTF("TX jitter: last %ld ms, max %ld ms, avg %ld ms, %ld uplinks, %ld late",
+				  uplink_stats.last_jitter, uplink_stats.max_jitter,
+				  uplink_stats.uplinks == 0 ? 0 : uplink_stats.jitter_sum / uplink_stats.uplinks,
+				  uplink_stats.uplinks, uplink_stats.late);
+	}
+	else if (param->argc == 1)
+	{
+		for (int i = 0; i < strlen(param->argv[0]); i++)
+		{
+			if (!isdigit(*(param->argv[0] + i)))
+			{
+				MYLOG("AT_CMD", "%d is no digit", i);
+				return AT_PARAM_ERROR;
+			}
+		}
+
+		uint32_t new_lead = strtoul(param->argv[0], NULL, 10);
+		if (new_lead > ACQ_LEAD_MAX)
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_acq_lead_min = new_lead;
+		// The lead is used by the uplink job in loop()
+		if (!post_setting(&at_acq_lead_queued, 1, apply_acq_lead))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the queue of samples that were not sent
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_sf_queue_at(void)
+{
+	return api.system.atMode.add((char *)"SFQUEUE",
+								 (char *)"Get the depth and drops of the queue of unsent samples, 0 to clear it",
+								 (char *)"SFQUEUE", sf_queue_handler);
+}
+
+/**
+ * @brief Handler for the sample queue AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int sf_queue_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d of %d, max %d", sf_depth(), SF_QUEUE_SIZE, sf_stats.max_depth);
+		AT_PRINTF("Stored %ld, sent %ld, dropped %ld", sf_stats.stored, sf_stats.sent, sf_stats.dropped);
+	}
+	else if (param->argc == 1 && !strcmp(param->argv[0], "0"))
+	{
+		// Queue is used from loop()
+		if (!bus_post(sf_clear))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the number of samples per uplink
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_batch_at(void)
+{
+	return api.system.atMode.add((char *)"BATCH",
+								 (char *)"Set/Get the number of samples per uplink, 1 = one LPP uplink per sample",
+								 (char *)"BATCH", batch_handler);
+}
+
+/** Samples per uplink of the last AT command, applied from loop() */
+static uint8_t at_batch_samples;
+/** Not 0 while apply_batch() is queued */
+static volatile uint16_t at_batch_queued = 0;
+
+/**
+ * @brief Set the samples per uplink of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_batch(void)
+{
+	__sync_fetch_and_and(&at_batch_queued, 0);
+	if ((at_batch_samples == 1) && (g_batch_samples > 1))
+	{
+		// Collected samples are sent from the queue
+		batch_to_queue();
+	}
+	g_batch_samples = at_batch_samples;
+
+	// Save custom settings
+	save_at_setting(BATCH_OFFSET);
+}
+
+/**
+ * @brief Handler for the samples per uplink AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int batch_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d collected %d max payload %d", g_batch_samples, batch_count(), max_payload_size());
+	}
+	else if (param->argc == 1)
+	{
+		for (int i = 0; i < strlen(param->argv[0]); i++)
+		{
+			if (!isdigit(*(param->argv[0] + i)))
+			{
+				MYLOG("AT_CMD", "%d is no digit", i);
+				return AT_PARAM_ERROR;
+			}
+		}
+
+		uint32_t new_samples = strtoul(param->argv[0], NULL, 10);
+		if ((new_samples < 1) || (new_samples > BATCH_MAX_SAMPLES))
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_batch_samples = (uint8_t)new_samples;
+		// The batch is collected and sent from loop()
+		if (!post_setting(&at_batch_queued, 1, apply_batch))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Check if a parameter is a decimal number
+ *
+ * @param value parameter string
+ * @return true if the parameter has only digits
+ * @return false if the parameter is empty or has other characters
+ */
+static bool is_number(const char *value)
+{
+	if (*value == 0)
+	{
+		return false;
+	}
+	for (int i = 0; i < strlen(value); i++)
+	{
+		if (!isdigit(value[i]))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Add AT commands for report-by-exception
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_sod_at(void)
+{
+	if (!api.system.atMode.add((char *)"RBE",
+							   (char *)"Set/Get report-by-exception max silence and min gap in seconds, 0 = send every sample",
+							   (char *)"RBE", sod_handler))
+	{
+		return false;
+	}
+	return api.system.atMode.add((char *)"DEADBAND",
+								 (char *)"Set/Get the deadband of a value (0-8) in payload resolution, 0 = not checked",
+								 (char *)"DEADBAND", deadband_handler);
+}
+
+/** Report-by-exception timing of the last AT command, applied from loop() */
+static uint32_t at_sod_heartbeat;
+static uint32_t at_sod_min_gap;
+/** Not 0 while apply_sod() is queued */
+static volatile uint16_t at_sod_queued = 0;
+
+/**
+ * @brief Set the report-by-exception timing of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_sod(void)
+{
+	__sync_fetch_and_and(&at_sod_queued, 0);
+	g_sod_heartbeat = at_sod_heartbeat;
+	g_sod_min_gap = at_sod_min_gap;
+
+	// Save custom settings
+	save_at_setting(SOD_OFFSET);
+}
+
+/**
+ * @brief Handler for the report-by-exception AT commands
+ *        AT+RBE=<max silence>,<min gap>
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int sod_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%ld,%ld", g_sod_heartbeat / 1000, g_sod_min_gap / 1000);
+		AT_PRINTF("Samples %ld, sent %ld, heartbeats %ld, excursions %ld",
+				  sod_stats.samples, sod_stats.reports, sod_stats.heartbeats, sod_stats.excursions);
+	}
+	else if (param->argc == 2)
+	{
+		if (!is_number(param->argv[0]) || !is_number(param->argv[1]))
+		{
+			return AT_PARAM_ERROR;
+		}
+		uint32_t new_heartbeat = strtoul(param->argv[0], NULL, 10);
+		uint32_t new_min_gap = strtoul(param->argv[1], NULL, 10);
+		if ((new_heartbeat > 604800) || ((new_heartbeat != 0) && (new_min_gap > new_heartbeat)))
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_sod_heartbeat = new_heartbeat * 1000;
+		at_sod_min_gap = new_min_gap * 1000;
+		// The samples are checked in loop()
+		if (!post_setting(&at_sod_queued, 1, apply_sod))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/** Deadbands of the AT commands, applied from loop() */
+static uint16_t at_sod_deadband[SF_CHANNELS];
+/** Bit n = deadband of value n was changed by an AT command */
+static volatile uint16_t at_deadband_changed = 0;
+
+/**
+ * @brief Set the deadbands changed by AT commands
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_deadband(void)
+{
+	uint16_t changed = __sync_fetch_and_and(&at_deadband_changed, 0);
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if (changed & (1 << channel))
+		{
+			g_sod_deadband[channel] = at_sod_deadband[channel];
+		}
+	}
+
+	// Save custom settings
+	save_at_setting(DEADBAND_OFFSET);
+}
+
+/**
+ * @brief Handler for the deadband AT commands
+ *        AT+DEADBAND=<value>,<deadband>
+ *        value 0 RAK1906 temperature, 1 humidity, 2 pressure, 3 gas,
+ *        4 RAK12037 CO2, 5 temperature, 6 humidity, 7 RAK12047 VOC, 8 battery
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int deadband_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d,%d,%d,%d,%d,%d,%d,%d,%d",
+				  g_sod_deadband[0], g_sod_deadband[1], g_sod_deadband[2],
+				  g_sod_deadband[3], g_sod_deadband[4], g_sod_deadband[5],
+				  g_sod_deadband[6], g_sod_deadband[7], g_sod_deadband[8]);
+	}
+	else if (param->argc == 2)
+	{
+		if (!is_number(param->argv[0]) || !is_number(param->argv[1]))
+		{
+			return AT_PARAM_ERROR;
+		}
+		uint32_t channel = strtoul(param->argv[0], NULL, 10);
+		uint32_t deadband = strtoul(param->argv[1], NULL, 10);
+		if ((channel >= SF_CHANNELS) || (deadband > 0xFFFF))
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_sod_deadband[channel] = (uint16_t)deadband;
+		// The samples are checked in loop()
+		if (!post_setting(&at_deadband_changed, 1 << channel, apply_deadband))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the payload format
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_payload_format_at(void)
+{
+	return api.system.atMode.add((char *)"PAYLOAD",
+								 (char *)"Set/Get the payload format, 0 = Cayenne LPP on fPort 2, 1 = bit-packed on fPort 5, 2 = keyframe/delta on fPort 6",
+								 (char *)"PAYLOAD", payload_format_handler);
+}
+
+/** Payload format of the last AT command, applied from loop() */
+static uint8_t at_payload_format;
+/** Not 0 while apply_payload_format() is queued */
+static volatile uint16_t at_payload_format_queued = 0;
+
+/**
+ * @brief Set the payload format of the AT command
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_payload_format(void)
+{
+	__sync_fetch_and_and(&at_payload_format_queued, 0);
+	g_payload_format = at_payload_format;
+
+	// Save custom settings
+	save_at_setting(PAYLOAD_FORMAT_OFFSET);
+}
+
+/**
+ * @brief Handler for the payload format AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int payload_format_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d", g_payload_format);
+	}
+	else if (param->argc == 1)
+	{
+		if (!is_number(param->argv[0]))
+		{
+			return AT_PARAM_ERROR;
+		}
+		uint32_t new_format = strtoul(param->argv[0], NULL, 10);
+		if (new_format > PAYLOAD_DELTA)
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_payload_format = (uint8_t)new_format;
+		// The payload is built in loop()
+		if (!post_setting(&at_payload_format_queued, 1, apply_payload_format))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the keyframe interval of the delta payload
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_keyframe_at(void)
+{
+	return api.system.atMode.add((char *)"KEYFRAME",
+								 (char *)"Set/Get the uplinks from one keyframe to the next 1 .. 255, setting it forces a keyframe",
+								 (char *)"KEYFRAME", keyframe_handler);
+}
+
+/** Keyframe interval of the last AT command, applied from loop() */
+static uint8_t at_keyframe_interval;
+/** Not 0 while apply_keyframe() is queued */
+static volatile uint16_t at_keyframe_queued = 0;
+
+/**
+ * @brief Set the keyframe interval of the AT command and force a keyframe
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_keyframe(void)
+{
+	__sync_fetch_and_and(&at_keyframe_queued, 0);
+	g_delta_keyframe_interval = at_keyframe_interval;
+	delta_request_keyframe();
+
+	// Save custom settings
+	save_at_setting(KEYFRAME_OFFSET);
+}
+
+/**
+ * @brief Handler for the keyframe interval AT commands
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int keyframe_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d", g_delta_keyframe_interval);
+	}
+	else if (param->argc == 1)
+	{
+		if (!is_number(param->argv[0]))
+		{
+			return AT_PARAM_ERROR;
+		}
+		uint32_t new_interval = strtoul(param->argv[0], NULL, 10);
+		if ((new_interval < 1) || (new_interval > 255))
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_keyframe_interval = (uint8_t)new_interval;
+		// The payload is built in loop()
+		if (!post_setting(&at_keyframe_queued, 1, apply_keyframe))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add AT command for the payload priorities
+ *
+ * @return true if success
+ * @return false if failed
+ */
+bool init_plan_at(void)
+{
+	return api.system.atMode.add((char *)"PRIO",
+								 (char *)"Set/Get the priority of a value if the payload is too large for the data rate, <value 0-8>,<priority 0-255>",
+								 (char *)"PRIO", priority_handler);
+}
+
+/** Priorities of the AT commands, applied from loop() */
+static uint8_t at_plan_priority[SF_CHANNELS];
+/** Bit n = priority of value n was changed by an AT command */
+static volatile uint16_t at_priority_changed = 0;
+
+/**
+ * @brief Set the priorities changed by AT commands
+ *        Queued by the AT command, runs from loop()
+ *
+ */
+static void apply_priority(void)
+{
+	uint16_t changed = __sync_fetch_and_and(&at_priority_changed, 0);
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if (changed & (1 << channel))
+		{
+			g_plan_priority[channel] = at_plan_priority[channel];
+		}
+	}
+
+	// Save custom settings
+	save_at_setting(PRIORITY_OFFSET);
+}
+
+/**
+ * @brief Handler for the payload priority AT commands
+ *        AT+PRIO=<value>,<priority>
+ *        value 0 RAK1906 temperature, 1 humidity, 2 pressure, 3 gas,
+ *        4 RAK12037 CO2, 5 temperature, 6 humidity, 7 RAK12047 VOC, 8 battery
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int priority_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF(cmd);
+		AT_PRINTF("=%d,%d,%d,%d,%d,%d,%d,%d,%d",
+				  g_plan_priority[0], g_plan_priority[1], g_plan_priority[2],
+				  g_plan_priority[3], g_plan_priority[4], g_plan_priority[5],
+				  g_plan_priority[6], g_plan_priority[7], g_plan_priority[8]);
+		AT_PRINTF("Max payload %d, payloads %ld, shortened %ld, values dropped %ld",
+				  max_payload_size(), plan_stats.planned, plan_stats.shed, plan_stats.dropped);
+	}
+	else if (param->argc == 2)
+	{
+		if (!is_number(param->argv[0]) || !is_number(param->argv[1]))
+		{
+			return AT_PARAM_ERROR;
+		}
+		uint32_t channel = strtoul(param->argv[0], NULL, 10);
+		uint32_t priority = strtoul(param->argv[1], NULL, 10);
+		if ((channel >= SF_CHANNELS) || (priority > 0xFF))
+		{
+			return AT_PARAM_ERROR;
+		}
+		at_plan_priority[channel] = (uint8_t)priority;
+		// The payload is planned in loop()
+		if (!post_setting(&at_priority_changed, 1 << channel, apply_priority))
+		{
+			return AT_BUSY_ERROR;
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+
+	return AT_OK;
+}
+
+/**
+ * @brief Add custom Status AT commands
+ *
+ * @return true AT commands were added
+ * @return false AT commands couldn't be added
+ */
+bool init_status_at(void)
+{
+	return api.system.atMode.add((char *)"STATUS",
+								 (char *)"Get device information",
+								 (char *)"STATUS", status_handler);
+}
+
+/** Regions as text array */
+char *regions_list[] = {"EU433", "CN470", "RU864", "IN865", "EU868", "US915", "AU915", "KR920", "AS923", "AS923-2", "AS923-3", "AS923-4"};
+/** Network modes as text array*/
+char *nwm_list[] = {"P2P", "LoRaWAN", "FSK"};
+
+/**
+ * @brief Print device status over Serial
+ *
+ * @param port Serial port used
+ * @param cmd char array with the received AT command
+ * @param param char array with the received AT command parameters
+ * @return int result of command parsing
+ * 			AT_OK AT command & parameters valid
+ * 			AT_PARAM_ERROR command or parameters invalid
+ */
+int status_handler(SERIAL_PORT port, char *cmd, stParam *param)
+{
+	String value_str = "";
+	int nw_mode = 0;
+	int region_set = 0;
+	uint8_t key_eui[16] = {0}; // efadff29c77b4829acf71e1a6e76f713
+
+	if (param->argc == 1 && !strcmp(param->argv[0], "?"))
+	{
+		AT_PRINTF("Device Status:");
+		value_str = api.system.modelId.get();
+		value_str.toUpperCase();
+		AT_PRINTF("Module: %s", value_str.c_str());
+		AT_PRINTF("Version: %s", api.system.firmwareVersion.get().c_str());
+		AT_PRINTF("Send time: %d s", g_lorawan_settings.send_repeat_time / 1000);
+		if (found_sensors[ENV_ID].found_sensor)
+		{
+			uint32_t hits;
+			uint32_t misses;
+			get_rak1906_cache_stats(hits, misses);
+			AT_PRINTF("T/RH cache: max age %ld s, %ld hits, %ld misses", g_bme_th_max_age / 1000, hits, misses);
+		}
+		if (found_sensors[VOC_ID].found_sensor)
+		{
+			AT_PRINTF("VOC mode: %s, %ld wakeups", g_voc_mode == VOC_MODE_BURST ? "burst" : "continuous", g_voc_wakeups);
+		}
+		uint32_t last_hour;
+		uint32_t this_hour;
+		sched_wakeups(last_hour, this_hour);
+		AT_PRINTF("Wakeups: %ld last hour, %ld this hour", last_hour, this_hour);
+		nw_mode = api.lorawan.nwm.get();
+		AT_PRINTF("Network mode %s", nwm_list[nw_mode]);
+		if (nw_mode == 1)
+		{
+			AT_PRINTF("Network %s", api.lorawan.njs.get() ? "joined" : "not joined");
+			region_set = api.lorawan.band.get();
+			AT_PRINTF("Region: %d", region_set);
+			AT_PRINTF("Region: %s", regions_list[region_set]);
+			if (api.lorawan.njm.get())
+			{
+				AT_PRINTF("OTAA mode");
+				api.lorawan.deui.get(key_eui, 8);
+				AT_PRINTF("DevEUI = %02X%02X%02X%02X%02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
+						  key_eui[4], key_eui[5], key_eui[6], key_eui[7]);
+				api.lorawan.appeui.get(key_eui, 8);
+				AT_PRINTF("AppEUI = %02X%02X%02X%02X%02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
+						  key_eui[4], key_eui[5], key_eui[6], key_eui[7]);
+				api.lorawan.appkey.get(key_eui, 16);
+				AT_PRINTF("AppKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
+						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
+						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
+						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
+			}
+			else
+			{
+				AT_PRINTF("ABP mode");
+				api.lorawan.appskey.get(key_eui, 16);
+				AT_PRINTF("AppsKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
+						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
+						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
+						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
+				api.lorawan.nwkskey.get(key_eui, 16);
+				AT_PRINTF("NwsKey = %02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3],
+						  key_eui[4], key_eui[5], key_eui[6], key_eui[7],
+						  key_eui[8], key_eui[9], key_eui[10], key_eui[11],
+						  key_eui[12], key_eui[13], key_eui[14], key_eui[15]);
+				api.lorawan.daddr.set(key_eui, 4);
+				AT_PRINTF("DevAddr = %02X%02X%02X%02X",
+						  key_eui[0], key_eui[1], key_eui[2], key_eui[3]);
+			}
+		}
+		else if (nw_mode == 0)
+		{
+			AT_PRINTF("Frequency = %d\r\n", api.lorawan.pfreq.get());
+			AT_PRINTF("SF = %d", api.lorawan.psf.get());
+			AT_PRINTF("BW = %d", api.lorawan.pbw.get());
+			AT_PRINTF("CR = %d", api.lorawan.pcr.get());
+			AT_PRINTF("Preamble length = %d", api.lorawan.ppl.get());
+			AT_PRINTF("TX power = %d", api.lorawan.ptp.get());
+		}
+		else
+		{
+			AT_PRINTF("Frequency = %d", api.lorawan.pfreq.get());
+			AT_PRINTF("Bitrate = %d", api.lorawan.pbr.get());
+			AT_PRINTF("Deviaton = %d", api.lorawan.pfdev.get());
+		}
+	}
+	else
+	{
+		return AT_PARAM_ERROR;
+	}
+	return AT_OK;
+}
+
+/**
+ * @brief Get setting from flash
+ *
+ * @param setting_type type of setting, valid values
+ * 			SEND_INT_OFFSET for send interval setting
+ * 			TH_AGE_OFFSET for the T/RH cache max age
+ * 			VOC_MODE_OFFSET for the VOC sampling mode
+ * 			ACQ_LEAD_OFFSET for the minimum acquisition lead time
+ * 			BATCH_OFFSET for the number of samples per uplink
+ * 			SOD_OFFSET for the report-by-exception timing
+ * 			DEADBAND_OFFSET for the report-by-exception deadbands
+ * 			PAYLOAD_FORMAT_OFFSET for the payload format
+ * 			KEYFRAME_OFFSET for the keyframe interval of the delta payload
+ * 			PRIORITY_OFFSET for the payload priorities
+ * @return true read from flash was successful
+ * @return false read from flash failed or invalid settings type
+ */
+bool get_at_setting(uint32_t setting_type)
+{
+	uint8_t flash_value[32];
+	switch (setting_type)
+	{
+	case SEND_INT_OFFSET:
+		if (!api.system.flash.get(SEND_INT_OFFSET, flash_value, 5))
+		{
+			// MYLOG("AT_CMD", "Failed to read send interval from Flash");
+			return false;
+		}
+		if (flash_value[4] != 0xAA)
+		{
+			// MYLOG("AT_CMD", "No valid send interval found, set to default, read 0X%02X 0X%02X 0X%02X 0X%02X",
+			// 	  flash_value[0], flash_value[1],
+			// 	  flash_value[2], flash_value[3]);
+			g_lorawan_settings.send_repeat_time = 60000;
+			save_at_setting(SEND_INT_OFFSET);
+			return false;
+		}
+		// MYLOG("AT_CMD", "Read send interval 0X%02X 0X%02X 0X%02X 0X%02X",
+		// 	  flash_value[0], flash_value[1],
+		// 	  flash_value[2], flash_value[3]);
+		g_lorawan_settings.send_repeat_time = 0;
+		g_lorawan_settings.send_repeat_time |= flash_value[0] << 0;
+		g_lorawan_settings.send_repeat_time |= flash_value[1] << 8;
+		g_lorawan_settings.send_repeat_time |= flash_value[2] << 16;
+		g_lorawan_settings.send_repeat_time |= flash_value[3] << 24;
+		// MYLOG("AT_CMD", "send interval found %ld", g_lorawan_settings.send_repeat_time);
+		return true;
+		break;
+	case TH_AGE_OFFSET:
+		if (!api.system.flash.get(TH_AGE_OFFSET, flash_value, 5))
+		{
+			return false;
+		}
+		if (flash_value[4] != 0xAA)
+		{
+			g_bme_th_max_age = BME_TH_MAX_AGE;
+			return false;
+		}
+		g_bme_th_max_age = 0;
+		g_bme_th_max_age |= flash_value[0] << 0;
+		g_bme_th_max_age |= flash_value[1] << 8;
+		g_bme_th_max_age |= flash_value[2] << 16;
+		g_bme_th_max_age |= flash_value[3] << 24;
+		return true;
+		break;
+	case VOC_MODE_OFFSET:
+		if (!api.system.flash.get(VOC_MODE_OFFSET, flash_value, 2))
+		{
+			return false;
+		}
+		if ((flash_value[1] != 0xAA) || (flash_value[0] > VOC_MODE_BURST))
+		{
+			g_voc_mode = VOC_MODE_CONTINUOUS;
+			return false;
+		}
+		g_voc_mode = flash_value[0];
+		return true;
+		break;
+	case ACQ_LEAD_OFFSET:
+		if (!api.system.flash.get(ACQ_LEAD_OFFSET, flash_value, 5))
+		{
+			return false;
+		}
+		if (flash_value[4] != 0xAA)
+		{
+			g_acq_lead_min = ACQ_LEAD_MIN;
+			return false;
+		}
+		g_acq_lead_min = 0;
+		g_acq_lead_min |= flash_value[0] << 0;
+		g_acq_lead_min |= flash_value[1] << 8;
+		g_acq_lead_min |= flash_value[2] << 16;
+		g_acq_lead_min |= flash_value[3] << 24;
+		return true;
+		break;
+	case BATCH_OFFSET:
+		if (!api.system.flash.get(BATCH_OFFSET, flash_value, 2))
+		{
+			return false;
+		}
+		if ((flash_value[1] != 0xAA) || (flash_value[0] < 1) || (flash_value[0] > BATCH_MAX_SAMPLES))
+		{
+			g_batch_samples = 1;
+			return false;
+		}
+		g_batch_samples = flash_value[0];
+		return true;
+		break;
+	case SOD_OFFSET:
+		if (!api.system.flash.get(SOD_OFFSET, flash_value, 9))
+		{
+			return false;
+		}
+		if (flash_value[8] != 0xAA)
+		{
+			g_sod_heartbeat = 0;
+			g_sod_min_gap = 0;
+			return false;
+		}
+		g_sod_heartbeat = 0;
+		g_sod_heartbeat |= flash_value[0] << 0;
+		g_sod_heartbeat |= flash_value[1] << 8;
+		g_sod_heartbeat |= flash_value[2] << 16;
+		g_sod_heartbeat |= flash_value[3] << 24;
+		g_sod_min_gap = 0;
+		g_sod_min_gap |= flash_value[4] << 0;
+		g_sod_min_gap |= flash_value[5] << 8;
+		g_sod_min_gap |= flash_value[6] << 16;
+		g_sod_min_gap |= flash_value[7] << 24;
+		return true;
+		break;
+	case DEADBAND_OFFSET:
+		if (!api.system.flash.get(DEADBAND_OFFSET, flash_value, SF_CHANNELS * 2 + 1))
+		{
+			return false;
+		}
+		if (flash_value[SF_CHANNELS * 2] != 0xAA)
+		{
+			// Keep the default deadbands
+			return false;
+		}
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			g_sod_deadband[channel] = flash_value[channel * 2] | (flash_value[channel * 2 + 1] << 8);
+		}
+		return true;
+		break;
+	case PAYLOAD_FORMAT_OFFSET:
+		if (!api.system.flash.get(PAYLOAD_FORMAT_OFFSET, flash_value, 2))
+		{
+			return false;
+		}
+		if ((flash_value[1] != 0xAA) || (flash_value[0] > PAYLOAD_DELTA))
+		{
+			g_payload_format = PAYLOAD_LPP;
+			return false;
+		}
+		g_payload_format = flash_value[0];
+		return true;
+		break;
+	case KEYFRAME_OFFSET:
+		if (!api.system.flash.get(KEYFRAME_OFFSET, flash_value, 2))
+		{
+			return false;
+		}
+		if ((flash_value[1] != 0xAA) || (flash_value[0] < 1))
+		{
+			g_delta_keyframe_interval = DELTA_KEYFRAME_INTERVAL;
+			return false;
+		}
+		g_delta_keyframe_interval = flash_value[0];
+		return true;
+		break;
+	case PRIORITY_OFFSET:
+		if (!api.system.flash.get(PRIORITY_OFFSET, flash_value, SF_CHANNELS + 1))
+		{
+			return false;
+		}
+		if (flash_value[SF_CHANNELS] != 0xAA)
+		{
+			// Keep the default priorities
+			return false;
+		}
+		memcpy(g_plan_priority, flash_value, SF_CHANNELS);
+		return true;
+		break;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief Calculate a CRC16 (CCITT) to validate data stored in flash
+ *
+ * @param data data to check
+ * @param length number of bytes
+ * @return uint16_t CRC of the data
+ */
+uint16_t flash_crc16(const uint8_t *data, uint16_t length)
+{
+	uint16_t crc = 0xFFFF;
+	for (uint16_t idx = 0; idx < length; idx++)
+	{
+		crc ^= (uint16_t)data[idx] << 8;
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**
+ * @brief Save setting to flash
+ *
+ * @param setting_type type of setting, valid values
+ * 			SEND_INT_OFFSET for send interval setting
+ * 			TH_AGE_OFFSET for the T/RH cache max age
+ * 			VOC_MODE_OFFSET for the VOC sampling mode
+ * 			ACQ_LEAD_OFFSET for the minimum acquisition lead time
+ * 			BATCH_OFFSET for the number of samples per uplink
+ * 			SOD_OFFSET for the report-by-exception timing
+ * 			DEADBAND_OFFSET for the report-by-exception deadbands
+ * 			PAYLOAD_FORMAT_OFFSET for the payload format
+ * 			KEYFRAME_OFFSET for the keyframe interval of the delta payload
+ * 			PRIORITY_OFFSET for the payload priorities
+ * @return true write to flash was successful
+ * @return false write to flash failed or invalid settings type
+ */
+bool save_at_setting(uint32_t setting_type)
+{
+	uint8_t flash_value[32] = {0};
+	bool wr_result = false;
+	switch (setting_type)
+	{
+	case SEND_INT_OFFSET:
+		flash_value[0] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 0);
+		flash_value[1] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 8);
+		flash_value[2] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 16);
+		flash_value[3] = (uint8_t)(g_lorawan_settings.send_repeat_time >> 24);
+		flash_value[4] = 0xAA;
+		// MYLOG("AT_CMD", "Writing send interval 0X%02X 0X%02X 0X%02X 0X%02X ",
+		// 	  flash_value[0], flash_value[1],
+		// 	  flash_value[2], flash_value[3]);
+		wr_result = api.system.flash.set(SEND_INT_OFFSET, flash_value, 5);
+		// MYLOG("AT_CMD", "Writing %s", wr_result ? "Success" : "Fail");
+		return wr_result;
+		break;
+	case TH_AGE_OFFSET:
+		flash_value[0] = (uint8_t)(g_bme_th_max_age >> 0);
+		flash_value[1] = (uint8_t)(g_bme_th_max_age >> 8);
+		flash_value[2] = (uint8_t)(g_bme_th_max_age >> 16);
+		flash_value[3] = (uint8_t)(g_bme_th_max_age >> 24);
+		flash_value[4] = 0xAA;
+		wr_result = api.system.flash.set(TH_AGE_OFFSET, flash_value, 5);
+		return wr_result;
+		break;
+	case VOC_MODE_OFFSET:
+		flash_value[0] = g_voc_mode;
+		flash_value[1] = 0xAA;
+		wr_result = api.system.flash.set(VOC_MODE_OFFSET, flash_value, 2);
+		return wr_result;
+		break;
+	case ACQ_LEAD_OFFSET:
+		flash_value[0] = (uint8_t)(g_acq_lead_min >> 0);
+		flash_value[1] = (uint8_t)(g_acq_lead_min >> 8);
+		flash_value[2] = (uint8_t)(g_acq_lead_min >> 16);
+		flash_value[3] = (uint8_t)(g_acq_lead_min >> 24);
+		flash_value[4] = 0xAA;
+		wr_result = api.system.flash.set(ACQ_LEAD_OFFSET, flash_value, 5);
+		return wr_result;
+		break;
+	case BATCH_OFFSET:
+		flash_value[0] = g_batch_samples;
+		flash_value[1] = 0xAA;
+		wr_result = api.system.flash.set(BATCH_OFFSET, flash_value, 2);
+		return wr_result;
+		break;
+	case SOD_OFFSET:
+		flash_value[0] = (uint8_t)(g_sod_heartbeat >> 0);
+		flash_value[1] = (uint8_t)(g_sod_heartbeat >> 8);
+		flash_value[2] = (uint8_t)(g_sod_heartbeat >> 16);
+		flash_value[3] = (uint8_t)(g_sod_heartbeat >> 24);
+		flash_value[4] = (uint8_t)(g_sod_min_gap >> 0);
+		flash_value[5] = (uint8_t)(g_sod_min_gap >> 8);
+		flash_value[6] = (uint8_t)(g_sod_min_gap >> 16);
+		flash_value[7] = (uint8_t)(g_sod_min_gap >> 24);
+		flash_value[8] = 0xAA;
+		wr_result = api.system.flash.set(SOD_OFFSET, flash_value, 9);
+		return wr_result;
+		break;
+	case DEADBAND_OFFSET:
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			flash_value[channel * 2] = (uint8_t)(g_sod_deadband[channel]);
+			flash_value[channel * 2 + 1] = (uint8_t)(g_sod_deadband[channel] >> 8);
+		}
+		flash_value[SF_CHANNELS * 2] = 0xAA;
+		wr_result = api.system.flash.set(DEADBAND_OFFSET, flash_value, SF_CHANNELS * 2 + 1);
+		return wr_result;
+		break;
+	case PAYLOAD_FORMAT_OFFSET:
+		flash_value[0] = g_payload_format;
+		flash_value[1] = 0xAA;
+		wr_result = api.system.flash.set(PAYLOAD_FORMAT_OFFSET, flash_value, 2);
+		return wr_result;
+		break;
+	case KEYFRAME_OFFSET:
+		flash_value[0] = g_delta_keyframe_interval;
+		flash_value[1] = 0xAA;
+		wr_result = api.system.flash.set(KEYFRAME_OFFSET, flash_value, 2);
+		return wr_result;
+		break;
+	case PRIORITY_OFFSET:
+		memcpy(flash_value, g_plan_priority, SF_CHANNELS);
+		flash_value[SF_CHANNELS] = 0xAA;
+		wr_result = api.system.flash.set(PRIORITY_OFFSET, flash_value, SF_CHANNELS + 1);
+		return wr_result;
+		break;
+	default:
+		return false;
+		break;
+	}
+	return false;
+}
@@ -0,0 +1,202 @@
+/**
+ * @file debug_log.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Deferred debug logger
+ *        Log calls only format the message into a ring buffer.
+ *        The buffer is written to Serial from loop() before the
+ *        MCU goes back to sleep, so debug builds have the same
+ *        timing in the sensor and timer callbacks as release builds.
+ *        Until setup() enables the deferred mode the messages are
+ *        printed right away, the setup() output does not fit into
+ *        the queue.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+#if MY_DEBUG > 0
+
+/** Queued log lines */
+static char log_queue[LOG_QUEUE_SIZE][LOG_LINE_SIZE];
+/** Flag per line, set when the line is formatted completely */
+static volatile bool log_ready[LOG_QUEUE_SIZE];
+/** Next line to reserve, changed with interrupts disabled */
+static volatile uint16_t log_head = 0;
+/** Next line to print, only changed by log_flush() */
+static volatile uint16_t log_tail = 0;
+/** Number of lines lost because the queue was full */
+static volatile uint32_t log_dropped = 0;
+/** Messages are queued, before they are printed right away */
+static volatile bool log_deferred = false;
+
+/** Letters of the log levels, printed in front of the tag */
+static const char log_level_char[] = {'?', 'E', 'W', 'I', 'D'};
+
+/** Comma separated list of suppressed tags */
+static const char *log_filter = MY_LOG_FILTER;
+
+/**
+ * @brief Check if a tag is in the filter list
+ *
+ * @param tag tag of the log message
+ * @return true if the message should be suppressed
+ */
+static bool log_tag_filtered(const char *tag)
+{
+	size_t tag_len = strlen(tag);
+	const char *entry = log_filter;
+
+	while (*entry != 0)
+	{
+		const char *end = strchr(entry, ',');
+		size_t entry_len = (end == NULL) ? strlen(entry) : (size_t)(end - entry);
+		if ((entry_len == tag_len) && (strncmp(entry, tag, tag_len) == 0))
+		{
+			return true;
+		}
+		if (end == NULL)
+		{
+			break;
+		}
+		entry = end + 1;
+	}
+	return false;
+}
+
+/**
+ * @brief Set the list of suppressed tags
+ *
+ * @param tags comma separated list of tags, e.g. "BME,VOC", "" to show all
+ *        The string must stay valid, it is not copied
+ */
+void log_set_filter(const char *tags)
+{
+	log_filter = (tags == NULL) ? "" : tags;
+}
+
+/**
+ * @brief Switch between printing right away and queueing
+ *        setup() prints its messages right away and switches
+ *        to the deferred mode when the timers are running
+ *
+ * @param deferred true to queue the messages until log_flush()
+ */
+void log_set_deferred(bool deferred)
+{
+	if (!deferred)
+	{
+		log_flush();
+	}
+	log_deferred = deferred;
+}
+
+/**
+ * @brief Format level, tag and message into a line
+ *
+ * @param line buffer with LOG_LINE_SIZE bytes
+ * @param level log level of the message
+ * @param tag tag printed in front of the message, can be NULL
+ * @param format printf style format
+ * @param args arguments of the format
+ */
+static void log_format(char *line, uint8_t level, const char *tag, const char *format, va_list args)
+{
+	char level_char = (level < sizeof(log_level_char)) ? log_level_char[level] : '?';
+	int used;
+	if (tag != NULL)
+	{
+		used = snprintf(line, LOG_LINE_SIZE, "%c [%s] ", level_char, tag);
+	}
+	else
+	{
+		used = snprintf(line, LOG_LINE_SIZE, "%c ", level_char);
+	}
+	if ((used < 0) || (used >= LOG_LINE_SIZE))
+	{
+		used = 0;
+	}
+	vsnprintf(&line[used], LOG_LINE_SIZE - used, format, args);
+}
+
+/**
+ * @brief Format a log message into the queue
+ *        Does not touch the Serial port and does not block
+ *        Can be called from loop() and from callbacks, the
+ *        line is reserved with interrupts disabled
+ *
+ * @param level log level of the message
+ * @param tag tag printed in front of the message, can be NULL
+ * @param format printf style format
+ */
+void log_push(uint8_t level, const char *tag, const char *format, ...)
+{
+	if ((tag != NULL) && log_tag_filtered(tag))
+	{
+		return;
+	}
+
+	va_list args;
+	va_start(args, format);
+
+	if (!log_deferred)
+	{
+		char line[LOG_LINE_SIZE];
+		log_format(line, level, tag, format, args);
+		va_end(args);
+		Serial.printf("%s\n", line);
+		return;
+	}
+
+	// Reserve a line, a callback can interrupt the formatting of another message
+	noInterrupts();
+	uint16_t line_idx = log_head;
+	uint16_t next_head = (line_idx + 1) % LOG_QUEUE_SIZE;
+	bool queue_full = (next_head == log_tail);
+	if (queue_full)
+	{
+		// Message is lost
+		log_dropped++;
+	}
+	else
+	{
+		log_head = next_head;
+	}
+	interrupts();
+
+	if (!queue_full)
+	{
+		log_format(log_queue[line_idx], level, tag, format, args);
+		log_ready[line_idx] = true;
+	}
+	va_end(args);
+}
+
+/**
+ * @brief Print all queued log messages
+ *        Called from loop() before the MCU goes to sleep
+ *
+ */
+void log_flush(void)
+{
+	// Stop at a line that is still formatted by an interrupted producer
+	while ((log_tail != log_head) && log_ready[log_tail])
+	{
+		Serial.printf("%s\n", log_queue[log_tail]);
+		log_ready[log_tail] = false;
+		log_tail = (log_tail + 1) % LOG_QUEUE_SIZE;
+	}
+
+	if (log_dropped != 0)
+	{
+		noInterrupts();
+		uint32_t dropped = log_dropped;
+		log_dropped = 0;
+		interrupts();
+		Serial.printf("W [LOG] %lu messages dropped\n", (unsigned long)dropped);
+	}
+}
+
+#endif // MY_DEBUG > 0
@@ -0,0 +1,76 @@
+/**
+ * @file debug_log.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Deferred debug logger, messages are queued and printed before the MCU sleeps
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DEBUG_LOG_H
+#define DEBUG_LOG_H
+
+#include <Arduino.h>
+
+/** Log levels, a message is only compiled in if its level is <= MY_LOG_LEVEL */
+#define LOG_LVL_ERROR 1
+#define LOG_LVL_WARN 2
+#define LOG_LVL_INFO 3
+#define LOG_LVL_DEBUG 4
+
+#ifndef MY_LOG_LEVEL
+#define MY_LOG_LEVEL LOG_LVL_INFO
+#endif
+
+// Comma separated list of tags that are suppressed at startup, e.g. "BME,VOC"
+#ifndef MY_LOG_FILTER
+#define MY_LOG_FILTER ""
+#endif
+
+// Number of log lines that can be queued between two flushes
+#ifndef LOG_QUEUE_SIZE
+#define LOG_QUEUE_SIZE 16
+#endif
+
+// Max length of one log line including the tag
+#ifndef LOG_LINE_SIZE
+#define LOG_LINE_SIZE 96
+#endif
+
+#if MY_DEBUG > 0
+void log_push(uint8_t level, const char *tag, const char *format, ...);
+void log_flush(void);
+void log_set_filter(const char *tags);
+void log_set_deferred(bool deferred);
+#else
+#define log_flush()
+#define log_set_filter(tags)
+#define log_set_deferred(deferred)
+#endif
+
+#if MY_DEBUG > 0 && MY_LOG_LEVEL >= LOG_LVL_ERROR
+#define MYLOG_E(tag, ...) log_push(LOG_LVL_ERROR, tag, __VA_ARGS__)
+#else
+#define MYLOG_E(...)
+#endif
+
+#if MY_DEBUG > 0 && MY_LOG_LEVEL >= LOG_LVL_WARN
+#define MYLOG_W(tag, ...) log_push(LOG_LVL_WARN, tag, __VA_ARGS__)
+#else
+#define MYLOG_W(...)
+#endif
+
+#if MY_DEBUG > 0 && MY_LOG_LEVEL >= LOG_LVL_INFO
+#define MYLOG_I(tag, ...) log_push(LOG_LVL_INFO, tag, __VA_ARGS__)
+#else
+#define MYLOG_I(...)
+#endif
+
+#if MY_DEBUG > 0 && MY_LOG_LEVEL >= LOG_LVL_DEBUG
+#define MYLOG_D(tag, ...) log_push(LOG_LVL_DEBUG, tag, __VA_ARGS__)
+#else
+#define MYLOG_D(...)
+#endif
+
+#endif // DEBUG_LOG_H
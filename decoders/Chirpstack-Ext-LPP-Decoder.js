@@ -38,7 +38,11 @@
  *  GPS Location        3337    137     89      11          Latitude  : 0.000001 ° Signed MSB
  *                                                          Longitude : 0.000001 ° Signed MSB
  *                                                          Altitude  : 0.01 meter Signed MSB
- *  VOC index           3338    138     8A      1           VOC index
+ *  VOC index           3338    138     8A      2           1 Unsigned MSB
+ *
+ * Channel 9 (analog_in_9) is the BME680 gas resistance in kOhm, 0.01 kOhm per bit,
+ * limited to 327.67 kOhm. The RAK3172 firmware before the fixed point encoding sent
+ * 1 kOhm per bit on this channel, its values decode 100 times too small.
  * 
  */
 
@@ -110,6 +114,9 @@ function lppDecode(bytes) {
 
 		var s_value = 0;
 		var type = sensor_types[s_type];
+		if (i + type.size > bytes.length) {
+			throw 'Payload too short!: ' + s_type;
+		}
 		switch (s_type) {
 
 			case 113:   // Accelerometer
@@ -162,8 +169,190 @@ function lppDecode(bytes) {
 
 }
 
+// Uplinks on fPort 3 contain samples that were queued while the node could not send.
+// Each sample starts with its age in seconds on channel 40.
+function lppSamples(fields) {
+	var samples = [];
+	var sample = null;
+	fields.forEach(function (field) {
+		if (field['channel'] == 40 || sample == null) {
+			sample = {};
+			samples.push(sample);
+		}
+		sample[field['name'] + '_' + field['channel']] = field['value'];
+	});
+	return samples;
+}
+
+// Uplinks on fPort 4 contain several samples in the batch format of sample_batch.cpp.
+// The values are returned with the same names as in the LPP uplinks.
+function batchDecode(bytes) {
+	var channels = [
+		{ 'key': 'temperature_7', 'size': 2, 'signed': true, 'divisor': 10 },
+		{ 'key': 'humidity_6', 'size': 1, 'signed': false, 'divisor': 2 },
+		{ 'key': 'barometer_8', 'size': 2, 'signed': false, 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'size': 2, 'signed': false, 'divisor': 100 },
+		{ 'key': 'concentration_35', 'size': 2, 'signed': false, 'divisor': 1 },
+		{ 'key': 'temperature_36', 'size': 2, 'signed': true, 'divisor': 10 },
+		{ 'key': 'humidity_37', 'size': 1, 'signed': false, 'divisor': 2 },
+		{ 'key': 'voc_16', 'size': 2, 'signed': false, 'divisor': 1 },
+		{ 'key': 'voltage_1', 'size': 2, 'signed': false, 'divisor': 100 }
+	];
+
+	if (bytes[0] != 2) {
+		throw 'Batch format error!: ' + bytes[0];
+	}
+	var age = (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+	var count = bytes[4];
+	var bitmap = (bytes[5] << 8) | bytes[6];
+	var i = 7;
+
+	// Seconds from the previous sample, 7 bits per byte, lowest bits first
+	var samples = [{ 'generic_40': age }];
+	var time = 0;
+	for (var s = 1; s < count; s++) {
+		var offset = 0;
+		var shift = 1;
+		var next;
+		do {
+			next = bytes[i++];
+			offset += (next & 0x7F) * shift;
+			shift *= 128;
+		} while (next & 0x80);
+		time += offset;
+		samples.push({ 'generic_40': age - time });
+	}
+
+	function readValue(channel) {
+		var value = 0;
+		for (var b = 0; b < channel.size; b++) {
+			value = (value << 8) | bytes[i++];
+		}
+		if (channel.signed && (value & (1 << (channel.size * 8 - 1)))) {
+			value -= 1 << (channel.size * 8);
+		}
+		return value;
+	}
+
+	for (var c = 0; c < channels.length; c++) {
+		if (!(bitmap & (1 << c))) {
+			continue;
+		}
+		var value = 0;
+		for (var s = 0; s < count; s++) {
+			if (s == 0) {
+				value = readValue(channels[c]);
+			} else if (bytes[i] == 0x80) {
+				// Escape, full value follows
+				i++;
+				value = readValue(channels[c]);
+			} else {
+				var delta = bytes[i++];
+				value += (delta > 127) ? delta - 256 : delta;
+			}
+			samples[s][channels[c].key] = value / channels[c].divisor;
+		}
+	}
+	return samples;
+}
+
+// Uplinks on fPort 5 contain one sample in the bit-packed format of packed_payload.cpp.
+// The values are returned with the same names as in the LPP uplinks.
+function packedDecode(bytes) {
+	var fields = [
+		{ 'key': 'temperature_7', 'bits': 11, 'min': -400, 'divisor': 10 },
+		{ 'key': 'humidity_6', 'bits': 8, 'min': 0, 'divisor': 2 },
+		{ 'key': 'barometer_8', 'bits': 13, 'min': 3000, 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'bits': 15, 'min': 0, 'divisor': 10 },
+		{ 'key': 'concentration_35', 'bits': 14, 'min': 0, 'divisor': 1 },
+		{ 'key': 'temperature_36', 'bits': 11, 'min': -400, 'divisor': 10 },
+		{ 'key': 'humidity_37', 'bits': 8, 'min': 0, 'divisor': 2 },
+		{ 'key': 'voc_16', 'bits': 9, 'min': 0, 'divisor': 1 },
+		{ 'key': 'voltage_1', 'bits': 8, 'min': 0, 'divisor': 50 }
+	];
+
+	if (bytes[0] != 1) {
+		throw 'Packed schema error!: ' + bytes[0];
+	}
+	var bit = 8;
+
+	function readBits(count) {
+		var value = 0;
+		for (var b = 0; b < count; b++) {
+			value = (value << 1) | ((bytes[bit >> 3] >> (7 - (bit & 7))) & 1);
+			bit++;
+		}
+		return value;
+	}
+
+	var present = readBits(fields.length);
+	var response = {};
+	for (var c = 0; c < fields.length; c++) {
+		if (present & (1 << c)) {
+			response[fields[c].key] = (readBits(fields[c].bits) + fields[c].min) / fields[c].divisor;
+		}
+	}
+	return response;
+}
+
+// Uplinks on fPort 6 are keyframes with all values or deltas to the last keyframe, see delta_payload.cpp.
+// Without state only keyframes have values, deltas are returned with a 'delta_' prefix
+// and have to be added to the keyframe with the same id, see Delta-Reference-Decoder.js.
+function deltaDecode(bytes) {
+	var channels = [
+		{ 'key': 'temperature_7', 'divisor': 10 },
+		{ 'key': 'humidity_6', 'divisor': 2 },
+		{ 'key': 'barometer_8', 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'divisor': 100 },
+		{ 'key': 'concentration_35', 'divisor': 1 },
+		{ 'key': 'temperature_36', 'divisor': 10 },
+		{ 'key': 'humidity_37', 'divisor': 2 },
+		{ 'key': 'voc_16', 'divisor': 1 },
+		{ 'key': 'voltage_1', 'divisor': 100 }
+	];
+	var i = 0;
+
+	function readVarint() {
+		var value = 0;
+		var shift = 0;
+		var data;
+		do {
+			data = bytes[i++];
+			value += (data & 0x7F) * Math.pow(2, shift);
+			shift += 7;
+		} while (data & 0x80);
+		return value;
+	}
+
+	var keyframe = (bytes[0] & 0x80) != 0;
+	var response = { 'keyframe': bytes[i++] & 0x7F, 'counter': keyframe ? 0 : bytes[i++] };
+	var bitmap = readVarint();
+	for (var c = 0; c < channels.length; c++) {
+		if (bitmap & (1 << c)) {
+			var zigzag = readVarint();
+			var value = (zigzag % 2) ? -(zigzag + 1) / 2 : zigzag / 2;
+			response[(keyframe ? '' : 'delta_') + channels[c].key] = value / channels[c].divisor;
+		}
+	}
+	return response;
+}
+
 // To use with Chirpstack
 function Decode(fPort, bytes, variables) {
+	// queued samples, one object per sample
+	if (fPort == 3) {
+		return { data: { 'samples': lppSamples(lppDecode(bytes, 1)) } };
+	}
+	if (fPort == 4) {
+		return { data: { 'samples': batchDecode(bytes) } };
+	}
+	if (fPort == 5) {
+		return { data: packedDecode(bytes) };
+	}
+	if (fPort == 6) {
+		return { data: deltaDecode(bytes) };
+	}
+
 	// flat output (like original decoder):
 	var response = {};
 	lppDecode(bytes, 1).forEach(function (field) {
@@ -178,6 +367,20 @@ function Decode(fPort, bytes, variables) {
 
 // To use with TTN
 function Decoder(bytes, port) {
+	// queued samples, one object per sample
+	if (port == 3) {
+		return { data: { 'samples': lppSamples(lppDecode(bytes, 1)) } };
+	}
+	if (port == 4) {
+		return { data: { 'samples': batchDecode(bytes) } };
+	}
+	if (port == 5) {
+		return { data: packedDecode(bytes) };
+	}
+	if (port == 6) {
+		return { data: deltaDecode(bytes) };
+	}
+
 	// flat output (like original decoder):
 	var response = {};
 	lppDecode(bytes, 1).forEach(function (field) {
@@ -0,0 +1,112 @@
+// Stateful decoder for the keyframe and delta uplinks on fPort 6, see delta_payload.cpp.
+// The network server decoders have no state, they return keyframes and deltas as they are.
+// This decoder keeps the last keyframe and returns complete samples for both.
+//
+// Usage in an application server:
+//   var decoder = new DeltaDecoder();
+//   var result = decoder.decode(bytes);
+//   if (result.keyframe_missing) { send any downlink on fPort 6 to request a keyframe }
+//   else { use result.data }
+//
+// A lost delta uplink has no effect on the next ones, they all refer to the keyframe.
+// After a lost keyframe the deltas cannot be decoded until the next keyframe arrives.
+
+var DELTA_CHANNELS = [
+	{ 'key': 'temperature_7', 'divisor': 10 },
+	{ 'key': 'humidity_6', 'divisor': 2 },
+	{ 'key': 'barometer_8', 'divisor': 10 },
+	{ 'key': 'analog_in_9', 'divisor': 100 },
+	{ 'key': 'concentration_35', 'divisor': 1 },
+	{ 'key': 'temperature_36', 'divisor': 10 },
+	{ 'key': 'humidity_37', 'divisor': 2 },
+	{ 'key': 'voc_16', 'divisor': 1 },
+	{ 'key': 'voltage_1', 'divisor': 100 }
+];
+
+function DeltaDecoder() {
+	// Last keyframe, raw values per channel
+	this.key = null;
+	// Statistics
+	this.stats = { 'keyframes': 0, 'deltas': 0, 'undecodable': 0, 'lost': 0 };
+	this.lastCounter = 0;
+}
+
+// Split an uplink into keyframe id, counter and raw values or deltas per channel
+DeltaDecoder.prototype.parse = function (bytes) {
+	var i = 0;
+
+	function readVarint() {
+		var value = 0;
+		var shift = 0;
+		var data;
+		do {
+			if (i >= bytes.length) {
+				throw 'Delta payload too short';
+			}
+			data = bytes[i++];
+			value += (data & 0x7F) * Math.pow(2, shift);
+			shift += 7;
+		} while (data & 0x80);
+		return value;
+	}
+
+	var frame = { 'keyframe': (bytes[0] & 0x80) != 0, 'id': bytes[i++] & 0x7F, 'counter': 0, 'values': [] };
+	if (!frame.keyframe) {
+		frame.counter = bytes[i++];
+	}
+	frame.bitmap = readVarint();
+	for (var c = 0; c < DELTA_CHANNELS.length; c++) {
+		if (frame.bitmap & (1 << c)) {
+			var zigzag = readVarint();
+			frame.values[c] = (zigzag % 2) ? -(zigzag + 1) / 2 : zigzag / 2;
+		}
+	}
+	return frame;
+};
+
+// Convert raw values to the names and units of the LPP uplinks
+DeltaDecoder.prototype.sample = function (raw) {
+	var data = {};
+	for (var c = 0; c < DELTA_CHANNELS.length; c++) {
+		if (raw[c] !== undefined) {
+			data[DELTA_CHANNELS[c].key] = raw[c] / DELTA_CHANNELS[c].divisor;
+		}
+	}
+	return data;
+};
+
+// Decode one uplink, returns { data } or { keyframe_missing: id }
+DeltaDecoder.prototype.decode = function (bytes) {
+	var frame = this.parse(bytes);
+
+	if (frame.keyframe) {
+		this.key = { 'id': frame.id, 'values': frame.values };
+		this.lastCounter = 0;
+		this.stats.keyframes++;
+		return { 'data': this.sample(frame.values) };
+	}
+
+	if ((this.key == null) || (this.key.id != frame.id)) {
+		this.stats.undecodable++;
+		return { 'keyframe_missing': frame.id };
+	}
+
+	if (frame.counter > this.lastCounter + 1) {
+		this.stats.lost += frame.counter - this.lastCounter - 1;
+	}
+	this.lastCounter = frame.counter;
+	this.stats.deltas++;
+
+	// Channels without delta did not change since the keyframe
+	var raw = this.key.values.slice();
+	for (var c = 0; c < DELTA_CHANNELS.length; c++) {
+		if (frame.values[c] !== undefined) {
+			raw[c] += frame.values[c];
+		}
+	}
+	return { 'data': this.sample(raw) };
+};
+
+if (typeof module !== 'undefined') {
+	module.exports = DeltaDecoder;
+}
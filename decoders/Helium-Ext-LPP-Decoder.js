@@ -1,188 +1,391 @@
-/**
- * @reference https://github.com/myDevicesIoT/cayenne-docs/blob/master/docs/LORA.md
- * @reference http://openmobilealliance.org/wp/OMNA/LwM2M/LwM2MRegistry.html#extlabel
- *
- * Adapted for lora-app-server from https://gist.github.com/iPAS/e24970a91463a4a8177f9806d1ef14b8
- *
- * Type                 IPSO    LPP     Hex     Data Size   Data Resolution per bit
- *  Digital Input       3200    0       0       1           1
- *  Digital Output      3201    1       1       1           1
- *  Analog Input        3202    2       2       2           0.01 Signed
- *  Analog Output       3203    3       3       2           0.01 Signed
- *  Illuminance Sensor  3301    101     65      2           1 Lux Unsigned MSB
- *  Presence Sensor     3302    102     66      1           1
- *  Temperature Sensor  3303    103     67      2           0.1 °C Signed MSB
- *  Humidity Sensor     3304    104     68      1           0.5 % Unsigned
- *  Accelerometer       3313    113     71      6           0.001 G Signed MSB per axis
- *  Barometer           3315    115     73      2           0.1 hPa Unsigned MSB
- *  Time                3333    133     85      4           Unix time MSB
- *  Gyrometer           3334    134     86      6           0.01 °/s Signed MSB per axis
- *  GPS Location        3336    136     88      9           Latitude  : 0.0001 ° Signed MSB
- *                                                          Longitude : 0.0001 ° Signed MSB
- *                                                          Altitude  : 0.01 meter Signed MSB
- *
- * Additional types
- *  Generic Sensor      3300    100     64      4           Unsigned integer MSB
- *  Voltage             3316    116     74      2           0.01 V Unsigned MSB
- *  Current             3317    117     75      2           0.001 A Unsigned MSB
- *  Frequency           3318    118     76      4           1 Hz Unsigned MSB
- *  Percentage          3320    120     78      1           1% Unsigned
- *  Altitude            3321    121     79      2           1m Signed MSB
- *  Concentration       3325    125     7D      2           1 PPM unsigned : 1pmm = 1 * 10 ^-6 = 0.000 001
- *  Power               3328    128     80      2           1 W Unsigned MSB
- *  Distance            3330    130     82      4           0.001m Unsigned MSB
- *  Energy              3331    131     83      4           0.001kWh Unsigned MSB
- *  Colour              3335    135     87      3           R: 255 G: 255 B: 255
- *  Direction           3332    132     84      2           1º Unsigned MSB
- *  Switch              3342    142     8E      1           0/1
- *  GPS Location        3337    137     89      11          Latitude  : 0.000001 ° Signed MSB
- *                                                          Longitude : 0.000001 ° Signed MSB
- *                                                          Altitude  : 0.01 meter Signed MSB
- *  VOC index           3338    138     8A      1           VOC index
- * 
- */
-
-// lppDecode decodes an array of bytes into an array of ojects, 
-// each one with the channel, the data type and the value.
-function lppDecode(bytes) {
-
-	var sensor_types = {
-		0: { 'size': 1, 'name': 'digital_in', 'signed': false, 'divisor': 1 },
-		1: { 'size': 1, 'name': 'digital_out', 'signed': false, 'divisor': 1 },
-		2: { 'size': 2, 'name': 'analog_in', 'signed': true, 'divisor': 100 },
-		3: { 'size': 2, 'name': 'analog_out', 'signed': true, 'divisor': 100 },
-		100: { 'size': 4, 'name': 'generic', 'signed': false, 'divisor': 1 },
-		101: { 'size': 2, 'name': 'illuminance', 'signed': false, 'divisor': 1 },
-		102: { 'size': 1, 'name': 'presence', 'signed': false, 'divisor': 1 },
-		103: { 'size': 2, 'name': 'temperature', 'signed': true, 'divisor': 10 },
-		104: { 'size': 1, 'name': 'humidity', 'signed': false, 'divisor': 2 },
-		113: { 'size': 6, 'name': 'accelerometer', 'signed': true, 'divisor': 1000 },
-		115: { 'size': 2, 'name': 'barometer', 'signed': false, 'divisor': 10 },
-		116: { 'size': 2, 'name': 'voltage', 'signed': false, 'divisor': 100 },
-		117: { 'size': 2, 'name': 'current', 'signed': false, 'divisor': 1000 },
-		118: { 'size': 4, 'name': 'frequency', 'signed': false, 'divisor': 1 },
-		120: { 'size': 1, 'name': 'percentage', 'signed': false, 'divisor': 1 },
-		121: { 'size': 2, 'name': 'altitude', 'signed': true, 'divisor': 1 },
-		125: { 'size': 2, 'name': 'concentration', 'signed': false, 'divisor': 1 },
-		128: { 'size': 2, 'name': 'power', 'signed': false, 'divisor': 1 },
-		130: { 'size': 4, 'name': 'distance', 'signed': false, 'divisor': 1000 },
-		131: { 'size': 4, 'name': 'energy', 'signed': false, 'divisor': 1000 },
-		132: { 'size': 2, 'name': 'direction', 'signed': false, 'divisor': 1 },
-		133: { 'size': 4, 'name': 'time', 'signed': false, 'divisor': 1 },
-		134: { 'size': 6, 'name': 'gyrometer', 'signed': true, 'divisor': 100 },
-		135: { 'size': 3, 'name': 'colour', 'signed': false, 'divisor': 1 },
-		136: { 'size': 9, 'name': 'gps', 'signed': true, 'divisor': [10000, 10000, 100] },
-		137: { 'size': 11, 'name': 'gps', 'signed': true, 'divisor': [1000000, 1000000, 100] },
-		138: { 'size': 2, 'name': 'voc', 'signed': false, 'divisor': 1 },
-		142: { 'size': 1, 'name': 'switch', 'signed': false, 'divisor': 1 },
-	};
-
-	function arrayToDecimal(stream, is_signed, divisor) {
-
-		var value = 0;
-		for (var i = 0; i < stream.length; i++) {
-			if (stream[i] > 0xFF)
-				throw 'Byte value overflow!';
-			value = (value << 8) | stream[i];
-		}
-
-		if (is_signed) {
-			var edge = 1 << (stream.length) * 8;  // 0x1000..
-			var max = (edge - 1) >> 1;             // 0x0FFF.. >> 1
-			value = (value > max) ? value - edge : value;
-		}
-
-		value /= divisor;
-
-		return value;
-
-	}
-
-	var sensors = [];
-	var i = 0;
-	while (i < bytes.length) {
-
-		var s_no = bytes[i++];
-		var s_type = bytes[i++];
-		if (typeof sensor_types[s_type] == 'undefined') {
-			throw 'Sensor type error!: ' + s_type;
-		}
-
-		var s_value = 0;
-		var type = sensor_types[s_type];
-		switch (s_type) {
-
-			case 113:   // Accelerometer
-			case 134:   // Gyrometer
-				s_value = {
-					'x': arrayToDecimal(bytes.slice(i + 0, i + 2), type.signed, type.divisor),
-					'y': arrayToDecimal(bytes.slice(i + 2, i + 4), type.signed, type.divisor),
-					'z': arrayToDecimal(bytes.slice(i + 4, i + 6), type.signed, type.divisor)
-				};
-				break;
-			case 136:   // GPS Location
-				s_value = {
-					'latitude': arrayToDecimal(bytes.slice(i + 0, i + 3), type.signed, type.divisor[0]),
-					'longitude': arrayToDecimal(bytes.slice(i + 3, i + 6), type.signed, type.divisor[1]),
-					'altitude': arrayToDecimal(bytes.slice(i + 6, i + 9), type.signed, type.divisor[2])
-				};
-				break;
-			case 137:   // Precise GPS Location
-				s_value = {
-					'latitude': arrayToDecimal(bytes.slice(i + 0, i + 4), type.signed, type.divisor[0]),
-					'longitude': arrayToDecimal(bytes.slice(i + 4, i + 8), type.signed, type.divisor[1]),
-					'altitude': arrayToDecimal(bytes.slice(i + 8, i + 11), type.signed, type.divisor[2])
-				};
-				break;
-			case 135:   // Colour
-				s_value = {
-					'r': arrayToDecimal(bytes.slice(i + 0, i + 1), type.signed, type.divisor),
-					'g': arrayToDecimal(bytes.slice(i + 1, i + 2), type.signed, type.divisor),
-					'b': arrayToDecimal(bytes.slice(i + 2, i + 3), type.signed, type.divisor)
-				};
-				break;
-
-			default:    // All the rest
-				s_value = arrayToDecimal(bytes.slice(i, i + type.size), type.signed, type.divisor);
-				break;
-		}
-
-		sensors.push({
-			'channel': s_no,
-			'type': s_type,
-			'name': type.name,
-			'value': s_value
-		});
-
-		i += type.size;
-
-	}
-
-	return sensors;
-
-}
-
-// To use with Chirpstack
-function Decode(fPort, bytes, variables) {
-	// flat output (like original decoder):
-	var response = {};
-	lppDecode(bytes, 1).forEach(function (field) {
-		response[field['name'] + '_' + field['channel']] = field['value'];
-	});
-	return { data: response };
-
-	// field output
-	//return {'fields': lppDecode(bytes, fPort)};
-
-}
-
-// To use with Helium
-function Decoder(bytes, port, uplink_info) {
-	// flat output (like original decoder):
-	var response = {};
-	lppDecode(bytes, 1).forEach(function (field) {
-		response[field['name'] + '_' + field['channel']] = field['value'];
-	});
-	return { data: response };
-}
-
+/**
+ * @reference https://github.com/myDevicesIoT/cayenne-docs/blob/master/docs/LORA.md
+ * @reference http://openmobilealliance.org/wp/OMNA/LwM2M/LwM2MRegistry.html#extlabel
+ *
+ * Adapted for lora-app-server from https://gist.github.com/iPAS/e24970a91463a4a8177f9806d1ef14b8
+ *
+ * Type                 IPSO    LPP     Hex     Data Size   Data Resolution per bit
+ *  Digital Input       3200    0       0       1           1
+ *  Digital Output      3201    1       1       1           1
+ *  Analog Input        3202    2       2       2           0.01 Signed
+ *  Analog Output       3203    3       3       2           0.01 Signed
+ *  Illuminance Sensor  3301    101     65      2           1 Lux Unsigned MSB
+ *  Presence Sensor     3302    102     66      1           1
+ *  Temperature Sensor  3303    103     67      2           0.1 °C Signed MSB
+ *  Humidity Sensor     3304    104     68      1           0.5 % Unsigned
+ *  Accelerometer       3313    113     71      6           0.001 G Signed MSB per axis
+ *  Barometer           3315    115     73      2           0.1 hPa Unsigned MSB
+ *  Time                3333    133     85      4           Unix time MSB
+ *  Gyrometer           3334    134     86      6           0.01 °/s Signed MSB per axis
+ *  GPS Location        3336    136     88      9           Latitude  : 0.0001 ° Signed MSB
+ *                                                          Longitude : 0.0001 ° Signed MSB
+ *                                                          Altitude  : 0.01 meter Signed MSB
+ *
+ * Additional types
+ *  Generic Sensor      3300    100     64      4           Unsigned integer MSB
+ *  Voltage             3316    116     74      2           0.01 V Unsigned MSB
+ *  Current             3317    117     75      2           0.001 A Unsigned MSB
+ *  Frequency           3318    118     76      4           1 Hz Unsigned MSB
+ *  Percentage          3320    120     78      1           1% Unsigned
+ *  Altitude            3321    121     79      2           1m Signed MSB
+ *  Concentration       3325    125     7D      2           1 PPM unsigned : 1pmm = 1 * 10 ^-6 = 0.000 001
+ *  Power               3328    128     80      2           1 W Unsigned MSB
+ *  Distance            3330    130     82      4           0.001m Unsigned MSB
+ *  Energy              3331    131     83      4           0.001kWh Unsigned MSB
+ *  Colour              3335    135     87      3           R: 255 G: 255 B: 255
+ *  Direction           3332    132     84      2           1º Unsigned MSB
+ *  Switch              3342    142     8E      1           0/1
+ *  GPS Location        3337    137     89      11          Latitude  : 0.000001 ° Signed MSB
+ *                                                          Longitude : 0.000001 ° Signed MSB
+ *                                                          Altitude  : 0.01 meter Signed MSB
+ *  VOC index           3338    138     8A      2           1 Unsigned MSB
+ *
+ * Channel 9 (analog_in_9) is the BME680 gas resistance in kOhm, 0.01 kOhm per bit,
+ * limited to 327.67 kOhm. The RAK3172 firmware before the fixed point encoding sent
+ * 1 kOhm per bit on this channel, its values decode 100 times too small.
+ * 
+ */
+
+// lppDecode decodes an array of bytes into an array of ojects, 
+// each one with the channel, the data type and the value.
+function lppDecode(bytes) {
+
+	var sensor_types = {
+		0: { 'size': 1, 'name': 'digital_in', 'signed': false, 'divisor': 1 },
+		1: { 'size': 1, 'name': 'digital_out', 'signed': false, 'divisor': 1 },
+		2: { 'size': 2, 'name': 'analog_in', 'signed': true, 'divisor': 100 },
+		3: { 'size': 2, 'name': 'analog_out', 'signed': true, 'divisor': 100 },
+		100: { 'size': 4, 'name': 'generic', 'signed': false, 'divisor': 1 },
+		101: { 'size': 2, 'name': 'illuminance', 'signed': false, 'divisor': 1 },
+		102: { 'size': 1, 'name': 'presence', 'signed': false, 'divisor': 1 },
+		103: { 'size': 2, 'name': 'temperature', 'signed': true, 'divisor': 10 },
+		104: { 'size': 1, 'name': 'humidity', 'signed': false, 'divisor': 2 },
+		113: { 'size': 6, 'name': 'accelerometer', 'signed': true, 'divisor': 1000 },
+		115: { 'size': 2, 'name': 'barometer', 'signed': false, 'divisor': 10 },
+		116: { 'size': 2, 'name': 'voltage', 'signed': false, 'divisor': 100 },
+		117: { 'size': 2, 'name': 'current', 'signed': false, 'divisor': 1000 },
+		118: { 'size': 4, 'name': 'frequency', 'signed': false, 'divisor': 1 },
+		120: { 'size': 1, 'name': 'percentage', 'signed': false, 'divisor': 1 },
+		121: { 'size': 2, 'name': 'altitude', 'signed': true, 'divisor': 1 },
+		125: { 'size': 2, 'name': 'concentration', 'signed': false, 'divisor': 1 },
+		128: { 'size': 2, 'name': 'power', 'signed': false, 'divisor': 1 },
+		130: { 'size': 4, 'name': 'distance', 'signed': false, 'divisor': 1000 },
+		131: { 'size': 4, 'name': 'energy', 'signed': false, 'divisor': 1000 },
+		132: { 'size': 2, 'name': 'direction', 'signed': false, 'divisor': 1 },
+		133: { 'size': 4, 'name': 'time', 'signed': false, 'divisor': 1 },
+		134: { 'size': 6, 'name': 'gyrometer', 'signed': true, 'divisor': 100 },
+		135: { 'size': 3, 'name': 'colour', 'signed': false, 'divisor': 1 },
+		136: { 'size': 9, 'name': 'gps', 'signed': true, 'divisor': [10000, 10000, 100] },
+		137: { 'size': 11, 'name': 'gps', 'signed': true, 'divisor': [1000000, 1000000, 100] },
+		138: { 'size': 2, 'name': 'voc', 'signed': false, 'divisor': 1 },
+		142: { 'size': 1, 'name': 'switch', 'signed': false, 'divisor': 1 },
+	};
+
+	function arrayToDecimal(stream, is_signed, divisor) {
+
+		var value = 0;
+		for (var i = 0; i < stream.length; i++) {
+			if (stream[i] > 0xFF)
+				throw 'Byte value overflow!';
+			value = (value << 8) | stream[i];
+		}
+
+		if (is_signed) {
+			var edge = 1 << (stream.length) * 8;  // 0x1000..
+			var max = (edge - 1) >> 1;             // 0x0FFF.. >> 1
+			value = (value > max) ? value - edge : value;
+		}
+
+		value /= divisor;
+
+		return value;
+
+	}
+
+	var sensors = [];
+	var i = 0;
+	while (i < bytes.length) {
+
+		var s_no = bytes[i++];
+		var s_type = bytes[i++];
+		if (typeof sensor_types[s_type] == 'undefined') {
+			throw 'Sensor type error!: ' + s_type;
+		}
+
+		var s_value = 0;
+		var type = sensor_types[s_type];
+		if (i + type.size > bytes.length) {
+			throw 'Payload too short!: ' + s_type;
+		}
+		switch (s_type) {
+
+			case 113:   // Accelerometer
+			case 134:   // Gyrometer
+				s_value = {
+					'x': arrayToDecimal(bytes.slice(i + 0, i + 2), type.signed, type.divisor),
+					'y': arrayToDecimal(bytes.slice(i + 2, i + 4), type.signed, type.divisor),
+					'z': arrayToDecimal(bytes.slice(i + 4, i + 6), type.signed, type.divisor)
+				};
+				break;
+			case 136:   // GPS Location
+				s_value = {
+					'latitude': arrayToDecimal(bytes.slice(i + 0, i + 3), type.signed, type.divisor[0]),
+					'longitude': arrayToDecimal(bytes.slice(i + 3, i + 6), type.signed, type.divisor[1]),
+					'altitude': arrayToDecimal(bytes.slice(i + 6, i + 9), type.signed, type.divisor[2])
+				};
+				break;
+			case 137:   // Precise GPS Location
+				s_value = {
+					'latitude': arrayToDecimal(bytes.slice(i + 0, i + 4), type.signed, type.divisor[0]),
+					'longitude': arrayToDecimal(bytes.slice(i + 4, i + 8), type.signed, type.divisor[1]),
+					'altitude': arrayToDecimal(bytes.slice(i + 8, i + 11), type.signed, type.divisor[2])
+				};
+				break;
+			case 135:   // Colour
+				s_value = {
+					'r': arrayToDecimal(bytes.slice(i + 0, i + 1), type.signed, type.divisor),
+					'g': arrayToDecimal(bytes.slice(i + 1, i + 2), type.signed, type.divisor),
+					'b': arrayToDecimal(bytes.slice(i + 2, i + 3), type.signed, type.divisor)
+				};
+				break;
+
+			default:    // All the rest
+				s_value = arrayToDecimal(bytes.slice(i, i + type.size), type.signed, type.divisor);
+				break;
+		}
+
+		sensors.push({
+			'channel': s_no,
+			'type': s_type,
+			'name': type.name,
+			'value': s_value
+		});
+
+		i += type.size;
+
+	}
+
+	return sensors;
+
+}
+
+// Uplinks on fPort 3 contain samples that were queued while the node could not send.
+// Each sample starts with its age in seconds on channel 40.
+function lppSamples(fields) {
+	var samples = [];
+	var sample = null;
+	fields.forEach(function (field) {
+		if (field['channel'] == 40 || sample == null) {
+			sample = {};
+			samples.push(sample);
+		}
+		sample[field['name'] + '_' + field['channel']] = field['value'];
+	});
+	return samples;
+}
+
+// Uplinks on fPort 4 contain several samples in the batch format of sample_batch.cpp.
+// The values are returned with the same names as in the LPP uplinks.
+function batchDecode(bytes) {
+	var channels = [
+		{ 'key': 'temperature_7', 'size': 2, 'signed': true, 'divisor': 10 },
+		{ 'key': 'humidity_6', 'size': 1, 'signed': false, 'divisor': 2 },
+		{ 'key': 'barometer_8', 'size': 2, 'signed': false, 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'size': 2, 'signed': false, 'divisor': 100 },
+		{ 'key': 'concentration_35', 'size': 2, 'signed': false, 'divisor': 1 },
+		{ 'key': 'temperature_36', 'size': 2, 'signed': true, 'divisor': 10 },
+		{ 'key': 'humidity_37', 'size': 1, 'signed': false, 'divisor': 2 },
+		{ 'key': 'voc_16', 'size': 2, 'signed': false, 'divisor': 1 },
+		{ 'key': 'voltage_1', 'size': 2, 'signed': false, 'divisor': 100 }
+	];
+
+	if (bytes[0] != 2) {
+		throw 'Batch format error!: ' + bytes[0];
+	}
+	var age = (bytes[1] << 16) | (bytes[2] << 8) | bytes[3];
+	var count = bytes[4];
+	var bitmap = (bytes[5] << 8) | bytes[6];
+	var i = 7;
+
+	// Seconds from the previous sample, 7 bits per byte, lowest bits first
+	var samples = [{ 'generic_40': age }];
+	var time = 0;
+	for (var s = 1; s < count; s++) {
+		var offset = 0;
+		var shift = 1;
+		var next;
+		do {
+			next = bytes[i++];
+			offset += (next & 0x7F) * shift;
+			shift *= 128;
+		} while (next & 0x80);
+		time += offset;
+		samples.push({ 'generic_40': age - time });
+	}
+
+	function readValue(channel) {
+		var value = 0;
+		for (var b = 0; b < channel.size; b++) {
+			value = (value << 8) | bytes[i++];
+		}
+		if (channel.signed && (value & (1 << (channel.size * 8 - 1)))) {
+			value -= 1 << (channel.size * 8);
+		}
+		return value;
+	}
+
+	for (var c = 0; c < channels.length; c++) {
+		if (!(bitmap & (1 << c))) {
+			continue;
+		}
+		var value = 0;
+		for (var s = 0; s < count; s++) {
+			if (s == 0) {
+				value = readValue(channels[c]);
+			} else if (bytes[i] == 0x80) {
+				// Escape, full value follows
+				i++;
+				value = readValue(channels[c]);
+			} else {
+				var delta = bytes[i++];
+				value += (delta > 127) ? delta - 256 : delta;
+			}
+			samples[s][channels[c].key] = value / channels[c].divisor;
+		}
+	}
+	return samples;
+}
+
+// Uplinks on fPort 5 contain one sample in the bit-packed format of packed_payload.cpp.
+// The values are returned with the same names as in the LPP uplinks.
+function packedDecode(bytes) {
+	var fields = [
+		{ 'key': 'temperature_7', 'bits': 11, 'min': -400, 'divisor': 10 },
+		{ 'key': 'humidity_6', 'bits': 8, 'min': 0, 'divisor': 2 },
+		{ 'key': 'barometer_8', 'bits': 13, 'min': 3000, 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'bits': 15, 'min': 0, 'divisor': 10 },
+		{ 'key': 'concentration_35', 'bits': 14, 'min': 0, 'divisor': 1 },
+		{ 'key': 'temperature_36', 'bits': 11, 'min': -400, 'divisor': 10 },
+		{ 'key': 'humidity_37', 'bits': 8, 'min': 0, 'divisor': 2 },
+		{ 'key': 'voc_16', 'bits': 9, 'min': 0, 'divisor': 1 },
+		{ 'key': 'voltage_1', 'bits': 8, 'min': 0, 'divisor': 50 }
+	];
+
+	if (bytes[0] != 1) {
+		throw 'Packed schema error!: ' + bytes[0];
+	}
+	var bit = 8;
+
+	function readBits(count) {
+		var value = 0;
+		for (var b = 0; b < count; b++) {
+			value = (value << 1) | ((bytes[bit >> 3] >> (7 - (bit & 7))) & 1);
+			bit++;
+		}
+		return value;
+	}
+
+	var present = readBits(fields.length);
+	var response = {};
+	for (var c = 0; c < fields.length; c++) {
+		if (present & (1 << c)) {
+			response[fields[c].key] = (readBits(fields[c].bits) + fields[c].min) / fields[c].divisor;
+		}
+	}
+	return response;
+}
+
+// Uplinks on fPort 6 are keyframes with all values or deltas to the last keyframe, see delta_payload.cpp.
+// Without state only keyframes have values, deltas are returned with a 'delta_' prefix
+// and have to be added to the keyframe with the same id, see Delta-Reference-Decoder.js.
+function deltaDecode(bytes) {
+	var channels = [
+		{ 'key': 'temperature_7', 'divisor': 10 },
+		{ 'key': 'humidity_6', 'divisor': 2 },
+		{ 'key': 'barometer_8', 'divisor': 10 },
+		{ 'key': 'analog_in_9', 'divisor': 100 },
+		{ 'key': 'concentration_35', 'divisor': 1 },
+		{ 'key': 'temperature_36', 'divisor': 10 },
+		{ 'key': 'humidity_37', 'divisor': 2 },
+		{ 'key': 'voc_16', 'divisor': 1 },
+		{ 'key': 'voltage_1', 'divisor': 100 }
+	];
+	var i = 0;
+
+	function readVarint() {
+		var value = 0;
+		var shift = 0;
+		var data;
+		do {
+			data = bytes[i++];
+			value += (data & 0x7F) * Math.pow(2, shift);
+			shift += 7;
+		} while (data & 0x80);
+		return value;
+	}
+
+	var keyframe = (bytes[0] & 0x80) != 0;
+	var response = { 'keyframe': bytes[i++] & 0x7F, 'counter': keyframe ? 0 : bytes[i++] };
+	var bitmap = readVarint();
+	for (var c = 0; c < channels.length; c++) {
+		if (bitmap & (1 << c)) {
+			var zigzag = readVarint();
+			var value = (zigzag % 2) ? -(zigzag + 1) / 2 : zigzag / 2;
+			response[(keyframe ? '' : 'delta_') + channels[c].key] = value / channels[c].divisor;
+		}
+	}
+	return response;
+}
+
+// To use with Chirpstack
+function Decode(fPort, bytes, variables) {
+	// queued samples, one object per sample
+	if (fPort == 3) {
+		return { data: { 'samples': lppSamples(lppDecode(bytes, 1)) } };
+	}
+	if (fPort == 4) {
+		return { data: { 'samples': batchDecode(bytes) } };
+	}
+	if (fPort == 5) {
+		return { data: packedDecode(bytes) };
+	}
+	if (fPort == 6) {
+		return { data: deltaDecode(bytes) };
+	}
+
+	// flat output (like original decoder):
+	var response = {};
+	lppDecode(bytes, 1).forEach(function (field) {
+		response[field['name'] + '_' + field['channel']] = field['value'];
+	});
+	return { data: response };
+
+	// field output
+	//return {'fields': lppDecode(bytes, fPort)};
+
+}
+
+// To use with Helium
+function Decoder(bytes, port, uplink_info) {
+	// queued samples, one object per sample
+	if (port == 3) {
+		return { data: { 'samples': lppSamples(lppDecode(bytes, 1)) } };
+	}
+	if (port == 4) {
+		return { data: { 'samples': batchDecode(bytes) } };
+	}
+	if (port == 5) {
+		return { data: packedDecode(bytes) };
+	}
+	if (port == 6) {
+		return { data: deltaDecode(bytes) };
+	}
+
+	// flat output (like original decoder):
+	var response = {};
+	lppDecode(bytes, 1).forEach(function (field) {
+		response[field['name'] + '_' + field['channel']] = field['value'];
+	});
+	return { data: response };
+}
+
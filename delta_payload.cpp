@@ -0,0 +1,187 @@
+/**
+ * @file delta_payload.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Keyframe and delta payload, compression across uplinks
+ *        If g_payload_format is PAYLOAD_DELTA the single sample
+ *        uplinks are sent on DELTA_FPORT. A keyframe has all values,
+ *        the uplinks in between only the changes against the last
+ *        keyframe, so a lost delta uplink does not affect the others.
+ *
+ *        Keyframe
+ *          header       1 byte  DELTA_KEYFRAME | keyframe id 0 .. 127
+ *          channels     varint  bitmap of the valid values, see SF_CH_xxx
+ *          values       zig-zag varint per channel in the bitmap, lowest bit first
+ *        Delta
+ *          header       1 byte  keyframe id 0 .. 127
+ *          counter      1 byte  uplinks since the keyframe
+ *          channels     varint  bitmap of the values that changed
+ *          deltas       zig-zag varint per channel in the bitmap, lowest bit first
+ *
+ *        Values have the resolution of the LPP payload. Varints are
+ *        7 bits per byte, lowest group first, bit 7 set if more follow.
+ *        A keyframe is sent every g_delta_keyframe_interval uplinks,
+ *        if the valid values change, after AT+KEYFRAME or after any
+ *        downlink on DELTA_FPORT.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Uplinks from one keyframe to the next */
+uint8_t g_delta_keyframe_interval = DELTA_KEYFRAME_INTERVAL;
+
+/** Encoded payload */
+static uint8_t delta_buffer[DELTA_MAX_SIZE];
+
+/** Values of the last sent keyframe */
+static int32_t delta_key_value[SF_CHANNELS];
+/** Valid values of the last sent keyframe */
+static uint16_t delta_key_channels = 0;
+/** Id of the last sent keyframe */
+static uint8_t delta_key_id = 0;
+/** Uplinks sent since the last keyframe */
+static uint8_t delta_counter = 0;
+/** Flag if a keyframe was sent already */
+static bool delta_has_key = false;
+/** Set by AT command or downlink, the next uplink is a keyframe */
+static volatile bool delta_key_requested = false;
+
+/** Values of the encoded payload, become the keyframe when it was sent */
+static int32_t delta_pending_value[SF_CHANNELS];
+/** Valid values of the encoded payload */
+static uint16_t delta_pending_channels = 0;
+/** Flag if the encoded payload is a keyframe */
+static bool delta_pending_key = false;
+
+/**
+ * @brief Append a zig-zag varint to the payload
+ *
+ * @param size next free byte, updated
+ * @param value signed value
+ */
+static void delta_put(uint8_t &size, int32_t value)
+{
+	uint32_t zigzag = ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+	while (zigzag > 0x7F)
+	{
+		delta_buffer[size++] = (uint8_t)(zigzag & 0x7F) | 0x80;
+		zigzag >>= 7;
+	}
+	delta_buffer[size++] = (uint8_t)zigzag;
+}
+
+/**
+ * @brief Append an unsigned varint to the payload
+ *
+ * @param size next free byte, updated
+ * @param value value
+ */
+static void delta_put_bitmap(uint8_t &size, uint16_t value)
+{
+	while (value > 0x7F)
+	{
+		delta_buffer[size++] = (uint8_t)(value & 0x7F) | 0x80;
+		value >>= 7;
+	}
+	delta_buffer[size++] = (uint8_t)value;
+}
+
+/**
+ * @brief Encode a sample as keyframe or as delta to the last keyframe
+ *        The keyframe state only changes when delta_sent() is called
+ *
+ * @param values sensor values
+ * @param battery battery voltage in V
+ * @return uint8_t payload size in bytes
+ */
+uint8_t delta_encode(const sensor_snapshot_t &values, float battery)
+{
+	sf_record_t record;
+	sf_make_record(record, values, battery);
+	delta_pending_channels = sf_record_channels(record);
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		delta_pending_value[channel] = sf_record_value(record, channel);
+	}
+
+	delta_pending_key = !delta_has_key || delta_key_requested || (delta_counter + 1 >= g_delta_keyframe_interval) || (delta_pending_channels != delta_key_channels);
+
+	uint8_t size = 0;
+	if (delta_pending_key)
+	{
+		delta_buffer[size++] = DELTA_KEYFRAME | ((delta_key_id + 1) & 0x7F);
+		delta_put_bitmap(size, delta_pending_channels);
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (delta_pending_channels & (1 << channel))
+			{
+				delta_put(size, delta_pending_value[channel]);
+			}
+		}
+		return size;
+	}
+
+	uint16_t changed = 0;
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if ((delta_pending_channels & (1 << channel)) && (delta_pending_value[channel] != delta_key_value[channel]))
+		{
+			changed |= 1 << channel;
+		}
+	}
+
+	delta_buffer[size++] = delta_key_id;
+	delta_buffer[size++] = delta_counter + 1;
+	delta_put_bitmap(size, changed);
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if (changed & (1 << channel))
+		{
+			delta_put(size, delta_pending_value[channel] - delta_key_value[channel]);
+		}
+	}
+	return size;
+}
+
+/**
+ * @brief Get the payload encoded by delta_encode()
+ *
+ * @return uint8_t* payload buffer
+ */
+uint8_t *delta_payload(void)
+{
+	return delta_buffer;
+}
+
+/**
+ * @brief The payload encoded by delta_encode() was sent
+ *        A keyframe becomes the reference for the next deltas
+ *
+ */
+void delta_sent(void)
+{
+	if (!delta_pending_key)
+	{
+		delta_counter++;
+		return;
+	}
+	memcpy(delta_key_value, delta_pending_value, sizeof(delta_key_value));
+	delta_key_channels = delta_pending_channels;
+	delta_key_id = (delta_key_id + 1) & 0x7F;
+	delta_counter = 0;
+	delta_has_key = true;
+	delta_key_requested = false;
+}
+
+/**
+ * @brief Send the next uplink as keyframe
+ *        Can be called from the LoRaWAN callbacks
+ *
+ */
+void delta_request_keyframe(void)
+{
+	delta_key_requested = true;
+}
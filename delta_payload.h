@@ -0,0 +1,32 @@
+/**
+ * @file delta_payload.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Keyframe and delta payload, compression across uplinks
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef DELTA_PAYLOAD_H
+#define DELTA_PAYLOAD_H
+
+#include <Arduino.h>
+
+/** fPort of the keyframe and delta uplinks, a downlink on it requests a keyframe */
+#define DELTA_FPORT 6
+/** Flag in the first byte of a keyframe */
+#define DELTA_KEYFRAME 0x80
+/** Default number of uplinks from one keyframe to the next */
+#define DELTA_KEYFRAME_INTERVAL 16
+/** Header, channel bitmap and 9 values of max 3 bytes */
+#define DELTA_MAX_SIZE 32
+
+extern uint8_t g_delta_keyframe_interval;
+
+uint8_t delta_encode(const sensor_snapshot_t &values, float battery);
+uint8_t *delta_payload(void);
+void delta_sent(void);
+void delta_request_keyframe(void);
+
+#endif // DELTA_PAYLOAD_H
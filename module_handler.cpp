@@ -1,186 +1,840 @@
-/**
- * @file module_handler.cpp
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief Find and handle WisBlock sensor modules
- * @version 0.1
- * @date 2022-04-10
- *
- * @copyright Copyright (c) 2022
- *
- */
-
-#include "main.h"
-#include "module_handler.h"
-
-/**
- * @brief List of all supported WisBlock modules
- *
- */
-volatile sensors_t found_sensors[] = {
-	// I2C address , I2C bus, found?
-	{0x18, 0, false}, //  0 RAK1904 accelerometer
-	{0x44, 0, false}, //  1 RAK1903 light sensor
-	{0x42, 0, false}, //  2 RAK12500 GNSS sensor
-	{0x5c, 0, false}, //  3 RAK1902 barometric pressure sensor
-	{0x70, 0, false}, //  4 RAK1901 temperature & humidity sensor
-	{0x76, 0, false}, //  5 ✔ RAK1906 environment sensor
-	{0x20, 0, false}, //  6 RAK12035 soil moisture sensor !! address conflict with RAK13003
-	{0x10, 0, false}, //  7 RAK12010 light sensor
-	{0x51, 0, false}, //  8 RAK12004 MQ2 CO2 gas sensor
-	{0x50, 0, false}, //  9 RAK15000 EEPROM !! conflict with RAK12008
-	{0x50, 0, false}, // 10 RAK12008 MG812 CO2 gas sensor
-	{0x55, 0, false}, // 11 RAK12009 MQ3 Alcohol gas sensor
-	{0x29, 0, false}, // 12 RAK12014 Laser ToF sensor
-	{0x52, 0, false}, // 13 RAK12002 RTC module address
-	{0x04, 0, false}, // 14 RAK14003 LED bargraph module
-	{0x59, 0, false}, // 15 ✔ RAK12047 VOC sensor address !! conflict with RAK13600, RAK13003
-	{0x68, 0, false}, // 16 RAK12025 Gyroscope address !! conflict with RAK1905
-	{0x73, 0, false}, // 17 RAK14008 Gesture sensor
-	{0x3C, 0, false}, // 18 RAK1921 OLED display
-	{0x53, 0, false}, // 19 RAK12019 LTR390 light sensor
-	{0x28, 0, false}, // 20 RAK14002 Touch Button module
-	{0x41, 0, false}, // 21 RAK16000 DC current sensor
-	{0x68, 0, false}, // 22 RAK1905 MPU9250 9DOF sensor !! address conflict with RAK12025
-	{0x61, 0, false}, // 23 ✔ RAK12037 CO2 sensor !! address conflict with RAK16001
-	{0x3A, 0, false}, // 24 RAK12003 IR temperature sensor
-	{0x68, 0, false}, // 25 RAK12040 AMG8833 temperature array sensor
-	{0x57, 0, false}, // 26 RAK12012 MAX30102 heart rate sensor
-	{0x54, 0, false}, // 27 RAK12016 Flex sensor
-	{0x47, 0, false}, // 28 RAK13004 PWM expander module
-	{0x38, 0, false}, // 29 RAK14001 RGB LED module
-	{0x5F, 0, false}, // 30 RAK14004 Keypad interface
-	{0x61, 0, false}, // 31 RAK16001 ADC sensor !! address conflict with RAK12037
-	{0x59, 0, false}, // 32 RAK13600 NFC !! address conflict with RAK12047, RAK13600
-	{0x59, 0, false}, // 33 RAK16002 Coulomb sensor !! address conflict with RAK13600, RAK12047
-	{0x20, 0, false}, // 34 RAK13003 IO expander module !! address conflict with RAK12035
-};
-
-/**
- * @brief Scan both I2C bus for devices
- *
- */
-void find_modules(void)
-{
-	// Scan the I2C interfaces for devices
-	byte error;
-	uint8_t num_dev = 0;
-
-	Wire.begin();
-	Wire.setClock(400000);
-	for (byte address = 1; address < 127; address++)
-	{
-		Wire.beginTransmission(address);
-		error = Wire.endTransmission();
-		if (error == 0)
-		{
-			// MYLOG("SCAN", "Found sensor on I2C1 0x%02X\n", address);
-			for (uint8_t i = 0; i < sizeof(found_sensors) / sizeof(sensors_t); i++)
-			{
-				if (address == found_sensors[i].i2c_addr)
-				{
-					found_sensors[i].i2c_num = 1;
-					found_sensors[i].found_sensor = true;
-					break;
-				}
-			}
-			num_dev++;
-		}
-	}
-
-	if (found_sensors[ENV_ID].found_sensor)
-	{
-		if (init_rak1906())
-		{
-			sprintf(g_dev_name, "RUI3 Env Sensor");
-		}
-		else
-		{
-			found_sensors[ENV_ID].found_sensor = false;
-		}
-	}
-
-	// if (found_sensors[CO2_ID].found_sensor)
-	// {
-	// 	if (init_rak12037())
-	// 	{
-	// 		sprintf(g_dev_name, "RUI3 CO2 Sensor");
-	// 	}
-	// 	else
-	// 	{
-	// 		found_sensors[CO2_ID].found_sensor = false;
-	// 	}
-	// }
-
-	if (found_sensors[VOC_ID].found_sensor)
-	{
-		// MYLOG("MOD", "init_rak12047");
-		if (init_rak12047())
-		{
-			sprintf(g_dev_name, "RUI3 VOC Sensor");
-		}
-		else
-		{
-			found_sensors[VOC_ID].found_sensor = false;
-		}
-	}
-
-}
-
-/**
- * @brief AT command feedback about found modules
- *
- */
-void announce_modules(void)
-{
-	if (found_sensors[ENV_ID].found_sensor)
-	{
-		Serial.println("+EVT:RAK1906");
-		// // Start reading sensor data
-		// start_rak1906();
-		// delay(100);
-		// // Reading sensor data
-		// read_rak1906();
-	}
-
-	if (found_sensors[CO2_ID].found_sensor)
-	{
-		Serial.println("+EVT:RAK12037");
-		// // Reading sensor data
-		// read_rak12037();
-	}
-
-	if (found_sensors[VOC_ID].found_sensor)
-	{
-		Serial.println("+EVT:RAK12047");
-		// Sensor needs 100 readings before valid data is available.
-		// Makes no sense to read it already.
-	}
-}
-
-/**
- * @brief Read values from the found modules
- *
- */
-void get_sensor_values(void)
-{
-	if (found_sensors[ENV_ID].found_sensor)
-	{
-		// // Start reading sensor data
-		// start_rak1906();
-		// delay(100);
-		// Reading sensor data
-		read_rak1906();
-	}
-
-	// if (found_sensors[CO2_ID].found_sensor)
-	// {
-	// 	// Read sensor data
-	// 	read_rak12037();
-	// }
-
-	if (found_sensors[VOC_ID].found_sensor)
-	{
-		// Read sensor data
-		read_rak12047();
-	}
-}
\ No newline at end of file
+/**
+ * @file module_handler.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Find and handle WisBlock sensor modules
+ * @version 0.1
+ * @date 2022-04-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+
+#include "main.h"
+#include "module_handler.h"
+
+// Identification probes for modules that share an I2C address
+static bool identify_sgp40(uint8_t address);
+static bool identify_scd30(uint8_t address);
+static bool identify_i3g4250d(uint8_t address);
+static bool identify_mpu9250(uint8_t address);
+
+/** Identification probe, returns true if the device on the address is this module */
+typedef bool (*module_identify_t)(uint8_t address);
+
+/**
+ * @brief List of all supported WisBlock modules
+ *        X(I2C address, identification probe or NULL)
+ *        The index in the list is the module ID (ENV_ID, VOC_ID, ...)
+ *
+ */
+#define MODULE_LIST(X) \
+	X(0x18, NULL) /*  0 RAK1904 accelerometer */ \
+	X(0x44, NULL) /*  1 RAK1903 light sensor */ \
+	X(0x42, NULL) /*  2 RAK12500 GNSS sensor */ \
+	X(0x5C, NULL) /*  3 RAK1902 barometric pressure sensor */ \
+	X(0x70, NULL) /*  4 RAK1901 temperature & humidity sensor */ \
+	X(0x76, NULL) /*  5 ✔ RAK1906 environment sensor */ \
+	X(0x20, NULL) /*  6 RAK12035 soil moisture sensor !! address conflict with RAK13003 */ \
+	X(0x10, NULL) /*  7 RAK12010 light sensor */ \
+	X(0x51, NULL) /*  8 RAK12004 MQ2 CO2 gas sensor */ \
+	X(0x50, NULL) /*  9 RAK15000 EEPROM !! conflict with RAK12008 */ \
+	X(0x50, NULL) /* 10 RAK12008 MG812 CO2 gas sensor */ \
+	X(0x55, NULL) /* 11 RAK12009 MQ3 Alcohol gas sensor */ \
+	X(0x29, NULL) /* 12 RAK12014 Laser ToF sensor */ \
+	X(0x52, NULL) /* 13 RAK12002 RTC module address */ \
+	X(0x04, NULL) /* 14 RAK14003 LED bargraph module */ \
+	X(0x59, identify_sgp40) /* 15 ✔ RAK12047 VOC sensor address !! conflict with RAK13600, RAK13003 */ \
+	X(0x68, identify_i3g4250d) /* 16 RAK12025 Gyroscope address !! conflict with RAK1905 */ \
+	X(0x73, NULL) /* 17 RAK14008 Gesture sensor */ \
+	X(0x3C, NULL) /* 18 RAK1921 OLED display */ \
+	X(0x53, NULL) /* 19 RAK12019 LTR390 light sensor */ \
+	X(0x28, NULL) /* 20 RAK14002 Touch Button module */ \
+	X(0x41, NULL) /* 21 RAK16000 DC current sensor */ \
+	X(0x68, identify_mpu9250) /* 22 RAK1905 MPU9250 9DOF sensor !! address conflict with RAK12025 */ \
+	X(0x61, identify_scd30) /* 23 ✔ RAK12037 CO2 sensor !! address conflict with RAK16001 */ \
+	X(0x3A, NULL) /* 24 RAK12003 IR temperature sensor */ \
+	X(0x68, NULL) /* 25 RAK12040 AMG8833 temperature array sensor */ \
+	X(0x57, NULL) /* 26 RAK12012 MAX30102 heart rate sensor */ \
+	X(0x54, NULL) /* 27 RAK12016 Flex sensor */ \
+	X(0x47, NULL) /* 28 RAK13004 PWM expander module */ \
+	X(0x38, NULL) /* 29 RAK14001 RGB LED module */ \
+	X(0x5F, NULL) /* 30 RAK14004 Keypad interface */ \
+	X(0x61, NULL) /* 31 RAK16001 ADC sensor !! address conflict with RAK12037 */ \
+	X(0x59, NULL) /* 32 RAK13600 NFC !! address conflict with RAK12047, RAK13600 */ \
+	X(0x59, NULL) /* 33 RAK16002 Coulomb sensor !! address conflict with RAK13600, RAK12047 */ \
+	X(0x20, NULL) /* 34 RAK13003 IO expander module !! address conflict with RAK12035 */
+
+#define MODULE_SENSOR(addr, identify) {addr, 0, false},
+#define MODULE_ADDR(addr, identify) addr,
+#define MODULE_IDENTIFY(addr, identify) identify,
+
+volatile sensors_t found_sensors[] = {
+	// I2C address , I2C bus, found?
+	MODULE_LIST(MODULE_SENSOR)};
+
+/** I2C addresses of the modules, usable at compile time */
+static constexpr uint8_t module_addr[] = {MODULE_LIST(MODULE_ADDR)};
+
+/** Identification probes of the modules */
+static const module_identify_t module_identify[] = {MODULE_LIST(MODULE_IDENTIFY)};
+
+/** Number of entries in found_sensors[] */
+#define NUM_MODULES (sizeof(module_addr) / sizeof(module_addr[0]))
+
+static_assert(NUM_MODULES <= 64, "Module inventory does not fit into 64 bits");
+static_assert(sizeof(found_sensors) / sizeof(sensors_t) == NUM_MODULES, "Module list mismatch");
+
+/**
+ * @brief Bitmap of the modules that use an I2C address
+ *
+ * @param address I2C address
+ * @param idx module index to start with
+ * @return uint64_t bit n = module n uses this address
+ */
+static constexpr uint64_t candidates_for(uint8_t address, uint8_t idx = 0)
+{
+	return (idx >= NUM_MODULES) ? 0 : (((module_addr[idx] == address) ? ((uint64_t)1 << idx) : 0) | candidates_for(address, idx + 1));
+}
+
+#define CANDIDATES_4(a) candidates_for(a), candidates_for(a + 1), candidates_for(a + 2), candidates_for(a + 3)
+#define CANDIDATES_16(a) CANDIDATES_4(a), CANDIDATES_4(a + 4), CANDIDATES_4(a + 8), CANDIDATES_4(a + 12)
+
+/** Modules per I2C address, built at compile time from MODULE_LIST */
+static constexpr uint64_t addr_candidates[128] = {
+	CANDIDATES_16(0x00), CANDIDATES_16(0x10), CANDIDATES_16(0x20), CANDIDATES_16(0x30),
+	CANDIDATES_16(0x40), CANDIDATES_16(0x50), CANDIDATES_16(0x60), CANDIDATES_16(0x70)};
+
+// Known address conflicts
+static_assert(addr_candidates[0x59] == (((uint64_t)1 << VOC_ID) | ((uint64_t)1 << 32) | ((uint64_t)1 << 33)), "0x59 candidates");
+static_assert(addr_candidates[0x61] == (((uint64_t)1 << CO2_ID) | ((uint64_t)1 << 31)), "0x61 candidates");
+static_assert(addr_candidates[0x68] == (((uint64_t)1 << 16) | ((uint64_t)1 << 22) | ((uint64_t)1 << 25)), "0x68 candidates");
+static_assert(addr_candidates[0x76] == ((uint64_t)1 << ENV_ID), "0x76 candidates");
+static_assert(addr_candidates[0x00] == 0, "0x00 candidates");
+
+/**
+ * @brief Drivers of the supported sensors
+ *        To add a sensor, add its functions here
+ *
+ */
+const sensor_driver_t sensor_drivers[] = {
+	// module, name, device name, init, start, collect, encode, announce, conversion time, LPP channels
+	{ENV_ID, "RAK1906", "RUI3 Env Sensor", init_rak1906, start_rak1906, collect_rak1906, encode_rak1906, NULL, 200,
+	 {LPP_CHANNEL_HUMID_2, LPP_CHANNEL_TEMP_2, LPP_CHANNEL_PRESS_2, LPP_CHANNEL_GAS_2}},
+	// Values are collected in the background by poll_rak12037()
+	{CO2_ID, "RAK12037", "RUI3 CO2 Sensor", init_rak12037, NULL, NULL, encode_rak12037, NULL, 0,
+	 {LPP_CHANNEL_CO2_2, LPP_CHANNEL_CO2_Temp_2, LPP_CHANNEL_CO2_HUMID_2, 0}},
+	// Values are collected by the VOC timer, the algorithm needs 100 readings before the index is valid
+	{VOC_ID, "RAK12047", "RUI3 VOC Sensor", init_rak12047, NULL, NULL, encode_rak12047, NULL, 0,
+	 {LPP_CHANNEL_VOC, 0, 0, 0}},
+};
+
+/** Number of sensor drivers */
+const uint8_t num_sensor_drivers = sizeof(sensor_drivers) / sizeof(sensor_driver_t);
+
+/** Timing statistics per sensor driver */
+driver_stats_t driver_stats[sizeof(sensor_drivers) / sizeof(sensor_driver_t)];
+
+static_assert(sizeof(sensor_drivers) / sizeof(sensor_driver_t) <= 32, "Too many drivers for the pending bitmap");
+
+/** Published [0] or [1] and work copy of the sensor values */
+static sensor_snapshot_t snapshots[2];
+/** Index of the published snapshot */
+static volatile uint8_t snapshot_front = 0;
+
+/**
+ * @brief Get the work copy of the sensor values
+ *        The work copy starts with the published values,
+ *        changes are visible after snapshot_publish()
+ *
+ * @return sensor_snapshot_t* work copy
+ */
+sensor_snapshot_t *snapshot_edit(void)
+{
+	uint8_t back = snapshot_front ^ 1;
+	snapshots[back] = snapshots[snapshot_front];
+	return &snapshots[back];
+}
+
+/**
+ * @brief Make the work copy the published snapshot
+ *
+ */
+void snapshot_publish(void)
+{
+	uint8_t back = snapshot_front ^ 1;
+	snapshots[back].sequence++;
+	// Values must be complete before the index changes
+	__sync_synchronize();
+	snapshot_front = back;
+}
+
+/**
+ * @brief Get the last published sensor values
+ *
+ * @return const sensor_snapshot_t* published snapshot
+ */
+const sensor_snapshot_t *snapshot_get(void)
+{
+	return &snapshots[snapshot_front];
+}
+
+/** Drivers with a conversion that is not collected yet, bit n = sensor_drivers[n] */
+static uint32_t pending_drivers = 0;
+/** Drivers with valid values for the payload */
+static uint32_t collected_drivers = 0;
+/** Number of collect_sensors() calls that found unfinished conversions */
+static uint8_t collect_retries = 0;
+
+/** Timing of the last acquisition cycle */
+acquisition_stats_t acquisition_stats;
+
+/** Lead time and TX timing statistics */
+uplink_stats_t uplink_stats;
+
+/** Minimum time in ms between the start of the acquisition and the TX slot */
+uint32_t g_acq_lead_min = ACQ_LEAD_MIN;
+
+/** Marker and layout version of the module inventory stored in flash */
+#define INVENTORY_MARKER 0xD1
+/** Size of the inventory in flash, marker + bitmap + CRC */
+#define INVENTORY_SIZE 11
+
+/** Flag if the modules were found with the inventory from flash */
+bool g_inventory_cached = false;
+/** Time in ms needed to find and initialize the modules */
+uint32_t g_module_scan_time = 0;
+/** Time in ms from boot to the first uplink, 0 if no uplink yet */
+uint32_t g_first_uplink_time = 0;
+
+/**
+ * @brief Check if a device answers on an I2C address
+ *
+ * @param address I2C address
+ * @return true if the device sent an ACK
+ */
+static bool probe_address(uint8_t address)
+{
+	Wire.beginTransmission(address);
+	return (Wire.endTransmission() == 0);
+}
+
+/**
+ * @brief Read one register of an I2C device
+ *
+ * @param address I2C address
+ * @param reg register address
+ * @param value register value
+ * @return true if the read was successful
+ */
+static bool read_register(uint8_t address, uint8_t reg, uint8_t &value)
+{
+	Wire.beginTransmission(address);
+	Wire.write(reg);
+	if (Wire.endTransmission(false) != 0)
+	{
+		return false;
+	}
+	if (Wire.requestFrom(address, (uint8_t)1) != 1)
+	{
+		return false;
+	}
+	value = Wire.read();
+	return true;
+}
+
+/**
+ * @brief Calculate the CRC8 of a Sensirion data word
+ *
+ * @param data 2 bytes of data
+ * @return uint8_t CRC (polynomial 0x31, init 0xFF)
+ */
+static uint8_t sensirion_crc8(const uint8_t *data)
+{
+	uint8_t crc = 0xFF;
+	for (uint8_t idx = 0; idx < 2; idx++)
+	{
+		crc ^= data[idx];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? ((crc << 1) ^ 0x31) : (crc << 1);
+		}
+	}
+	return crc;
+}
+
+/**
+ * @brief Send a Sensirion 16 bit command and check the CRC of the response words
+ *
+ * @param address I2C address
+ * @param command command code
+ * @param wait_ms time between command and read
+ * @param words number of response words
+ * @return true if all words were received with a valid CRC
+ */
+static bool read_sensirion_words(uint8_t address, uint16_t command, uint8_t wait_ms, uint8_t words)
+{
+	Wire.beginTransmission(address);
+	Wire.write((uint8_t)(command >> 8));
+	Wire.write((uint8_t)(command));
+	if (Wire.endTransmission() != 0)
+	{
+		return false;
+	}
+	delay(wait_ms);
+	if (Wire.requestFrom(address, (uint8_t)(words * 3)) != words * 3)
+	{
+		return false;
+	}
+	bool crc_ok = true;
+	for (uint8_t idx = 0; idx < words; idx++)
+	{
+		uint8_t word[3];
+		word[0] = Wire.read();
+		word[1] = Wire.read();
+		word[2] = Wire.read();
+		if (sensirion_crc8(word) != word[2])
+		{
+			crc_ok = false;
+		}
+	}
+	return crc_ok;
+}
+
+/**
+ * @brief RAK12047, SGP40 answers the get serial number command
+ */
+static bool identify_sgp40(uint8_t address)
+{
+	return read_sensirion_words(address, 0x3682, 1, 3);
+}
+
+/**
+ * @brief RAK12037, SCD30 answers the read firmware version command
+ */
+static bool identify_scd30(uint8_t address)
+{
+	return read_sensirion_words(address, 0xD100, 3, 1);
+}
+
+/**
+ * @brief RAK12025, I3G4250D WHO_AM_I register is 0xD3
+ */
+static bool identify_i3g4250d(uint8_t address)
+{
+	uint8_t who_am_i;
+	return read_register(address, 0x0F, who_am_i) && (who_am_i == 0xD3);
+}
+
+/**
+ * @brief RAK1905, MPU9250 WHO_AM_I register is 0x71 (0x73 for MPU9255)
+ */
+static bool identify_mpu9250(uint8_t address)
+{
+	uint8_t who_am_i;
+	return read_register(address, 0x75, who_am_i) && ((who_am_i == 0x71) || (who_am_i == 0x73));
+}
+
+/**
+ * @brief Find out which module answers on an I2C address
+ *        Modules with an identification probe are checked first,
+ *        if none matches the first module without probe is used
+ *
+ * @param address I2C address, the device must have sent an ACK
+ * @return uint64_t bitmap with the bit of the identified module, 0 if unknown
+ */
+static uint64_t identify_address(uint8_t address)
+{
+	uint64_t candidates = addr_candidates[address];
+	uint64_t fallback = 0;
+	for (uint8_t i = 0; i < NUM_MODULES; i++)
+	{
+		uint64_t module_bit = (uint64_t)1 << i;
+		if ((candidates & module_bit) == 0)
+		{
+			continue;
+		}
+		if (module_identify[i] == NULL)
+		{
+			if (fallback == 0)
+			{
+				fallback = module_bit;
+			}
+		}
+		else if (module_identify[i](address))
+		{
+			return module_bit;
+		}
+	}
+	return fallback;
+}
+
+/**
+ * @brief Probe each known I2C address once and identify the module
+ *
+ * @return uint64_t bitmap of the found modules, bit n = found_sensors[n]
+ */
+static uint64_t probe_modules(void)
+{
+	uint64_t inventory = 0;
+	for (uint8_t address = 0; address < 128; address++)
+	{
+		if ((addr_candidates[address] != 0) && probe_address(address))
+		{
+			// MYLOG("SCAN", "Found sensor on I2C1 0x%02X\n", address);
+			uint64_t module_bit = identify_address(address);
+			if (module_bit == 0)
+			{
+				MYLOG("SCAN", "Unknown device on 0x%02X", address);
+			}
+			inventory |= module_bit;
+		}
+	}
+	return inventory;
+}
+
+/**
+ * @brief Check the known I2C addresses that are not used by the
+ *        inventory for new modules, only an ACK is needed for that
+ *        Identification probes run only on addresses that answer
+ *
+ * @param inventory bitmap of the expected modules
+ * @return uint64_t bitmap of the new modules
+ */
+static uint64_t probe_new_modules(uint64_t inventory)
+{
+	uint64_t new_modules = 0;
+	for (uint8_t address = 0; address < 128; address++)
+	{
+		if ((addr_candidates[address] == 0) || ((addr_candidates[address] & inventory) != 0))
+		{
+			continue;
+		}
+		if (probe_address(address))
+		{
+			uint64_t module_bit = identify_address(address);
+			if (module_bit != 0)
+			{
+				MYLOG("SCAN", "New module on 0x%02X", address);
+			}
+			new_modules |= module_bit;
+		}
+	}
+	return new_modules;
+}
+
+/**
+ * @brief Check that all modules of the inventory answer
+ *        and are still the same module
+ *
+ * @param inventory bitmap of the expected modules
+ * @return true if all modules were found
+ */
+static bool verify_inventory(uint64_t inventory)
+{
+	for (uint8_t i = 0; i < NUM_MODULES; i++)
+	{
+		uint64_t module_bit = (uint64_t)1 << i;
+		if ((inventory & module_bit) == 0)
+		{
+			continue;
+		}
+		if (!probe_address(module_addr[i]) || (identify_address(module_addr[i]) != module_bit))
+		{
+			MYLOG("SCAN", "Module %d missing", i);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * @brief Read the module inventory of the last boot from flash
+ *
+ * @param inventory bitmap of the found modules
+ * @return true if a valid inventory was found
+ */
+static bool load_inventory(uint64_t &inventory)
+{
+	uint8_t flash_value[INVENTORY_SIZE];
+	if (!api.system.flash.get(INVENTORY_OFFSET, flash_value, INVENTORY_SIZE))
+	{
+		return false;
+	}
+	if (flash_value[0] != INVENTORY_MARKER)
+	{
+		return false;
+	}
+	uint16_t crc = flash_value[INVENTORY_SIZE - 2] | (flash_value[INVENTORY_SIZE - 1] << 8);
+	if (crc != flash_crc16(flash_value, INVENTORY_SIZE - 2))
+	{
+		return false;
+	}
+	inventory = 0;
+	for (uint8_t idx = 0; idx < 8; idx++)
+	{
+		inventory |= (uint64_t)flash_value[1 + idx] << (8 * idx);
+	}
+	return true;
+}
+
+/**
+ * @brief Save the module inventory to flash
+ *
+ * @param inventory bitmap of the found modules
+ * @return true if write to flash was successful
+ */
+static bool save_inventory(uint64_t inventory)
+{
+	uint8_t flash_value[INVENTORY_SIZE];
+	flash_value[0] = INVENTORY_MARKER;
+	for (uint8_t idx = 0; idx < 8; idx++)
+	{
+		flash_value[1 + idx] = (uint8_t)(inventory >> (8 * idx));
+	}
+	uint16_t crc = flash_crc16(flash_value, INVENTORY_SIZE - 2);
+	flash_value[INVENTORY_SIZE - 2] = (uint8_t)(crc);
+	flash_value[INVENTORY_SIZE - 1] = (uint8_t)(crc >> 8);
+	return api.system.flash.set(INVENTORY_OFFSET, flash_value, INVENTORY_SIZE);
+}
+
+/**
+ * @brief Delete the module inventory in flash
+ *        The next boot probes all known addresses again
+ *
+ * @return true if write to flash was successful
+ */
+bool clear_inventory(void)
+{
+	uint8_t flash_value[INVENTORY_SIZE] = {0};
+	return api.system.flash.set(INVENTORY_OFFSET, flash_value, INVENTORY_SIZE);
+}
+
+/**
+ * @brief Get the bitmap of the found modules
+ *
+ * @return uint64_t bit n = found_sensors[n] was found
+ */
+uint64_t get_inventory(void)
+{
+	uint64_t inventory = 0;
+	for (uint8_t i = 0; i < NUM_MODULES; i++)
+	{
+		if (found_sensors[i].found_sensor)
+		{
+			inventory |= (uint64_t)1 << i;
+		}
+	}
+	return inventory;
+}
+
+/**
+ * @brief Find the WisBlock modules
+ *        Uses the inventory of the last boot if all its modules
+ *        answer and checks the other addresses with an ACK for new
+ *        modules. Without a stored inventory, with an empty one or
+ *        if a module is missing all known addresses are probed.
+ *        The probed modules are saved, a module that failed to
+ *        initialize is tried again on the next boot.
+ *
+ */
+void find_modules(void)
+{
+	uint32_t scan_start = millis();
+	uint64_t stored_inventory = 0;
+	uint64_t inventory = 0;
+
+	Wire.begin();
+	Wire.setClock(400000);
+
+	bool stored = load_inventory(stored_inventory);
+	g_inventory_cached = stored && (stored_inventory != 0) && verify_inventory(stored_inventory);
+	if (g_inventory_cached)
+	{
+		inventory = stored_inventory | probe_new_modules(stored_inventory);
+	}
+	else
+	{
+		inventory = probe_modules();
+	}
+	if (!stored || (inventory != stored_inventory))
+	{
+		MYLOG("SCAN", "Save inventory %s", save_inventory(inventory) ? "OK" : "NOK");
+	}
+
+	for (uint8_t i = 0; i < NUM_MODULES; i++)
+	{
+		if (inventory & ((uint64_t)1 << i))
+		{
+			found_sensors[i].i2c_num = 1;
+			found_sensors[i].found_sensor = true;
+		}
+	}
+
+	// Initialize the found modules
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		const sensor_driver_t &driver = sensor_drivers[drv];
+		if (!found_sensors[driver.module_id].found_sensor)
+		{
+			continue;
+		}
+		uint32_t init_start = millis();
+		bool init_ok = (driver.init == NULL) || driver.init();
+		driver_stats[drv].init_time = millis() - init_start;
+		if (init_ok)
+		{
+			sprintf(g_dev_name, "%s", driver.dev_name);
+		}
+		else
+		{
+			MYLOG("MOD", "%s init failed", driver.name);
+			driver_stats[drv].failures++;
+			found_sensors[driver.module_id].found_sensor = false;
+		}
+	}
+
+	g_module_scan_time = millis() - scan_start;
+	MYLOG("SCAN", "%s inventory, modules found in %ld ms", g_inventory_cached ? "Cached" : "Probed", g_module_scan_time);
+}
+
+/**
+ * @brief AT command feedback about found modules
+ *
+ */
+void announce_modules(void)
+{
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		const sensor_driver_t &driver = sensor_drivers[drv];
+		if (!found_sensors[driver.module_id].found_sensor)
+		{
+			continue;
+		}
+		Serial.printf("+EVT:%s\r\n", driver.name);
+		if (driver.announce != NULL)
+		{
+			driver.announce();
+		}
+	}
+}
+
+/**
+ * @brief Start the conversions of all found modules
+ *        All conversions run in parallel, the MCU can sleep
+ *        until the longest one is finished
+ *
+ * @return uint32_t time in ms until all conversions are finished
+ *         0 if no module needs a conversion time
+ */
+uint32_t start_sensors(void)
+{
+	uint32_t conversion_time = 0;
+	uint32_t phase_start = micros();
+
+	acquisition_stats.cycle_start = millis();
+	acquisition_stats.awake_time = 0;
+	pending_drivers = 0;
+	collected_drivers = 0;
+	collect_retries = 0;
+
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		const sensor_driver_t &driver = sensor_drivers[drv];
+		if (!found_sensors[driver.module_id].found_sensor)
+		{
+			continue;
+		}
+		if (driver.collect == NULL)
+		{
+			// Values are cached, nothing to wait for
+			collected_drivers |= (uint32_t)1 << drv;
+			continue;
+		}
+		pending_drivers |= (uint32_t)1 << drv;
+		if (driver.start == NULL)
+		{
+			continue;
+		}
+		uint32_t driver_time = driver.start();
+		// Do not trust a start time longer than the driver can need
+		if (driver_time > driver.conversion_time)
+		{
+			driver_time = driver.conversion_time;
+		}
+		if (driver_time > conversion_time)
+		{
+			conversion_time = driver_time;
+		}
+	}
+
+	acquisition_stats.awake_time += micros() - phase_start;
+	return conversion_time;
+}
+
+/**
+ * @brief Collect the results of the conversions started with start_sensors()
+ *        Drivers that are not finished yet stay pending for the next call
+ *
+ * @return true if all results are collected or the retries are used up
+ * @return false if some conversions are not finished, call again after CONVERSION_RETRY_TIME
+ */
+bool collect_sensors(void)
+{
+	uint32_t phase_start = micros();
+
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		uint32_t driver_bit = (uint32_t)1 << drv;
+		if ((pending_drivers & driver_bit) == 0)
+		{
+			continue;
+		}
+		uint32_t read_start = micros();
+		bool collected = sensor_drivers[drv].collect();
+		driver_stats[drv].read_time = micros() - read_start;
+		if (collected)
+		{
+			pending_drivers &= ~driver_bit;
+			collected_drivers |= driver_bit;
+		}
+		else if (collect_retries >= CONVERSION_RETRIES)
+		{
+			// Give up, the values of this driver are missing in this uplink
+			pending_drivers &= ~driver_bit;
+			driver_stats[drv].failures++;
+		}
+	}
+
+	acquisition_stats.awake_time += micros() - phase_start;
+	if (pending_drivers != 0)
+	{
+		collect_retries++;
+		acquisition_stats.retries++;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @brief Add the values of the collected modules to the payload
+ *        Conversions must have been collected with collect_sensors()
+ *
+ */
+void get_sensor_values(void)
+{
+	uint32_t phase_start = micros();
+
+	// Build the whole payload from one set of values
+	sensor_snapshot_t values = *snapshot_get();
+
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		const sensor_driver_t &driver = sensor_drivers[drv];
+		if ((collected_drivers & ((uint32_t)1 << drv)) == 0)
+		{
+			continue;
+		}
+		if (driver.encode != NULL)
+		{
+			uint32_t encode_start = micros();
+			driver.encode(values);
+			driver_stats[drv].read_time += micros() - encode_start;
+		}
+		if (driver_stats[drv].read_time > driver_stats[drv].max_read_time)
+		{
+			driver_stats[drv].max_read_time = driver_stats[drv].read_time;
+		}
+		driver_stats[drv].reads++;
+	}
+
+	acquisition_stats.awake_time += micros() - phase_start;
+	acquisition_stats.wall_time = millis() - acquisition_stats.cycle_start;
+	if (acquisition_stats.awake_time > acquisition_stats.max_awake_time)
+	{
+		acquisition_stats.max_awake_time = acquisition_stats.awake_time;
+	}
+	MYLOG("MOD", "Acquisition %ld ms, awake %ld us", acquisition_stats.wall_time, acquisition_stats.awake_time);
+
+	// Running averages of the acquisition time and its deviation, gains 1/8 and 1/4
+	int32_t latency = (int32_t)acquisition_stats.wall_time;
+	if (uplink_stats.uplinks == 0)
+	{
+		uplink_stats.latency_avg = latency;
+		uplink_stats.latency_dev = latency / 2;
+	}
+	else
+	{
+		int32_t error = latency - uplink_stats.latency_avg;
+		uplink_stats.latency_avg += error / 8;
+		uplink_stats.latency_dev += ((error < 0 ? -error : error) - uplink_stats.latency_dev) / 4;
+	}
+}
+
+/**
+ * @brief Add the values of all found modules to the payload
+ *        Used for samples that were taken earlier
+ *
+ * @param values sensor values
+ */
+void encode_sensor_values(const sensor_snapshot_t &values)
+{
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		const sensor_driver_t &driver = sensor_drivers[drv];
+		if (found_sensors[driver.module_id].found_sensor && (driver.encode != NULL))
+		{
+			driver.encode(values);
+		}
+	}
+}
+
+/**
+ * @brief Get the time in ms the acquisition has to start before the TX slot
+ *        Based on the measured acquisition times, at least g_acq_lead_min
+ *
+ * @return uint32_t lead time in ms
+ */
+uint32_t acquisition_lead(void)
+{
+	uint32_t lead = g_acq_lead_min;
+	if (uplink_stats.uplinks != 0)
+	{
+		// Same idea as the TCP retransmit timeout, average plus 4 deviations
+		int32_t expected = uplink_stats.latency_avg + 4 * uplink_stats.latency_dev + ACQ_LEAD_MARGIN;
+		if ((expected > 0) && ((uint32_t)expected > lead))
+		{
+			lead = (uint32_t)expected;
+		}
+	}
+	if (lead > ACQ_LEAD_MAX)
+	{
+		lead = ACQ_LEAD_MAX;
+	}
+	if (lead > g_lorawan_settings.send_repeat_time / 2)
+	{
+		lead = g_lorawan_settings.send_repeat_time / 2;
+	}
+	uplink_stats.lead = lead;
+	return lead;
+}
+
+/**
+ * @brief Record the delay between the TX slot and the send
+ *
+ * @param jitter time in ms between the TX slot and api.lorawan.send()
+ * @param late true if the payload was not ready at the TX slot
+ */
+void record_tx_jitter(uint32_t jitter, bool late)
+{
+	uplink_stats.last_jitter = jitter;
+	if (jitter > uplink_stats.max_jitter)
+	{
+		uplink_stats.max_jitter = jitter;
+	}
+	uplink_stats.jitter_sum += jitter;
+	uplink_stats.uplinks++;
+	if (late)
+	{
+		uplink_stats.late++;
+	}
+}
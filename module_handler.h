@@ -1,126 +1,326 @@
-/**
- * @file module_handler.h
- * @author Bernd Giesecke (bernd@giesecke.tk)
- * @brief Globals and defines for module handling
- * @version 0.1
- * @date 2022-04-10
- *
- * @copyright Copyright (c) 2022
- *
- */
-#ifndef MODULE_HANDLER_H
-#define MODULE_HANDLER_H
-
-// Module handler stuff
-void find_modules(void);
-void announce_modules(void);
-void get_sensor_values(void);
-
-// Forward declarations
-void sensor_handler(void *);
-
-typedef struct sensors_s
-{
-	uint8_t i2c_addr;  // I2C address
-	uint8_t i2c_num;   // I2C port
-	bool found_sensor; // Flag if sensor is present
-} sensors_t;
-
-extern volatile sensors_t found_sensors[];
-
-// Index for known I2C devices
-// #define ACC_ID 0	   // RAK1904 accelerometer
-// #define LIGHT_ID 1	   // RAK1903 light sensor
-// #define GNSS_ID 2	   // RAK12500 GNSS sensor
-// #define PRESS_ID 3	   // RAK1902 barometric pressure sensor
-// #define TEMP_ID 4	   // RAK1901 temperature & humidity sensor
-#define ENV_ID 5	   // RAK1906 environment sensor
-// #define SOIL_ID 6	   // RAK12035 soil moisture sensor
-// #define LIGHT2_ID 7	   // RAK12010 light sensor
-// #define EEPROM_ID 8	   // RAK15000 EEPROM module
-// #define MQ2_ID 9	   // RAK12004 MQ2 CO2 gas sensor
-// #define MG812_ID 10	   // RAK12008 MG812 CO2 gas sensor
-// #define MQ3_ID 11	   // RAK12009 MQ3 Alcohol gas sensor
-// #define TOF_ID 12	   // RAK12014 Laser ToF sensor
-// #define RTC_ID 13	   // RAK12002 RTC module
-// #define BAR_ID 14	   // RAK14003 LED bargraph module
-#define VOC_ID 15	   // RAK12047 VOC sensor
-// #define GYRO_ID 16	   // RAK12025 Gyroscope
-// #define GESTURE_ID 17  // RAK14008 Gesture sensor
-// #define OLED_ID 18	   // RAK1921 OLED display
-// #define UVL_ID 19	   // RAK12019 UV light sensor
-// #define TOUCH_ID 20	   // RAK14002 Touch Pad
-// #define CURRENT_ID 21  // RAK16000 current sensor
-// #define MPU_ID 22	   // RAK1905 9DOF MPU9250 sensor
-#define CO2_ID 23	   // RAK12037 CO2 sensor
-// #define FIR_ID 24	   // RAK12003 FIR temperature sensor
-// #define TEMP_ARR_ID 25 // RAK12040 Temp Array sensor
-// #define DOF_ID 26	   // RAK12034 9DOF BMX160 sensor
-// #define ACC2_ID 27	   // RAK12032 ADXL313 accelerometer
-
-// LoRaWAN stuff
-#include "wisblock_cayenne.h"
-// Cayenne LPP Channel numbers per sensor value
-#define LPP_CHANNEL_BATT 1			   // Base Board
-// #define LPP_CHANNEL_HUMID 2			   // RAK1901
-// #define LPP_CHANNEL_TEMP 3			   // RAK1901
-// #define LPP_CHANNEL_PRESS 4			   // RAK1902
-// #define LPP_CHANNEL_LIGHT 5			   // RAK1903
-#define LPP_CHANNEL_HUMID_2 6		   // RAK1906
-#define LPP_CHANNEL_TEMP_2 7		   // RAK1906
-#define LPP_CHANNEL_PRESS_2 8		   // RAK1906
-#define LPP_CHANNEL_GAS_2 9			   // RAK1906
-// #define LPP_CHANNEL_GPS 10			   // RAK1910/RAK12500
-// #define LPP_CHANNEL_SOIL_TEMP 11	   // RAK12035
-// #define LPP_CHANNEL_SOIL_HUMID 12	   // RAK12035
-// #define LPP_CHANNEL_SOIL_HUMID_RAW 13  // RAK12035
-// #define LPP_CHANNEL_SOIL_VALID 14	   // RAK12035
-// #define LPP_CHANNEL_LIGHT2 15		   // RAK12010
-#define LPP_CHANNEL_VOC 16			   // RAK12047
-// #define LPP_CHANNEL_GAS 17			   // RAK12004
-// #define LPP_CHANNEL_GAS_PERC 18		   // RAK12004
-// #define LPP_CHANNEL_CO2 19			   // RAK12008
-// #define LPP_CHANNEL_CO2_PERC 20		   // RAK12008
-// #define LPP_CHANNEL_ALC 21			   // RAK12009
-// #define LPP_CHANNEL_ALC_PERC 22		   // RAK12009
-// #define LPP_CHANNEL_TOF 23			   // RAK12014
-// #define LPP_CHANNEL_TOF_VALID 24	   // RAK12014
-// #define LPP_CHANNEL_GYRO 25			   // RAK12025
-// #define LPP_CHANNEL_GESTURE 26		   // RAK14008
-// #define LPP_CHANNEL_UVI 27			   // RAK12019
-// #define LPP_CHANNEL_UVS 28			   // RAK12019
-// #define LPP_CHANNEL_CURRENT_CURRENT 29 // RAK16000
-// #define LPP_CHANNEL_CURRENT_VOLTAGE 30 // RAK16000
-// #define LPP_CHANNEL_CURRENT_POWER 31   // RAK16000
-// #define LPP_CHANNEL_TOUCH_1 32		   // RAK14002
-// #define LPP_CHANNEL_TOUCH_2 33		   // RAK14002
-// #define LPP_CHANNEL_TOUCH_3 34		   // RAK14002
-#define LPP_CHANNEL_CO2_2 35		   // RAK12037
-#define LPP_CHANNEL_CO2_Temp_2 36	   // RAK12037
-#define LPP_CHANNEL_CO2_HUMID_2 37	   // RAK12037
-#define LPP_CHANNEL_TEMP_3 38		   // RAK12003
-#define LPP_CHANNEL_TEMP_4 39		   // RAK12003
-
-extern WisCayenne g_solution_data;
-
-// Sensor functions
-bool init_rak1906(void);
-void start_rak1906(void);
-bool read_rak1906(void);
-void get_rak1906_values(float *values);
-bool init_rak12037(void);
-void read_rak12037(void);
-bool init_rak12047(void);
-void read_rak12047(void);
-
-// Custom AT commands
-bool get_at_setting(uint32_t setting_type);
-bool save_at_setting(uint32_t setting_type);
-bool init_send_interval_at(void);
-bool init_status_at(void);
-
-/** Settings offset in flash */
-// #define GNSS_OFFSET 0x00000000		// length 1 byte
-#define SEND_INT_OFFSET 0x00000002 // length 4 bytes
-
+/**
+ * @file module_handler.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Globals and defines for module handling
+ * @version 0.1
+ * @date 2022-04-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#ifndef MODULE_HANDLER_H
+#define MODULE_HANDLER_H
+
+// Module handler stuff
+void find_modules(void);
+uint64_t get_inventory(void);
+bool clear_inventory(void);
+void announce_modules(void);
+uint32_t start_sensors(void);
+bool collect_sensors(void);
+void get_sensor_values(void);
+uint32_t acquisition_lead(void);
+void record_tx_jitter(uint32_t jitter, bool late);
+
+// Forward declarations
+void uplink_handler(void *);
+void sensor_handler(void *);
+void send_handler(void *);
+void schedule_uplinks(void);
+void drain_handler(void *);
+bool send_batch(bool late);
+
+// Boot statistics
+extern bool g_inventory_cached;
+extern uint32_t g_module_scan_time;
+extern uint32_t g_first_uplink_time;
+
+/** Extra time added to the expected sensor conversion time */
+#define CONVERSION_MARGIN 5
+/** Time in ms before checking again for conversions that were not finished */
+#define CONVERSION_RETRY_TIME 5
+/** Max number of checks for unfinished conversions */
+#define CONVERSION_RETRIES 4
+
+/** Default minimum time in ms between the start of the acquisition and the TX slot */
+#define ACQ_LEAD_MIN 250
+/** Time in ms added to the expected acquisition time */
+#define ACQ_LEAD_MARGIN 50
+/** Maximum lead time in ms, limited to half of the send interval as well */
+#define ACQ_LEAD_MAX 30000
+
+/** Default maximum age of the cached BME680 temperature and humidity in ms */
+#define BME_TH_MAX_AGE 30000
+/** Time in ms after the expected end of a T/RH conversion before it is given up */
+#define BME_TH_TIMEOUT (CONVERSION_RETRY_TIME * CONVERSION_RETRIES)
+
+/** VOC sensor is read every 10 seconds */
+#define VOC_MODE_CONTINUOUS 0
+/** VOC sensor is read in a short burst before each uplink, heater is off in between */
+#define VOC_MODE_BURST 1
+/** Default measurement interval of the SCD30 in seconds */
+#define SCD30_INTERVAL 10
+/** Valid range of the SCD30 measurement interval in seconds */
+#define SCD30_INTERVAL_MIN 2
+#define SCD30_INTERVAL_MAX 1800
+/** Time in seconds between the last SCD30 measurement and the poll before the uplink */
+#define SCD30_SAMPLE_LEAD 3
+/** Time in ms between the SCD30 poll and the start of the acquisition */
+#define SCD30_POLL_LEAD 2000
+/** Extra polls in 1 second steps if the SCD30 has no data yet */
+#define SCD30_POLL_RETRIES 3
+/** Realign the SCD30 cycle after this time in ms, a fast sensor clock is not seen by the poll */
+#define SCD30_REALIGN_TIME (24 * 3600 * 1000UL)
+/** CO2 values older than this number of measurement intervals are not sent */
+#define SCD30_MAX_AGE_INTERVALS 3
+
+/** Time in s the VOC algorithm runs before its index is used, 101 readings of the continuous mode */
+#define VOC_WARMUP_TIME 1010
+/** Number of VOC readings in one burst */
+#define VOC_BURST_SAMPLES 6
+/** Time in ms between the end of the burst and the start of the acquisition */
+#define VOC_BURST_LEAD 2000
+
+typedef struct sensors_s
+{
+	uint8_t i2c_addr;  // I2C address
+	uint8_t i2c_num;   // I2C port
+	bool found_sensor; // Flag if sensor is present
+} sensors_t;
+
+extern volatile sensors_t found_sensors[];
+
+/** Maximum number of LPP channels per driver */
+#define DRIVER_MAX_CHANNELS 4
+
+/**
+ * @brief Latest sensor values for the payload
+ *        Written by the sensor jobs, read by get_sensor_values()
+ *        Two copies are kept, the payload is always built from
+ *        the last complete copy
+ *
+ */
+typedef struct sensor_snapshot_s
+{
+	uint32_t sequence;		 // Incremented with each published snapshot
+	bool env_valid;			 // RAK1906 values are valid
+	int32_t env_temperature; // Temperature in 0.01 °C
+	int32_t env_humidity;	 // Humidity in 0.001 %RH
+	int32_t env_pressure;	 // Pressure in Pa
+	uint32_t env_gas;		 // Gas resistance in Ohm
+	bool co2_valid;			 // RAK12037 values are valid
+	uint32_t co2_timestamp;	 // millis() when the CO2 values were read
+	uint16_t co2;			 // CO2 in ppm
+	float co2_temperature;	 // Temperature in °C
+	float co2_humidity;		 // Humidity in %RH
+	bool voc_valid;			 // RAK12047 value is valid
+	int32_t voc_index;		 // VOC index
+} sensor_snapshot_t;
+
+sensor_snapshot_t *snapshot_edit(void);
+void snapshot_publish(void);
+const sensor_snapshot_t *snapshot_get(void);
+void encode_sensor_values(const sensor_snapshot_t &values);
+
+/**
+ * @brief Sensor driver descriptor
+ *        Hooks that are not needed by a driver are NULL
+ *
+ */
+typedef struct sensor_driver_s
+{
+	uint8_t module_id;							// Index in found_sensors[]
+	const char *name;							// Module name for +EVT
+	const char *dev_name;						// Device name if the module is found
+	bool (*init)(void);							// Initialize the module, false if it failed
+	uint32_t (*start)(void);					// Start a conversion, returns time in ms until finished
+	bool (*collect)(void);						// Read the conversion results, false if it failed
+	void (*encode)(const sensor_snapshot_t &);	// Add the values from the snapshot to the payload
+	void (*announce)(void);						// Extra output after +EVT
+	uint16_t conversion_time;					// Max expected conversion time in ms
+	uint8_t lpp_channels[DRIVER_MAX_CHANNELS];	// LPP channels used, 0 = unused
+} sensor_driver_t;
+
+/**
+ * @brief Timing statistics of a sensor driver
+ *
+ */
+typedef struct driver_stats_s
+{
+	uint32_t init_time;		// Time of init() in ms
+	uint32_t read_time;		// Time of the last collect() + encode() in us
+	uint32_t max_read_time; // Longest collect() + encode() in us
+	uint32_t reads;			// Number of reads
+	uint32_t failures;		// Failed init() or collect()
+} driver_stats_t;
+
+/**
+ * @brief Timing of the sensor acquisition for one uplink
+ *
+ */
+typedef struct acquisition_stats_s
+{
+	uint32_t cycle_start;	 // millis() when the conversions were started
+	uint32_t wall_time;		 // Time from start to payload ready in ms
+	uint32_t awake_time;	 // Time the MCU worked on the sensors in us
+	uint32_t max_awake_time; // Longest awake time in us
+	uint32_t retries;		 // Number of collect retries for unfinished conversions
+} acquisition_stats_t;
+
+/**
+ * @brief Lead time of the acquisition and timing of the uplinks
+ *
+ */
+typedef struct uplink_stats_s
+{
+	int32_t latency_avg;	 // Average acquisition time in ms
+	int32_t latency_dev;	 // Average deviation of the acquisition time in ms
+	uint32_t lead;			 // Current lead time in ms
+	uint32_t last_jitter;	 // Delay of the last TX after its slot in ms
+	uint32_t max_jitter;	 // Longest TX delay in ms
+	uint32_t jitter_sum;	 // Sum of all TX delays in ms
+	uint32_t uplinks;		 // Number of uplinks
+	uint32_t late;			 // Uplinks where the payload was not ready at the TX slot
+} uplink_stats_t;
+
+extern acquisition_stats_t acquisition_stats;
+extern uplink_stats_t uplink_stats;
+extern uint32_t g_acq_lead_min;
+extern const sensor_driver_t sensor_drivers[];
+extern driver_stats_t driver_stats[];
+extern const uint8_t num_sensor_drivers;
+
+// Index for known I2C devices
+// #define ACC_ID 0	   // RAK1904 accelerometer
+// #define LIGHT_ID 1	   // RAK1903 light sensor
+// #define GNSS_ID 2	   // RAK12500 GNSS sensor
+// #define PRESS_ID 3	   // RAK1902 barometric pressure sensor
+// #define TEMP_ID 4	   // RAK1901 temperature & humidity sensor
+#define ENV_ID 5	   // RAK1906 environment sensor
+// #define SOIL_ID 6	   // RAK12035 soil moisture sensor
+// #define LIGHT2_ID 7	   // RAK12010 light sensor
+// #define EEPROM_ID 8	   // RAK15000 EEPROM module
+// #define MQ2_ID 9	   // RAK12004 MQ2 CO2 gas sensor
+// #define MG812_ID 10	   // RAK12008 MG812 CO2 gas sensor
+// #define MQ3_ID 11	   // RAK12009 MQ3 Alcohol gas sensor
+// #define TOF_ID 12	   // RAK12014 Laser ToF sensor
+// #define RTC_ID 13	   // RAK12002 RTC module
+// #define BAR_ID 14	   // RAK14003 LED bargraph module
+#define VOC_ID 15	   // RAK12047 VOC sensor
+// #define GYRO_ID 16	   // RAK12025 Gyroscope
+// #define GESTURE_ID 17  // RAK14008 Gesture sensor
+// #define OLED_ID 18	   // RAK1921 OLED display
+// #define UVL_ID 19	   // RAK12019 UV light sensor
+// #define TOUCH_ID 20	   // RAK14002 Touch Pad
+// #define CURRENT_ID 21  // RAK16000 current sensor
+// #define MPU_ID 22	   // RAK1905 9DOF MPU9250 sensor
+#define CO2_ID 23	   // RAK12037 CO2 sensor
+// #define FIR_ID 24	   // RAK12003 FIR temperature sensor
+// #define TEMP_ARR_ID 25 // RAK12040 Temp Array sensor
+// #define DOF_ID 26	   // RAK12034 9DOF BMX160 sensor
+// #define ACC2_ID 27	   // RAK12032 ADXL313 accelerometer
+
+// LoRaWAN stuff
+#include "wisblock_cayenne.h"
+// Cayenne LPP Channel numbers per sensor value
+#define LPP_CHANNEL_BATT 1			   // Base Board
+// #define LPP_CHANNEL_HUMID 2			   // RAK1901
+// #define LPP_CHANNEL_TEMP 3			   // RAK1901
+// #define LPP_CHANNEL_PRESS 4			   // RAK1902
+// #define LPP_CHANNEL_LIGHT 5			   // RAK1903
+#define LPP_CHANNEL_HUMID_2 6		   // RAK1906
+#define LPP_CHANNEL_TEMP_2 7		   // RAK1906
+#define LPP_CHANNEL_PRESS_2 8		   // RAK1906
+#define LPP_CHANNEL_GAS_2 9			   // RAK1906
+// #define LPP_CHANNEL_GPS 10			   // RAK1910/RAK12500
+// #define LPP_CHANNEL_SOIL_TEMP 11	   // RAK12035
+// #define LPP_CHANNEL_SOIL_HUMID 12	   // RAK12035
+// #define LPP_CHANNEL_SOIL_HUMID_RAW 13  // RAK12035
+// #define LPP_CHANNEL_SOIL_VALID 14	   // RAK12035
+// #define LPP_CHANNEL_LIGHT2 15		   // RAK12010
+#define LPP_CHANNEL_VOC 16			   // RAK12047
+// #define LPP_CHANNEL_GAS 17			   // RAK12004
+// #define LPP_CHANNEL_GAS_PERC 18		   // RAK12004
+// #define LPP_CHANNEL_CO2 19			   // RAK12008
+// #define LPP_CHANNEL_CO2_PERC 20		   // RAK12008
+// #define LPP_CHANNEL_ALC 21			   // RAK12009
+// #define LPP_CHANNEL_ALC_PERC 22		   // RAK12009
+// #define LPP_CHANNEL_TOF 23			   // RAK12014
+// #define LPP_CHANNEL_TOF_VALID 24	   // RAK12014
+// #define LPP_CHANNEL_GYRO 25			   // RAK12025
+// #define LPP_CHANNEL_GESTURE 26		   // RAK14008
+// #define LPP_CHANNEL_UVI 27			   // RAK12019
+// #define LPP_CHANNEL_UVS 28			   // RAK12019
+// #define LPP_CHANNEL_CURRENT_CURRENT 29 // RAK16000
+// #define LPP_CHANNEL_CURRENT_VOLTAGE 30 // RAK16000
+// #define LPP_CHANNEL_CURRENT_POWER 31   // RAK16000
+// #define LPP_CHANNEL_TOUCH_1 32		   // RAK14002
+// #define LPP_CHANNEL_TOUCH_2 33		   // RAK14002
+// #define LPP_CHANNEL_TOUCH_3 34		   // RAK14002
+#define LPP_CHANNEL_CO2_2 35		   // RAK12037
+#define LPP_CHANNEL_CO2_Temp_2 36	   // RAK12037
+#define LPP_CHANNEL_CO2_HUMID_2 37	   // RAK12037
+#define LPP_CHANNEL_TEMP_3 38		   // RAK12003
+#define LPP_CHANNEL_TEMP_4 39		   // RAK12003
+#define LPP_CHANNEL_AGE 40			   // Age of a queued sample in seconds
+
+extern WisCayenne g_solution_data;
+
+// Sensor functions
+bool init_rak1906(void);
+uint32_t start_rak1906(void);
+bool collect_rak1906(void);
+void encode_rak1906(const sensor_snapshot_t &values);
+void get_rak1906_values(float *values);
+uint32_t start_rak1906_th(void);
+bool collect_rak1906_th(void);
+bool rak1906_th_running(void);
+void get_rak1906_cache_stats(uint32_t &hits, uint32_t &misses);
+extern uint32_t g_bme_th_max_age;
+bool init_rak12037(void);
+void encode_rak12037(const sensor_snapshot_t &values);
+void co2_schedule(void);
+void co2_realign(void);
+uint16_t scd30_interval_for(uint32_t send_interval);
+bool init_rak12047(void);
+void encode_rak12047(const sensor_snapshot_t &values);
+void voc_schedule_burst(void);
+void voc_apply_mode(void);
+extern uint8_t g_voc_mode;
+extern uint32_t g_voc_wakeups;
+
+// Custom AT commands
+bool get_at_setting(uint32_t setting_type);
+bool save_at_setting(uint32_t setting_type);
+bool init_send_interval_at(void);
+bool init_status_at(void);
+bool init_th_max_age_at(void);
+bool init_voc_mode_at(void);
+bool init_inventory_at(void);
+bool init_driver_stats_at(void);
+bool init_tx_lead_at(void);
+bool init_sf_queue_at(void);
+bool init_batch_at(void);
+bool init_sod_at(void);
+bool init_payload_format_at(void);
+bool init_keyframe_at(void);
+bool init_plan_at(void);
+uint16_t flash_crc16(const uint8_t *data, uint16_t length);
+
+/** Settings offset in flash */
+// #define GNSS_OFFSET 0x00000000		// length 1 byte
+#define SEND_INT_OFFSET 0x00000002 // length 4 bytes
+#define BME_CALIB_OFFSET 0x00000010 // length 48 bytes
+#define TH_AGE_OFFSET 0x00000040 // length 5 bytes
+#define VOC_STATE_OFFSET 0x00000050 // length 16 bytes
+#define VOC_MODE_OFFSET 0x00000060 // length 2 bytes
+#define INVENTORY_OFFSET 0x00000068 // length 11 bytes
+#define ACQ_LEAD_OFFSET 0x00000078 // length 5 bytes
+#define BATCH_OFFSET 0x00000080 // length 2 bytes
+#define SOD_OFFSET 0x00000084 // length 9 bytes
+#define DEADBAND_OFFSET 0x00000090 // length 19 bytes
+#define PAYLOAD_FORMAT_OFFSET 0x000000A8 // length 2 bytes
+#define KEYFRAME_OFFSET 0x000000AC // length 2 bytes
+#define PRIORITY_OFFSET 0x000000B0 // length 10 bytes
+
 #endif
\ No newline at end of file
@@ -0,0 +1,166 @@
+/**
+ * @file packed_payload.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Bit-packed fixed schema payload as alternative to Cayenne LPP
+ *        If g_payload_format is PAYLOAD_PACKED the single sample
+ *        uplinks are sent on PACKED_FPORT instead of LPP on fPort 2:
+ *
+ *          schema       8 bits  PACKED_SCHEMA
+ *          present      9 bits  bitmap of the values that follow,
+ *                               bit n = SF_CH_xxx n
+ *          values       packed_field[] bits each, value - min,
+ *                               lowest channel first
+ *
+ *        The bits are written MSB first, the last byte is padded with 0.
+ *        Values outside of the range are clamped, values that do
+ *        not fit into max_size are left out by plan_channels().
+ *        Queued and batched samples keep their own formats.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Payload format of the single sample uplinks */
+uint8_t g_payload_format = PAYLOAD_LPP;
+
+/** Encoded payload */
+static uint8_t packed_buffer[PACKED_MAX_SIZE];
+
+/**
+ * @brief Width and offset of a packed value
+ *
+ */
+typedef struct packed_field_s
+{
+	uint8_t bits; // Number of bits
+	int16_t min;  // Value sent as 0
+} packed_field_t;
+
+/** Fields of schema 1, index is the bit in the presence bitmap */
+static const packed_field_t packed_field[SF_CHANNELS] = {
+	{11, -400}, // RAK1906 temperature 0.1 °C, -40.0 .. 164.7 °C
+	{8, 0},		// RAK1906 humidity 0.5 %RH, 0 .. 127.5 %RH
+	{13, 3000}, // RAK1906 pressure 0.1 hPa, 300.0 .. 1119.1 hPa
+	{15, 0},	// RAK1906 gas resistance 100 Ohm, 0 .. 3.2767 MOhm
+	{14, 0},	// RAK12037 CO2 ppm, 0 .. 16383 ppm
+	{11, -400}, // RAK12037 temperature 0.1 °C, -40.0 .. 164.7 °C
+	{8, 0},		// RAK12037 humidity 0.5 %RH, 0 .. 127.5 %RH
+	{9, 0},		// RAK12047 VOC index, 0 .. 511
+	{8, 0},		// Battery 0.02 V, 0 .. 5.10 V
+};
+
+/**
+ * @brief Append bits to the payload, MSB first
+ *
+ * @param bit_pos next free bit, updated
+ * @param value value to write
+ * @param bits number of bits
+ */
+static void packed_put(uint16_t &bit_pos, uint32_t value, uint8_t bits)
+{
+	while (bits != 0)
+	{
+		bits--;
+		if ((value >> bits) & 1)
+		{
+			packed_buffer[bit_pos >> 3] |= 0x80 >> (bit_pos & 7);
+		}
+		bit_pos++;
+	}
+}
+
+/**
+ * @brief Round a value to a coarser resolution
+ *
+ * @param value value in the fine resolution
+ * @param divisor ratio between the resolutions
+ * @return int32_t rounded value
+ */
+static int32_t packed_round(int32_t value, int32_t divisor)
+{
+	return (value >= 0) ? (value + divisor / 2) / divisor : (value - divisor / 2) / divisor;
+}
+
+/**
+ * @brief Encode a sample into the bit-packed payload
+ *
+ * @param values sensor values
+ * @param battery battery voltage in V
+ * @param max_size max size of the payload in bytes
+ * @return uint8_t payload size in bytes
+ */
+uint8_t packed_encode(const sensor_snapshot_t &values, float battery, uint8_t max_size)
+{
+	int32_t value[SF_CHANNELS];
+	uint16_t present = 1 << SF_CH_BATT;
+
+	if (values.env_valid)
+	{
+		value[SF_CH_ENV_TEMP] = packed_round(values.env_temperature, 10);
+		value[SF_CH_ENV_HUMID] = packed_round(values.env_humidity, 500);
+		value[SF_CH_ENV_PRESS] = packed_round(values.env_pressure, 10);
+		value[SF_CH_ENV_GAS] = (int32_t)((values.env_gas + 50) / 100);
+		present |= (1 << SF_CH_ENV_TEMP) | (1 << SF_CH_ENV_HUMID) | (1 << SF_CH_ENV_PRESS) | (1 << SF_CH_ENV_GAS);
+	}
+	if (values.co2_valid)
+	{
+		value[SF_CH_CO2] = values.co2;
+		value[SF_CH_CO2_TEMP] = (int32_t)floorf(values.co2_temperature * 10.0f + 0.5f);
+		value[SF_CH_CO2_HUMID] = (int32_t)floorf(values.co2_humidity * 2.0f + 0.5f);
+		present |= (1 << SF_CH_CO2) | (1 << SF_CH_CO2_TEMP) | (1 << SF_CH_CO2_HUMID);
+	}
+	if (values.voc_valid)
+	{
+		value[SF_CH_VOC] = values.voc_index;
+		present |= 1 << SF_CH_VOC;
+	}
+	value[SF_CH_BATT] = (int32_t)floorf(battery * 50.0f + 0.5f);
+
+	// Leave out the values that do not fit
+	uint8_t bits[SF_CHANNELS];
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		bits[channel] = packed_field[channel].bits;
+	}
+	uint16_t header_bits = 8 + SF_CHANNELS;
+	uint16_t budget = (max_size * 8 > header_bits) ? max_size * 8 - header_bits : 0;
+	present = plan_channels(present, bits, budget);
+
+	memset(packed_buffer, 0, sizeof(packed_buffer));
+	uint16_t bit_pos = 0;
+	packed_put(bit_pos, PACKED_SCHEMA, 8);
+	packed_put(bit_pos, present, SF_CHANNELS);
+
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if ((present & (1 << channel)) == 0)
+		{
+			continue;
+		}
+		int32_t raw = value[channel] - packed_field[channel].min;
+		int32_t raw_max = (1L << packed_field[channel].bits) - 1;
+		if (raw < 0)
+		{
+			raw = 0;
+		}
+		else if (raw > raw_max)
+		{
+			raw = raw_max;
+		}
+		packed_put(bit_pos, (uint32_t)raw, packed_field[channel].bits);
+	}
+	return (uint8_t)((bit_pos + 7) >> 3);
+}
+
+/**
+ * @brief Get the payload encoded by packed_encode()
+ *
+ * @return uint8_t* payload buffer
+ */
+uint8_t *packed_payload(void)
+{
+	return packed_buffer;
+}
@@ -0,0 +1,33 @@
+/**
+ * @file packed_payload.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Bit-packed fixed schema payload as alternative to Cayenne LPP
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef PACKED_PAYLOAD_H
+#define PACKED_PAYLOAD_H
+
+#include <Arduino.h>
+
+/** Payload formats of the single sample uplinks */
+#define PAYLOAD_LPP 0
+#define PAYLOAD_PACKED 1
+#define PAYLOAD_DELTA 2
+
+/** fPort of the bit-packed uplinks */
+#define PACKED_FPORT 5
+/** Version of the bit-packed schema, first byte of the payload */
+#define PACKED_SCHEMA 1
+/** Schema version, presence bitmap and all values */
+#define PACKED_MAX_SIZE 15
+
+extern uint8_t g_payload_format;
+
+uint8_t packed_encode(const sensor_snapshot_t &values, float battery, uint8_t max_size);
+uint8_t *packed_payload(void);
+
+#endif // PACKED_PAYLOAD_H
@@ -0,0 +1,242 @@
+/**
+ * @file payload_plan.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Fit the payload into the max size of the data rate
+ *        If not all values fit into max_payload_size(), the values
+ *        with the highest priority are sent. Each time a value is
+ *        dropped its priority rises by PLAN_AGING until it is sent,
+ *        so the dropped values rotate through the next uplinks.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Priority per SF_CH_xxx, the higher the earlier the value is sent */
+uint8_t g_plan_priority[SF_CHANNELS] = {
+	7, // RAK1906 temperature
+	6, // RAK1906 humidity
+	3, // RAK1906 pressure
+	2, // RAK1906 gas resistance
+	9, // RAK12037 CO2
+	4, // RAK12037 temperature
+	4, // RAK12037 humidity
+	8, // RAK12047 VOC index
+	5, // Battery
+};
+
+/** Payload planner statistics */
+plan_stats_t plan_stats;
+
+/** Uplinks since a value was sent last */
+static uint8_t plan_skipped[SF_CHANNELS] = {0};
+/** Values selected by the last plan */
+static uint16_t plan_selected = 0;
+
+/** LPP channel of the values, index is SF_CH_xxx */
+static const uint8_t plan_lpp_channel[SF_CHANNELS] = {
+	LPP_CHANNEL_TEMP_2,
+	LPP_CHANNEL_HUMID_2,
+	LPP_CHANNEL_PRESS_2,
+	LPP_CHANNEL_GAS_2,
+	LPP_CHANNEL_CO2_2,
+	LPP_CHANNEL_CO2_Temp_2,
+	LPP_CHANNEL_CO2_HUMID_2,
+	LPP_CHANNEL_VOC,
+	LPP_CHANNEL_BATT,
+};
+
+/**
+ * @brief Select the values that fit into the payload
+ *        Values are taken by priority, a value that does not fit
+ *        is skipped and the next smaller one is tried
+ *
+ * @param present bitmap of the values in the payload, bit n = SF_CH_xxx n
+ * @param size size of each value, in the same unit as budget
+ * @param budget space for the values
+ * @return uint16_t bitmap of the values to send
+ */
+uint16_t plan_channels(uint16_t present, const uint8_t *size, uint16_t budget)
+{
+	uint16_t selected = 0;
+	uint16_t tried = 0;
+
+	plan_stats.planned++;
+	while (tried != present)
+	{
+		// Value with the highest priority not tried yet
+		uint8_t best = SF_CHANNELS;
+		uint16_t best_rank = 0;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (((present & ~tried) & (1 << channel)) == 0)
+			{
+				continue;
+			}
+			uint16_t rank = g_plan_priority[channel] + PLAN_AGING * plan_skipped[channel];
+			if ((best == SF_CHANNELS) || (rank > best_rank))
+			{
+				best = channel;
+				best_rank = rank;
+			}
+		}
+		tried |= 1 << best;
+		if (size[best] <= budget)
+		{
+			budget -= size[best];
+			selected |= 1 << best;
+		}
+	}
+
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if (selected & (1 << channel))
+		{
+			plan_skipped[channel] = 0;
+		}
+		else if (present & (1 << channel))
+		{
+			if (plan_skipped[channel] < 0xFF)
+			{
+				plan_skipped[channel]++;
+			}
+			plan_stats.dropped++;
+		}
+	}
+	if (selected != present)
+	{
+		plan_stats.shed++;
+	}
+	plan_selected = selected;
+	return selected;
+}
+
+/**
+ * @brief Size of the data of an LPP type
+ *
+ * @param type LPP type
+ * @return uint8_t data size, 0 if the type is not used by this application
+ */
+static uint8_t plan_lpp_size(uint8_t type)
+{
+	switch (type)
+	{
+	case LPP_TEMPERATURE:
+		return LPP_TEMPERATURE_SIZE;
+	case LPP_RELATIVE_HUMIDITY:
+		return LPP_RELATIVE_HUMIDITY_SIZE;
+	case LPP_BAROMETRIC_PRESSURE:
+		return LPP_BAROMETRIC_PRESSURE_SIZE;
+	case LPP_ANALOG_INPUT:
+		return LPP_ANALOG_INPUT_SIZE;
+	case LPP_CONCENTRATION:
+		return LPP_CONCENTRATION_SIZE;
+	case LPP_VOC:
+		return LPP_VOC_SIZE;
+	case LPP_VOLTAGE:
+		return LPP_VOLTAGE_SIZE;
+	case LPP_GENERIC_SENSOR:
+		return LPP_GENERIC_SENSOR_SIZE;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * @brief Remove values from g_solution_data until it fits
+ *        Values of unknown LPP channels are always kept
+ *
+ * @param max_size max size of the payload in bytes
+ * @return true if the payload fits
+ * @return false if the payload has unknown LPP types or
+ *         the values that are always kept do not fit
+ */
+bool plan_lpp_payload(uint8_t max_size)
+{
+	uint8_t *buffer = g_solution_data.getBuffer();
+	uint8_t payload_size = g_solution_data.getSize();
+
+	// Find the values in the payload
+	uint8_t field_start[SF_CHANNELS];
+	uint8_t size[SF_CHANNELS] = {0};
+	uint16_t present = 0;
+	uint8_t fixed_size = 0;
+	uint8_t pos = 0;
+	while (pos < payload_size)
+	{
+		uint8_t field_size = plan_lpp_size(buffer[pos + 1]);
+		if ((field_size == 0) || (pos + 2 + field_size > payload_size))
+		{
+			MYLOG("PLAN", "Unknown LPP type %d", buffer[pos + 1]);
+			// Payload is sent as it is
+			plan_selected = SOD_ALL_CHANNELS;
+			return payload_size <= max_size;
+		}
+		field_size += 2;
+
+		uint8_t channel = 0;
+		while ((channel < SF_CHANNELS) && (plan_lpp_channel[channel] != buffer[pos]))
+		{
+			channel++;
+		}
+		if ((channel < SF_CHANNELS) && ((present & (1 << channel)) == 0))
+		{
+			present |= 1 << channel;
+			field_start[channel] = pos;
+			size[channel] = field_size;
+		}
+		else
+		{
+			fixed_size += field_size;
+		}
+		pos += field_size;
+	}
+	if (fixed_size > max_size)
+	{
+		return false;
+	}
+
+	uint16_t selected = plan_channels(present, size, max_size - fixed_size);
+	if (selected == present)
+	{
+		return true;
+	}
+	MYLOG("PLAN", "Max payload %d, sent values %03X of %03X", max_size, selected, present);
+
+	// Move the selected values together, the order of the payload is kept
+	uint8_t write_pos = 0;
+	pos = 0;
+	while (pos < payload_size)
+	{
+		uint8_t field_size = plan_lpp_size(buffer[pos + 1]) + 2;
+		bool keep = true;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if ((present & (1 << channel)) && (field_start[channel] == pos))
+			{
+				keep = (selected & (1 << channel)) != 0;
+				break;
+			}
+		}
+		if (keep)
+		{
+			memmove(&buffer[write_pos], &buffer[pos], field_size);
+			write_pos += field_size;
+		}
+		pos += field_size;
+	}
+	g_solution_data.rewind(write_pos);
+	return true;
+}
+
+/**
+ * @brief Get the values of the last payload that was planned
+ *
+ * @return uint16_t bitmap of the values, bit n = SF_CH_xxx n
+ */
+uint16_t plan_sent_channels(void)
+{
+	return plan_selected;
+}
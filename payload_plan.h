@@ -0,0 +1,37 @@
+/**
+ * @file payload_plan.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Fit the payload into the max size of the data rate
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef PAYLOAD_PLAN_H
+#define PAYLOAD_PLAN_H
+
+#include <Arduino.h>
+
+/** Priority added per uplink a value was dropped from */
+#define PLAN_AGING 2
+
+/**
+ * @brief Payload planner statistics
+ *
+ */
+typedef struct plan_stats_s
+{
+	uint32_t planned; // Payloads checked
+	uint32_t shed;	  // Payloads that had to drop values
+	uint32_t dropped; // Values dropped
+} plan_stats_t;
+
+extern uint8_t g_plan_priority[SF_CHANNELS];
+extern plan_stats_t plan_stats;
+
+uint16_t plan_channels(uint16_t present, const uint8_t *size, uint16_t budget);
+bool plan_lpp_payload(uint8_t max_size);
+uint16_t plan_sent_channels(void);
+
+#endif // PAYLOAD_PLAN_H
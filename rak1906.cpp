@@ -1,7 +1,12 @@
 #include "rak1906.h"
 
-rak1906::rak1906()
+rak1906::rak1906():_osTemperature(SensorOff), _osHumidity(SensorOff),
+_osPressure(SensorOff), _gasMillis(0), _heaterShadow(0),
+_durationShadow(0), _dirtyMask(0), _i2cCount(0), _chipId(0),
+_calibFromCache(false)
 {
+    for (uint8_t i = 0; i < sizeof(_ctrlShadow); i++)
+	_ctrlShadow[i] = 0;
 }
 
 uint8_t
@@ -15,18 +20,38 @@ rak1906::readByte(const uint8_t addr) const
 bool
 rak1906::init()
 {
+    return init(NULL);
+}
+
+bool
+rak1906::init(const rak1906_calib_t * cached)
+{
+    _i2cCount = 1;
     Wire.beginTransmission(RAK1906_ADDRESS);
     if (!Wire.endTransmission() == 0)
 	return false;
 
-    getCalibration();		// get the calibration values
-    uint8_t         workRegister = readByte(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
-										// the 
-										// control 
-										// measure
-    putData(RAK1906_CONTROL_MEASURE_REGISTER, (uint8_t) (workRegister | 1));	// Trigger 
-										// 1st 
-										// measurement
+    _chipId = readByte(RAK1906_CHIPID_REGISTER);	// Identify the
+							// sensor
+    _calibFromCache = false;
+    if (cached != NULL && cached->chipId == _chipId) {
+	uint16_t        t1;	// T1 is unique per sensor, detects a
+				// swapped module
+	getData(RAK1906_COEFF_START_ADDRESS2 + RAK1906_T1_LSB_REG, t1);	// LSB 
+									// first
+	if (t1 == cached->T1) {
+	    setCalibrationData(*cached);
+	    _calibFromCache = true;
+	}
+    }
+    if (!_calibFromCache)
+	getCalibration();	// get the calibration values
+    getData(RAK1906_SHADOW_FIRST_REGISTER, _ctrlShadow);	// Read 0x70 
+								// ... 0x75 
+								// in one go
+    shadow(RAK1906_CONTROL_MEASURE_REGISTER) &= 0xFC;	// Shadow keeps
+							// sleep mode
+    _dirtyMask = 0;
     setOversampling(TemperatureSensor, Oversample16);	// Use enumerated
 							// type values
     setOversampling(HumiditySensor, Oversample16);	// Use enumerated
@@ -35,6 +60,8 @@ rak1906::init()
 							// type values
     setIIRFilter(IIR4);		// Use enumerated type values
     setGas(320, 150);		// 320�c for 150 milliseconds
+    triggerMeasurement();	// Write the settings and trigger 1st
+				// measurement
 
     return true;
 
@@ -44,9 +71,77 @@ bool
 rak1906::update()
 {
     Wire.beginTransmission(RAK1906_ADDRESS);
+    _i2cCount++;
     if (!Wire.endTransmission() == 0)
 	return false;
 
+    waitForReadings();
+    readMeasurement();
+    triggerMeasurement();	// trigger the next measurement
+
+    return true;		// FIXME
+}
+
+uint16_t
+rak1906::startMeasurement()
+{
+    triggerMeasurement();	// start a single forced measurement
+    return measurementDuration();
+}
+
+uint16_t
+rak1906::startMeasurementNoGas()
+{
+    uint8_t         gasControl1 = shadow(RAK1906_CONTROL_GAS_REGISTER1);
+    uint8_t         gasControl2 = shadow(RAK1906_CONTROL_GAS_REGISTER2);
+    uint16_t        gasMillis = _gasMillis;
+    writeShadow(RAK1906_CONTROL_GAS_REGISTER1, gasControl1 | 0x08);	// heater 
+									// off
+    writeShadow(RAK1906_CONTROL_GAS_REGISTER2, gasControl2 & 0xEF);	// no gas 
+									// conversion
+    _gasMillis = 0;
+    triggerMeasurement();
+    uint16_t        duration = measurementDuration();
+    // Restore the gas settings, they are written with the next trigger
+    writeShadow(RAK1906_CONTROL_GAS_REGISTER1, gasControl1);
+    writeShadow(RAK1906_CONTROL_GAS_REGISTER2, gasControl2);
+    _gasMillis = gasMillis;
+    return duration;
+}
+
+bool
+rak1906::collect()
+{
+    if (measuring())		// conversion not finished yet
+	return false;
+    readMeasurement();
+    return true;
+}
+
+uint16_t
+rak1906::measurementDuration() const
+{
+    // Measurement cycles per oversampling setting, index is the
+    // oversamplingTypes value
+    const uint8_t   osToMeasCycles[UnknownOversample] =
+	{ 0, 1, 2, 4, 8, 16 };
+    uint32_t        measCycles = osToMeasCycles[_osTemperature] +
+	osToMeasCycles[_osPressure] + osToMeasCycles[_osHumidity];
+    uint32_t        duration = measCycles * UINT32_C(1963);	// us per
+								// conversion 
+								// cycle
+    duration += UINT32_C(477) * 4;	// TPH switching duration
+    duration += UINT32_C(477) * 5;	// gas measurement duration
+    duration += UINT32_C(500);	// round up
+    duration /= UINT32_C(1000);	// convert to ms
+    duration += 1;		// wake up duration of 1 ms
+    duration += _gasMillis;	// gas heater duration, 0 if off
+    return (uint16_t) duration;
+}
+
+void
+rak1906::readMeasurement()
+{
     const uint32_t  lookupTable1[16] = {
 	UINT32_C(2147483647), UINT32_C(2147483647), UINT32_C(2147483647),
 	    UINT32_C(2147483647),
@@ -81,7 +176,6 @@ rak1906::update()
                     adc_pres;	// Raw ADC temperature and pressure
     uint16_t        adc_hum,
                     adc_gas_res;	// Raw ADC humidity and gas
-    waitForReadings();
     getData(RAK1906_STATUS_REGISTER, buff);	// read all 15 bytes in
 						// one go
     adc_pres = (uint32_t) (((uint32_t) buff[2] << 12) | ((uint32_t) buff[3] << 4) | ((uint32_t) buff[4] >> 4));	// put 
@@ -186,14 +280,13 @@ rak1906::update()
 	 var1);
     var3 = (((int64_t) lookupTable2[gas_range] * (int64_t) var1) >> 9);
     _Gas = (uint32_t) ((var3 + ((int64_t) uvar2 >> 1)) / (int64_t) uvar2);
-    triggerMeasurement();	// trigger the next measurement
 
     tmpTemperature = _Temperature;
     tmpHumidity = _Humidity;
     tmpPressure = _Pressure;
-    tmpGas = _Gas;
-
-    return true;		// FIXME
+    if (buff[14] & 0x20)	// gas_valid_r, keep the last value if
+				// the heater was off
+	tmpGas = _Gas;
 }
 
 float
@@ -220,6 +313,30 @@ rak1906::gas()
     return (float) tmpGas / 100;
 }
 
+int32_t
+rak1906::temperatureCenti() const
+{
+    return tmpTemperature;	// compensation result is in 0.01 degC
+}
+
+int32_t
+rak1906::humidityMilli() const
+{
+    return tmpHumidity;		// compensation result is in 0.001 %RH
+}
+
+int32_t
+rak1906::pressurePa() const
+{
+    return tmpPressure;		// compensation result is in Pa
+}
+
+uint32_t
+rak1906::gasOhm() const
+{
+    return (uint32_t) tmpGas;	// compensation result is in Ohm
+}
+
 
 uint8_t
 rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
@@ -239,11 +356,10 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
     }
     uint8_t         tempRegister;	// Temporary register variable
     uint8_t         returnValue = sampling;	// Return sampling value
-    waitForReadings();		// Ensure any active reading is finished
     switch (sensor) {		// Depending upon which sensor is chosen
     case HumiditySensor:	// Set the humidity oversampling
 	{
-	    tempRegister = readByte(RAK1906_CONTROL_HUMIDITY_REGISTER);	// Read 
+	    tempRegister = shadow(RAK1906_CONTROL_HUMIDITY_REGISTER);	// Read 
 									// the 
 									// register 
 									// contents
@@ -257,7 +373,8 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 		tempRegister &= RAK1906_HUMIDITY_MASK;	// Mask bits to 0
 		tempRegister |= sampling;	// Add in the sampling
 						// bits
-		putData(RAK1906_CONTROL_HUMIDITY_REGISTER, (uint8_t) tempRegister);	// Update 
+		writeShadow(RAK1906_CONTROL_HUMIDITY_REGISTER, tempRegister);	// Update 
+		_osHumidity = sampling;
 											// humidity 
 											// bits 
 											// 0:2
@@ -267,7 +384,7 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 	}			// of HumiditySensor
     case PressureSensor:	// Set the pressure oversampling
 	{
-	    tempRegister = readByte(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
+	    tempRegister = shadow(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
 									// the 
 									// register 
 									// contents
@@ -280,7 +397,8 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 		tempRegister &= RAK1906_PRESSURE_MASK;	// Mask bits to 0
 		tempRegister |= (sampling << 2);	// Add in sampling 
 							// bits at offset
-		putData(RAK1906_CONTROL_MEASURE_REGISTER, (uint8_t) tempRegister);	// Update 
+		writeShadow(RAK1906_CONTROL_MEASURE_REGISTER, tempRegister);	// Update 
+		_osPressure = sampling;
 											// register
 	    }			// if-then return current value or set new 
 				// value
@@ -288,7 +406,7 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 	}			// of PressureSensor
     case TemperatureSensor:	// Set the temperature oversampling
 	{
-	    tempRegister = readByte(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
+	    tempRegister = shadow(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
 									// the 
 									// register 
 									// contents
@@ -304,7 +422,8 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 		tempRegister |= (sampling << 5);	// Add in the
 							// sampling bits
 							// at offset
-		putData(RAK1906_CONTROL_MEASURE_REGISTER, (uint8_t) tempRegister);	// Update 
+		writeShadow(RAK1906_CONTROL_MEASURE_REGISTER, tempRegister);	// Update 
+		_osTemperature = sampling;
 											// humidity 
 											// bits 
 											// 5:7
@@ -320,10 +439,9 @@ rak1906::setOversampling(const uint8_t sensor, const uint8_t sampling)
 }
 
 uint8_t
-rak1906::setIIRFilter(const uint8_t iirFilterSetting) const
+rak1906::setIIRFilter(const uint8_t iirFilterSetting)
 {
-    waitForReadings();		// Ensure any active reading is finished
-    uint8_t         returnValue = readByte(RAK1906_CONFIG_REGISTER);	// Get 
+    uint8_t         returnValue = shadow(RAK1906_CONFIG_REGISTER);	// Get 
 									// control 
 									// register 
 									// byte 
@@ -333,7 +451,7 @@ rak1906::setIIRFilter(const uint8_t iirFilterSetting) const
 	returnValue = returnValue & 0xE3;	// mask IIR bits
 	returnValue |= (iirFilterSetting & 0x07) << 2;	// use 3 bits of
 							// iirFilterSetting
-	putData(RAK1906_CONFIG_REGISTER, returnValue);	// Write new
+	writeShadow(RAK1906_CONFIG_REGISTER, returnValue);	// Write new
 							// control
 							// register value
     }				// if the value is to be changed //
@@ -344,23 +462,24 @@ rak1906::setIIRFilter(const uint8_t iirFilterSetting) const
 }
 
 bool
-rak1906::setGas(uint16_t GasTemp, uint16_t GasMillis) const
+rak1906::setGas(uint16_t GasTemp, uint16_t GasMillis)
 {
-    uint8_t         gasRegister = readByte(RAK1906_CONTROL_GAS_REGISTER2);	// Read 
+    uint8_t         gasRegister = shadow(RAK1906_CONTROL_GAS_REGISTER2);	// Read 
 										// current 
 										// register 
 										// values
     if (GasTemp == 0 || GasMillis == 0) {
 	// If either input variable is zero //
-	putData(RAK1906_CONTROL_GAS_REGISTER1, (uint8_t) 0x08);	// Turn
+	writeShadow(RAK1906_CONTROL_GAS_REGISTER1, 0x08);	// Turn
 								// off gas 
 								// heater
-	putData(RAK1906_CONTROL_GAS_REGISTER2, (uint8_t) (gasRegister & 0xEF));	// Turn 
+	writeShadow(RAK1906_CONTROL_GAS_REGISTER2, gasRegister & 0xEF);	// Turn 
 										// off 
 										// gas 
 										// measurements
+	_gasMillis = 0;		// no heater phase in the conversion
     } else {
-	putData(RAK1906_CONTROL_GAS_REGISTER1, (uint8_t) 0);	// Turn
+	writeShadow(RAK1906_CONTROL_GAS_REGISTER1, 0);	// Turn
 								// off
 								// heater
 								// bit to
@@ -385,7 +504,11 @@ rak1906::setGas(uint16_t GasTemp, uint16_t GasMillis) const
 	var5 = (131 * _res_heat) + 65536;
 	heatr_res_x100 = (int32_t) (((var4 / var5) - 250) * 34);
 	heatr_res = (uint8_t) ((heatr_res_x100 + 50) / 100);
-	putData(RAK1906_GAS_HEATER_REGISTER0, heatr_res);
+	writeShadow(RAK1906_GAS_HEATER_REGISTER0, heatr_res);
+	_gasMillis = (GasMillis >= 0xfc0) ? 0xfc0 : GasMillis;	// heater
+								// phase 
+								// of the 
+								// conversion
 	uint8_t         factor = 0;
 	uint8_t         durval;
 	if (GasMillis >= 0xfc0)
@@ -397,13 +520,12 @@ rak1906::setGas(uint16_t GasTemp, uint16_t GasMillis) const
 	    }			// of while loop
 	    durval = (uint8_t) (GasMillis + (factor * 64));
 	}			// of if-then-else duration exceeds max
-	putData(RAK1906_CONTROL_GAS_REGISTER1, (uint8_t) 0);	// then
+	writeShadow(RAK1906_CONTROL_GAS_REGISTER1, 0);	// then
 								// turn
 								// off gas 
 								// heater
-	putData(RAK1906_GAS_DURATION_REGISTER0, durval);
-	putData(RAK1906_CONTROL_GAS_REGISTER2,
-		(uint8_t) (gasRegister | 0x10));
+	writeShadow(RAK1906_GAS_DURATION_REGISTER0, durval);
+	writeShadow(RAK1906_CONTROL_GAS_REGISTER2, gasRegister | 0x10);
     }				// of if-then-else turn gas measurements
 				// on or off
     return true;
@@ -520,6 +642,75 @@ rak1906::getCalibration()
     _rng_sw_err = ((int8_t) temp_var & (int8_t) RAK1906_RSERROR_MSK) / 16;
 }
 
+bool
+rak1906::calibrationFromCache() const
+{
+    return _calibFromCache;
+}				// of method "calibrationFromCache()"
+
+void
+rak1906::getCalibrationData(rak1906_calib_t & calib) const
+{
+    calib.chipId = _chipId;
+    calib.H6 = _H6;
+    calib.P10 = _P10;
+    calib.resHeatRange = _res_heat_range;
+    calib.H3 = _H3;
+    calib.H4 = _H4;
+    calib.H5 = _H5;
+    calib.H7 = _H7;
+    calib.G1 = _G1;
+    calib.G3 = _G3;
+    calib.T3 = _T3;
+    calib.P3 = _P3;
+    calib.P6 = _P6;
+    calib.P7 = _P7;
+    calib.resHeat = _res_heat;
+    calib.rngSwErr = _rng_sw_err;
+    calib.H1 = _H1;
+    calib.H2 = _H2;
+    calib.T1 = _T1;
+    calib.P1 = _P1;
+    calib.G2 = _G2;
+    calib.T2 = _T2;
+    calib.P2 = _P2;
+    calib.P4 = _P4;
+    calib.P5 = _P5;
+    calib.P8 = _P8;
+    calib.P9 = _P9;
+}				// of method "getCalibrationData()"
+
+void
+rak1906::setCalibrationData(const rak1906_calib_t & calib)
+{
+    _H6 = calib.H6;
+    _P10 = calib.P10;
+    _res_heat_range = calib.resHeatRange;
+    _H3 = calib.H3;
+    _H4 = calib.H4;
+    _H5 = calib.H5;
+    _H7 = calib.H7;
+    _G1 = calib.G1;
+    _G3 = calib.G3;
+    _T3 = calib.T3;
+    _P3 = calib.P3;
+    _P6 = calib.P6;
+    _P7 = calib.P7;
+    _res_heat = calib.resHeat;
+    _rng_sw_err = calib.rngSwErr;
+    _H1 = calib.H1;
+    _H2 = calib.H2;
+    _T1 = calib.T1;
+    _P1 = calib.P1;
+    _G2 = calib.G2;
+    _T2 = calib.T2;
+    _P2 = calib.P2;
+    _P4 = calib.P4;
+    _P5 = calib.P5;
+    _P8 = calib.P8;
+    _P9 = calib.P9;
+}				// of method "setCalibrationData()"
+
 void
 rak1906::waitForReadings() const
 {
@@ -540,15 +731,92 @@ rak1906::measuring() const
 }				// of method "measuring()"
 
 void
-rak1906::triggerMeasurement() const
+rak1906::triggerMeasurement()
 {
-    uint8_t         workRegister = readByte(RAK1906_CONTROL_MEASURE_REGISTER);	// Read 
-										// the 
-										// control 
-										// measure
-    putData(RAK1906_CONTROL_MEASURE_REGISTER, (uint8_t) (workRegister | 1));	// Trigger 
-										// start 
-										// of 
-										// next 
-										// measurement
+    writeBurst(true);		// Write changed settings and set forced
+				// mode in one transaction
 }				// of method "triggerMeasurement()"
+
+bool
+rak1906::flushConfig()
+{
+    return writeBurst(false);
+}				// of method "flushConfig()"
+
+uint32_t
+rak1906::i2cTransactions() const
+{
+    return _i2cCount;
+}				// of method "i2cTransactions()"
+
+void
+rak1906::resetI2cTransactions()
+{
+    _i2cCount = 0;
+}				// of method "resetI2cTransactions()"
+
+uint8_t &
+rak1906::shadow(const uint8_t addr)
+{
+    if (addr == RAK1906_GAS_HEATER_REGISTER0)
+	return _heaterShadow;
+    if (addr == RAK1906_GAS_DURATION_REGISTER0)
+	return _durationShadow;
+    return _ctrlShadow[addr - RAK1906_SHADOW_FIRST_REGISTER];	// 0x70 
+								// ... 
+								// 0x75
+}				// of method "shadow()"
+
+void
+rak1906::writeShadow(const uint8_t addr, const uint8_t value)
+{
+    uint8_t         bit;	// Dirty flag of the register
+    if (addr == RAK1906_GAS_HEATER_REGISTER0)
+	bit = 6;
+    else if (addr == RAK1906_GAS_DURATION_REGISTER0)
+	bit = 7;
+    else
+	bit = addr - RAK1906_SHADOW_FIRST_REGISTER;
+    if (shadow(addr) != value) {	// Only changed registers go to the 
+					// sensor
+	shadow(addr) = value;
+	_dirtyMask |= _BV(bit);
+    }
+}				// of method "writeShadow()"
+
+bool
+rak1906::writeBurst(bool trigger)
+{
+    // Write order, ctrl_meas must be last, it applies ctrl_hum and
+    // starts the conversion
+    const uint8_t   writeOrder[7] = {
+	RAK1906_GAS_HEATER_REGISTER0, RAK1906_GAS_DURATION_REGISTER0,
+	RAK1906_CONTROL_GAS_REGISTER1, RAK1906_CONTROL_GAS_REGISTER2,
+	RAK1906_CONTROL_HUMIDITY_REGISTER, RAK1906_CONFIG_REGISTER,
+	RAK1906_CONTROL_MEASURE_REGISTER
+    };
+    const uint8_t   dirtyBit[7] = { 6, 7, 0, 1, 2, 5, 4 };
+    if (_dirtyMask & _BV(2))	// ctrl_hum only takes effect after a
+				// write to ctrl_meas
+	_dirtyMask |= _BV(4);
+    if (trigger)
+	_dirtyMask |= _BV(4);
+    if (_dirtyMask == 0)	// Nothing to write
+	return true;
+
+    Wire.beginTransmission(RAK1906_ADDRESS);	// Register/value pairs
+						// in one burst
+    for (uint8_t i = 0; i < sizeof(writeOrder); i++) {
+	if ((_dirtyMask & _BV(dirtyBit[i])) == 0)
+	    continue;
+	uint8_t         value = shadow(writeOrder[i]);
+	if (trigger && (writeOrder[i] == RAK1906_CONTROL_MEASURE_REGISTER))
+	    value |= 1;		// Forced mode, sensor returns to sleep
+				// mode after the conversion
+	Wire.write(writeOrder[i]);
+	Wire.write(value);
+    }
+    _i2cCount++;
+    _dirtyMask = 0;
+    return (Wire.endTransmission() == 0);
+}				// of method "writeBurst()"
@@ -35,6 +35,8 @@ typedef enum
   RAK1906_CONTROL_MEASURE_REGISTER = 0x74, // /< Temp, Pressure
                                            // control register
   RAK1906_CONFIG_REGISTER = 0x75,     // /< Configuration register
+  RAK1906_SHADOW_FIRST_REGISTER = 0x70, // /< First control register
+                                        // held in the shadow copy
   RAK1906_CHIPID_REGISTER = 0xD0,     // /< Chip-Id register
   RAK1906_SOFTRESET_REGISTER = 0xE0,  // /< Reset when 0xB6 is written
                                       // here
@@ -140,6 +142,38 @@ enum oversamplingTypes
   UnknownOversample
 };
 
+/** Parsed calibration coefficients, can be stored to skip reading them on boot */
+typedef struct
+{
+  uint8_t chipId;       // /< Chip ID of the sensor
+  uint8_t H6,
+      P10,
+      resHeatRange;
+  int8_t H3,
+      H4,
+      H5,
+      H7,
+      G1,
+      G3,
+      T3,
+      P3,
+      P6,
+      P7,
+      resHeat,
+      rngSwErr;
+  uint16_t H1,
+      H2,
+      T1,
+      P1;
+  int16_t G2,
+      T2,
+      P2,
+      P4,
+      P5,
+      P8,
+      P9;
+} rak1906_calib_t;
+
 class rak1906
 {
 public:
@@ -159,6 +193,28 @@ public:
    */
   bool init(void);
 
+  /**@brief	Same as init(), but uses stored calibration coefficients if they belong
+   * 	to the connected sensor (same chip ID and T1 coefficient). Otherwise the
+   * 	coefficients are read from the sensor
+   *
+   * @param cached	Stored calibration coefficients, NULL to read them from the sensor
+   * @return bool		True if successfully query and identify RAK1906 module.
+   * 			FALSE if RAK1906 init failed
+   */
+  bool init(const rak1906_calib_t *cached);
+
+  /**@brief	This function returns true if init() used the stored calibration
+   *
+   * @return bool
+   */
+  bool calibrationFromCache(void) const;
+
+  /**@brief	This function copies the calibration coefficients in use
+   *
+   * @param calib	Structure to fill
+   */
+  void getCalibrationData(rak1906_calib_t &calib) const;
+
   /**@brief	This function will trigger the RAK1906 to update the Environment values,
    * 	after the values are updated theRAK1906 will go back to power saving mode
    *
@@ -166,6 +222,33 @@ public:
    */
   bool update(void);
 
+  /**@brief	This function triggers a single forced measurement and returns immediately.
+   * 	The results are read with collect() after the returned time has passed
+   *
+   * @return uint16_t		Expected conversion time in milliseconds
+   */
+  uint16_t startMeasurement(void);
+
+  /**@brief	This function triggers a single forced measurement of temperature, humidity and pressure only.
+   * 	The gas heater stays off, the gas settings are restored for the next startMeasurement()
+   *
+   * @return uint16_t		Expected conversion time in milliseconds
+   */
+  uint16_t startMeasurementNoGas(void);
+
+  /**@brief	This function reads the results of a measurement started with startMeasurement()
+   *
+   * @return bool		True if values updated successfully. FALSE if the conversion is still running
+   */
+  bool collect(void);
+
+  /**@brief	This function calculates the conversion time of one forced measurement
+   * 	from the configured oversampling and gas heater duration (BME680 datasheet)
+   *
+   * @return uint16_t		Conversion time in milliseconds
+   */
+  uint16_t measurementDuration(void) const;
+
   /**@brief	This function will trigger the RAK1906 to return the latest TEMPERATURE value
    *
    * @return float
@@ -189,8 +272,39 @@ public:
    * @return float
    */
   float gas(void);
+
+  /**@brief	This function returns the latest TEMPERATURE value without float conversion
+   *
+   * @return int32_t		Temperature in 0.01 degree Celsius
+   */
+  int32_t temperatureCenti(void) const;
+
+  /**@brief	This function returns the latest HUMIDITY value without float conversion
+   *
+   * @return int32_t		Humidity in 0.001 %RH
+   */
+  int32_t humidityMilli(void) const;
+
+  /**@brief	This function returns the latest AIR PRESSURE value without float conversion
+   *
+   * @return int32_t		Pressure in Pa
+   */
+  int32_t pressurePa(void) const;
+
+  /**@brief	This function returns the latest GAS resistance without float conversion
+   * 	The integer compensation has 1 Ohm resolution, a milli Ohm value would only
+   * 	add zeros and overflow uint32_t above 4.29 MOhm
+   *
+   * @return uint32_t		Gas resistance in Ohm
+   */
+  uint32_t gasOhm(void) const;
   /**@}*/
 
+  /**@brief	The configuration setters below only change a shadow copy of the
+   * 	control and heater registers. Changed registers are written to the sensor
+   * 	in one burst by flushConfig() or by the next startMeasurement() / update()
+   */
+
   /**@brief	This function sets the oversampling rate for the sensor types
    * @var sensor Sensor type TemperatureSensor, HumiditySensor, PressureSensor
    * @var oversampling IIR filter to IIROff, IIR2, IIR4, IIR8, IIR16, IIR32, IIR64 or IIR128
@@ -202,14 +316,30 @@ public:
    * @var iirFilterSetting IIR filter to IIROff, IIR2, IIR4, IIR8, IIR16, IIR32, IIR64 or IIR128
    * @return uint8_t
    */
-  uint8_t setIIRFilter(const uint8_t iirFilterSetting = UINT8_MAX) const; // Set IIR Filter
+  uint8_t setIIRFilter(const uint8_t iirFilterSetting = UINT8_MAX); // Set IIR Filter
 
   /**@brief	This function sets gas sensor temperature and heating time
    * @var GasTemp Temperature in degree
    * @var GasMillis Heating time in milliseconds
    * @return bool
    */
-  bool setGas(uint16_t GasTemp, uint16_t GasMillis) const; // Gas heating temperature and time
+  bool setGas(uint16_t GasTemp, uint16_t GasMillis); // Gas heating temperature and time
+
+  /**@brief	This function writes all changed configuration registers in a single
+   * 	I2C burst write. Must not be called while a conversion is running
+   * @return bool		True if the write was acknowledged
+   */
+  bool flushConfig(void);
+
+  /**@brief	This function returns the number of I2C transactions since init()
+   * 	or the last resetI2cTransactions()
+   * @return uint32_t
+   */
+  uint32_t i2cTransactions(void) const;
+
+  /**@brief	This function resets the I2C transaction counter
+   */
+  void resetI2cTransactions(void);
 
   int32_t tmpTemperature,
       tmpHumidity,
@@ -225,11 +355,31 @@ private:
   uint8_t readByte(const uint8_t) const;
   void getCalibration(); // /< Load calibration from
                          // registers
+  void setCalibrationData(const rak1906_calib_t &calib);
   float altitude(const int32_t press, const float seaLevel =
                                           1013.25);
   bool measuring() const;          // /< true if currently measuring
-  void triggerMeasurement() const; // /< trigger a
+  void triggerMeasurement();       // /< trigger a
                                    // measurement
+  void readMeasurement();          // /< read and compensate
+                                   // the results
+
+  uint8_t _osTemperature,
+      _osHumidity,
+      _osPressure;
+  uint16_t _gasMillis;
+
+  bool writeBurst(bool trigger);   // /< write dirty registers
+  void writeShadow(const uint8_t addr, const uint8_t value);
+  uint8_t &shadow(const uint8_t addr);
+
+  uint8_t _ctrlShadow[6],          // /< 0x70 ... 0x75
+      _heaterShadow,               // /< res_heat_0 0x5A
+      _durationShadow,             // /< gas_wait_0 0x64
+      _dirtyMask;                  // /< registers to write
+  mutable uint32_t _i2cCount;      // /< I2C transactions
+  uint8_t _chipId;                 // /< Chip ID read at init
+  bool _calibFromCache;            // /< Calibration was not read
 
   uint8_t _H6,
       _P10,
@@ -273,6 +423,7 @@ private:
     Wire.write(addr);                             // Send register address to read
     Wire.endTransmission();                       // Close transmission
     Wire.requestFrom(RAK1906_ADDRESS, sizeof(T)); // Request 1 byte of data
+    _i2cCount += 2;                               // Address write + read
     structSize = Wire.available();                // Use the actual number of bytes
     for (uint8_t i = 0; i < structSize; i++)
       *bytePtr++ = Wire.read(); // loop for each byte to be read
@@ -289,6 +440,7 @@ private:
     for (uint8_t i = 0; i < sizeof(T); i++)
       Wire.write(*bytePtr++); // loop for each byte to be written
     Wire.endTransmission();   // Close transmission
+    _i2cCount++;
     return (structSize);
   }
 };
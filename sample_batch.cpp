@@ -0,0 +1,240 @@
+/**
+ * @file sample_batch.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Several sampling rounds in one uplink
+ *        If g_batch_samples is > 1 the samples of each TX slot
+ *        are collected and sent together on BATCH_FPORT:
+ *
+ *        Header
+ *          format       1 byte  BATCH_FORMAT
+ *          age          3 bytes seconds since the first sample MSB
+ *          count        1 byte  number of samples
+ *          channels     2 bytes bitmap of the channels that follow MSB
+ *          offsets      count - 1 varints, seconds from the previous
+ *                       sample, 7 bits per byte, lowest bits first,
+ *                       bit 7 set if another byte follows
+ *        Per channel in the bitmap, lowest bit first, see SF_CH_xxx
+ *          first value  1 or 2 bytes MSB, same resolution as the LPP payload
+ *          count - 1 deltas to the previous value, 1 byte signed,
+ *          BATCH_DELTA_ESCAPE is followed by the full value
+ *
+ *        A channel is only sent if it is valid in all samples.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Sampling rounds per uplink, 1 = batching off */
+uint8_t g_batch_samples = 1;
+
+/** Collected sampling rounds */
+static sf_record_t batch_samples[BATCH_MAX_SAMPLES];
+/** Number of collected sampling rounds */
+static uint8_t batch_samples_count = 0;
+
+/** Encoded batch, large enough for the worst case of all deltas escaped */
+static uint8_t batch_buffer[BATCH_HEADER_SIZE + BATCH_OFFSET_MAX_SIZE * (BATCH_MAX_SAMPLES - 1) + SF_CHANNELS * 3 * BATCH_MAX_SAMPLES];
+
+/** Size of the values in bytes, index is the bit in the channel bitmap */
+static const uint8_t batch_width[SF_CHANNELS] = {
+	2, // RAK1906 temperature 0.1 °C signed
+	1, // RAK1906 humidity 0.5 %RH
+	2, // RAK1906 pressure 0.1 hPa
+	2, // RAK1906 gas resistance 0.01 kOhm
+	2, // RAK12037 CO2 ppm
+	2, // RAK12037 temperature 0.1 °C signed
+	1, // RAK12037 humidity 0.5 %RH
+	2, // RAK12047 VOC index
+	2, // Battery 0.01 V
+};
+
+/**
+ * @brief Max application payload for the current region and data rate
+ *        LoRaWAN Regional Parameters RP002, for AS923 the smaller value
+ *        of dwell time on and off
+ *
+ * @return uint8_t max payload size in bytes
+ */
+uint8_t max_payload_size(void)
+{
+	uint8_t data_rate = api.lorawan.dr.get();
+	switch (api.lorawan.band.get())
+	{
+	case RAK_REGION_US915:
+	{
+		static const uint8_t us915_size[] = {11, 53, 125, 242, 242};
+		return data_rate < sizeof(us915_size) ? us915_size[data_rate] : 11;
+	}
+	case RAK_REGION_AS923:
+	case RAK_REGION_AS923_2:
+	case RAK_REGION_AS923_3:
+	case RAK_REGION_AS923_4:
+	{
+		static const uint8_t as923_size[] = {51, 51, 11, 53, 125, 222, 222, 222};
+		return data_rate < sizeof(as923_size) ? as923_size[data_rate] : 11;
+	}
+	default:
+	{
+		// EU868, EU433, CN470, RU864, IN865, KR920 and AU915 DR0 to DR6
+		static const uint8_t eu868_size[] = {51, 51, 51, 115, 222, 222, 222, 222};
+		return data_rate < sizeof(eu868_size) ? eu868_size[data_rate] : 51;
+	}
+	}
+}
+
+/**
+ * @brief Add the values of a TX slot to the batch
+ *        If the batch is full the oldest sample is moved to the queue
+ *
+ * @param values sensor values of the TX slot
+ * @param battery battery voltage in V
+ */
+void batch_add(const sensor_snapshot_t &values, float battery)
+{
+	if (batch_samples_count == BATCH_MAX_SAMPLES)
+	{
+		sf_push_record(batch_samples[0]);
+		batch_release(1);
+	}
+	sf_make_record(batch_samples[batch_samples_count], values, battery);
+	batch_samples_count++;
+}
+
+/**
+ * @brief Get the number of collected samples
+ *
+ * @return uint8_t collected samples
+ */
+uint8_t batch_count(void)
+{
+	return batch_samples_count;
+}
+
+/**
+ * @brief Encode the oldest samples into the batch format
+ *
+ * @param count number of samples to encode
+ * @return uint16_t size of the payload, get it with batch_payload()
+ */
+uint16_t batch_encode(uint8_t count)
+{
+	if (count > batch_samples_count)
+	{
+		count = batch_samples_count;
+	}
+	if (count == 0)
+	{
+		return 0;
+	}
+
+	uint16_t channels = 0xFFFF;
+	for (uint8_t idx = 0; idx < count; idx++)
+	{
+		channels &= sf_record_channels(batch_samples[idx]);
+	}
+
+	uint32_t now = millis();
+	uint32_t age = (now - batch_samples[0].timestamp) / 1000;
+	if (age > 0xFFFFFF)
+	{
+		age = 0xFFFFFF;
+	}
+
+	uint16_t size = 0;
+	batch_buffer[size++] = BATCH_FORMAT;
+	batch_buffer[size++] = (uint8_t)(age >> 16);
+	batch_buffer[size++] = (uint8_t)(age >> 8);
+	batch_buffer[size++] = (uint8_t)(age);
+	batch_buffer[size++] = count;
+	batch_buffer[size++] = (uint8_t)(channels >> 8);
+	batch_buffer[size++] = (uint8_t)(channels);
+
+	// Time of each sample, missed or late TX slots keep their real time
+	uint32_t last_time = 0;
+	for (uint8_t idx = 1; idx < count; idx++)
+	{
+		// Rounded from the first sample, the rounding errors do not add up
+		uint32_t sample_time = (batch_samples[idx].timestamp - batch_samples[0].timestamp + 500) / 1000;
+		uint32_t offset = sample_time - last_time;
+		last_time = sample_time;
+		while (offset >= 0x80)
+		{
+			batch_buffer[size++] = (uint8_t)(offset | 0x80);
+			offset >>= 7;
+		}
+		batch_buffer[size++] = (uint8_t)offset;
+	}
+
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if ((channels & (1 << channel)) == 0)
+		{
+			continue;
+		}
+		int32_t last_value = 0;
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			int32_t value = sf_record_value(batch_samples[idx], channel);
+			int32_t delta = value - last_value;
+			if (idx != 0)
+			{
+				if ((delta >= -127) && (delta <= 127))
+				{
+					batch_buffer[size++] = (uint8_t)(int8_t)delta;
+					last_value = value;
+					continue;
+				}
+				batch_buffer[size++] = BATCH_DELTA_ESCAPE;
+			}
+			if (batch_width[channel] == 2)
+			{
+				batch_buffer[size++] = (uint8_t)(value >> 8);
+			}
+			batch_buffer[size++] = (uint8_t)(value);
+			last_value = value;
+		}
+	}
+	return size;
+}
+
+/**
+ * @brief Get the payload encoded by batch_encode()
+ *
+ * @return uint8_t* payload
+ */
+uint8_t *batch_payload(void)
+{
+	return batch_buffer;
+}
+
+/**
+ * @brief Remove the oldest samples after they were sent
+ *
+ * @param count number of samples to remove
+ */
+void batch_release(uint8_t count)
+{
+	if (count > batch_samples_count)
+	{
+		count = batch_samples_count;
+	}
+	batch_samples_count -= count;
+	memmove(&batch_samples[0], &batch_samples[count], batch_samples_count * sizeof(sf_record_t));
+}
+
+/**
+ * @brief Move all collected samples to the queue of unsent samples
+ *        Used if the batch uplink failed or batching is switched off
+ *
+ */
+void batch_to_queue(void)
+{
+	for (uint8_t idx = 0; idx < batch_samples_count; idx++)
+	{
+		sf_push_record(batch_samples[idx]);
+	}
+	batch_samples_count = 0;
+}
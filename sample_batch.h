@@ -0,0 +1,42 @@
+/**
+ * @file sample_batch.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Several sampling rounds in one uplink
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SAMPLE_BATCH_H
+#define SAMPLE_BATCH_H
+
+#include <Arduino.h>
+
+/** Max number of sampling rounds in one uplink */
+#ifndef BATCH_MAX_SAMPLES
+#define BATCH_MAX_SAMPLES 16
+#endif
+
+/** fPort of the batched uplinks */
+#define BATCH_FPORT 4
+/** Version of the batch format, first byte of the payload */
+#define BATCH_FORMAT 2
+/** Format, age of the first sample (3), count, channel bitmap (2), without the time offsets */
+#define BATCH_HEADER_SIZE 7
+/** Max size of a time offset, 7 bits per byte */
+#define BATCH_OFFSET_MAX_SIZE 5
+/** Delta that marks a full value */
+#define BATCH_DELTA_ESCAPE 0x80
+
+extern uint8_t g_batch_samples;
+
+uint8_t max_payload_size(void);
+void batch_add(const sensor_snapshot_t &values, float battery);
+uint8_t batch_count(void);
+uint16_t batch_encode(uint8_t count);
+uint8_t *batch_payload(void);
+void batch_release(uint8_t count);
+void batch_to_queue(void);
+
+#endif // SAMPLE_BATCH_H
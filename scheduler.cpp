@@ -0,0 +1,214 @@
+/**
+ * @file scheduler.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Software timers for all periodic and one-shot jobs
+ *        Only RAK_TIMER_0 is used, it is armed for the next
+ *        due job and wakes up the MCU. The jobs are run from
+ *        loop(). Jobs that are due within their slack time of
+ *        a wakeup are run together with it, so the MCU wakes
+ *        up once for several jobs.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Job settings and state */
+struct sched_job_s
+{
+	void (*handler)(void *) = NULL; // Job function
+	uint32_t due = 0;				// millis() when the job is due
+	uint32_t period = 0;			// Repeat time in ms, 0 = one-shot
+	uint16_t slack = 0;				// Time in ms the job may run before it is due
+	bool active = false;			// Flag if the job is scheduled
+};
+
+/** List of jobs, the index is the sched_job_id_t */
+static sched_job_s sched_jobs[SCHED_NUM_JOBS];
+
+/** millis() when the running job was due */
+static uint32_t sched_current_due = 0;
+
+/** Start of the current hour for the wakeup counter */
+static uint32_t sched_hour_start = 0;
+/** Wakeups in the current hour */
+static uint32_t sched_hour_wakeups = 0;
+/** Wakeups in the last complete hour */
+static uint32_t sched_last_hour_wakeups = 0;
+
+/**
+ * @brief Timer callback, only wakes up the MCU
+ *        The due jobs are run by sched_run() from loop()
+ *
+ */
+static void sched_timer_handler(void *)
+{
+}
+
+/**
+ * @brief Setup the scheduler timer
+ *        Must be called before any job is created
+ *
+ */
+void sched_init(void)
+{
+	api.system.timer.create(RAK_TIMER_0, sched_timer_handler, RAK_TIMER_ONESHOT);
+	sched_hour_start = millis();
+}
+
+/**
+ * @brief Setup a job
+ *
+ * @param job_id job from sched_job_id_t
+ * @param handler function called when the job is due
+ * @param slack time in ms the job may run before it is due
+ */
+void sched_create(uint8_t job_id, void (*handler)(void *), uint16_t slack)
+{
+	sched_jobs[job_id].handler = handler;
+	sched_jobs[job_id].slack = slack;
+	sched_jobs[job_id].active = false;
+}
+
+/**
+ * @brief Start or restart a job
+ *
+ * @param job_id job from sched_job_id_t
+ * @param delay time in ms until the job is due
+ * @param period repeat time in ms, 0 for a one-shot job
+ */
+void sched_start(uint8_t job_id, uint32_t delay, uint32_t period)
+{
+	sched_jobs[job_id].due = millis() + delay;
+	sched_jobs[job_id].period = period;
+	sched_jobs[job_id].active = true;
+}
+
+/**
+ * @brief Stop a job
+ *
+ * @param job_id job from sched_job_id_t
+ */
+void sched_stop(uint8_t job_id)
+{
+	sched_jobs[job_id].active = false;
+}
+
+/**
+ * @brief Check if a job is scheduled
+ *
+ * @param job_id job from sched_job_id_t
+ * @return true if the job is scheduled
+ * @return false if the job is stopped or a finished one-shot job
+ */
+bool sched_active(uint8_t job_id)
+{
+	return sched_jobs[job_id].active;
+}
+
+/**
+ * @brief Run all jobs that are due or within their slack time
+ *        and arm the timer for the next job
+ *        Called from loop() before the MCU goes to sleep
+ *
+ * @return uint32_t time in ms until the next job, SCHED_IDLE if no job is active
+ */
+uint32_t sched_run(void)
+{
+	bool woke_up = false;
+	bool job_run;
+
+	// Jobs can start other jobs, repeat until nothing is due
+	do
+	{
+		job_run = false;
+		for (uint8_t idx = 0; idx < SCHED_NUM_JOBS; idx++)
+		{
+			sched_job_s &job = sched_jobs[idx];
+			uint32_t now = millis();
+			// Signed difference handles the millis() overflow
+			if (!job.active || ((int32_t)(job.due - job.slack - now) > 0))
+			{
+				continue;
+			}
+			sched_current_due = job.due;
+			if (job.period != 0)
+			{
+				// Keep the cadence of periodic jobs, skip missed periods
+				job.due += job.period;
+				if ((int32_t)(job.due - now) <= 0)
+				{
+					job.due = now + job.period;
+				}
+			}
+			else
+			{
+				job.active = false;
+			}
+			job.handler(NULL);
+			job_run = true;
+			woke_up = true;
+		}
+	} while (job_run);
+
+	// Wakeup statistics
+	uint32_t now = millis();
+	if (woke_up)
+	{
+		sched_hour_wakeups++;
+	}
+	if ((now - sched_hour_start) >= 3600000)
+	{
+		sched_last_hour_wakeups = sched_hour_wakeups;
+		sched_hour_wakeups = 0;
+		sched_hour_start = now;
+	}
+
+	// Find the next job
+	uint32_t next_time = SCHED_IDLE;
+	for (uint8_t idx = 0; idx < SCHED_NUM_JOBS; idx++)
+	{
+		if (!sched_jobs[idx].active)
+		{
+			continue;
+		}
+		int32_t time_left = (int32_t)(sched_jobs[idx].due - now);
+		uint32_t job_time = (time_left > 0) ? (uint32_t)time_left : 0;
+		if (job_time < next_time)
+		{
+			next_time = job_time;
+		}
+	}
+
+	api.system.timer.stop(RAK_TIMER_0);
+	if (next_time != SCHED_IDLE)
+	{
+		api.system.timer.start(RAK_TIMER_0, next_time == 0 ? 1 : next_time, NULL);
+	}
+	return next_time;
+}
+
+/**
+ * @brief Get the time the running job was due
+ *        Only valid inside a job handler
+ *
+ * @return uint32_t millis() when the job was due
+ */
+uint32_t sched_due_time(void)
+{
+	return sched_current_due;
+}
+
+/**
+ * @brief Get the number of wakeups caused by the scheduler
+ *
+ * @param last_hour wakeups in the last complete hour
+ * @param this_hour wakeups in the current hour
+ */
+void sched_wakeups(uint32_t &last_hour, uint32_t &this_hour)
+{
+	last_hour = sched_last_hour_wakeups;
+	this_hour = sched_hour_wakeups;
+}
@@ -0,0 +1,56 @@
+/**
+ * @file scheduler.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Software timers for all periodic and one-shot jobs on one RUI3 timer
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <Arduino.h>
+
+/** Jobs handled by the scheduler */
+typedef enum
+{
+	SCHED_UPLINK = 0, // TX slot, every send interval
+	SCHED_SENSOR,	  // Start of the sensor acquisition, lead time before the TX slot
+	SCHED_COLLECT,	  // Collect the sensor values after the conversions
+	SCHED_VOC,		  // VOC reading
+	SCHED_VOC_TH,	  // VOC reading after the T/RH conversion for the compensation
+	SCHED_VOC_BURST,  // Start of a VOC burst before the uplink
+	SCHED_CO2_POLL,	  // SCD30 poll before the uplink
+	SCHED_DRAIN,	  // Uplink of queued samples
+	SCHED_NUM_JOBS
+} sched_job_id_t;
+
+/** Time in ms a job may run before it is due, to share the wakeup with another job */
+#ifndef SCHED_SLACK_SENSOR
+#define SCHED_SLACK_SENSOR 1000
+#endif
+#ifndef SCHED_SLACK_VOC
+#define SCHED_SLACK_VOC 500
+#endif
+#ifndef SCHED_SLACK_POLL
+#define SCHED_SLACK_POLL 500
+#endif
+#ifndef SCHED_SLACK_DRAIN
+#define SCHED_SLACK_DRAIN 5000
+#endif
+
+/** Returned by sched_run() if no job is active */
+#define SCHED_IDLE 0xFFFFFFFF
+
+void sched_init(void);
+void sched_create(uint8_t job_id, void (*handler)(void *), uint16_t slack);
+void sched_start(uint8_t job_id, uint32_t delay, uint32_t period);
+void sched_stop(uint8_t job_id);
+bool sched_active(uint8_t job_id);
+uint32_t sched_run(void);
+uint32_t sched_due_time(void);
+void sched_wakeups(uint32_t &last_hour, uint32_t &this_hour);
+
+#endif // SCHEDULER_H
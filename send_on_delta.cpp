@@ -0,0 +1,171 @@
+/**
+ * @file send_on_delta.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Report-by-exception, send only samples that changed
+ *        The sensors are still read in every TX slot. A sample is
+ *        only sent if a value moved by its deadband since the last
+ *        sent sample, the set of valid values changed or nothing
+ *        was sent for g_sod_heartbeat ms.
+ *        Changes are sent at most every g_sod_min_gap ms, except
+ *        changes of SOD_EXCURSION_FACTOR deadbands or more.
+ *        Values are compared at the resolution of the payload.
+ *        The reference of a value is only updated by sod_sent()
+ *        after an uplink that contained the value, a value that
+ *        was left out by the payload planner or an uplink that
+ *        failed is still compared with the value sent before.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Max time in ms without uplink, 0 = every sample is sent */
+uint32_t g_sod_heartbeat = 0;
+/** Min time in ms between two uplinks for changes below the excursion limit */
+uint32_t g_sod_min_gap = 0;
+
+/** Deadband per SF_CH_xxx at the payload resolution, 0 = value is not checked */
+uint16_t g_sod_deadband[SF_CHANNELS] = {
+	5,	// RAK1906 temperature 0.5 °C
+	6,	// RAK1906 humidity 3 %RH
+	10, // RAK1906 pressure 1 hPa
+	0,	// RAK1906 gas resistance
+	50, // RAK12037 CO2 50 ppm
+	5,	// RAK12037 temperature 0.5 °C
+	6,	// RAK12037 humidity 3 %RH
+	20, // RAK12047 VOC index
+	0,	// Battery
+};
+
+/** Report-by-exception statistics */
+sod_stats_t sod_stats;
+
+/** Last value sent per SF_CH_xxx */
+static int32_t sod_ref[SF_CHANNELS];
+/** Values that have a reference, bit n = SF_CH_xxx n */
+static uint16_t sod_ref_channels = 0;
+/** Valid values of the last sample sent */
+static uint16_t sod_last_channels = 0;
+/** Time of the last sample sent */
+static uint32_t sod_last_time = 0;
+/** Flag if a sample was sent already */
+static bool sod_has_last = false;
+/** Sample to be sent, becomes the reference in sod_sent() */
+static sf_record_t sod_pending;
+/** Flag if sod_pending is waiting for its uplink */
+static bool sod_has_pending = false;
+
+/**
+ * @brief Check if a sample has to be sent
+ *        If yes, sod_sent() has to be called after the uplink
+ *
+ * @param values sensor values of the TX slot
+ * @param battery battery voltage in V
+ * @return true if the sample has to be sent
+ * @return false if the sample can be skipped
+ */
+bool sod_check(const sensor_snapshot_t &values, float battery)
+{
+	sod_stats.samples++;
+	sod_has_pending = false;
+	if (g_sod_heartbeat == 0)
+	{
+		// Report-by-exception is off
+		sod_stats.reports++;
+		return true;
+	}
+
+	sf_record_t record;
+	sf_make_record(record, values, battery);
+
+	uint32_t silence = record.timestamp - sod_last_time;
+	uint16_t channels = sf_record_channels(record);
+	bool report = false;
+
+	if (!sod_has_last || (channels != sod_last_channels))
+	{
+		report = true;
+	}
+	else if (silence >= g_sod_heartbeat)
+	{
+		report = true;
+		sod_stats.heartbeats++;
+	}
+	else
+	{
+		bool changed = false;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (((channels & (1 << channel)) == 0) || (g_sod_deadband[channel] == 0))
+			{
+				continue;
+			}
+			if ((sod_ref_channels & (1 << channel)) == 0)
+			{
+				// Value was never sent
+				changed = true;
+				continue;
+			}
+			int32_t delta = sf_record_value(record, channel) - sod_ref[channel];
+			if (delta < 0)
+			{
+				delta = -delta;
+			}
+			if (delta >= (int32_t)g_sod_deadband[channel] * SOD_EXCURSION_FACTOR)
+			{
+				// Large change, send right away
+				report = true;
+				sod_stats.excursions++;
+				break;
+			}
+			if (delta >= g_sod_deadband[channel])
+			{
+				changed = true;
+			}
+		}
+		if (changed && (silence >= g_sod_min_gap))
+		{
+			report = true;
+		}
+	}
+
+	if (report)
+	{
+		sod_pending = record;
+		sod_has_pending = true;
+		sod_stats.reports++;
+	}
+	return report;
+}
+
+/**
+ * @brief Update the references after the uplink of the
+ *        sample of the last sod_check() was started
+ *
+ * @param channels values that were in the uplink, bit n = SF_CH_xxx n
+ */
+void sod_sent(uint16_t channels)
+{
+	if (!sod_has_pending)
+	{
+		return;
+	}
+	sod_has_pending = false;
+
+	uint16_t valid = sf_record_channels(sod_pending);
+	channels &= valid;
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if (channels & (1 << channel))
+		{
+			sod_ref[channel] = sf_record_value(sod_pending, channel);
+		}
+	}
+	// Values that are not valid anymore are sent again when they come back
+	sod_ref_channels = (sod_ref_channels & valid) | channels;
+	sod_last_channels = valid;
+	sod_last_time = sod_pending.timestamp;
+	sod_has_last = true;
+}
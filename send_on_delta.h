@@ -0,0 +1,41 @@
+/**
+ * @file send_on_delta.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Report-by-exception, send only samples that changed
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SEND_ON_DELTA_H
+#define SEND_ON_DELTA_H
+
+#include <Arduino.h>
+
+/** A change of this many deadbands is sent without waiting for the min gap */
+#define SOD_EXCURSION_FACTOR 4
+/** All values of a sample were sent, for sod_sent() */
+#define SOD_ALL_CHANNELS ((1 << SF_CHANNELS) - 1)
+
+/**
+ * @brief Report-by-exception statistics
+ *
+ */
+typedef struct sod_stats_s
+{
+	uint32_t samples;	 // Samples checked
+	uint32_t reports;	 // Samples sent
+	uint32_t heartbeats; // Samples sent because of the max silence
+	uint32_t excursions; // Samples sent because of a large change
+} sod_stats_t;
+
+extern uint32_t g_sod_heartbeat;
+extern uint32_t g_sod_min_gap;
+extern uint16_t g_sod_deadband[];
+extern sod_stats_t sod_stats;
+
+bool sod_check(const sensor_snapshot_t &values, float battery);
+void sod_sent(uint16_t channels);
+
+#endif // SEND_ON_DELTA_H
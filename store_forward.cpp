@@ -0,0 +1,242 @@
+/**
+ * @file store_forward.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Queue for samples that could not be sent
+ *        Samples taken while the node is not joined or while
+ *        the uplink fails are kept in RAM. After the join they
+ *        are sent in batches on SF_FPORT, each sample starts
+ *        with its age in seconds on LPP_CHANNEL_AGE.
+ *        If the queue is full the oldest sample is dropped.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+
+/** Queued samples */
+static sf_record_t sf_queue[SF_QUEUE_SIZE];
+/** Index of the oldest sample */
+static uint16_t sf_tail = 0;
+/** Number of queued samples */
+static uint16_t sf_count = 0;
+
+/** Queue statistics */
+sf_stats_t sf_stats;
+
+/**
+ * @brief Convert sensor values into a compact sample
+ *
+ * @param record sample to fill
+ * @param values sensor values
+ * @param battery battery voltage in V
+ */
+void sf_make_record(sf_record_t &record, const sensor_snapshot_t &values, float battery)
+{
+	memset(&record, 0, sizeof(sf_record_t));
+	record.timestamp = millis();
+	if (values.env_valid)
+	{
+		record.env_temperature = (int16_t)(values.env_temperature / 10);
+		record.env_humidity = (uint8_t)(values.env_humidity / 500);
+		record.env_pressure = (uint16_t)(values.env_pressure / 10);
+		// Clean air can be above the range of the sample
+		uint32_t gas = values.env_gas / 10;
+		record.env_gas = (gas > UINT16_MAX) ? UINT16_MAX : (uint16_t)gas;
+		record.flags |= SF_ENV_VALID;
+	}
+	if (values.co2_valid)
+	{
+		record.co2 = values.co2;
+		record.co2_temperature = (int16_t)(values.co2_temperature * 10.0);
+		record.co2_humidity = (uint8_t)(values.co2_humidity * 2.0);
+		record.flags |= SF_CO2_VALID;
+	}
+	if (values.voc_valid)
+	{
+		record.voc_index = (uint16_t)values.voc_index;
+		record.flags |= SF_VOC_VALID;
+	}
+	record.battery = (uint16_t)(battery * 100.0);
+}
+
+/**
+ * @brief Add a sample to the queue
+ *        If the queue is full the oldest sample is dropped
+ *
+ * @param record sample that was not sent
+ */
+void sf_push_record(const sf_record_t &record)
+{
+	if (sf_count == SF_QUEUE_SIZE)
+	{
+		sf_tail = (sf_tail + 1) % SF_QUEUE_SIZE;
+		sf_count--;
+		sf_stats.dropped++;
+	}
+
+	sf_queue[(sf_tail + sf_count) % SF_QUEUE_SIZE] = record;
+	sf_count++;
+	sf_stats.stored++;
+	if (sf_count > sf_stats.max_depth)
+	{
+		sf_stats.max_depth = sf_count;
+	}
+	MYLOG("SF", "Sample queued, %d waiting", sf_count);
+}
+
+/**
+ * @brief Add the values of a payload that was not sent to the queue
+ *
+ * @param values sensor values of the payload
+ * @param battery battery voltage in V
+ */
+void sf_push(const sensor_snapshot_t &values, float battery)
+{
+	sf_record_t record;
+	sf_make_record(record, values, battery);
+	sf_push_record(record);
+}
+
+/**
+ * @brief Get the bitmap of the valid channels of a sample
+ *
+ * @param record sample
+ * @return uint16_t bitmap of the valid SF_CH_xxx
+ */
+uint16_t sf_record_channels(const sf_record_t &record)
+{
+	uint16_t channels = 0x0100; // Battery
+	if (record.flags & SF_ENV_VALID)
+	{
+		channels |= 0x000F;
+	}
+	if (record.flags & SF_CO2_VALID)
+	{
+		channels |= 0x0070;
+	}
+	if (record.flags & SF_VOC_VALID)
+	{
+		channels |= 0x0080;
+	}
+	return channels;
+}
+
+/**
+ * @brief Get a value of a sample
+ *
+ * @param record sample
+ * @param channel SF_CH_xxx
+ * @return int32_t value at the resolution of the LPP payload
+ */
+int32_t sf_record_value(const sf_record_t &record, uint8_t channel)
+{
+	switch (channel)
+	{
+	case SF_CH_ENV_TEMP:
+		return record.env_temperature;
+	case SF_CH_ENV_HUMID:
+		return record.env_humidity;
+	case SF_CH_ENV_PRESS:
+		return record.env_pressure;
+	case SF_CH_ENV_GAS:
+		return record.env_gas;
+	case SF_CH_CO2:
+		return record.co2;
+	case SF_CH_CO2_TEMP:
+		return record.co2_temperature;
+	case SF_CH_CO2_HUMID:
+		return record.co2_humidity;
+	case SF_CH_VOC:
+		return record.voc_index;
+	default:
+		return record.battery;
+	}
+}
+
+/**
+ * @brief Get the number of queued samples
+ *
+ * @return uint16_t queued samples
+ */
+uint16_t sf_depth(void)
+{
+	return sf_count;
+}
+
+/**
+ * @brief Encode the oldest samples into g_solution_data
+ *        The samples stay in the queue until sf_release() is called
+ *
+ * @param max_size max size of the payload in bytes
+ * @return uint8_t number of samples in the payload
+ */
+uint8_t sf_build_batch(uint8_t max_size)
+{
+	g_solution_data.reset();
+	uint8_t added = 0;
+	uint32_t now = millis();
+
+	while (added < sf_count)
+	{
+		const sf_record_t &record = sf_queue[(sf_tail + added) % SF_QUEUE_SIZE];
+		uint8_t record_start = g_solution_data.getSize();
+
+		// Same values as the live payload, rebuilt with the payload resolution
+		sensor_snapshot_t values;
+		memset(&values, 0, sizeof(sensor_snapshot_t));
+		values.env_valid = (record.flags & SF_ENV_VALID) != 0;
+		values.env_temperature = (int32_t)record.env_temperature * 10;
+		values.env_humidity = (int32_t)record.env_humidity * 500;
+		values.env_pressure = (int32_t)record.env_pressure * 10;
+		values.env_gas = (uint32_t)record.env_gas * 10;
+		values.co2_valid = (record.flags & SF_CO2_VALID) != 0;
+		// The age is sent in its own channel, do not skip the CO2 values as too old
+		values.co2_timestamp = now;
+		values.co2 = record.co2;
+		values.co2_temperature = record.co2_temperature / 10.0;
+		values.co2_humidity = record.co2_humidity / 2.0;
+		values.voc_valid = (record.flags & SF_VOC_VALID) != 0;
+		values.voc_index = record.voc_index;
+
+		g_solution_data.addGenericSensor_u32(LPP_CHANNEL_AGE, (now - record.timestamp) / 1000);
+		encode_sensor_values(values);
+		g_solution_data.addVoltage(LPP_CHANNEL_BATT, record.battery / 100.0);
+
+		if ((g_solution_data.getSize() > max_size) || (g_solution_data.getError() != LPP_ERROR_OK))
+		{
+			// Sample does not fit anymore, send it with the next batch
+			g_solution_data.rewind(record_start);
+			break;
+		}
+		added++;
+	}
+	return added;
+}
+
+/**
+ * @brief Remove the oldest samples after they were sent
+ *
+ * @param count number of samples sent
+ */
+void sf_release(uint8_t count)
+{
+	if (count > sf_count)
+	{
+		count = sf_count;
+	}
+	sf_tail = (sf_tail + count) % SF_QUEUE_SIZE;
+	sf_count -= count;
+	sf_stats.sent += count;
+}
+
+/**
+ * @brief Remove all queued samples
+ *
+ */
+void sf_clear(void)
+{
+	sf_tail = 0;
+	sf_count = 0;
+}
@@ -0,0 +1,88 @@
+/**
+ * @file store_forward.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Queue for samples that could not be sent
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef STORE_FORWARD_H
+#define STORE_FORWARD_H
+
+#include <Arduino.h>
+
+/** Number of samples kept while the node is not joined or TX fails */
+#ifndef SF_QUEUE_SIZE
+#define SF_QUEUE_SIZE 32
+#endif
+
+/** fPort of the uplinks with queued samples */
+#define SF_FPORT 3
+/** Time in ms between two uplinks with queued samples */
+#define SF_DRAIN_INTERVAL 30000
+/** Longest time in ms between two tries if the uplinks are blocked */
+#define SF_DRAIN_INTERVAL_MAX 600000
+
+/** Values of a sample, index for sf_record_value() and bit in sf_record_channels() */
+#define SF_CH_ENV_TEMP 0  // RAK1906 temperature 0.1 °C signed
+#define SF_CH_ENV_HUMID 1 // RAK1906 humidity 0.5 %RH
+#define SF_CH_ENV_PRESS 2 // RAK1906 pressure 0.1 hPa
+#define SF_CH_ENV_GAS 3	  // RAK1906 gas resistance 0.01 kOhm
+#define SF_CH_CO2 4		  // RAK12037 CO2 ppm
+#define SF_CH_CO2_TEMP 5  // RAK12037 temperature 0.1 °C signed
+#define SF_CH_CO2_HUMID 6 // RAK12037 humidity 0.5 %RH
+#define SF_CH_VOC 7		  // RAK12047 VOC index
+#define SF_CH_BATT 8	  // Battery 0.01 V
+#define SF_CHANNELS 9
+
+/** Flags of the values in a sample */
+#define SF_ENV_VALID 0x01
+#define SF_CO2_VALID 0x02
+#define SF_VOC_VALID 0x04
+
+/**
+ * @brief Compact sample, same resolution as the LPP payload
+ *
+ */
+typedef struct sf_record_s
+{
+	uint32_t timestamp;		 // millis() when the sample was taken
+	int16_t env_temperature; // Temperature in 0.1 °C
+	uint16_t env_pressure;	 // Pressure in 0.1 hPa
+	uint16_t env_gas;		 // Gas resistance in 10 Ohm
+	uint16_t co2;			 // CO2 in ppm
+	int16_t co2_temperature; // Temperature in 0.1 °C
+	uint16_t voc_index;		 // VOC index
+	uint16_t battery;		 // Battery voltage in 0.01 V
+	uint8_t env_humidity;	 // Humidity in 0.5 %RH
+	uint8_t co2_humidity;	 // Humidity in 0.5 %RH
+	uint8_t flags;			 // SF_xxx_VALID
+} sf_record_t;
+
+/**
+ * @brief Queue statistics
+ *
+ */
+typedef struct sf_stats_s
+{
+	uint32_t stored;  // Samples added to the queue
+	uint32_t sent;	  // Samples sent from the queue
+	uint32_t dropped; // Oldest samples lost because the queue was full
+	uint16_t max_depth; // Highest number of queued samples
+} sf_stats_t;
+
+extern sf_stats_t sf_stats;
+
+void sf_make_record(sf_record_t &record, const sensor_snapshot_t &values, float battery);
+void sf_push_record(const sf_record_t &record);
+void sf_push(const sensor_snapshot_t &values, float battery);
+uint16_t sf_record_channels(const sf_record_t &record);
+int32_t sf_record_value(const sf_record_t &record, uint8_t channel);
+uint16_t sf_depth(void);
+uint8_t sf_build_batch(uint8_t max_size);
+void sf_release(uint8_t count);
+void sf_clear(void);
+
+#endif // STORE_FORWARD_H
@@ -0,0 +1,181 @@
+/**
+ * @file acquisition_pipeline.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host simulation of the sensor acquisition before an uplink
+ *        Compares the sequential schedule of the original sketch
+ *        with the pipeline of the node for configurable latencies
+ *        of the sensors and the I2C bus:
+ *        - sequential: BME680 forced conversion with heater waited
+ *          with delay(), then SCD30 read, then SGP40 measurement
+ *        - pipelined: sensor_handler() starts the conversions, the
+ *          MCU sleeps until the longest one is finished,
+ *          send_handler() collects and encodes once. SCD30 and SGP40
+ *          are read by their own timer jobs, the acquisition only
+ *          encodes their values.
+ *        Reports wall time and awake time of one acquisition.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o acquisition_pipeline \
+ *            tests/acquisition_pipeline.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./acquisition_pipeline
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include <SparkFun_SCD30_Arduino_Library.h>
+#include <SensirionI2CSgp40.h>
+
+extern SCD30 scd30;
+extern SensirionI2CSgp40 sgp40;
+
+/** Uplinks measured per scenario */
+#define TEST_UPLINKS 5
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Latencies of one scenario */
+struct scenario_t
+{
+	const char *name;
+	/** BME680 conversion time on top of the datasheet time */
+	uint32_t bme_extra_us;
+	/** SGP40 measurement time */
+	uint32_t sgp40_us;
+	/** SCD30 read including clock stretching */
+	uint32_t scd30_us;
+	/** Bus time per I2C transaction */
+	uint32_t i2c_us;
+};
+
+static const scenario_t scenarios[] = {
+	{"default", 0, 30000, 0, 0},
+	{"100 kHz bus", 0, 30000, 2000, 250},
+	// Within CONVERSION_MARGIN + CONVERSION_RETRIES * CONVERSION_RETRY_TIME of the datasheet time
+	{"slow BME680 +20 ms", 20000, 30000, 0, 50},
+	{"slow SGP40 and SCD30", 0, 60000, 20000, 50},
+};
+#define NUM_SCENARIOS (sizeof(scenarios) / sizeof(scenarios[0]))
+
+/** Timing of one acquisition */
+struct timing_t
+{
+	double wall_ms;
+	double awake_ms;
+};
+
+/**
+ * @brief Sequential acquisition like the original get_sensor_values(),
+ *        the MCU waits with delay() for each sensor
+ *
+ * @param scenario latencies
+ * @return timing_t
+ */
+static timing_t sequential(const scenario_t &scenario)
+{
+	uint64_t start = host_now_us();
+	uint64_t awake = host_awake_us;
+
+	// BME680 forced conversion with heater, waited with delay()
+	delay(start_rak1906());
+	while (!collect_rak1906())
+	{
+		delay(CONVERSION_RETRY_TIME);
+	}
+
+	// SCD30, data ready check and read of the three values
+	if (scd30.dataAvailable())
+	{
+		scd30.getCO2();
+	}
+	delayMicroseconds(scenario.scd30_us);
+
+	// SGP40 measurement, blocks for the measurement time
+	uint16_t sraw;
+	sgp40.measureRawSignal(0x8000, 0x6666, sraw);
+
+	// Encode like get_sensor_values(), without its timing statistics of the node
+	g_solution_data.reset();
+	for (uint8_t drv = 0; drv < num_sensor_drivers; drv++)
+	{
+		sensor_drivers[drv].encode(*snapshot_get());
+	}
+
+	timing_t timing;
+	timing.wall_ms = (host_now_us() - start) / 1000.0;
+	timing.awake_ms = (host_awake_us - awake) / 1000.0;
+	return timing;
+}
+
+/**
+ * @brief Pipelined acquisition of the node, measured over several uplinks
+ *
+ * @return timing_t average of the acquisitions
+ */
+static timing_t pipelined(void)
+{
+	timing_t timing = {0, 0};
+	size_t uplinks = host_uplinks.size();
+	uint32_t measured = 0;
+	while (measured < TEST_UPLINKS)
+	{
+		host_run_until(host_now_us() + 1000000ULL);
+		if (host_uplinks.size() > uplinks)
+		{
+			uplinks = host_uplinks.size();
+			timing.wall_ms += acquisition_stats.wall_time;
+			timing.awake_ms += acquisition_stats.awake_time / 1000.0;
+			measured++;
+		}
+	}
+	timing.wall_ms /= TEST_UPLINKS;
+	timing.awake_ms /= TEST_UPLINKS;
+	return timing;
+}
+
+int main(void)
+{
+	host_bme680 *sim = host_default_node();
+	setup();
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	// Let the VOC and CO2 values become valid
+	host_run_until(host_now_us() + 300000000ULL);
+
+	printf("Acquisition of one uplink, sequential vs. pipelined\n");
+	printf("  %-22s %12s %12s   %12s %12s\n", "scenario", "seq wall ms", "seq awake ms", "pipe wall ms", "pipe awake ms");
+	for (uint8_t idx = 0; idx < NUM_SCENARIOS; idx++)
+	{
+		const scenario_t &scenario = scenarios[idx];
+		sim->extra_us = scenario.bme_extra_us;
+		host_sgp40.measure_us = scenario.sgp40_us;
+		host_i2c_transaction_us = scenario.i2c_us;
+
+		uint32_t env_failures = driver_stats[0].failures;
+		timing_t seq = sequential(scenario);
+		timing_t pipe = pipelined();
+		printf("  %-22s %12.1f %12.1f   %12.1f %12.1f\n", scenario.name, seq.wall_ms, seq.awake_ms, pipe.wall_ms, pipe.awake_ms);
+
+		check(driver_stats[0].failures == env_failures, "RAK1906 values missing in the pipeline");
+		// The MCU sleeps during the conversions and does not wait for SCD30 and SGP40
+		check(pipe.awake_ms * 10 < seq.awake_ms, "pipeline does not reduce the awake time");
+		// Conversion margin and one retry step at most on top of the longest conversion
+		check(pipe.wall_ms <= seq.wall_ms + CONVERSION_MARGIN + CONVERSION_RETRY_TIME, "pipeline takes longer than the sequential schedule");
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,160 @@
+/**
+ * @file bme680_calib_cache.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the BME680 calibration stored in flash
+ *        Boots init_rak1906() on the simulated sensor with an
+ *        erased flash, with a valid stored calibration, after a
+ *        module swap (other T1), with a stored calibration of
+ *        another chip ID and with a corrupted flash. Reports the
+ *        calibration reads and I2C transactions of each boot.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o bme680_calib_cache \
+ *            tests/bme680_calib_cache.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./bme680_calib_cache
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include "rak1906.h"
+
+extern rak1906 bme;
+bool save_bme_calibration(const rak1906_calib_t &calib);
+
+/** T1 of a second sensor for the module swap */
+#define TEST_OTHER_T1 25000
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Result of one boot */
+struct boot_result_t
+{
+	bool init;
+	bool from_cache;
+	uint32_t calib_reads;
+	uint32_t transactions;
+	uint32_t flash_writes;
+	int32_t temperature;
+	int32_t humidity;
+	int32_t pressure;
+};
+
+/**
+ * @brief Boot init_rak1906() on a fresh simulated sensor and take one measurement
+ *
+ * @param t1 T1 coefficient of the sensor
+ * @param name name of the case for the report
+ * @return boot_result_t
+ */
+static boot_result_t boot(uint16_t t1, const char *name)
+{
+	host_i2c_detach_all();
+	static host_bme680 sim;
+	sim = host_bme680(t1);
+	host_i2c_attach(RAK1906_ADDRESS, &sim);
+	uint32_t transactions = host_i2c_transactions;
+	uint32_t flash_writes = host_flash_writes;
+
+	boot_result_t result;
+	result.init = init_rak1906();
+	result.from_cache = bme.calibrationFromCache();
+	result.calib_reads = sim.calib_reads;
+	result.transactions = host_i2c_transactions - transactions;
+	result.flash_writes = host_flash_writes - flash_writes;
+
+	host_advance_us(start_rak1906() * 1000ULL);
+	check(collect_rak1906(), "measurement failed");
+	result.temperature = bme.temperatureCenti();
+	result.humidity = bme.humidityMilli();
+	result.pressure = bme.pressurePa();
+
+	printf("  %-24s %-6s %2d calibration bytes, %2d I2C transactions, %d flash writes\n", name,
+		   result.from_cache ? "cache" : "sensor", result.calib_reads, result.transactions, result.flash_writes);
+	return result;
+}
+
+/**
+ * @brief Store a calibration with a changed chip ID and a valid CRC
+ */
+static void store_other_chip(void)
+{
+	rak1906_calib_t calib;
+	bme.getCalibrationData(calib);
+	calib.chipId ^= 0x01;
+	save_bme_calibration(calib);
+}
+
+int main(void)
+{
+	printf("BME680 calibration cache\n");
+
+	// New device, calibration is read from the sensor and saved
+	host_flash_erase();
+	boot_result_t first = boot(26185, "erased flash");
+	check(first.init, "init failed with an erased flash");
+	check(!first.from_cache, "calibration from an erased flash");
+	check(first.calib_reads == 41, "calibration not read completely");
+	check(first.flash_writes == 1, "calibration not saved");
+	check(first.temperature == 2200, "wrong temperature");
+
+	// Reboot, only T1 is read to check the module
+	boot_result_t cached = boot(26185, "stored calibration");
+	check(cached.from_cache, "stored calibration not used");
+	check(cached.calib_reads == 2, "more than T1 read with a stored calibration");
+	check(cached.flash_writes == 0, "flash written with a stored calibration");
+	check(cached.transactions < first.transactions, "no I2C transactions saved");
+	check((cached.temperature == first.temperature) && (cached.humidity == first.humidity) && (cached.pressure == first.pressure),
+		  "values differ with the stored calibration");
+
+	// Module swapped, T1 does not match, read and save the new calibration
+	boot_result_t swapped = boot(TEST_OTHER_T1, "module swapped (T1)");
+	check(!swapped.from_cache, "stored calibration used for another sensor");
+	check(swapped.calib_reads == 2 + 41, "calibration of the new sensor not read");
+	check(swapped.flash_writes == 1, "calibration of the new sensor not saved");
+	check(swapped.temperature != first.temperature, "new T1 not used");
+	boot_result_t swapped_again = boot(TEST_OTHER_T1, "new sensor reboot");
+	check(swapped_again.from_cache && (swapped_again.temperature == swapped.temperature), "calibration of the new sensor not cached");
+
+	// Stored calibration of another chip type
+	store_other_chip();
+	boot_result_t other_chip = boot(TEST_OTHER_T1, "other chip ID");
+	check(!other_chip.from_cache, "stored calibration used for another chip ID");
+	check(other_chip.calib_reads == 41, "T1 checked or calibration incomplete with another chip ID");
+	check(other_chip.flash_writes == 1, "calibration not saved after chip ID mismatch");
+	check(other_chip.temperature == swapped.temperature, "wrong values after chip ID mismatch");
+
+	// Flipped bit in flash, CRC fails and the sensor is read
+	host_flash[BME_CALIB_OFFSET + 8] ^= 0x10;
+	boot_result_t corrupt = boot(TEST_OTHER_T1, "corrupted flash");
+	check(corrupt.init, "init failed with a corrupted flash");
+	check(!corrupt.from_cache, "corrupted calibration used");
+	check(corrupt.calib_reads == 41, "calibration not read after CRC error");
+	check(corrupt.flash_writes == 1, "calibration not saved after CRC error");
+	check(corrupt.temperature == swapped.temperature, "wrong values after CRC error");
+	boot_result_t repaired = boot(TEST_OTHER_T1, "after repair");
+	check(repaired.from_cache, "calibration not repaired");
+
+	// Saved calibration without a sensor is not touched
+	host_i2c_detach_all();
+	uint32_t flash_writes = host_flash_writes;
+	check(!init_rak1906(), "init succeeded without a sensor");
+	check(host_flash_writes == flash_writes, "flash written without a sensor");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,211 @@
+/**
+ * @file bme680_encode_bench.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host micro-benchmark of the BME680 payload path
+ *        Reads random conversions from the simulated BME680 and
+ *        encodes them with the float API of CayenneLPP (path of the
+ *        original sketch) and with the fixed point path of
+ *        encode_rak1906(). The payload bytes are compared for every
+ *        sample, a difference is only accepted if it is one LSB
+ *        caused by the float rounding of the old path.
+ *        The gas resistance is a deliberate unit change: the
+ *        original RAK3172 path sent 1 kOhm per bit, the fixed point
+ *        path sends 0.01 kOhm per bit like the RAK4631 and the
+ *        README, limited to 327.67 kOhm. Both fields are checked
+ *        against their own scaling.
+ *
+ *        The host has an FPU, so the timing does not include the
+ *        cost of soft-float. On the RAK3172 (no FPU)
+ *        each field of the float path adds an int to float
+ *        conversion, a division, a compare, a multiplication and a
+ *        float to int conversion as soft-float library calls.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o bme680_encode_bench \
+ *            tests/bme680_encode_bench.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./bme680_encode_bench
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include "rak1906.h"
+#include <chrono>
+
+extern rak1906 bme;
+
+/** Number of random conversions */
+#define TEST_SAMPLES 20000
+/** Encode repetitions per conversion for the timing */
+#define TEST_REPEAT 50
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Float path of the original sketch
+ *        gas() returns Ohm / 100, the gas resistance is sent with
+ *        1 kOhm per bit and wraps above 65.535 MOhm
+ *
+ * @param payload encoder
+ */
+static void encode_float(WisCayenne &payload)
+{
+	payload.addRelativeHumidity(LPP_CHANNEL_HUMID_2, bme.humidity());
+	payload.addTemperature(LPP_CHANNEL_TEMP_2, bme.temperature());
+	payload.addBarometricPressure(LPP_CHANNEL_PRESS_2, bme.pressure());
+	payload.addAnalogInput(LPP_CHANNEL_GAS_2, (float)(bme.gas()) / 1000.0);
+}
+
+/**
+ * @brief Check if a field differs by one LSB because the float value
+ *        times the LPP resolution ends just below an integer
+ *
+ * @param float_bytes field of the float path, MSB first
+ * @param int_bytes field of the integer path
+ * @param size field size
+ * @param exact exact scaled value
+ * @return true if the difference is a float rounding
+ */
+static bool float_rounding(const uint8_t *float_bytes, const uint8_t *int_bytes, uint8_t size, double exact)
+{
+	int32_t float_value = 0;
+	int32_t int_value = 0;
+	for (uint8_t idx = 0; idx < size; idx++)
+	{
+		float_value = (float_value << 8) | float_bytes[idx];
+		int_value = (int_value << 8) | int_bytes[idx];
+	}
+	// Exact value is an integer, the float product is a tiny bit smaller and truncated
+	return (abs(float_value - int_value) == 1) && (fabs(exact - round(exact)) < 1e-9);
+}
+
+int main(void)
+{
+	host_bme680 sim;
+	host_i2c_attach(RAK1906_ADDRESS, &sim);
+	check(init_rak1906(), "init failed");
+
+	WisCayenne float_data(64);
+	srand(5);
+	int mismatches = 0;
+	int rounding = 0;
+	int field_rounding[3] = {0, 0, 0};
+	int gas_scaled = 0;
+	int gas_clamped = 0;
+	int gas_wrapped = 0;
+	double float_ns = 0;
+	double integer_ns = 0;
+	for (int sample = 0; sample < TEST_SAMPLES; sample++)
+	{
+		// Random conversion, -20 .. 60 degC, all humidity, 300 .. 1100 hPa, all gas ranges
+		sim.adc_temp = 400000 + rand() % 160000;
+		sim.adc_hum = 5000 + rand() % 40000;
+		sim.adc_pres = 200000 + rand() % 350000;
+		sim.adc_gas = rand() % 1024;
+		sim.gas_range = rand() % 16;
+		host_advance_us(start_rak1906() * 1000ULL);
+		check(collect_rak1906(), "collect failed");
+		const sensor_snapshot_t &values = *snapshot_get();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < TEST_REPEAT; repeat++)
+		{
+			float_data.reset();
+			encode_float(float_data);
+		}
+		auto middle = std::chrono::steady_clock::now();
+		for (int repeat = 0; repeat < TEST_REPEAT; repeat++)
+		{
+			g_solution_data.reset();
+			encode_rak1906(values);
+		}
+		auto end = std::chrono::steady_clock::now();
+		float_ns += std::chrono::duration<double, std::nano>(middle - start).count();
+		integer_ns += std::chrono::duration<double, std::nano>(end - middle).count();
+
+		// Same channels and sizes, compare field by field
+		uint8_t *float_bytes = float_data.getBuffer();
+		uint8_t *int_bytes = g_solution_data.getBuffer();
+		if (float_data.getSize() != g_solution_data.getSize())
+		{
+			check(false, "payload size differs");
+			continue;
+		}
+		// Exact scaled values of the fields: RH 0.5 %, T 0.1 degC, p 0.1 hPa
+		const double exact[3] = {bme.humidityMilli() / 500.0, bme.temperatureCenti() / 10.0, bme.pressurePa() / 10.0};
+		const uint8_t sizes[3] = {1, 2, 2};
+		uint8_t pos = 0;
+		for (int field = 0; field < 3; field++)
+		{
+			uint8_t len = 2 + sizes[field];
+			if (memcmp(&float_bytes[pos], &int_bytes[pos], len) != 0)
+			{
+				mismatches++;
+				if ((memcmp(&float_bytes[pos], &int_bytes[pos], 2) == 0) && float_rounding(&float_bytes[pos + 2], &int_bytes[pos + 2], sizes[field], exact[field]))
+				{
+					rounding++;
+					field_rounding[field]++;
+				}
+				else
+				{
+					printf("  sample %d field %d: exact %.3f\n", sample, field, exact[field]);
+					check(false, "payload bytes differ");
+				}
+			}
+			pos += len;
+		}
+
+		// Gas resistance, original 1 kOhm per bit, now 0.01 kOhm per bit
+		check(memcmp(&float_bytes[pos], &int_bytes[pos], 2) == 0, "gas resistance channel or type differs");
+		uint16_t old_raw = (float_bytes[pos + 2] << 8) | float_bytes[pos + 3];
+		uint16_t new_raw = (int_bytes[pos + 2] << 8) | int_bytes[pos + 3];
+		uint32_t ohm = bme.gasOhm();
+		uint32_t new_expected = (ohm / 10 > INT16_MAX) ? INT16_MAX : ohm / 10;
+		// The float division can end one LSB below
+		uint16_t old_expected = (uint16_t)(ohm / 1000);
+		if ((new_raw != new_expected) || ((uint16_t)(old_expected - old_raw) > 1))
+		{
+			printf("  sample %d gas %lu Ohm: original %u, fixed point %u\n", sample, (unsigned long)ohm, old_raw, new_raw);
+			check(false, "gas resistance not in the unit of its path");
+		}
+		else if (ohm / 1000 > INT16_MAX)
+		{
+			// Negative or wrapped in the original payload
+			gas_wrapped++;
+		}
+		else if (new_raw == INT16_MAX)
+		{
+			gas_clamped++;
+		}
+		else
+		{
+			// Same value, 100 times the resolution
+			gas_scaled++;
+			check(abs((int)(new_raw / 100) - (int)old_raw) <= 1, "gas resistance not scaled by 100");
+		}
+	}
+
+	printf("BME680 payload encoding, %d conversions\n", TEST_SAMPLES);
+	printf("  float path:   %.1f ns per payload\n", float_ns / TEST_SAMPLES / TEST_REPEAT);
+	printf("  integer path: %.1f ns per payload\n", integer_ns / TEST_SAMPLES / TEST_REPEAT);
+	printf("  fields differing: %d, float truncations of an exact value: %d (RH %d, T %d, p %d)\n", mismatches, rounding,
+		   field_rounding[0], field_rounding[1], field_rounding[2]);
+	printf("  gas resistance, 1 kOhm -> 0.01 kOhm per bit: %d scaled by 100, %d limited to 327.67 kOhm, %d wrapped in the original\n",
+		   gas_scaled, gas_clamped, gas_wrapped);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,135 @@
+/**
+ * @file bme680_timing.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the BME680 conversion time
+ *        Checks rak1906::measurementDuration() for all oversampling
+ *        and heater combinations against the rounding of the Bosch
+ *        BME680 driver (bme680_get_profile_dur()) and against the
+ *        conversion time of the datasheet. A forced measurement on
+ *        the simulated sensor must be ready when the returned time
+ *        has passed.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o bme680_timing \
+ *            tests/bme680_timing.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./bme680_timing
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include "rak1906.h"
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Conversion time of bme680_get_profile_dur() of the Bosch driver
+ *
+ * @param os_t temperature oversampling, oversamplingTypes value
+ * @param os_p pressure oversampling
+ * @param os_h humidity oversampling
+ * @param heater_ms heater duration, 0 if the gas measurement is off
+ * @return uint16_t duration in ms
+ */
+static uint16_t bosch_profile_dur(uint8_t os_t, uint8_t os_p, uint8_t os_h, uint16_t heater_ms)
+{
+	const uint8_t os_to_meas_cycles[6] = {0, 1, 2, 4, 8, 16};
+	uint32_t meas_cycles = os_to_meas_cycles[os_t] + os_to_meas_cycles[os_p] + os_to_meas_cycles[os_h];
+	uint32_t tph_dur = meas_cycles * UINT32_C(1963);
+	tph_dur += UINT32_C(477 * 4);
+	tph_dur += UINT32_C(477 * 5);
+	tph_dur += UINT32_C(500);
+	tph_dur /= UINT32_C(1000);
+	tph_dur += UINT32_C(1);
+	return (uint16_t)(tph_dur + heater_ms);
+}
+
+/** Heater durations tested, 0 = gas measurement off */
+static const uint16_t heater_ms[] = {0, 1, 25, 63, 64, 100, 150, 300, 1000, 4032};
+
+int main(void)
+{
+	host_bme680 sim;
+	host_i2c_attach(RAK1906_ADDRESS, &sim);
+	rak1906 sensor;
+	check(sensor.init(), "init() failed");
+
+	int combinations = 0;
+	int worst_margin_us = INT32_MAX;
+	int max_margin_us = 0;
+	char message[128];
+	for (uint8_t os_t = SensorOff; os_t < UnknownOversample; os_t++)
+	{
+		for (uint8_t os_p = SensorOff; os_p < UnknownOversample; os_p++)
+		{
+			for (uint8_t os_h = SensorOff; os_h < UnknownOversample; os_h++)
+			{
+				for (size_t idx = 0; idx < sizeof(heater_ms) / sizeof(heater_ms[0]); idx++)
+				{
+					sensor.setOversampling(TemperatureSensor, os_t);
+					sensor.setOversampling(PressureSensor, os_p);
+					sensor.setOversampling(HumiditySensor, os_h);
+					sensor.setGas(heater_ms[idx] == 0 ? 0 : 320, heater_ms[idx]);
+					combinations++;
+					snprintf(message, sizeof(message), "T%d P%d H%d heater %d ms", os_t, os_p, os_h, heater_ms[idx]);
+
+					uint16_t duration = sensor.measurementDuration();
+					if (duration != bosch_profile_dur(os_t, os_p, os_h, heater_ms[idx]))
+					{
+						printf("  %s: %d ms, Bosch %d ms\n", message, duration, bosch_profile_dur(os_t, os_p, os_h, heater_ms[idx]));
+						check(false, "duration differs from the Bosch driver");
+					}
+
+					// Forced measurement on the simulated sensor
+					uint64_t start_us = host_now_us();
+					uint16_t started = sensor.startMeasurement();
+					check(started == duration, "startMeasurement() returns a different duration");
+					int margin_us = (int)(duration * 1000LL - (int64_t)sim.conversion_time_us());
+					if (margin_us < 0)
+					{
+						printf("  %s: %d ms, datasheet %.3f ms\n", message, duration, sim.conversion_time_us() / 1000.0);
+						check(false, "duration shorter than the datasheet conversion time");
+					}
+					worst_margin_us = (margin_us < worst_margin_us) ? margin_us : worst_margin_us;
+					max_margin_us = (margin_us > max_margin_us) ? margin_us : max_margin_us;
+					check(!sensor.collect(), "collect() succeeds before the conversion is finished");
+					host_set_time_us(start_us + duration * 1000ULL);
+					if (!sensor.collect())
+					{
+						printf("  %s\n", message);
+						check(false, "conversion not finished after the returned time");
+					}
+
+					// T/RH only refresh, heater off and no gas conversion
+					uint32_t gas_conversions = sim.gas_conversions;
+					start_us = host_now_us();
+					uint16_t no_gas = sensor.startMeasurementNoGas();
+					check(no_gas == bosch_profile_dur(os_t, os_p, os_h, 0), "startMeasurementNoGas() duration includes the heater");
+					check(sim.gas_conversions == gas_conversions, "startMeasurementNoGas() ran the heater");
+					host_set_time_us(start_us + no_gas * 1000ULL);
+					check(sensor.collect(), "T/RH conversion not finished after the returned time");
+					check(sensor.measurementDuration() == duration, "startMeasurementNoGas() did not restore the gas settings");
+				}
+			}
+		}
+	}
+
+	printf("BME680 conversion time, %d combinations\n", combinations);
+	printf("  margin to the datasheet time: min %.3f ms, max %.3f ms\n", worst_margin_us / 1000.0, max_margin_us / 1000.0);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,432 @@
+/**
+ * @file bus_stress.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stress test of the AT commands against loop()
+ *        A second thread plays the AT command context and sends
+ *        random PRIO, DEADBAND, RBE, KEYFRAME, PAYLOAD, BATCH, THAGE,
+ *        TXLEAD, SENDINT and VOCMODE commands while loop() runs the
+ *        node with a send interval around 60 s. Checks that no AT command touches
+ *        the I2C bus, that every uplink is a complete payload of
+ *        its format within the size of the data rate and that the
+ *        last accepted value of each setting is applied and saved.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o bus_stress \
+ *            tests/bus_stress.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./bus_stress
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include <atomic>
+#include <thread>
+
+/** Simulated run time, the data rate changes every hour */
+#define TEST_HOURS 24
+/** Random seed of the AT commands */
+#define TEST_SEED 1234
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Last value of each setting accepted by an AT command */
+struct settings_t
+{
+	uint8_t priority[SF_CHANNELS];
+	uint16_t deadband[SF_CHANNELS];
+	uint32_t heartbeat;
+	uint32_t min_gap;
+	uint8_t keyframe;
+	uint8_t format;
+	uint8_t batch;
+	uint32_t th_max_age;
+	uint32_t acq_lead;
+	uint32_t send_interval;
+	uint8_t voc_mode;
+};
+
+/** Settings of the node */
+static void read_settings(settings_t &settings)
+{
+	memcpy(settings.priority, g_plan_priority, sizeof(settings.priority));
+	memcpy(settings.deadband, g_sod_deadband, sizeof(settings.deadband));
+	settings.heartbeat = g_sod_heartbeat;
+	settings.min_gap = g_sod_min_gap;
+	settings.keyframe = g_delta_keyframe_interval;
+	settings.format = g_payload_format;
+	settings.batch = g_batch_samples;
+	settings.th_max_age = g_bme_th_max_age;
+	settings.acq_lead = g_acq_lead_min;
+	settings.send_interval = g_lorawan_settings.send_repeat_time;
+	settings.voc_mode = g_voc_mode;
+}
+
+static bool same_settings(const settings_t &first, const settings_t &second)
+{
+	return (memcmp(first.priority, second.priority, sizeof(first.priority)) == 0) &&
+		   (memcmp(first.deadband, second.deadband, sizeof(first.deadband)) == 0) &&
+		   (first.heartbeat == second.heartbeat) && (first.min_gap == second.min_gap) &&
+		   (first.keyframe == second.keyframe) && (first.format == second.format) &&
+		   (first.batch == second.batch) && (first.th_max_age == second.th_max_age) &&
+		   (first.acq_lead == second.acq_lead) && (first.send_interval == second.send_interval) &&
+		   (first.voc_mode == second.voc_mode);
+}
+
+/** Expected settings, only written by the AT thread */
+static settings_t expected;
+/** AT commands sent, accepted and rejected as busy */
+static std::atomic<uint32_t> at_sent(0);
+static uint32_t at_ok = 0;
+static uint32_t at_busy = 0;
+static std::atomic<bool> running(true);
+
+/**
+ * @brief Send one random AT command and record the value if it was accepted
+ *
+ * @param seed state of rand_r()
+ */
+static void random_at(unsigned int &seed)
+{
+	char command[48];
+	uint32_t channel = rand_r(&seed) % SF_CHANNELS;
+	uint32_t value = rand_r(&seed);
+	uint8_t which = rand_r(&seed) % 10;
+	switch (which)
+	{
+	case 0:
+		value %= 256;
+		snprintf(command, sizeof(command), "ATC+PRIO=%lu:%lu", (unsigned long)channel, (unsigned long)value);
+		break;
+	case 1:
+		value %= 50;
+		snprintf(command, sizeof(command), "ATC+DEADBAND=%lu:%lu", (unsigned long)channel, (unsigned long)value);
+		break;
+	case 2:
+		// Report-by-exception off most of the time, otherwise no uplinks are left to check
+		value = (value % 4 == 0) ? 60 + value % 600 : 0;
+		snprintf(command, sizeof(command), "ATC+RBE=%lu:%lu", (unsigned long)value, (unsigned long)(value / 2));
+		break;
+	case 3:
+		value = 1 + value % 255;
+		snprintf(command, sizeof(command), "ATC+KEYFRAME=%lu", (unsigned long)value);
+		break;
+	case 4:
+		value %= PAYLOAD_DELTA + 1;
+		snprintf(command, sizeof(command), "ATC+PAYLOAD=%lu", (unsigned long)value);
+		break;
+	case 5:
+		value = 1 + value % 4;
+		snprintf(command, sizeof(command), "ATC+BATCH=%lu", (unsigned long)value);
+		break;
+	case 6:
+		value %= 3601;
+		snprintf(command, sizeof(command), "ATC+THAGE=%lu", (unsigned long)value);
+		break;
+	case 7:
+		value %= ACQ_LEAD_MAX + 1;
+		snprintf(command, sizeof(command), "ATC+TXLEAD=%lu", (unsigned long)value);
+		break;
+	case 8:
+		// Around the 60 s of the uplink checks
+		value = 45 + (value % 3) * 15;
+		snprintf(command, sizeof(command), "ATC+SENDINT=%lu", (unsigned long)value);
+		break;
+	default:
+		value %= 2;
+		snprintf(command, sizeof(command), "ATC+VOCMODE=%lu", (unsigned long)value);
+		break;
+	}
+	int result = host_at(command);
+	at_sent++;
+	if (result == AT_BUSY_ERROR)
+	{
+		at_busy++;
+		return;
+	}
+	check(result == AT_OK, "AT command rejected");
+	at_ok++;
+	switch (which)
+	{
+	case 0:
+		expected.priority[channel] = value;
+		break;
+	case 1:
+		expected.deadband[channel] = value;
+		break;
+	case 2:
+		expected.heartbeat = value * 1000;
+		expected.min_gap = value / 2 * 1000;
+		break;
+	case 3:
+		expected.keyframe = value;
+		break;
+	case 4:
+		expected.format = value;
+		break;
+	case 5:
+		expected.batch = value;
+		break;
+	case 6:
+		expected.th_max_age = value * 1000;
+		break;
+	case 7:
+		expected.acq_lead = value;
+		break;
+	case 8:
+		expected.send_interval = value * 1000;
+		break;
+	default:
+		expected.voc_mode = value ? VOC_MODE_BURST : VOC_MODE_CONTINUOUS;
+		break;
+	}
+}
+
+/** Does nothing, fills the job queue */
+static void idle_job(void)
+{
+}
+
+/**
+ * @brief AT commands while the job queue is full
+ *        A command that gets AT_BUSY_ERROR must not change the setting
+ */
+static void test_busy(void)
+{
+	settings_t before;
+	read_settings(before);
+	while (bus_post(idle_job))
+	{
+	}
+	bool busy = (host_at("ATC+SENDINT=75") == AT_BUSY_ERROR) &&
+				(host_at(before.voc_mode == VOC_MODE_BURST ? "ATC+VOCMODE=0" : "ATC+VOCMODE=1") == AT_BUSY_ERROR);
+	bus_run();
+	settings_t applied;
+	read_settings(applied);
+	// Read back from flash
+	get_at_setting(SEND_INT_OFFSET);
+	get_at_setting(VOC_MODE_OFFSET);
+	settings_t saved;
+	read_settings(saved);
+	printf("  AT commands with a full job queue: %s, send interval %lu s, VOC mode %d\n", busy ? "busy" : "accepted",
+		   (unsigned long)(applied.send_interval / 1000), applied.voc_mode);
+	check(busy, "AT command accepted with a full job queue");
+	check(same_settings(before, applied), "busy AT command changed the setting");
+	check(same_settings(before, saved), "busy AT command saved the setting");
+}
+
+/**
+ * @brief AT command context, random commands until the node run ends
+ */
+static void at_thread(void)
+{
+	host_mark_foreign_thread();
+	unsigned int seed = TEST_SEED;
+	while (running)
+	{
+		random_at(seed);
+		// Let loop() run between the commands, bursts fill the queue
+		if (rand_r(&seed) % 8 == 0)
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(rand_r(&seed) % 200));
+		}
+	}
+}
+
+/**
+ * @brief Check that an LPP payload is a list of complete records
+ *        with each channel once
+ *
+ * @param data payload
+ * @param size payload size
+ * @return true if the payload is complete
+ */
+static bool lpp_complete(const uint8_t *data, size_t size)
+{
+	bool seen[256] = {false};
+	size_t pos = 0;
+	while (pos < size)
+	{
+		if (pos + 2 > size)
+		{
+			return false;
+		}
+		uint8_t channel = data[pos];
+		uint8_t length;
+		switch (data[pos + 1])
+		{
+		case LPP_DIGITAL_INPUT:
+		case LPP_DIGITAL_OUTPUT:
+		case LPP_PRESENCE:
+		case LPP_RELATIVE_HUMIDITY:
+		case LPP_PERCENTAGE:
+			length = 1;
+			break;
+		case LPP_ANALOG_INPUT:
+		case LPP_ANALOG_OUTPUT:
+		case LPP_LUMINOSITY:
+		case LPP_TEMPERATURE:
+		case LPP_BAROMETRIC_PRESSURE:
+		case LPP_VOLTAGE:
+		case LPP_CURRENT:
+		case LPP_CONCENTRATION:
+		case LPP_VOC:
+			length = 2;
+			break;
+		case LPP_GENERIC_SENSOR:
+		case LPP_UNIXTIME:
+			length = 4;
+			break;
+		default:
+			return false;
+		}
+		// Queued uplinks have several samples, each starts with its age
+		if (channel == LPP_CHANNEL_AGE)
+		{
+			memset(seen, 0, sizeof(seen));
+		}
+		else if (seen[channel])
+		{
+			return false;
+		}
+		seen[channel] = true;
+		pos += 2 + length;
+	}
+	return pos == size;
+}
+
+/**
+ * @brief Check the uplinks since the last call
+ *
+ * @param checked number of uplinks already checked
+ * @param formats bit n = uplinks on fPort n were seen
+ * @return number of uplinks with a broken payload
+ */
+static uint32_t check_uplinks(size_t &checked, uint32_t &formats)
+{
+	uint32_t broken = 0;
+	uint8_t max_size = max_payload_size();
+	for (; checked < host_uplinks.size(); checked++)
+	{
+		const host_uplink_t &uplink = host_uplinks[checked];
+		const uint8_t *data = uplink.data.data();
+		size_t size = uplink.data.size();
+		bool ok = (size > 0) && (size <= max_size);
+		switch (uplink.fport)
+		{
+		case 2:
+		case SF_FPORT:
+			ok = ok && lpp_complete(data, size);
+			break;
+		case BATCH_FPORT:
+			ok = ok && (size >= BATCH_HEADER_SIZE) && (data[0] == BATCH_FORMAT);
+			break;
+		case PACKED_FPORT:
+			ok = ok && (size <= PACKED_MAX_SIZE) && (data[0] == PACKED_SCHEMA);
+			break;
+		case DELTA_FPORT:
+			ok = ok && (size <= DELTA_MAX_SIZE);
+			break;
+		default:
+			ok = false;
+			break;
+		}
+		formats |= 1UL << (uplink.fport & 0x1F);
+		if (!ok && (broken++ < 5))
+		{
+			printf("  broken uplink on fPort %d, %d bytes, max %d:", uplink.fport, (int)size, max_size);
+			for (size_t idx = 0; idx < size; idx++)
+			{
+				printf(" %02X", data[idx]);
+			}
+			printf("\n");
+		}
+	}
+	return broken;
+}
+
+int main(void)
+{
+	host_default_node();
+	setup();
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	// The AT commands are applied from loop()
+	bus_run();
+	read_settings(expected);
+	test_busy();
+
+	printf("AT commands from a second thread during %d h of uplinks every 60 s\n", TEST_HOURS);
+	std::thread commands(at_thread);
+	size_t checked = host_uplinks.size();
+	uint32_t formats = 0;
+	uint32_t broken = 0;
+	const uint8_t data_rates[] = {0, 5, 2, 3};
+	for (uint32_t hour = 0; hour < TEST_HOURS; hour++)
+	{
+		host_dr = data_rates[hour % sizeof(data_rates)];
+		uint64_t end = host_now_us() + 3600000000ULL;
+		while (host_now_us() < end)
+		{
+			uint32_t sent = at_sent;
+			host_run_until(host_now_us() + 60000000ULL);
+			broken += check_uplinks(checked, formats);
+			// At least one AT command per send interval, at a random point of loop()
+			while (at_sent < sent + 2)
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+	running = false;
+	commands.join();
+
+	// Jobs of the last AT commands
+	bus_run();
+	printf("  %lu AT commands, %lu accepted, %lu busy, %lu uplinks, %lu broken, %lu I2C access from the AT context\n",
+		   (unsigned long)at_sent.load(), (unsigned long)at_ok, (unsigned long)at_busy, (unsigned long)host_uplinks.size(),
+		   (unsigned long)broken, (unsigned long)host_bus_violations);
+	check(host_bus_violations == 0, "AT command accessed the I2C bus");
+	check(broken == 0, "broken payloads");
+	// Up to 4 samples per batch uplink and report-by-exception leave out uplinks
+	check(host_uplinks.size() > TEST_HOURS * 60 / 8, "uplinks missing");
+	check((formats & (1UL << 2)) && (formats & (1UL << PACKED_FPORT)) && (formats & (1UL << DELTA_FPORT)) &&
+			  (formats & (1UL << BATCH_FPORT)),
+		  "payload formats not all used");
+
+	// Every accepted AT command is applied, the last value wins
+	settings_t applied;
+	read_settings(applied);
+	check(same_settings(applied, expected), "settings of the last AT commands not applied");
+
+	// And saved, read back from flash
+	memset(g_plan_priority, 0xEE, sizeof(g_plan_priority));
+	memset(g_sod_deadband, 0xEE, SF_CHANNELS * sizeof(g_sod_deadband[0]));
+	g_sod_heartbeat = g_sod_min_gap = g_bme_th_max_age = g_acq_lead_min = 0xEEEE;
+	g_lorawan_settings.send_repeat_time = 0xEEEE;
+	g_delta_keyframe_interval = g_payload_format = g_batch_samples = g_voc_mode = 0xEE;
+	const uint32_t offsets[] = {PRIORITY_OFFSET, DEADBAND_OFFSET, SOD_OFFSET, KEYFRAME_OFFSET, PAYLOAD_FORMAT_OFFSET,
+								BATCH_OFFSET, TH_AGE_OFFSET, ACQ_LEAD_OFFSET, SEND_INT_OFFSET, VOC_MODE_OFFSET};
+	for (uint8_t idx = 0; idx < sizeof(offsets) / sizeof(offsets[0]); idx++)
+	{
+		get_at_setting(offsets[idx]);
+	}
+	settings_t saved;
+	read_settings(saved);
+	check(same_settings(saved, expected), "settings of the last AT commands not saved");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
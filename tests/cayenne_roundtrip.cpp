@@ -0,0 +1,511 @@
+/**
+ * @file cayenne_roundtrip.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the WisCayenne encoder against the LPP decoder
+ *        Encodes random records with the WisCayenne types and the
+ *        CayenneLPP types of the stub, decodes them with
+ *        tools/lpp_decoder.h, the reference for the decoders in
+ *        decoders/, and checks every value within its resolution.
+ *        Fills encoders of every size from 0 bytes until they
+ *        overflow and checks that no value is written past the
+ *        max size, decodes every truncated prefix of the payloads
+ *        and random bytes. Reports the encoder throughput in
+ *        records/s.
+ *
+ *        Build and run on the host:
+ *          g++ -O2 -std=c++11 -Itests/stubs -I. -o cayenne_roundtrip \
+ *            tests/cayenne_roundtrip.cpp wisblock_cayenne.cpp
+ *          ./cayenne_roundtrip
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <chrono>
+#include <math.h>
+#include "wisblock_cayenne.h"
+#include "tools/lpp_decoder.h"
+
+/** Random records encoded and decoded */
+#define TEST_RECORDS 200000
+/** Records encoded for the throughput */
+#define TEST_BENCH_RECORDS 5000000
+/** Largest encoder of the overflow test */
+#define TEST_MAX_SIZE 64
+/** Random payloads of the decoder fuzz test */
+#define TEST_FUZZ 100000
+/** Random seed */
+#define TEST_SEED 4711
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+static uint32_t random_state = TEST_SEED;
+
+/**
+ * @brief Random number 0 .. 0xFFFFFFFF
+ */
+static uint32_t random_next(void)
+{
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 17;
+	random_state ^= random_state << 5;
+	return random_state;
+}
+
+static int32_t random_range(int32_t min, int32_t max)
+{
+	return min + (int32_t)(random_next() % (uint32_t)((int64_t)max - min + 1));
+}
+
+/** Expected value of one decoded row */
+struct expected_t
+{
+	uint8_t channel;
+	uint8_t type;
+	uint8_t component;
+	double value;
+	/** Allowed difference, the CayenneLPP float types truncate */
+	double tolerance;
+};
+
+/** Add functions of the test */
+enum
+{
+	ADD_TEMPERATURE_X10,
+	ADD_HUMIDITY_X2,
+	ADD_PRESSURE_X10,
+	ADD_ANALOG_X100,
+	ADD_GENERIC_U32,
+	ADD_VOC,
+	ADD_GNSS_4,
+	ADD_GNSS_6,
+	ADD_TEMPERATURE,
+	ADD_HUMIDITY,
+	ADD_VOLTAGE,
+	ADD_CONCENTRATION,
+	ADD_FUNCTIONS
+};
+
+/** Data size of the values of each add function, without channel and type */
+static const uint8_t add_size[ADD_FUNCTIONS] = {2, 1, 2, 2, 4, 2, 9, 11, 2, 1, 2, 2};
+
+/**
+ * @brief Add a random value with one of the add functions
+ *
+ * @param lpp encoder
+ * @param function ADD_xxx
+ * @param expected rows the decoder has to return, appended if the value was added
+ * @return uint8_t result of the add function
+ */
+static uint8_t add_random(WisCayenne &lpp, uint8_t function, std::vector<expected_t> &expected)
+{
+	uint8_t channel = (uint8_t)random_range(0, 255);
+	expected_t row[LPP_MAX_COMPONENTS];
+	uint8_t rows = 1;
+	uint8_t result = 0;
+	for (uint8_t idx = 0; idx < LPP_MAX_COMPONENTS; idx++)
+	{
+		row[idx].channel = channel;
+		row[idx].component = idx;
+		row[idx].tolerance = 1e-9;
+	}
+
+	switch (function)
+	{
+	case ADD_TEMPERATURE_X10:
+	{
+		int16_t value = (int16_t)random_range(-32768, 32767);
+		result = lpp.addTemperature_x10(channel, value);
+		row[0].type = LPP_TEMPERATURE;
+		row[0].value = value / 10.0;
+		break;
+	}
+	case ADD_HUMIDITY_X2:
+	{
+		uint8_t value = (uint8_t)random_range(0, 255);
+		result = lpp.addRelativeHumidity_x2(channel, value);
+		row[0].type = LPP_RELATIVE_HUMIDITY;
+		row[0].value = value / 2.0;
+		break;
+	}
+	case ADD_PRESSURE_X10:
+	{
+		uint16_t value = (uint16_t)random_range(0, 65535);
+		result = lpp.addBarometricPressure_x10(channel, value);
+		row[0].type = LPP_BAROMETRIC_PRESSURE;
+		row[0].value = value / 10.0;
+		break;
+	}
+	case ADD_ANALOG_X100:
+	{
+		int16_t value = (int16_t)random_range(-32768, 32767);
+		result = lpp.addAnalogInput_x100(channel, value);
+		row[0].type = LPP_ANALOG_INPUT;
+		row[0].value = value / 100.0;
+		break;
+	}
+	case ADD_GENERIC_U32:
+	{
+		uint32_t value = random_next();
+		result = lpp.addGenericSensor_u32(channel, value);
+		row[0].type = LPP_GENERIC_SENSOR;
+		row[0].value = value;
+		break;
+	}
+	case ADD_VOC:
+	{
+		// Larger than 2 bytes now and then, clamped
+		uint32_t value = (random_next() % 8 == 0) ? random_next() : (uint32_t)random_range(0, 500);
+		result = lpp.addVoc_index(channel, value);
+		row[0].type = LPP_VOC;
+		row[0].value = value > 0xFFFF ? 0xFFFF : value;
+		break;
+	}
+	case ADD_GNSS_4:
+	case ADD_GNSS_6:
+	{
+		// 1e-7 ° and mm like the GNSS receiver reports them
+		int32_t latitude = random_range(-900000000, 900000000);
+		int32_t longitude = random_range(-1800000000, 1800000000);
+		int32_t altitude = random_range(-100000, 9000000);
+		bool precise = (function == ADD_GNSS_6);
+		result = precise ? lpp.addGNSS_6(channel, (uint32_t)latitude, (uint32_t)longitude, (uint32_t)altitude)
+						 : lpp.addGNSS_4(channel, (uint32_t)latitude, (uint32_t)longitude, (uint32_t)altitude);
+		rows = 3;
+		row[0].type = row[1].type = row[2].type = precise ? LPP_GPS6 : LPP_GPS4;
+		// Divided as signed values, truncated towards 0
+		row[0].value = precise ? (latitude / 10) / 1e6 : (latitude / 1000) / 1e4;
+		row[1].value = precise ? (longitude / 10) / 1e6 : (longitude / 1000) / 1e4;
+		row[2].value = (altitude / 10) / 100.0;
+		break;
+	}
+	case ADD_TEMPERATURE:
+	{
+		float value = random_range(-3000, 3000) / 100.0f;
+		result = lpp.addTemperature(channel, value);
+		row[0].type = LPP_TEMPERATURE;
+		row[0].value = value;
+		row[0].tolerance = 0.1;
+		break;
+	}
+	case ADD_HUMIDITY:
+	{
+		float value = random_range(0, 10000) / 100.0f;
+		result = lpp.addRelativeHumidity(channel, value);
+		row[0].type = LPP_RELATIVE_HUMIDITY;
+		row[0].value = value;
+		row[0].tolerance = 0.5;
+		break;
+	}
+	case ADD_VOLTAGE:
+	{
+		float value = random_range(0, 600) / 100.0f;
+		result = lpp.addVoltage(channel, value);
+		row[0].type = LPP_VOLTAGE;
+		row[0].value = value;
+		row[0].tolerance = 0.01;
+		break;
+	}
+	default:
+	{
+		uint32_t value = (uint32_t)random_range(0, 65535);
+		result = lpp.addConcentration(channel, value);
+		row[0].type = LPP_CONCENTRATION;
+		row[0].value = value;
+		break;
+	}
+	}
+
+	if (result != 0)
+	{
+		for (uint8_t idx = 0; idx < rows; idx++)
+		{
+			expected.push_back(row[idx]);
+		}
+	}
+	return result;
+}
+
+/**
+ * @brief Compare the decoded rows with the expected ones
+ *
+ * @return uint32_t number of wrong rows
+ */
+static uint32_t compare(const lpp_columns_t &columns, const std::vector<expected_t> &expected)
+{
+	uint32_t wrong = 0;
+	for (size_t row = 0; row < expected.size(); row++)
+	{
+		const expected_t &want = expected[row];
+		if ((row >= columns.count) || (columns.channel[row] != want.channel) || (columns.type[row] != want.type) ||
+			(columns.component[row] != want.component) || (fabs(columns.value[row] - want.value) > want.tolerance + 1e-9))
+		{
+			wrong++;
+		}
+	}
+	return wrong + (columns.count > expected.size() ? (uint32_t)(columns.count - expected.size()) : 0);
+}
+
+/**
+ * @brief Encode random records and decode them
+ */
+static void test_round_trip(void)
+{
+	WisCayenne lpp(255);
+	lpp_columns_t columns(255);
+	std::vector<expected_t> expected;
+	uint32_t broken = 0;
+	uint32_t wrong = 0;
+	uint32_t values = 0;
+	uint32_t truncated_ok = 0;
+	uint32_t truncated_wrong = 0;
+	for (uint32_t record = 0; record < TEST_RECORDS; record++)
+	{
+		lpp.reset();
+		expected.clear();
+		uint8_t fields = (uint8_t)random_range(1, 12);
+		// Field ends, for the truncated payloads
+		std::vector<uint8_t> ends;
+		for (uint8_t field = 0; field < fields; field++)
+		{
+			if (add_random(lpp, (uint8_t)random_range(0, ADD_FUNCTIONS - 1), expected) != 0)
+			{
+				ends.push_back(lpp.getSize());
+			}
+		}
+		values += expected.size();
+
+		columns.clear();
+		if (lpp_decode(lpp.getBuffer(), lpp.getSize(), record, columns) < 0)
+		{
+			broken++;
+			continue;
+		}
+		wrong += compare(columns, expected);
+
+		// Every prefix that ends inside a value is rejected without values
+		if (record % 16 == 0)
+		{
+			for (uint8_t size = 1; size < lpp.getSize(); size++)
+			{
+				bool at_end = false;
+				for (size_t idx = 0; idx < ends.size(); idx++)
+				{
+					at_end |= (ends[idx] == size);
+				}
+				columns.clear();
+				int result = lpp_decode(lpp.getBuffer(), size, record, columns);
+				bool ok = at_end ? (result > 0) : ((result == LPP_DECODE_TRUNCATED) && (columns.count == 0));
+				truncated_ok += ok ? 1 : 0;
+				truncated_wrong += ok ? 0 : 1;
+			}
+		}
+	}
+	printf("Round trip of %d random records, %lu values: %lu broken, %lu wrong values\n", TEST_RECORDS, (unsigned long)values,
+		   (unsigned long)broken, (unsigned long)wrong);
+	printf("Truncated payloads: %lu rejected or decoded up to the last complete value, %lu wrong\n",
+		   (unsigned long)truncated_ok, (unsigned long)truncated_wrong);
+	check(broken == 0, "encoded record not decoded");
+	check(wrong == 0, "decoded value differs from the encoded value");
+	check(truncated_wrong == 0, "truncated payload not rejected");
+}
+
+/**
+ * @brief Encoder with canary bytes behind its max size
+ *
+ */
+class guarded_lpp : public WisCayenne
+{
+public:
+	uint8_t guard[TEST_MAX_SIZE + 32];
+
+	guarded_lpp(uint8_t size) : WisCayenne(size)
+	{
+		original = _buffer;
+		memset(guard, 0xA5, sizeof(guard));
+		_buffer = guard;
+	}
+	~guarded_lpp() { _buffer = original; }
+
+	bool intact(void) const
+	{
+		for (size_t idx = _maxsize; idx < sizeof(guard); idx++)
+		{
+			if (guard[idx] != 0xA5)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	uint8_t *original;
+};
+
+/**
+ * @brief Fill encoders of every size until they overflow
+ */
+static void test_overflow(void)
+{
+	uint32_t overruns = 0;
+	uint32_t wrong_size = 0;
+	uint32_t not_reported = 0;
+	uint32_t broken = 0;
+	uint32_t overflows = 0;
+	for (uint8_t max_size = 0; max_size <= TEST_MAX_SIZE; max_size++)
+	{
+		for (uint32_t run = 0; run < 200; run++)
+		{
+			guarded_lpp lpp(max_size);
+			std::vector<expected_t> expected;
+			lpp.getError();
+			// Some adds after the first overflow, smaller values can still fit
+			uint8_t failed = 0;
+			while (failed < 4)
+			{
+				uint8_t function = (uint8_t)random_range(0, ADD_FUNCTIONS - 1);
+				uint8_t before = lpp.getSize();
+				uint8_t result = add_random(lpp, function, expected);
+				bool fits = before + 2 + add_size[function] <= max_size;
+				if (result == 0)
+				{
+					failed++;
+					overflows++;
+					not_reported += (lpp.getError() == LPP_ERROR_OVERFLOW) ? 0 : 1;
+				}
+				wrong_size += (lpp.getSize() != (fits ? before + 2 + add_size[function] : before)) ? 1 : 0;
+				wrong_size += ((result != 0) != fits) ? 1 : 0;
+				overruns += lpp.intact() ? 0 : 1;
+			}
+			lpp_columns_t columns(TEST_MAX_SIZE);
+			if ((lpp_decode(lpp.getBuffer(), lpp.getSize(), 0, columns) < 0) || (compare(columns, expected) != 0))
+			{
+				broken++;
+			}
+		}
+	}
+	printf("Encoders of 0 to %d bytes: %lu overflows, %lu not reported, %lu wrong sizes, %lu writes past the max size, %lu broken\n",
+		   TEST_MAX_SIZE, (unsigned long)overflows, (unsigned long)not_reported, (unsigned long)wrong_size,
+		   (unsigned long)overruns, (unsigned long)broken);
+	check(not_reported == 0, "overflow not reported by getError()");
+	check(wrong_size == 0, "value added although it does not fit or not added although it fits");
+	check(overruns == 0, "value written past the max size");
+	check(broken == 0, "payload of a full encoder not decoded");
+}
+
+/**
+ * @brief GNSS in the Helium Mapper format has no channel and type
+ */
+static void test_gnss_h(void)
+{
+	uint32_t wrong = 0;
+	for (uint32_t run = 0; run < 10000; run++)
+	{
+		WisCayenne lpp(LPP_GPSH_SIZE);
+		int32_t latitude = random_range(-900000000, 900000000);
+		int32_t longitude = random_range(-1800000000, 1800000000);
+		uint16_t altitude = (uint16_t)random_range(0, 65535);
+		uint16_t accuracy = (uint16_t)random_range(0, 65535);
+		uint16_t battery = (uint16_t)random_range(0, 65535);
+		lpp.addGNSS_H((uint32_t)latitude, (uint32_t)longitude, altitude, accuracy, battery);
+		const uint8_t *data = lpp.getBuffer();
+		// LSB first
+		int32_t lat = (int32_t)(data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24));
+		int32_t lon = (int32_t)(data[4] | (data[5] << 8) | (data[6] << 16) | ((uint32_t)data[7] << 24));
+		bool ok = (lpp.getSize() == LPP_GPSH_SIZE) && (lat == latitude / 100) && (lon == longitude / 100) &&
+				  ((data[8] | (data[9] << 8)) == altitude / 1000) && ((data[10] | (data[11] << 8)) == accuracy) &&
+				  ((data[12] | (data[13] << 8)) == battery);
+		wrong += ok ? 0 : 1;
+	}
+	printf("GNSS Helium Mapper format: %lu wrong\n", (unsigned long)wrong);
+	check(wrong == 0, "GNSS Helium Mapper format wrong");
+}
+
+/**
+ * @brief Decode random bytes, the decoder must not read past the payload
+ */
+static void test_fuzz(void)
+{
+	uint8_t payload[64];
+	lpp_columns_t columns(64);
+	uint32_t decoded = 0;
+	uint32_t rejected = 0;
+	uint32_t wrong = 0;
+	for (uint32_t run = 0; run < TEST_FUZZ; run++)
+	{
+		uint8_t size = (uint8_t)random_range(0, sizeof(payload));
+		for (uint8_t idx = 0; idx < size; idx++)
+		{
+			// Mostly the types of the node, so longer payloads get decoded
+			payload[idx] = (random_next() % 2) ? (uint8_t)random_next() : lpp_types[random_next() % (sizeof(lpp_types) / sizeof(lpp_types[0]))].type;
+		}
+		columns.clear();
+		int result = lpp_decode(payload, size, run, columns);
+		if (result >= 0)
+		{
+			decoded++;
+			wrong += (columns.count != (size_t)result) ? 1 : 0;
+		}
+		else
+		{
+			rejected++;
+			wrong += ((columns.count != 0) || ((result != LPP_DECODE_TRUNCATED) && (result != LPP_DECODE_UNKNOWN_TYPE))) ? 1 : 0;
+		}
+	}
+	printf("Random payloads: %lu decoded, %lu rejected, %lu wrong\n", (unsigned long)decoded, (unsigned long)rejected,
+		   (unsigned long)wrong);
+	check(wrong == 0, "random payload decoded wrongly");
+}
+
+/**
+ * @brief Encoder throughput with the values of the node
+ */
+static void test_throughput(void)
+{
+	WisCayenne lpp(255);
+	uint32_t bytes = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (uint32_t record = 0; record < TEST_BENCH_RECORDS; record++)
+	{
+		// Same types and order as the encode functions of the sensor modules
+		lpp.reset();
+		lpp.addRelativeHumidity_x2(6, (uint8_t)(80 + (record & 0x1F)));
+		lpp.addTemperature_x10(7, (int16_t)(200 + (record & 0x3F)));
+		lpp.addBarometricPressure_x10(8, (uint16_t)(10100 + (record & 0xFF)));
+		lpp.addAnalogInput_x100(9, (int16_t)(12000 + (record & 0x3FF)));
+		lpp.addConcentration(35, 400 + (record & 0x3FF));
+		lpp.addTemperature(36, 21.5f + (record & 0x0F) / 10.0f);
+		lpp.addRelativeHumidity(37, 40.0f + (record & 0x0F) / 2.0f);
+		lpp.addVoc_index(16, 100 + (record & 0x7F));
+		lpp.addVoltage(1, 3.9f);
+		bytes += lpp.getSize() + lpp.getBuffer()[lpp.getSize() - 1];
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	printf("Encoder: %d records of 9 values in %.3f s, %.0f records/s, %.0f values/s (check %lu)\n", TEST_BENCH_RECORDS, seconds,
+		   TEST_BENCH_RECORDS / seconds, TEST_BENCH_RECORDS * 9 / seconds, (unsigned long)bytes);
+	check(bytes != 0, "no records encoded");
+}
+
+int main(void)
+{
+	test_round_trip();
+	test_overflow();
+	test_gnss_h();
+	test_fuzz();
+	test_throughput();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
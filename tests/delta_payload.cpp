@@ -0,0 +1,334 @@
+/**
+ * @file delta_payload.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the keyframe and delta payload on DELTA_FPORT
+ *        Encodes a synthetic indoor trace (daily cycle, occupancy
+ *        with CO2 and VOC peaks, noise, a module that is not valid
+ *        for a while) with delta_encode() and drops uplinks at
+ *        random like a radio link. A stateful reference decoder,
+ *        the same as decoders/Delta-Reference-Decoder.js, decodes
+ *        the uplinks that arrive. Every decoded sample has to equal
+ *        the sample that was encoded. Runs with and without the
+ *        downlink that requests a keyframe after a lost keyframe.
+ *        Reports bytes per uplink against LPP and the samples that
+ *        could not be decoded.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o delta_payload \
+ *            tests/delta_payload.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./delta_payload
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Uplinks per run, 15 minutes apart */
+#define TEST_UPLINKS 10000
+/** Time between two uplinks in s */
+#define TEST_SENDINT 900
+/** Random seed */
+#define TEST_SEED 4711
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+static uint32_t random_state = TEST_SEED;
+
+/**
+ * @brief Random number 0 .. 65535
+ */
+static uint32_t random_next(void)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return (random_state >> 16) & 0xFFFF;
+}
+
+/**
+ * @brief Stateful reference decoder, like decoders/Delta-Reference-Decoder.js
+ *
+ */
+struct delta_decoder_t
+{
+	bool has_key;
+	uint8_t key_id;
+	uint16_t key_channels;
+	int32_t key_value[SF_CHANNELS];
+	uint8_t last_counter;
+	/** Deltas lost between two received ones, from the counters */
+	uint32_t lost;
+
+	delta_decoder_t() : has_key(false), key_id(0), key_channels(0), last_counter(0), lost(0) {}
+
+	static bool read_varint(const uint8_t *data, size_t size, size_t &pos, uint32_t &value)
+	{
+		value = 0;
+		uint8_t shift = 0;
+		uint8_t next;
+		do
+		{
+			if ((pos >= size) || (shift > 28))
+			{
+				return false;
+			}
+			next = data[pos++];
+			value |= (uint32_t)(next & 0x7F) << shift;
+			shift += 7;
+		} while (next & 0x80);
+		return true;
+	}
+
+	/**
+	 * @brief Decode one uplink
+	 *
+	 * @param data payload
+	 * @param size payload size
+	 * @param channels valid values of the sample
+	 * @param value values of the sample, index is SF_CH_xxx
+	 * @param key_missing set if the uplink refers to a keyframe that was not received
+	 * @return true if the sample was decoded
+	 */
+	bool decode(const uint8_t *data, size_t size, uint16_t &channels, int32_t *value, bool &key_missing)
+	{
+		key_missing = false;
+		if (size < 1)
+		{
+			return false;
+		}
+		bool keyframe = (data[0] & DELTA_KEYFRAME) != 0;
+		uint8_t id = data[0] & 0x7F;
+		size_t pos = 1;
+		uint8_t counter = 0;
+		if (!keyframe)
+		{
+			if (pos >= size)
+			{
+				return false;
+			}
+			counter = data[pos++];
+		}
+		uint32_t bitmap;
+		if (!read_varint(data, size, pos, bitmap))
+		{
+			return false;
+		}
+		int32_t field[SF_CHANNELS];
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (bitmap & (1 << channel))
+			{
+				uint32_t zigzag;
+				if (!read_varint(data, size, pos, zigzag))
+				{
+					return false;
+				}
+				field[channel] = (int32_t)(zigzag >> 1) ^ -(int32_t)(zigzag & 1);
+			}
+		}
+		if (pos != size)
+		{
+			return false;
+		}
+
+		if (keyframe)
+		{
+			has_key = true;
+			key_id = id;
+			key_channels = (uint16_t)bitmap;
+			memcpy(key_value, field, sizeof(key_value));
+			last_counter = 0;
+			channels = key_channels;
+			memcpy(value, key_value, sizeof(key_value));
+			return true;
+		}
+		if (!has_key || (key_id != id) || ((bitmap & ~key_channels) != 0))
+		{
+			key_missing = true;
+			return false;
+		}
+		if (counter > last_counter + 1)
+		{
+			lost += counter - last_counter - 1;
+		}
+		last_counter = counter;
+		// Values without delta did not change since the keyframe
+		channels = key_channels;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			value[channel] = key_value[channel] + ((bitmap & (1 << channel)) ? field[channel] : 0);
+		}
+		return true;
+	}
+};
+
+/**
+ * @brief Sample of the synthetic indoor trace
+ *        Daily temperature cycle, occupied from 8:00 to 18:00 with
+ *        rising CO2 and VOC, sensor noise, the RAK12037 is not
+ *        valid for the first 30 minutes of every 5th day
+ *
+ * @param idx uplink number
+ * @param values sample
+ * @param battery battery voltage in V
+ */
+static void trace_sample(uint32_t idx, sensor_snapshot_t &values, float &battery)
+{
+	double t = (double)idx * TEST_SENDINT;
+	double hour = fmod(t / 3600.0, 24.0);
+	bool occupied = (hour >= 8.0) && (hour < 18.0);
+	double occupied_h = occupied ? hour - 8.0 : 0.0;
+	double noise = ((int32_t)(random_next() % 21) - 10) / 10.0;
+
+	memset(&values, 0, sizeof(values));
+	values.env_valid = true;
+	values.env_temperature = (int32_t)((21.0 + 1.5 * sin(2.0 * M_PI * (hour - 9.0) / 24.0) + 0.05 * noise) * 100.0);
+	values.env_humidity = (int32_t)((45.0 + 5.0 * sin(2.0 * M_PI * hour / 24.0) + 0.5 * noise) * 1000.0);
+	values.env_pressure = (int32_t)(101300.0 + 300.0 * sin(2.0 * M_PI * t / (5.0 * 86400.0)) + 5.0 * noise);
+	values.env_gas = (uint32_t)(150000.0 - 20000.0 * (occupied_h / 10.0) + 500.0 * noise);
+	values.co2_valid = !((idx % (5 * 96)) < 2);
+	values.co2 = (uint16_t)(450.0 + 600.0 * (1.0 - exp(-occupied_h / 2.0)) + 5.0 * noise);
+	values.co2_temperature = (float)(values.env_temperature / 100.0 + 0.3);
+	values.co2_humidity = (float)(values.env_humidity / 1000.0 - 1.0);
+	values.voc_valid = true;
+	values.voc_index = (int32_t)(100.0 + 80.0 * (occupied_h / 10.0) + 3.0 * noise);
+	values.co2_timestamp = millis();
+	battery = 3.9f - (float)(idx / 2000) * 0.01f;
+}
+
+/**
+ * @brief Encode the trace and decode the uplinks that arrive
+ *
+ * @param loss_percent uplinks lost in percent
+ * @param request a lost keyframe is requested with a downlink
+ * @param lpp_bytes bytes of the LPP uplinks of the same samples, 0 = not measured
+ */
+static void run(uint8_t loss_percent, bool request, uint32_t &lpp_bytes)
+{
+	random_state = TEST_SEED;
+	// Fresh decoder, e.g. after a join, starts with a keyframe
+	delta_decoder_t decoder;
+	delta_request_keyframe();
+
+	uint32_t bytes = 0;
+	uint32_t keyframes = 0;
+	uint32_t received = 0;
+	uint32_t decoded = 0;
+	uint32_t missing = 0;
+	uint32_t wrong = 0;
+	uint32_t broken = 0;
+	uint32_t too_large = 0;
+	uint32_t lost_keyframes = 0;
+	bool measure_lpp = (lpp_bytes == 0);
+	for (uint32_t idx = 0; idx < TEST_UPLINKS; idx++)
+	{
+		sensor_snapshot_t values;
+		float battery;
+		trace_sample(idx, values, battery);
+		if (measure_lpp)
+		{
+			g_solution_data.reset();
+			encode_sensor_values(values);
+			g_solution_data.addVoltage(LPP_CHANNEL_BATT, battery);
+			lpp_bytes += g_solution_data.getSize();
+		}
+
+		uint8_t size = delta_encode(values, battery);
+		too_large += (size > DELTA_MAX_SIZE) ? 1 : 0;
+		bytes += size;
+		bool keyframe = (delta_payload()[0] & DELTA_KEYFRAME) != 0;
+		keyframes += keyframe ? 1 : 0;
+		// Unconfirmed uplink, the node does not know if it arrived
+		delta_sent();
+
+		if ((random_next() % 100) < loss_percent)
+		{
+			lost_keyframes += keyframe ? 1 : 0;
+			continue;
+		}
+		received++;
+		uint16_t channels;
+		int32_t value[SF_CHANNELS];
+		bool key_missing;
+		if (!decoder.decode(delta_payload(), size, channels, value, key_missing))
+		{
+			if (!key_missing)
+			{
+				broken++;
+			}
+			missing++;
+			// The downlink goes through the same radio link
+			if (key_missing && request && ((random_next() % 100) >= loss_percent))
+			{
+				delta_request_keyframe();
+			}
+			continue;
+		}
+		decoded++;
+
+		sf_record_t record;
+		sf_make_record(record, values, battery);
+		bool ok = (channels == sf_record_channels(record));
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if ((channels & (1 << channel)) && (value[channel] != sf_record_value(record, channel)))
+			{
+				ok = false;
+			}
+		}
+		wrong += ok ? 0 : 1;
+	}
+
+	printf("  %3d %% loss, %-10s %5.2f bytes/uplink, %4lu keyframes, %5lu received, %5lu decoded, %4lu not decodable, %4lu lost by the counters, %lu wrong\n",
+		   loss_percent, request ? "request" : "no request", (double)bytes / TEST_UPLINKS, (unsigned long)keyframes,
+		   (unsigned long)received, (unsigned long)decoded, (unsigned long)missing, (unsigned long)decoder.lost, (unsigned long)wrong);
+	check(broken == 0, "uplink not decoded");
+	check(too_large == 0, "uplink larger than DELTA_MAX_SIZE");
+	check(wrong == 0, "decoded sample differs from the encoded sample");
+	check(decoded + missing == received, "uplinks not counted");
+	check(bytes * 2 < lpp_bytes, "delta payload not smaller than half of the LPP payload");
+	// Only the deltas after a lost keyframe cannot be decoded
+	check(missing <= lost_keyframes * g_delta_keyframe_interval, "more samples lost than the deltas of the lost keyframes");
+	if (loss_percent == 0)
+	{
+		check(decoded == TEST_UPLINKS, "samples not decoded without loss");
+	}
+	else if (request)
+	{
+		// One uplink per lost keyframe until the downlink arrives, the next uplink is a keyframe
+		check(missing * (100 - loss_percent) <= lost_keyframes * 100 * 2, "keyframe request does not limit the losses");
+	}
+}
+
+int main(void)
+{
+	found_sensors[ENV_ID].found_sensor = true;
+	found_sensors[CO2_ID].found_sensor = true;
+	found_sensors[VOC_ID].found_sensor = true;
+
+	printf("Delta payload, %d uplinks of a synthetic indoor trace, keyframe every %d uplinks\n", TEST_UPLINKS, g_delta_keyframe_interval);
+	uint32_t lpp_bytes = 0;
+	run(0, false, lpp_bytes);
+	printf("  LPP %5.2f bytes/uplink\n", (double)lpp_bytes / TEST_UPLINKS);
+	const uint8_t losses[] = {10, 30};
+	for (uint8_t idx = 0; idx < sizeof(losses); idx++)
+	{
+		run(losses[idx], false, lpp_bytes);
+		run(losses[idx], true, lpp_bytes);
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
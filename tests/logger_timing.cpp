@@ -0,0 +1,231 @@
+/**
+ * @file logger_timing.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the deferred debug logger
+ *        Runs the sketch on the simulated node with a 115200 baud
+ *        UART and reports the awake time per uplink cycle and the
+ *        delay of the uplinks after their TX slot. Checks that the
+ *        setup() output is complete, that every line has the level
+ *        prefix and that lines pushed from several threads are not
+ *        mixed up.
+ *
+ *        Build and run on the host, deferred logger:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o logger_timing \
+ *            tests/logger_timing.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./logger_timing
+ *
+ *        Same with the blocking MYLOG of the original sketch
+ *        (3 x Serial.printf and delay(100) per message) for comparison:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -DLOG_LEGACY -Itests/stubs -I. -o logger_legacy \
+ *            tests/logger_timing.cpp tests/stubs/host_stubs.cpp $(ls *.cpp | grep -v debug_log.cpp) \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./logger_legacy
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include <thread>
+
+/** Uplink cycles measured */
+#define TEST_CYCLES 50
+/** UART time per byte at 115200 baud */
+#define TEST_UART_BYTE_US 87
+
+#ifdef LOG_LEGACY
+#define LOG_VARIANT "Blocking"
+#else
+#define LOG_VARIANT "Deferred"
+#endif
+
+#ifdef LOG_LEGACY
+// MYLOG of the original sketch, prints right away and waits 100 ms
+void log_push(uint8_t level, const char *tag, const char *format, ...)
+{
+	(void)level;
+	char line[LOG_LINE_SIZE];
+	va_list args;
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+	if (tag)
+	{
+		Serial.printf("[%s] ", tag);
+	}
+	Serial.printf("%s", line);
+	Serial.printf("\n");
+	delay(100);
+}
+void log_flush(void) {}
+void log_set_filter(const char *) {}
+void log_set_deferred(bool) {}
+#endif
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Count the lines of the captured output that contain a text
+ */
+static int count_lines(const std::string &output, const char *text)
+{
+	int count = 0;
+	size_t pos = 0;
+	while ((pos = output.find(text, pos)) != std::string::npos)
+	{
+		count++;
+		pos++;
+	}
+	return count;
+}
+
+/**
+ * @brief Boot the node and measure the uplink cycles
+ */
+static void test_uplink_cycles(void)
+{
+	host_default_node();
+	host_serial_byte_us = TEST_UART_BYTE_US;
+
+	setup();
+	uint64_t setup_time = host_now_us();
+	std::string setup_output = host_serial_out;
+
+	// Setup output is complete, 12 AT commands and the module scan
+	check(count_lines(setup_output, "Add custom AT command") == 12, "setup() messages missing");
+	check(count_lines(setup_output, "messages dropped") == 0, "setup() messages dropped");
+#ifndef LOG_LEGACY
+	check(setup_output.find("I [SETUP] RAKwireless") != std::string::npos, "level prefix missing");
+#endif
+
+	// First cycle fills the running averages of the acquisition time
+	host_run_until(host_now_us() + g_lorawan_settings.send_repeat_time * 1000ULL);
+	uint64_t awake_start = host_awake_us;
+	uint64_t time_start = host_now_us();
+	size_t uplinks_start = host_uplinks.size();
+	uint32_t jitter_start = uplink_stats.jitter_sum;
+	uint32_t count_start = uplink_stats.uplinks;
+	uplink_stats.max_jitter = 0;
+
+	host_run_until(time_start + TEST_CYCLES * g_lorawan_settings.send_repeat_time * 1000ULL);
+
+	size_t uplinks = host_uplinks.size() - uplinks_start;
+	uint32_t cycles = uplink_stats.uplinks - count_start;
+	check(uplinks >= TEST_CYCLES - 1, "uplinks missing");
+	check(count_lines(host_serial_out, "messages dropped") == 0, "messages dropped in the uplink cycles");
+
+	printf("%s logger, UART %d us/byte\n", LOG_VARIANT, TEST_UART_BYTE_US);
+	printf("  setup():            %.1f ms, %d bytes of output\n", setup_time / 1000.0, (int)setup_output.size());
+	printf("  uplinks:            %d in %d cycles\n", (int)uplinks, cycles);
+	printf("  awake per cycle:    %.1f ms\n", (host_awake_us - awake_start) / 1000.0 / cycles);
+	printf("  TX delay after slot: avg %.1f ms, max %lu ms\n", (double)(uplink_stats.jitter_sum - jitter_start) / cycles,
+		   (unsigned long)uplink_stats.max_jitter);
+}
+
+#ifndef LOG_LEGACY
+/** Threads pushing log lines at the same time */
+#define TEST_PRODUCERS 4
+/** Lines per thread */
+#define TEST_LINES 20000
+
+/**
+ * @brief Push lines from several threads while loop() flushes
+ *        The host noInterrupts() is a lock like on the MCU, every
+ *        printed line must be complete and belong to one message
+ */
+static void test_concurrent_push(void)
+{
+	host_serial_byte_us = 0;
+	host_serial_out.clear();
+	log_flush();
+	host_serial_out.clear();
+
+	volatile bool running = true;
+	std::thread producers[TEST_PRODUCERS];
+	for (int id = 0; id < TEST_PRODUCERS; id++)
+	{
+		producers[id] = std::thread([id]()
+									{
+										char tag[8];
+										snprintf(tag, sizeof(tag), "T%d", id);
+										for (int line = 0; line < TEST_LINES; line++)
+										{
+											MYLOG_W(tag, "line %d check %d", line, line * 7 + id);
+											// Give the flush a chance, most lines should make it through
+											std::this_thread::yield();
+										} });
+	}
+	std::thread consumer([&running]()
+						 {
+							 while (running)
+							 {
+								 log_flush();
+							 } });
+	for (int id = 0; id < TEST_PRODUCERS; id++)
+	{
+		producers[id].join();
+	}
+	running = false;
+	consumer.join();
+	log_flush();
+
+	// Every line must be "W [Tn] line k check 7k+n"
+	int printed = 0;
+	int dropped = 0;
+	int corrupt = 0;
+	size_t pos = 0;
+	while (pos < host_serial_out.size())
+	{
+		size_t end = host_serial_out.find('\n', pos);
+		if (end == std::string::npos)
+		{
+			corrupt++;
+			break;
+		}
+		std::string line = host_serial_out.substr(pos, end - pos);
+		pos = end + 1;
+		int id;
+		int number;
+		int check_value;
+		int lost;
+		if (sscanf(line.c_str(), "W [LOG] %d messages dropped", &lost) == 1)
+		{
+			dropped += lost;
+		}
+		else if ((sscanf(line.c_str(), "W [T%d] line %d check %d", &id, &number, &check_value) == 3) && (check_value == number * 7 + id))
+		{
+			printed++;
+		}
+		else
+		{
+			corrupt++;
+		}
+	}
+	printf("  concurrent push:    %d lines, %d printed, %d dropped, %d corrupt\n", TEST_PRODUCERS * TEST_LINES, printed, dropped, corrupt);
+	check(corrupt == 0, "corrupt log lines");
+	check(printed + dropped == TEST_PRODUCERS * TEST_LINES, "log lines lost without drop count");
+}
+#endif
+
+int main(void)
+{
+	test_uplink_cycles();
+#ifndef LOG_LEGACY
+	test_concurrent_push();
+#endif
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
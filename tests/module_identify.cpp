@@ -0,0 +1,178 @@
+/**
+ * @file module_identify.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the identification of modules on shared I2C addresses
+ *        Populates the simulated bus with each device that can answer
+ *        on 0x59, 0x61 and 0x68 (and the clashes without probe on 0x20
+ *        and 0x50), alone and in combinations, probes all addresses
+ *        with find_modules() and checks that exactly the right module
+ *        is marked as found.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o module_identify \
+ *            tests/module_identify.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./module_identify
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Module IDs without a define in module_handler.h */
+#define RAK12035_ID 6
+#define RAK15000_ID 9
+#define RAK12025_ID 16
+#define RAK1905_ID 22
+#define RAK12040_ID 25
+#define RAK16001_ID 31
+#define RAK13600_ID 32
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Device with a WHO_AM_I register
+ */
+class who_am_i_device : public host_register_device
+{
+public:
+	who_am_i_device(uint8_t reg, uint8_t value) { regs[reg] = value; }
+};
+
+/** Devices that can answer on the shared addresses */
+static host_sensirion_id sgp40(0x3682, 3);
+static host_sensirion_id scd30(0xD100, 1);
+static who_am_i_device i3g4250d(0x0F, 0xD3);
+static who_am_i_device mpu9250(0x75, 0x71);
+static who_am_i_device mpu9255(0x75, 0x73);
+static host_register_device amg8833;
+/** Device that only sends an ACK, e.g. RAK13600, RAK16001 or an EEPROM */
+static host_ack_device other;
+
+/** One device on the bus */
+struct test_device_t
+{
+	uint8_t address;
+	host_i2c_device *device;
+	const char *name;
+	/** Module that has to be found */
+	uint8_t module_id;
+};
+
+static const test_device_t devices[] = {
+	{0x59, &sgp40, "SGP40", VOC_ID},
+	{0x59, &other, "other on 0x59", RAK13600_ID},
+	{0x61, &scd30, "SCD30", CO2_ID},
+	{0x61, &other, "other on 0x61", RAK16001_ID},
+	{0x68, &i3g4250d, "I3G4250D", RAK12025_ID},
+	{0x68, &mpu9250, "MPU9250", RAK1905_ID},
+	{0x68, &mpu9255, "MPU9255", RAK1905_ID},
+	{0x68, &amg8833, "AMG8833", RAK12040_ID},
+	{0x20, &other, "other on 0x20", RAK12035_ID},
+	{0x50, &other, "other on 0x50", RAK15000_ID},
+};
+#define NUM_DEVICES (sizeof(devices) / sizeof(devices[0]))
+
+/**
+ * @brief Probe all addresses with the devices of a bitmap on the bus
+ *
+ * @param selected bit n = devices[n] is on the bus
+ * @param transactions I2C transactions of the probe
+ * @return true if exactly the modules of the devices were found
+ */
+static bool probe(uint32_t selected, uint32_t &transactions)
+{
+	host_i2c_detach_all();
+	uint64_t expected = 0;
+	for (uint8_t idx = 0; idx < NUM_DEVICES; idx++)
+	{
+		if (selected & (1UL << idx))
+		{
+			host_i2c_attach(devices[idx].address, devices[idx].device);
+			expected |= (uint64_t)1 << devices[idx].module_id;
+		}
+	}
+	host_sgp40.present = (expected & ((uint64_t)1 << VOC_ID)) != 0;
+	host_scd30.present = (expected & ((uint64_t)1 << CO2_ID)) != 0;
+
+	for (uint8_t idx = 0; idx <= 34; idx++)
+	{
+		found_sensors[idx].found_sensor = false;
+	}
+	// Probe all addresses, no inventory of the last run
+	clear_inventory();
+	uint32_t start = host_i2c_transactions;
+	find_modules();
+	transactions = host_i2c_transactions - start;
+	return get_inventory() == expected;
+}
+
+int main(void)
+{
+	printf("Module identification on shared I2C addresses\n");
+
+	// Each device alone
+	for (uint8_t idx = 0; idx < NUM_DEVICES; idx++)
+	{
+		uint32_t transactions;
+		bool ok = probe(1UL << idx, transactions);
+		printf("  %-15s on 0x%02X: %s, %lu I2C transactions\n", devices[idx].name, devices[idx].address,
+			   ok ? "identified" : "WRONG MODULE", (unsigned long)transactions);
+		check(ok, "device alone not identified");
+	}
+
+	// One device per address, all combinations
+	uint32_t combinations = 0;
+	uint32_t wrong = 0;
+	uint32_t max_transactions = 0;
+	for (uint32_t selected = 1; selected < (1UL << NUM_DEVICES); selected++)
+	{
+		bool one_per_address = true;
+		for (uint8_t first = 0; first < NUM_DEVICES; first++)
+		{
+			for (uint8_t second = first + 1; second < NUM_DEVICES; second++)
+			{
+				if ((selected & (1UL << first)) && (selected & (1UL << second)) && (devices[first].address == devices[second].address))
+				{
+					one_per_address = false;
+				}
+			}
+		}
+		if (!one_per_address)
+		{
+			continue;
+		}
+		uint32_t transactions;
+		if (!probe(selected, transactions))
+		{
+			if (wrong++ < 5)
+			{
+				printf("  combination %03lX: wrong modules %08lX%08lX\n", (unsigned long)selected,
+					   (unsigned long)(get_inventory() >> 32), (unsigned long)get_inventory());
+			}
+		}
+		max_transactions = transactions > max_transactions ? transactions : max_transactions;
+		combinations++;
+	}
+	printf("  %lu combinations with one device per address, %lu wrong, at most %lu I2C transactions\n",
+		   (unsigned long)combinations, (unsigned long)wrong, (unsigned long)max_transactions);
+	// None or one of the devices on 0x59 (2), 0x61 (2), 0x68 (4), 0x20 (1) and 0x50 (1), without the empty bus
+	check(combinations == 3 * 3 * 5 * 2 * 2 - 1, "combinations missing");
+	check(wrong == 0, "modules on shared addresses not identified");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
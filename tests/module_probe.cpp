@@ -0,0 +1,183 @@
+/**
+ * @file module_probe.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the module inventory
+ *        Boots find_modules() on the simulated bus with an erased
+ *        flash, with the stored inventory, after a module was added
+ *        or removed, with a module that fails to initialize and with
+ *        an empty stored inventory. Checks the found modules and
+ *        the saved inventory and reports the I2C transactions of
+ *        each boot.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o module_probe \
+ *            tests/module_probe.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./module_probe
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Module bits of the air quality node */
+#define BIT_ENV ((uint64_t)1 << ENV_ID)
+#define BIT_VOC ((uint64_t)1 << VOC_ID)
+#define BIT_CO2 ((uint64_t)1 << CO2_ID)
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Simulated modules */
+static host_bme680 bme680;
+static host_sensirion_id sgp40(0x3682, 3);
+static host_sensirion_id scd30(0xD100, 1);
+
+/** Result of one boot */
+struct boot_result_t
+{
+	uint64_t found;
+	uint64_t saved;
+	bool cached;
+	bool flash_written;
+	uint32_t transactions;
+};
+
+/**
+ * @brief Attach the modules of a bitmap to the bus
+ */
+static void attach(uint64_t modules)
+{
+	host_i2c_detach_all();
+	bme680 = host_bme680();
+	if (modules & BIT_ENV)
+	{
+		host_i2c_attach(0x76, &bme680);
+	}
+	if (modules & BIT_VOC)
+	{
+		host_i2c_attach(0x59, &sgp40);
+	}
+	if (modules & BIT_CO2)
+	{
+		host_i2c_attach(0x61, &scd30);
+	}
+	host_sgp40.present = (modules & BIT_VOC) != 0;
+	host_scd30.present = (modules & BIT_CO2) != 0;
+}
+
+/**
+ * @brief Read the inventory from flash like load_inventory()
+ */
+static uint64_t stored_inventory(void)
+{
+	uint64_t inventory = 0;
+	for (uint8_t idx = 0; idx < 8; idx++)
+	{
+		inventory |= (uint64_t)host_flash[INVENTORY_OFFSET + 1 + idx] << (8 * idx);
+	}
+	return inventory;
+}
+
+/**
+ * @brief Boot find_modules() with the attached modules
+ *
+ * @param name name of the case for the report
+ * @return boot_result_t
+ */
+static boot_result_t boot(const char *name)
+{
+	for (uint8_t idx = 0; idx <= 34; idx++)
+	{
+		found_sensors[idx].found_sensor = false;
+	}
+	uint8_t flash_before[11];
+	memcpy(flash_before, &host_flash[INVENTORY_OFFSET], sizeof(flash_before));
+	uint32_t transactions = host_i2c_transactions;
+
+	find_modules();
+
+	boot_result_t result;
+	result.found = get_inventory();
+	result.saved = stored_inventory();
+	result.cached = g_inventory_cached;
+	result.flash_written = memcmp(flash_before, &host_flash[INVENTORY_OFFSET], sizeof(flash_before)) != 0;
+	result.transactions = host_i2c_transactions - transactions;
+	printf("  %-24s %-6s found %08lX saved %08lX, %3lu I2C transactions%s\n", name, result.cached ? "cached" : "probed",
+		   (unsigned long)result.found, (unsigned long)result.saved, (unsigned long)result.transactions,
+		   result.flash_written ? ", inventory written" : "");
+	return result;
+}
+
+int main(void)
+{
+	printf("Module inventory\n");
+	const uint64_t all = BIT_ENV | BIT_VOC | BIT_CO2;
+
+	// New device, all addresses probed and the inventory saved
+	attach(all);
+	host_flash_erase();
+	boot_result_t first = boot("erased flash");
+	check(!first.cached, "inventory from an erased flash");
+	check(first.found == all, "modules not found");
+	check(first.saved == all, "inventory not saved");
+
+	// Reboot, the stored modules are verified, the other addresses only get an ACK probe
+	boot_result_t cached = boot("stored inventory");
+	check(cached.cached, "stored inventory not used");
+	check(cached.found == all, "modules not found with the stored inventory");
+	check(!cached.flash_written, "inventory written without a change");
+	check(cached.transactions <= first.transactions, "stored inventory needs more I2C transactions");
+
+	// Module that fails to initialize stays in the inventory and is tried again
+	attach(all);
+	host_scd30.present = false;
+	boot_result_t init_failed = boot("RAK12037 init fails");
+	check(init_failed.found == (BIT_ENV | BIT_VOC), "module with failed init reported as found");
+	check(init_failed.saved == all, "module with failed init removed from the inventory");
+	host_scd30.present = true;
+	boot_result_t recovered = boot("RAK12037 init works");
+	check(recovered.cached && (recovered.found == all), "module not found again after a failed init");
+
+	// Module added, found by the ACK probe of the addresses outside the inventory
+	attach(BIT_ENV | BIT_VOC);
+	boot("RAK12037 removed");
+	attach(all);
+	boot_result_t added = boot("RAK12037 added");
+	check(added.cached, "stored inventory not used with a new module");
+	check(added.found == all, "new module not found");
+	check(added.saved == all, "new module not saved");
+
+	// Module removed, the stored inventory fails and all addresses are probed
+	attach(BIT_ENV | BIT_CO2);
+	boot_result_t removed = boot("RAK12047 removed");
+	check(!removed.cached, "stored inventory used with a missing module");
+	check(removed.found == (BIT_ENV | BIT_CO2), "wrong modules after removal");
+	check(removed.saved == (BIT_ENV | BIT_CO2), "inventory not updated after removal");
+
+	// Empty inventory, e.g. saved while the modules were not plugged in
+	attach(0);
+	boot_result_t none = boot("no modules");
+	check(none.found == 0, "modules found on an empty bus");
+	check(none.saved == 0, "empty inventory not saved");
+	attach(all);
+	boot_result_t after_empty = boot("modules after empty boot");
+	check(!after_empty.cached, "empty stored inventory used");
+	check(after_empty.found == all, "modules not found after an empty inventory");
+	check(after_empty.saved == all, "inventory not saved after an empty inventory");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
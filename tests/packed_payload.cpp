@@ -0,0 +1,341 @@
+/**
+ * @file packed_payload.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the bit-packed payload on PACKED_FPORT
+ *        Encodes random samples, including values outside of the
+ *        ranges of the schema and modules that are not valid,
+ *        decodes them with a reference decoder and checks each
+ *        value against the sensor value within half of its
+ *        resolution or the clamped limit. Checks that the payload
+ *        keeps max_size when values have to be left out. Reports
+ *        payload size and airtime against the LPP payload at SF10
+ *        and SF12.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o packed_payload \
+ *            tests/packed_payload.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./packed_payload
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Random samples encoded and decoded */
+#define TEST_SAMPLES 20000
+/** Random seed */
+#define TEST_SEED 4711
+/** LoRaWAN MAC header, FHDR without options, FPort and MIC */
+#define LORAWAN_OVERHEAD 13
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Schema 1, like the decoders, index is the bit in the presence bitmap */
+struct field_t
+{
+	uint8_t bits;
+	int32_t min;
+	/** Resolution in the unit of the physical value */
+	double resolution;
+};
+static const field_t fields[SF_CHANNELS] = {
+	{11, -400, 0.1},  // °C
+	{8, 0, 0.5},	  // %RH
+	{13, 3000, 0.1},  // hPa
+	{15, 0, 100.0},	  // Ohm
+	{14, 0, 1.0},	  // ppm
+	{11, -400, 0.1},  // °C
+	{8, 0, 0.5},	  // %RH
+	{9, 0, 1.0},	  // VOC index
+	{8, 0, 0.02},	  // V
+};
+
+static unsigned int seed = TEST_SEED;
+
+static int32_t random_range(int32_t min, int32_t max)
+{
+	return min + (int32_t)(rand_r(&seed) % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Reference decoder of schema 1
+ *
+ * @param data payload
+ * @param size payload size
+ * @param present presence bitmap of the payload
+ * @param value physical values, index is SF_CH_xxx
+ * @return true if the payload is complete and has no extra bytes
+ */
+static bool decode_packed(const uint8_t *data, size_t size, uint16_t &present, double *value)
+{
+	if ((size < 1) || (data[0] != PACKED_SCHEMA))
+	{
+		return false;
+	}
+	size_t bit = 8;
+	struct reader
+	{
+		static bool read(const uint8_t *data, size_t size, size_t &bit, uint8_t count, uint32_t &result)
+		{
+			result = 0;
+			for (uint8_t idx = 0; idx < count; idx++)
+			{
+				if ((bit >> 3) >= size)
+				{
+					return false;
+				}
+				result = (result << 1) | ((data[bit >> 3] >> (7 - (bit & 7))) & 1);
+				bit++;
+			}
+			return true;
+		}
+	};
+	uint32_t raw;
+	if (!reader::read(data, size, bit, SF_CHANNELS, raw))
+	{
+		return false;
+	}
+	present = (uint16_t)raw;
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if ((present & (1 << channel)) == 0)
+		{
+			continue;
+		}
+		if (!reader::read(data, size, bit, fields[channel].bits, raw))
+		{
+			return false;
+		}
+		value[channel] = ((int32_t)raw + fields[channel].min) * fields[channel].resolution;
+	}
+	// Only the padding of the last byte
+	return ((bit + 7) >> 3) == size;
+}
+
+/**
+ * @brief Physical values of a sample, index is SF_CH_xxx
+ */
+static uint16_t sample_values(const sensor_snapshot_t &values, float battery, double *value)
+{
+	uint16_t valid = 1 << SF_CH_BATT;
+	value[SF_CH_ENV_TEMP] = values.env_temperature / 100.0;
+	value[SF_CH_ENV_HUMID] = values.env_humidity / 1000.0;
+	value[SF_CH_ENV_PRESS] = values.env_pressure / 100.0;
+	value[SF_CH_ENV_GAS] = values.env_gas;
+	value[SF_CH_CO2] = values.co2;
+	value[SF_CH_CO2_TEMP] = values.co2_temperature;
+	value[SF_CH_CO2_HUMID] = values.co2_humidity;
+	value[SF_CH_VOC] = values.voc_index;
+	value[SF_CH_BATT] = battery;
+	if (values.env_valid)
+	{
+		valid |= (1 << SF_CH_ENV_TEMP) | (1 << SF_CH_ENV_HUMID) | (1 << SF_CH_ENV_PRESS) | (1 << SF_CH_ENV_GAS);
+	}
+	if (values.co2_valid)
+	{
+		valid |= (1 << SF_CH_CO2) | (1 << SF_CH_CO2_TEMP) | (1 << SF_CH_CO2_HUMID);
+	}
+	if (values.voc_valid)
+	{
+		valid |= 1 << SF_CH_VOC;
+	}
+	return valid;
+}
+
+/**
+ * @brief Check a decoded value against the sensor value
+ *        Values outside of the range are clamped to its limits
+ */
+static bool value_ok(uint8_t channel, double decoded, double expected)
+{
+	const field_t &field = fields[channel];
+	double min = field.min * field.resolution;
+	double max = (field.min + (1L << field.bits) - 1) * field.resolution;
+	if (expected < min)
+	{
+		expected = min;
+	}
+	else if (expected > max)
+	{
+		expected = max;
+	}
+	return fabs(decoded - expected) <= field.resolution / 2 + 1e-6 * (fabs(expected) + 1.0);
+}
+
+/**
+ * @brief Random sample, one in ten values is outside of the range of the schema
+ */
+static void random_sample(sensor_snapshot_t &values, float &battery)
+{
+	bool outside = random_range(0, 9) == 0;
+	values.env_valid = random_range(0, 15) != 0;
+	values.co2_valid = random_range(0, 15) != 0;
+	values.voc_valid = random_range(0, 15) != 0;
+	values.env_temperature = outside ? random_range(-6000, 20000) : random_range(-4000, 16000);
+	values.env_humidity = outside ? random_range(0, 150000) : random_range(0, 100000);
+	values.env_pressure = outside ? random_range(20000, 130000) : random_range(30000, 111000);
+	values.env_gas = outside ? random_range(0, 5000000) : random_range(0, 3000000);
+	values.co2 = outside ? random_range(0, 40000) : random_range(0, 10000);
+	values.co2_temperature = (outside ? random_range(-6000, 20000) : random_range(-4000, 16000)) / 100.0f;
+	values.co2_humidity = (outside ? random_range(0, 15000) : random_range(0, 10000)) / 100.0f;
+	values.voc_index = outside ? random_range(0, 1000) : random_range(1, 500);
+	battery = (outside ? random_range(0, 600) : random_range(250, 450)) / 100.0f;
+	values.co2_timestamp = millis();
+}
+
+/**
+ * @brief Encode random samples and decode them with the reference decoder
+ */
+static void test_round_trip(void)
+{
+	uint32_t broken = 0;
+	uint32_t wrong_channels = 0;
+	uint32_t wrong_values = 0;
+	uint32_t too_large = 0;
+	uint32_t shed = 0;
+	sensor_snapshot_t values;
+	memset(&values, 0, sizeof(values));
+	for (uint32_t sample = 0; sample < TEST_SAMPLES; sample++)
+	{
+		float battery;
+		random_sample(values, battery);
+		double expected[SF_CHANNELS];
+		uint16_t valid = sample_values(values, battery, expected);
+
+		// Every fourth sample with a max size that leaves values out, 3 bytes are the header
+		uint8_t max_size = (sample % 4 == 0) ? random_range(3, PACKED_MAX_SIZE - 1) : PACKED_MAX_SIZE;
+		uint8_t size = packed_encode(values, battery, max_size);
+		too_large += (size > max_size) ? 1 : 0;
+
+		uint16_t present;
+		double decoded[SF_CHANNELS];
+		if (!decode_packed(packed_payload(), size, present, decoded))
+		{
+			broken++;
+			continue;
+		}
+		if (((present & ~valid) != 0) || ((max_size == PACKED_MAX_SIZE) && (present != valid)))
+		{
+			wrong_channels++;
+		}
+		shed += (present != valid) ? 1 : 0;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if ((present & (1 << channel)) && !value_ok(channel, decoded[channel], expected[channel]))
+			{
+				wrong_values++;
+			}
+		}
+	}
+	printf("Round trip of %d random samples: %lu broken, %lu wrong channels, %lu wrong values, %lu too large, %lu with values left out\n",
+		   TEST_SAMPLES, (unsigned long)broken, (unsigned long)wrong_channels, (unsigned long)wrong_values,
+		   (unsigned long)too_large, (unsigned long)shed);
+	check(broken == 0, "payload not decoded");
+	check(wrong_channels == 0, "presence bitmap wrong");
+	check(wrong_values == 0, "decoded value wrong");
+	check(too_large == 0, "payload larger than max_size");
+	check(shed != 0, "no values left out");
+}
+
+/**
+ * @brief LoRa airtime, 125 kHz, CR 4/5, explicit header, CRC on, 8 symbols preamble
+ *
+ * @param sf spreading factor
+ * @param size PHY payload size in bytes
+ * @return double airtime in ms
+ */
+static double airtime_ms(uint8_t sf, uint16_t size)
+{
+	double symbol_ms = (double)(1 << sf) / 125.0;
+	// Low data rate optimization for symbols longer than 16 ms
+	int32_t de = (sf >= 11) ? 1 : 0;
+	int32_t bits = 8 * size - 4 * sf + 28 + 16;
+	int32_t blocks = (bits > 0) ? (bits + 4 * (sf - 2 * de) - 1) / (4 * (sf - 2 * de)) : 0;
+	return (8 + 4.25 + 8 + blocks * 5) * symbol_ms;
+}
+
+/**
+ * @brief Payload size and airtime of LPP and bit-packed payload
+ */
+static void test_airtime(void)
+{
+	// Known airtime of an uplink without application payload at SF7
+	check(fabs(airtime_ms(7, LORAWAN_OVERHEAD) - 46.336) < 0.01, "airtime formula wrong");
+
+	struct config_t
+	{
+		const char *name;
+		bool co2;
+		bool voc;
+	};
+	static const config_t configs[] = {
+		{"all modules", true, true},
+		{"RAK1906 + RAK12047", false, true},
+		{"RAK1906 only", false, false},
+	};
+	sensor_snapshot_t values;
+	memset(&values, 0, sizeof(values));
+	values.env_temperature = 2150;
+	values.env_humidity = 45000;
+	values.env_pressure = 101325;
+	values.env_gas = 120000;
+	values.co2 = 600;
+	values.co2_temperature = 22.5f;
+	values.co2_humidity = 40.0f;
+	values.voc_index = 100;
+
+	printf("Payload and airtime per uplink, 125 kHz, CR 4/5, %d bytes LoRaWAN overhead\n", LORAWAN_OVERHEAD);
+	printf("  %-20s %6s %7s %22s %22s\n", "modules", "LPP", "packed", "SF10 ms", "SF12 ms");
+	for (uint8_t idx = 0; idx < sizeof(configs) / sizeof(configs[0]); idx++)
+	{
+		found_sensors[ENV_ID].found_sensor = true;
+		found_sensors[CO2_ID].found_sensor = configs[idx].co2;
+		found_sensors[VOC_ID].found_sensor = configs[idx].voc;
+		values.env_valid = true;
+		values.co2_valid = configs[idx].co2;
+		values.voc_valid = configs[idx].voc;
+		values.co2_timestamp = millis();
+
+		g_solution_data.reset();
+		encode_sensor_values(values);
+		g_solution_data.addVoltage(LPP_CHANNEL_BATT, 3.9f);
+		uint16_t lpp_size = g_solution_data.getSize();
+		uint16_t packed_size = packed_encode(values, 3.9f, PACKED_MAX_SIZE);
+
+		char sf10[32];
+		char sf12[32];
+		double lpp_sf10 = airtime_ms(10, lpp_size + LORAWAN_OVERHEAD);
+		double packed_sf10 = airtime_ms(10, packed_size + LORAWAN_OVERHEAD);
+		double lpp_sf12 = airtime_ms(12, lpp_size + LORAWAN_OVERHEAD);
+		double packed_sf12 = airtime_ms(12, packed_size + LORAWAN_OVERHEAD);
+		snprintf(sf10, sizeof(sf10), "%.1f -> %.1f", lpp_sf10, packed_sf10);
+		snprintf(sf12, sizeof(sf12), "%.1f -> %.1f", lpp_sf12, packed_sf12);
+		printf("  %-20s %6d %7d %22s %22s   saved %.0f ms / %.0f ms\n", configs[idx].name, lpp_size, packed_size, sf10, sf12,
+			   lpp_sf10 - packed_sf10, lpp_sf12 - packed_sf12);
+		check(packed_size < lpp_size, "packed payload not smaller than LPP");
+		check(packed_sf12 < lpp_sf12, "packed payload saves no airtime at SF12");
+	}
+}
+
+int main(void)
+{
+	test_round_trip();
+	test_airtime();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/**
+ * @file payload_plan.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the payload planner
+ *        Calls plan_channels() with the LPP sizes of all values and
+ *        budgets from one value to all values. Checks that the
+ *        selection fits the budget, that no value that would still
+ *        fit is left out and that the values left out rotate, so
+ *        every value is sent after a bounded number of uplinks.
+ *        Runs the node in the regions with different max payloads
+ *        at every data rate and checks that each LPP uplink fits
+ *        max_payload_size() and that every value is sent.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o payload_plan \
+ *            tests/payload_plan.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./payload_plan
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Plans per budget */
+#define TEST_PLANS 500
+/** TX slots per data rate of the node */
+#define TEST_SLOTS 30
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** LPP size of the values with channel and type, index is SF_CH_xxx */
+static const uint8_t lpp_size[SF_CHANNELS] = {4, 3, 4, 4, 4, 4, 3, 4, 4};
+/** LPP channel of the values, index is SF_CH_xxx */
+static const uint8_t lpp_channel[SF_CHANNELS] = {
+	LPP_CHANNEL_TEMP_2,
+	LPP_CHANNEL_HUMID_2,
+	LPP_CHANNEL_PRESS_2,
+	LPP_CHANNEL_GAS_2,
+	LPP_CHANNEL_CO2_2,
+	LPP_CHANNEL_CO2_Temp_2,
+	LPP_CHANNEL_CO2_HUMID_2,
+	LPP_CHANNEL_VOC,
+	LPP_CHANNEL_BATT,
+};
+
+/**
+ * @brief Plan the values of all modules with one budget
+ *
+ * @param budget space for the values in bytes
+ */
+static void test_rotation(uint16_t budget)
+{
+	uint16_t present = (1 << SF_CHANNELS) - 1;
+	uint16_t total = 0;
+	uint8_t priority_min = 0xFF;
+	uint8_t priority_max = 0;
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		total += lpp_size[channel];
+		priority_min = g_plan_priority[channel] < priority_min ? g_plan_priority[channel] : priority_min;
+		priority_max = g_plan_priority[channel] > priority_max ? g_plan_priority[channel] : priority_max;
+	}
+	// Uplinks for all values and the aging that lifts the lowest priority above the highest one
+	uint16_t per_uplink = budget / 4;
+	uint32_t max_allowed = (SF_CHANNELS + per_uplink - 1) / per_uplink + (priority_max - priority_min + PLAN_AGING - 1) / PLAN_AGING;
+
+	uint32_t last_sent[SF_CHANNELS] = {0};
+	uint32_t max_gap = 0;
+	uint32_t too_large = 0;
+	uint32_t not_filled = 0;
+	for (uint32_t plan = 1; plan <= TEST_PLANS; plan++)
+	{
+		uint16_t selected = plan_channels(present, lpp_size, budget);
+		uint16_t used = 0;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (selected & (1 << channel))
+			{
+				used += lpp_size[channel];
+			}
+		}
+		too_large += (used > budget) ? 1 : 0;
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if (selected & (1 << channel))
+			{
+				uint32_t gap = plan - last_sent[channel];
+				max_gap = gap > max_gap ? gap : max_gap;
+				last_sent[channel] = plan;
+			}
+			else if (used + lpp_size[channel] <= budget)
+			{
+				// Left out although it fits
+				not_filled++;
+			}
+		}
+	}
+	// Values that were not sent at the end
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		uint32_t gap = TEST_PLANS + 1 - last_sent[channel];
+		max_gap = gap > max_gap ? gap : max_gap;
+	}
+	printf("  budget %2d of %2d bytes: every value sent at least every %2lu uplinks (limit %2lu), %lu too large, %lu not filled\n",
+		   budget, total, (unsigned long)max_gap, (unsigned long)(budget >= total ? 1 : max_allowed), (unsigned long)too_large,
+		   (unsigned long)not_filled);
+	check(too_large == 0, "planned values larger than the budget");
+	check(not_filled == 0, "value left out although it fits");
+	check(max_gap <= (budget >= total ? 1 : max_allowed), "value left out for too many uplinks");
+}
+
+/**
+ * @brief Run the node at one data rate and check its LPP uplinks
+ *
+ * @param band region
+ * @param name name of the region for the report
+ * @param data_rate data rate
+ */
+static void test_node(int32_t band, const char *name, uint8_t data_rate)
+{
+	host_band = band;
+	host_dr = data_rate;
+	uint32_t max_size = max_payload_size();
+	size_t first = host_uplinks.size();
+	uint32_t failed = sf_stats.stored;
+	host_run_until(host_now_us() + TEST_SLOTS * 60000000ULL);
+
+	uint32_t uplinks = 0;
+	uint32_t too_large = 0;
+	uint32_t largest = 0;
+	uint16_t sent = 0;
+	for (size_t idx = first; idx < host_uplinks.size(); idx++)
+	{
+		const host_uplink_t &uplink = host_uplinks[idx];
+		if (uplink.fport != 2)
+		{
+			continue;
+		}
+		uplinks++;
+		too_large += (uplink.data.size() > max_size) ? 1 : 0;
+		largest = uplink.data.size() > largest ? uplink.data.size() : largest;
+		// Values in the uplink, every field has a channel and a type byte
+		for (size_t pos = 0; pos + 1 < uplink.data.size();)
+		{
+			uint8_t size = 2;
+			for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+			{
+				if (lpp_channel[channel] == uplink.data[pos])
+				{
+					sent |= 1 << channel;
+					size = lpp_size[channel];
+				}
+			}
+			pos += size;
+		}
+	}
+	printf("  %-6s DR%d max %3lu bytes: %2lu uplinks, largest %2lu bytes, %lu too large, values sent %03X\n", name, data_rate,
+		   (unsigned long)max_size, (unsigned long)uplinks, (unsigned long)largest, (unsigned long)too_large, sent);
+	check(uplinks >= TEST_SLOTS - 1, "uplinks missing");
+	check(too_large == 0, "LPP uplink larger than the max payload");
+	check(sf_stats.stored == failed, "uplink failed");
+	check(sent == (1 << SF_CHANNELS) - 1, "value never sent");
+}
+
+int main(void)
+{
+	printf("Rotation of the values left out, LPP sizes of all modules\n");
+	const uint8_t budgets[] = {4, 7, 8, 11, 16, 20, 30, 33, 34};
+	for (uint8_t idx = 0; idx < sizeof(budgets); idx++)
+	{
+		test_rotation(budgets[idx]);
+	}
+
+	host_default_node();
+	setup();
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	// Let the values of all modules become valid
+	host_run_until(host_now_us() + 300000000ULL);
+
+	printf("LPP uplinks of the node, %d TX slots per data rate\n", TEST_SLOTS);
+	struct region_t
+	{
+		int32_t band;
+		const char *name;
+		uint8_t data_rates;
+	};
+	static const region_t regions[] = {
+		{RAK_REGION_EU868, "EU868", 8},
+		{RAK_REGION_US915, "US915", 5},
+		{RAK_REGION_AU915, "AU915", 7},
+		{RAK_REGION_AS923, "AS923", 8},
+	};
+	for (uint8_t region = 0; region < sizeof(regions) / sizeof(regions[0]); region++)
+	{
+		for (uint8_t data_rate = 0; data_rate < regions[region].data_rates; data_rate++)
+		{
+			test_node(regions[region].band, regions[region].name, data_rate);
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,391 @@
+/**
+ * @file sample_batch.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the batch format on BATCH_FPORT
+ *        Encodes random batches with regular, jittered and missed
+ *        TX slots, values that need the escape of a full value and
+ *        channels that are not valid in all samples, decodes them
+ *        with a reference decoder and checks the time and the
+ *        values of each sample. Runs the node with ATC+BATCH=8 at
+ *        the smallest data rate and decodes its uplinks. Reports
+ *        the bytes per sample against one LPP uplink per sample.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o sample_batch \
+ *            tests/sample_batch.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./sample_batch
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Random batches encoded and decoded */
+#define TEST_BATCHES 5000
+/** Random seed */
+#define TEST_SEED 4711
+/** LoRaWAN MAC header, FHDR without options, FPort and MIC */
+#define LORAWAN_OVERHEAD 13
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Size of the values in bytes and signedness, index is the bit in the channel bitmap */
+static const uint8_t width[SF_CHANNELS] = {2, 1, 2, 2, 2, 2, 1, 2, 2};
+static const bool is_signed[SF_CHANNELS] = {true, false, false, false, false, true, false, false, false};
+
+/** Sample decoded by the reference decoder */
+struct decoded_t
+{
+	/** Seconds between the sample and the uplink */
+	uint32_t age;
+	int32_t value[SF_CHANNELS];
+};
+
+/**
+ * @brief Reference decoder of the batch format
+ *
+ * @param data payload
+ * @param size payload size
+ * @param channels channel bitmap of the payload
+ * @param samples decoded samples
+ * @return true if the payload is complete and has no extra bytes
+ */
+static bool decode_batch(const uint8_t *data, size_t size, uint16_t &channels, std::vector<decoded_t> &samples)
+{
+	samples.clear();
+	if ((size < BATCH_HEADER_SIZE) || (data[0] != BATCH_FORMAT))
+	{
+		return false;
+	}
+	uint32_t age = ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+	uint8_t count = data[4];
+	channels = (data[5] << 8) | data[6];
+	size_t pos = BATCH_HEADER_SIZE;
+
+	uint32_t time = 0;
+	for (uint8_t idx = 0; idx < count; idx++)
+	{
+		if (idx != 0)
+		{
+			uint32_t offset = 0;
+			uint8_t shift = 0;
+			uint8_t next;
+			do
+			{
+				if ((pos >= size) || (shift > 28))
+				{
+					return false;
+				}
+				next = data[pos++];
+				offset |= (uint32_t)(next & 0x7F) << shift;
+				shift += 7;
+			} while (next & 0x80);
+			time += offset;
+		}
+		decoded_t sample;
+		memset(&sample, 0, sizeof(sample));
+		sample.age = age - time;
+		samples.push_back(sample);
+	}
+
+	for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+	{
+		if ((channels & (1 << channel)) == 0)
+		{
+			continue;
+		}
+		int32_t value = 0;
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			bool full = (idx == 0);
+			if (!full)
+			{
+				if (pos >= size)
+				{
+					return false;
+				}
+				if (data[pos] == BATCH_DELTA_ESCAPE)
+				{
+					pos++;
+					full = true;
+				}
+				else
+				{
+					value += (int8_t)data[pos++];
+				}
+			}
+			if (full)
+			{
+				if (pos + width[channel] > size)
+				{
+					return false;
+				}
+				value = (width[channel] == 2) ? ((data[pos] << 8) | data[pos + 1]) : data[pos];
+				if (is_signed[channel] && (width[channel] == 2))
+				{
+					value = (int16_t)value;
+				}
+				pos += width[channel];
+			}
+			samples[idx].value[channel] = value;
+		}
+	}
+	return pos == size;
+}
+
+/** Random number generator of the test */
+static unsigned int seed = TEST_SEED;
+
+static int32_t random_range(int32_t min, int32_t max)
+{
+	return min + (int32_t)(rand_r(&seed) % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Random walk of the sensor values, with jumps that need a full value
+ */
+static void random_values(sensor_snapshot_t &values, bool jumps)
+{
+	int32_t scale = (jumps && (rand_r(&seed) % 4 == 0)) ? 100 : 1;
+	values.env_temperature += random_range(-30, 30) * scale;
+	values.env_humidity = (values.env_humidity + random_range(-1000, 1000) * scale + 100000) % 100000;
+	values.env_pressure += random_range(-20, 20) * scale;
+	values.env_gas = (uint32_t)((int32_t)values.env_gas + random_range(-500, 500) * scale) % 3000000;
+	values.co2 = (uint16_t)(values.co2 + random_range(-20, 20) * scale) % 10000;
+	values.co2_temperature += random_range(-3, 3) * 0.1f * scale;
+	values.co2_humidity = (float)(((int32_t)(values.co2_humidity * 2) + random_range(-2, 2) * scale + 200) % 200) / 2.0f;
+	values.voc_index = (values.voc_index + random_range(-5, 5) * scale + 500) % 500 + 1;
+	values.co2_timestamp = millis();
+}
+
+/**
+ * @brief Encode random batches and decode them with the reference decoder
+ */
+static void test_round_trip(void)
+{
+	uint32_t wrong_time = 0;
+	uint32_t wrong_value = 0;
+	uint32_t wrong_channels = 0;
+	uint32_t broken = 0;
+	uint32_t escapes = 0;
+	uint32_t max_offset = 0;
+	sensor_snapshot_t values;
+	memset(&values, 0, sizeof(values));
+	values.env_temperature = 2150;
+	values.env_humidity = 45000;
+	values.env_pressure = 101325;
+	values.env_gas = 120000;
+	values.co2 = 600;
+	values.co2_temperature = 22.5f;
+	values.co2_humidity = 40.0f;
+	values.voc_index = 100;
+
+	for (uint32_t batch = 0; batch < TEST_BATCHES; batch++)
+	{
+		uint8_t count = random_range(1, BATCH_MAX_SAMPLES);
+		// From a few seconds to more than the 2 byte interval of the old format
+		static const uint32_t intervals[] = {10, 60, 127, 128, 900, 3600, 16383, 16384, 86400};
+		uint32_t interval = intervals[rand_r(&seed) % (sizeof(intervals) / sizeof(intervals[0]))];
+		bool jumps = (batch % 2) == 0;
+		uint64_t time_us[BATCH_MAX_SAMPLES];
+		sf_record_t records[BATCH_MAX_SAMPLES];
+		uint16_t expected_channels = 0x01FF;
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			// TX slots with jitter of the acquisition, now and then a missed one
+			host_advance_us(interval * 1000000ULL * ((rand_r(&seed) % 8 == 0) ? 2 : 1) + random_range(0, 2000) * 1000ULL);
+			random_values(values, jumps);
+			values.env_valid = (rand_r(&seed) % 32) != 0;
+			values.co2_valid = (rand_r(&seed) % 32) != 0;
+			values.voc_valid = (rand_r(&seed) % 32) != 0;
+			time_us[idx] = host_now_us();
+			float battery = random_range(330, 420) / 100.0f;
+			batch_add(values, battery);
+			sf_make_record(records[idx], values, battery);
+			expected_channels &= sf_record_channels(records[idx]);
+		}
+		host_advance_us(random_range(0, 3600000) * 1000ULL);
+
+		uint16_t size = batch_encode(count);
+		uint16_t channels;
+		std::vector<decoded_t> samples;
+		if (!decode_batch(batch_payload(), size, channels, samples) || (samples.size() != count))
+		{
+			broken++;
+			batch_release(count);
+			continue;
+		}
+		wrong_channels += (channels != expected_channels) ? 1 : 0;
+		for (uint8_t idx = 0; idx < count; idx++)
+		{
+			// Whole seconds, the age is truncated and the offsets rounded
+			int64_t error_ms = (int64_t)(host_now_us() - time_us[idx]) / 1000 - (int64_t)samples[idx].age * 1000;
+			if ((error_ms < -500) || (error_ms >= 1500))
+			{
+				wrong_time++;
+			}
+			if (idx != 0)
+			{
+				uint32_t offset = samples[idx - 1].age - samples[idx].age;
+				max_offset = offset > max_offset ? offset : max_offset;
+			}
+		}
+		for (uint8_t channel = 0; channel < SF_CHANNELS; channel++)
+		{
+			if ((channels & (1 << channel)) == 0)
+			{
+				continue;
+			}
+			for (uint8_t idx = 0; idx < count; idx++)
+			{
+				if (samples[idx].value[channel] != sf_record_value(records[idx], channel))
+				{
+					wrong_value++;
+				}
+				// Delta that does not fit into one byte
+				if ((idx != 0) && (abs(sf_record_value(records[idx], channel) - sf_record_value(records[idx - 1], channel)) > 127))
+				{
+					escapes++;
+				}
+			}
+		}
+		batch_release(count);
+	}
+	printf("Round trip of %d random batches: %lu broken, %lu wrong times, %lu wrong values, %lu wrong channels, %lu escapes, offsets up to %lu s\n",
+		   TEST_BATCHES, (unsigned long)broken, (unsigned long)wrong_time, (unsigned long)wrong_value, (unsigned long)wrong_channels,
+		   (unsigned long)escapes, (unsigned long)max_offset);
+	check(broken == 0, "batch not decoded");
+	check(wrong_time == 0, "sample time wrong");
+	check(wrong_value == 0, "sample value wrong");
+	check(wrong_channels == 0, "channel bitmap is not the channels valid in all samples");
+	check(escapes != 0, "escape of a full value not tested");
+}
+
+/**
+ * @brief Bytes per sample of batches against one LPP uplink per sample,
+ *        slowly changing values in 15 minute TX slots
+ */
+static void test_bytes_per_sample(void)
+{
+	found_sensors[ENV_ID].found_sensor = true;
+	found_sensors[CO2_ID].found_sensor = true;
+	found_sensors[VOC_ID].found_sensor = true;
+	sensor_snapshot_t values;
+	memset(&values, 0, sizeof(values));
+	values.env_valid = values.co2_valid = values.voc_valid = true;
+	values.env_temperature = 2150;
+	values.env_humidity = 45000;
+	values.env_pressure = 101325;
+	values.env_gas = 120000;
+	values.co2 = 600;
+	values.co2_temperature = 22.5f;
+	values.co2_humidity = 40.0f;
+	values.voc_index = 100;
+
+	// One LPP uplink per sample
+	values.co2_timestamp = millis();
+	g_solution_data.reset();
+	encode_sensor_values(values);
+	g_solution_data.addVoltage(LPP_CHANNEL_BATT, 3.9f);
+	uint16_t lpp_size = g_solution_data.getSize();
+	printf("Bytes per sample, values of all modules, TX slot every 900 s\n");
+	printf("  %-10s %8s %14s %20s\n", "format", "payload", "bytes/sample", "with LoRaWAN header");
+	printf("  %-10s %8d %14.1f %20.1f\n", "LPP", lpp_size, (double)lpp_size, (double)(lpp_size + LORAWAN_OVERHEAD));
+
+	const uint8_t counts[] = {2, 4, 8, 16};
+	for (uint8_t idx = 0; idx < sizeof(counts); idx++)
+	{
+		for (uint8_t sample = 0; sample < counts[idx]; sample++)
+		{
+			host_advance_us(900000000ULL + random_range(0, 2000) * 1000ULL);
+			random_values(values, false);
+			batch_add(values, 3.9f);
+		}
+		uint16_t size = batch_encode(counts[idx]);
+		batch_release(counts[idx]);
+		char name[16];
+		snprintf(name, sizeof(name), "batch %d", counts[idx]);
+		printf("  %-10s %8d %14.1f %20.1f\n", name, size, (double)size / counts[idx], (double)(size + LORAWAN_OVERHEAD) / counts[idx]);
+		check(size < lpp_size * counts[idx], "batch is larger than the LPP uplinks");
+	}
+}
+
+/**
+ * @brief Run the node with batches at the smallest data rate and decode its uplinks
+ */
+static void test_node(void)
+{
+	host_default_node();
+	setup();
+	host_dr = 0;
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	check(host_at("ATC+BATCH=8") == AT_OK, "BATCH failed");
+	size_t first = host_uplinks.size();
+	host_run_until(host_now_us() + 4 * 3600000000ULL);
+
+	uint32_t uplinks = 0;
+	uint32_t broken = 0;
+	uint32_t too_large = 0;
+	uint32_t samples_sent = 0;
+	uint32_t wrong_offsets = 0;
+	uint64_t last_sample_us = 0;
+	for (size_t idx = first; idx < host_uplinks.size(); idx++)
+	{
+		const host_uplink_t &uplink = host_uplinks[idx];
+		if (uplink.fport != BATCH_FPORT)
+		{
+			continue;
+		}
+		uplinks++;
+		too_large += (uplink.data.size() > max_payload_size()) ? 1 : 0;
+		uint16_t channels;
+		std::vector<decoded_t> samples;
+		if (!decode_batch(uplink.data.data(), uplink.data.size(), channels, samples))
+		{
+			broken++;
+			continue;
+		}
+		for (size_t sample = 0; sample < samples.size(); sample++)
+		{
+			uint64_t sample_us = uplink.time_us - samples[sample].age * 1000000ULL;
+			// One sample per TX slot, also across the uplinks
+			if ((last_sample_us != 0) && (llabs((int64_t)(sample_us - last_sample_us) - 60000000LL) > 1000000LL))
+			{
+				wrong_offsets++;
+			}
+			last_sample_us = sample_us;
+		}
+		samples_sent += samples.size();
+	}
+	printf("Node with ATC+BATCH=8 at DR0, 4 h: %lu uplinks with %lu samples, %lu broken, %lu too large, %lu wrong sample times\n",
+		   (unsigned long)uplinks, (unsigned long)samples_sent, (unsigned long)broken, (unsigned long)too_large,
+		   (unsigned long)wrong_offsets);
+	check(broken == 0, "batch uplink of the node not decoded");
+	check(too_large == 0, "batch uplink larger than the max payload");
+	check(wrong_offsets == 0, "sample times of the node wrong");
+	check(samples_sent + batch_count() + sf_depth() >= 4 * 60 - 2, "samples of the node missing");
+}
+
+int main(void)
+{
+	test_round_trip();
+	test_bytes_per_sample();
+	test_node();
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,181 @@
+/**
+ * @file scd30_interval.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the SCD30 measurement interval and alignment
+ *        Checks scd30_interval_for() over the whole send interval
+ *        range, then runs the node for two days with a sensor clock
+ *        that is exact, slow and fast. Reports the writes to the NV
+ *        memory of the SCD30 (interval and start commands) and the
+ *        age of the CO2 values at the uplinks.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o scd30_interval \
+ *            tests/scd30_interval.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./scd30_interval
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Send interval of the node run in s */
+#define TEST_SENDINT 900
+/** Run time of the node */
+#define TEST_HOURS 48
+/** Largest send interval checked in s */
+#define TEST_MAX_SENDINT (7 * 24 * 3600)
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Every send interval from 1 s to a week gets a valid interval,
+ *        the fewest measurements cover the send interval and the
+ *        sensor cycle is less than one second per measurement late
+ *        after each uplink
+ */
+static void test_interval_for(void)
+{
+	check(scd30_interval_for(0) == SCD30_INTERVAL_MAX, "sending off does not use the max interval");
+	uint32_t worst_late = 0;
+	uint32_t exact = 0;
+	int errors = 0;
+	for (uint32_t send_interval = 1; send_interval <= TEST_MAX_SENDINT; send_interval++)
+	{
+		uint16_t interval = scd30_interval_for(send_interval * 1000);
+		bool valid = (interval >= SCD30_INTERVAL_MIN) && (interval <= SCD30_INTERVAL_MAX);
+		// Measurements per uplink and the drift of the sensor cycle against the uplinks
+		uint32_t cycles = (send_interval + interval - 1) / interval;
+		uint32_t late = cycles * interval - send_interval;
+		if (interval > SCD30_INTERVAL_MIN)
+		{
+			valid = valid && (cycles == (send_interval + SCD30_INTERVAL_MAX - 1) / SCD30_INTERVAL_MAX) && (late < cycles);
+			worst_late = late > worst_late ? late : worst_late;
+		}
+		exact += (late == 0) ? 1 : 0;
+		if (!valid && (errors++ < 5))
+		{
+			printf("  send interval %lu s: interval %d s, %lu s late per uplink\n", (unsigned long)send_interval, interval,
+				   (unsigned long)late);
+			check(false, "interval does not fit the send interval");
+		}
+	}
+	printf("scd30_interval_for(), 1 s .. %d s: %lu exact, sensor cycle at most %lu s late per uplink\n", TEST_MAX_SENDINT,
+		   (unsigned long)exact, (unsigned long)worst_late);
+}
+
+/** Result of one node run */
+struct run_result_t
+{
+	uint32_t nv_writes;
+	uint32_t uplinks;
+	uint32_t repeated;
+	uint32_t invalid;
+	double max_age;
+	double avg_age;
+};
+
+/**
+ * @brief Run the node with a sensor clock error and record the age of
+ *        the CO2 measurement at each uplink
+ *
+ * @param clock_ppm clock error of the sensor, positive = slow
+ * @return run_result_t
+ */
+static run_result_t run_node(int32_t clock_ppm)
+{
+	run_result_t result;
+	memset(&result, 0, sizeof(result));
+	host_reset();
+	host_default_node();
+	host_scd30.clock_ppm = clock_ppm;
+	setup();
+	check(host_at("ATC+SENDINT=900") == AT_OK, "SENDINT failed");
+	uint32_t nv_writes = host_scd30.nv_writes;
+	size_t uplinks = host_uplinks.size();
+	double sum_age = 0;
+	uint64_t end = host_now_us() + TEST_HOURS * 3600000000ULL;
+	while (host_now_us() < end)
+	{
+		host_run_until(host_now_us() + 10000000ULL);
+		while (uplinks < host_uplinks.size())
+		{
+			// Skip the uplinks of the first cycle, the sensor is aligned at the first poll
+			if (uplinks++ < 2)
+			{
+				continue;
+			}
+			double age = (host_uplinks[uplinks - 1].time_us - host_scd30.last_read_done_us) / 1e6;
+			result.uplinks++;
+			if (!snapshot_get()->co2_valid || (age > 2 * TEST_SENDINT))
+			{
+				result.invalid++;
+			}
+			else if (age > TEST_SENDINT)
+			{
+				// Cycle was restarted before the poll, the uplink has the previous measurement
+				result.repeated++;
+			}
+			else
+			{
+				result.max_age = age > result.max_age ? age : result.max_age;
+				sum_age += age;
+			}
+		}
+	}
+	result.nv_writes = host_scd30.nv_writes - nv_writes;
+	result.avg_age = (result.uplinks > result.repeated) ? sum_age / (result.uplinks - result.repeated) : 0;
+	return result;
+}
+
+int main(void)
+{
+	test_interval_for();
+
+	printf("SCD30 on the node, send interval %d s, %d h\n", TEST_SENDINT, TEST_HOURS);
+	const int32_t clocks[3] = {0, 200, -200};
+	for (int idx = 0; idx < 3; idx++)
+	{
+		run_result_t result = run_node(clocks[idx]);
+		printf("  clock %+4ld ppm: %2lu NV writes, %lu uplinks, %2lu with the previous CO2 value, CO2 age avg %5.1f s max %5.1f s\n",
+			   (long)clocks[idx], (unsigned long)result.nv_writes, (unsigned long)result.uplinks, (unsigned long)result.repeated,
+			   result.avg_age, result.max_age);
+		check(result.uplinks >= TEST_HOURS * 3600 / TEST_SENDINT - 3, "uplinks missing");
+		check(result.invalid == 0, "CO2 values missing or older than two send intervals");
+		check(result.nv_writes <= result.uplinks / 8, "NV memory of the SCD30 written on every poll");
+		// Only the poll right after a restart of the cycle has no new measurement
+		check(result.repeated < result.nv_writes, "previous CO2 values sent without a realignment");
+		// Measurement is done SCD30_SAMPLE_LEAD s before the poll, with a slow clock up to one retry later
+		double max_age = SCD30_SAMPLE_LEAD + (SCD30_POLL_LEAD + uplink_stats.lead) / 1000.0 + 1;
+		if (clocks[idx] <= 0)
+		{
+			// Interval write, first alignment and one realignment a day
+			check(result.nv_writes <= 2 + TEST_HOURS / 24, "cycle realigned without drift");
+		}
+		if (clocks[idx] == 0)
+		{
+			check(result.max_age <= max_age, "CO2 values not measured before the uplink");
+		}
+		if (clocks[idx] > 0)
+		{
+			check(result.nv_writes > 2 + TEST_HOURS / 24, "slow sensor clock not realigned");
+			check(result.max_age <= max_age, "CO2 values of a slow sensor too old");
+		}
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
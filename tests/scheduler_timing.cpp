@@ -0,0 +1,211 @@
+/**
+ * @file scheduler_timing.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the job scheduler with simulated time
+ *        Runs the job set of the node (TX slot, acquisition, VOC
+ *        readings every 10 s, SCD30 poll) on the scheduler alone,
+ *        with and without the slack windows and across the millis()
+ *        overflow. Checks that periodic jobs keep their cadence, that
+ *        no job runs late or earlier than its slack and reports the
+ *        wakeups per hour.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o scheduler_timing \
+ *            tests/scheduler_timing.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./scheduler_timing
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Send interval and jobs like the node */
+#define TEST_SENDINT 900000
+#define TEST_ACQ_LEAD 5000
+#define TEST_VOC_INTERVAL 10000
+#define TEST_HOURS 6
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Statistics of one job */
+struct job_stats_t
+{
+	uint32_t runs;
+	int32_t max_early;
+	int32_t max_late;
+	uint32_t last_due;
+	uint32_t cadence_errors;
+};
+
+static job_stats_t stats[SCHED_NUM_JOBS];
+static uint16_t slack[SCHED_NUM_JOBS];
+/** A job ran in this wakeup */
+static bool job_ran;
+
+/**
+ * @brief Record the run time of a job against its due time
+ */
+static void record(uint8_t job_id, uint32_t period)
+{
+	job_stats_t &job = stats[job_id];
+	uint32_t due = sched_due_time();
+	int32_t late = (int32_t)(millis() - due);
+	if (-late > job.max_early)
+	{
+		job.max_early = -late;
+	}
+	if (late > job.max_late)
+	{
+		job.max_late = late;
+	}
+	// Due times of a periodic job are exactly one period apart, also over the millis() overflow
+	if ((period != 0) && (job.runs != 0) && ((uint32_t)(due - job.last_due) != period))
+	{
+		job.cadence_errors++;
+	}
+	job.last_due = due;
+	job.runs++;
+	job_ran = true;
+}
+
+static void uplink_job(void *)
+{
+	record(SCHED_UPLINK, TEST_SENDINT);
+	// Next acquisition and SCD30 poll before the next TX slot, like uplink_handler()
+	sched_start(SCHED_SENSOR, TEST_SENDINT - TEST_ACQ_LEAD, 0);
+	sched_start(SCHED_CO2_POLL, TEST_SENDINT - TEST_ACQ_LEAD - SCD30_POLL_LEAD, 0);
+}
+
+static void sensor_job(void *)
+{
+	record(SCHED_SENSOR, 0);
+	// Conversion time of the BME680
+	sched_start(SCHED_COLLECT, 188, 0);
+}
+
+static void collect_job(void *)
+{
+	record(SCHED_COLLECT, 0);
+}
+
+static void voc_job(void *)
+{
+	record(SCHED_VOC, TEST_VOC_INTERVAL);
+}
+
+static void co2_job(void *)
+{
+	record(SCHED_CO2_POLL, 0);
+}
+
+/**
+ * @brief Run the job set of the node
+ *
+ * @param start_ms millis() at the start
+ * @param with_slack use the slack windows of the node
+ * @param wakeups_hour wakeups per hour
+ */
+static void run(uint32_t start_ms, bool with_slack, double &wakeups_hour)
+{
+	host_set_time_us((uint64_t)start_ms * 1000ULL);
+	memset(stats, 0, sizeof(stats));
+	memset(slack, 0, sizeof(slack));
+	if (with_slack)
+	{
+		slack[SCHED_SENSOR] = SCHED_SLACK_SENSOR;
+		slack[SCHED_VOC] = SCHED_SLACK_VOC;
+		slack[SCHED_CO2_POLL] = SCHED_SLACK_POLL;
+	}
+	sched_init();
+	sched_create(SCHED_UPLINK, uplink_job, slack[SCHED_UPLINK]);
+	sched_create(SCHED_SENSOR, sensor_job, slack[SCHED_SENSOR]);
+	sched_create(SCHED_COLLECT, collect_job, slack[SCHED_COLLECT]);
+	sched_create(SCHED_VOC, voc_job, slack[SCHED_VOC]);
+	sched_create(SCHED_CO2_POLL, co2_job, slack[SCHED_CO2_POLL]);
+	sched_start(SCHED_UPLINK, TEST_SENDINT, TEST_SENDINT);
+	sched_start(SCHED_SENSOR, TEST_SENDINT - TEST_ACQ_LEAD, 0);
+	sched_start(SCHED_CO2_POLL, TEST_SENDINT - TEST_ACQ_LEAD - SCD30_POLL_LEAD, 0);
+	// VOC readings are not in phase with the TX slots
+	sched_start(SCHED_VOC, 4700, TEST_VOC_INTERVAL);
+
+	// Sleep until the time returned by sched_run() like loop()
+	uint32_t wakeups = 0;
+	// Include the TX slot at the end of the run
+	uint64_t end = host_now_us() + TEST_HOURS * 3600000000ULL + 1000;
+	while (host_now_us() < end)
+	{
+		job_ran = false;
+		uint32_t next = sched_run();
+		wakeups += job_ran ? 1 : 0;
+		if (next == SCHED_IDLE)
+		{
+			break;
+		}
+		host_set_time_us(host_now_us() + (next == 0 ? 1 : next) * 1000ULL);
+	}
+	wakeups_hour = (double)wakeups / TEST_HOURS;
+
+	// Wakeup counter of the scheduler, shown by ATC+STATUS
+	uint32_t last_hour;
+	uint32_t this_hour;
+	sched_wakeups(last_hour, this_hour);
+	check(fabs(last_hour - wakeups_hour) <= 1.0, "wakeup counter of the scheduler differs");
+}
+
+/**
+ * @brief Check the job statistics of a run
+ */
+static void check_run(const char *name, double wakeups_hour)
+{
+	static const char *names[SCHED_NUM_JOBS] = {"uplink", "sensor", "collect", "VOC", "VOC T/RH", "VOC burst", "CO2 poll", "drain"};
+	printf("  %s: %.1f wakeups/h\n", name, wakeups_hour);
+	const uint8_t jobs[] = {SCHED_UPLINK, SCHED_SENSOR, SCHED_COLLECT, SCHED_VOC, SCHED_CO2_POLL};
+	for (uint8_t idx = 0; idx < sizeof(jobs); idx++)
+	{
+		const job_stats_t &job = stats[jobs[idx]];
+		printf("    %-9s %5lu runs, up to %4ld ms early, %ld ms late\n", names[jobs[idx]], (unsigned long)job.runs, (long)job.max_early,
+			   (long)job.max_late);
+		check(job.max_late <= 1, "job ran late");
+		check(job.max_early <= slack[jobs[idx]], "job ran earlier than its slack");
+		check(job.cadence_errors == 0, "periodic job lost its cadence");
+	}
+	check(stats[SCHED_UPLINK].runs == TEST_HOURS * 3600000 / TEST_SENDINT, "TX slots missing");
+	check(stats[SCHED_VOC].runs == TEST_HOURS * 3600000 / TEST_VOC_INTERVAL, "VOC readings missing");
+	check(stats[SCHED_SENSOR].runs == stats[SCHED_UPLINK].runs, "acquisitions missing");
+	check(stats[SCHED_COLLECT].runs == stats[SCHED_SENSOR].runs, "collects missing");
+}
+
+int main(void)
+{
+	printf("Scheduler, %d h simulated, send interval %d s, VOC every %d s\n", TEST_HOURS, TEST_SENDINT / 1000, TEST_VOC_INTERVAL / 1000);
+	double without_slack;
+	run(1000, false, without_slack);
+	check_run("without slack", without_slack);
+	double with_slack;
+	run(1000, true, with_slack);
+	check_run("with slack", with_slack);
+	check(with_slack < without_slack, "slack does not save wakeups");
+
+	// Start 2 hours before the millis() overflow
+	double overflow;
+	run(0xFFFFFFFFUL - 2 * 3600000UL, true, overflow);
+	check_run("over the millis() overflow", overflow);
+	check(overflow == with_slack, "wakeups differ over the millis() overflow");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+/**
+ * @file sod_replay.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the report-by-exception references
+ *        Replays a trace of RAK12037 values into the node with
+ *        ATC+RBE and the 11 byte payload of US915 DR0, so the
+ *        payload planner has to leave values out of most uplinks.
+ *        Uplinks fail during a part of the trace. Decodes the LPP
+ *        uplinks and checks that a change of a value is sent after
+ *        a few uplinks, also if the value was left out or the
+ *        uplink failed, and that the last values reach the server
+ *        while the trace holds them until the end.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o sod_replay \
+ *            tests/sod_replay.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./sod_replay
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Send interval in s */
+#define TEST_SENDINT 60
+/** TX slots of the trace with changing values */
+#define TEST_TRACE_SLOTS 240
+/** TX slots at the end of the trace with constant values */
+#define TEST_HOLD_SLOTS 20
+/** TX slots in which the uplinks fail */
+#define TEST_FAIL_START 100
+#define TEST_FAIL_END 110
+/** Most TX slots with uplinks a change may wait, the values rotate through the 11 byte payload */
+#define TEST_MAX_STALE 8
+/** Random seed */
+#define TEST_SEED 4711
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Values of the trace, at the resolution of the payload */
+static const uint8_t test_channels[] = {SF_CH_CO2, SF_CH_CO2_TEMP, SF_CH_CO2_HUMID};
+static const uint8_t test_lpp_channels[] = {LPP_CHANNEL_CO2_2, LPP_CHANNEL_CO2_Temp_2, LPP_CHANNEL_CO2_HUMID_2};
+#define TEST_CHANNELS sizeof(test_channels)
+
+static uint32_t random_state = TEST_SEED;
+
+static int32_t random_range(int32_t min, int32_t max)
+{
+	random_state = random_state * 1103515245 + 12345;
+	return min + (int32_t)((random_state >> 8) % (uint32_t)(max - min + 1));
+}
+
+/**
+ * @brief Decode the values of the trace from an LPP uplink
+ *
+ * @param uplink uplink on fPort 2
+ * @param received last value received per trace channel, updated
+ * @param has_value flag per trace channel if a value was received, updated
+ * @return true if the payload is complete
+ */
+static bool decode_uplink(const host_uplink_t &uplink, int32_t *received, bool *has_value)
+{
+	const std::vector<uint8_t> &data = uplink.data;
+	size_t pos = 0;
+	while (pos < data.size())
+	{
+		if (pos + 2 > data.size())
+		{
+			return false;
+		}
+		uint8_t channel = data[pos];
+		size_t size;
+		switch (data[pos + 1])
+		{
+		case LPP_RELATIVE_HUMIDITY:
+			size = 1;
+			break;
+		case LPP_TEMPERATURE:
+		case LPP_BAROMETRIC_PRESSURE:
+		case LPP_ANALOG_INPUT:
+		case LPP_CONCENTRATION:
+		case LPP_VOLTAGE:
+		case LPP_VOC:
+			size = 2;
+			break;
+		default:
+			return false;
+		}
+		pos += 2;
+		if (pos + size > data.size())
+		{
+			return false;
+		}
+		int32_t value = (size == 1) ? data[pos] : (int16_t)((data[pos] << 8) | data[pos + 1]);
+		for (uint8_t idx = 0; idx < TEST_CHANNELS; idx++)
+		{
+			if (test_lpp_channels[idx] == channel)
+			{
+				received[idx] = (channel == LPP_CHANNEL_CO2_2) ? (uint16_t)value : value;
+				has_value[idx] = true;
+			}
+		}
+		pos += size;
+	}
+	return true;
+}
+
+int main(void)
+{
+	host_default_node();
+	setup();
+	host_band = RAK_REGION_US915;
+	host_dr = 0;
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	check(host_at("ATC+RBE=3600:0") == AT_OK, "RBE failed");
+
+	// Trace values at the payload resolution, CO2 in ppm, temperature in 0.1 °C, humidity in 0.5 %RH
+	int32_t value[TEST_CHANNELS] = {600, 225, 80};
+	host_scd30.co2 = value[0];
+	host_scd30.temperature = value[1] / 10.0f;
+	host_scd30.humidity = value[2] / 2.0f;
+	// Let the values of all modules become valid
+	host_run_until(host_now_us() + 300000000ULL);
+
+	int32_t received[TEST_CHANNELS] = {0};
+	bool has_value[TEST_CHANNELS] = {false};
+	uint32_t stale[TEST_CHANNELS] = {0};
+	uint32_t max_stale = 0;
+	uint32_t uplinks = 0;
+	uint32_t broken = 0;
+	uint32_t too_large = 0;
+	size_t first = host_uplinks.size();
+	uint32_t shed = plan_stats.shed;
+
+	for (uint32_t slot = 0; slot < TEST_TRACE_SLOTS + TEST_HOLD_SLOTS; slot++)
+	{
+		if (slot < TEST_TRACE_SLOTS)
+		{
+			// Small noise below the deadband, now and then a step above it
+			for (uint8_t idx = 0; idx < TEST_CHANNELS; idx++)
+			{
+				int32_t deadband = g_sod_deadband[test_channels[idx]];
+				int32_t step = (random_range(0, 9) == 0) ? random_range(deadband, 3 * deadband) : random_range(0, deadband / 2);
+				value[idx] += random_range(0, 1) ? step : -step;
+			}
+			value[0] = value[0] < 400 ? 400 : value[0];
+			value[2] = value[2] < 20 ? 20 : (value[2] > 180 ? 180 : value[2]);
+			host_scd30.co2 = value[0];
+			host_scd30.temperature = value[1] / 10.0f;
+			host_scd30.humidity = value[2] / 2.0f;
+		}
+		host_send_result = (slot < TEST_FAIL_START) || (slot >= TEST_FAIL_END);
+
+		size_t last = host_uplinks.size();
+		host_run_until(host_now_us() + TEST_SENDINT * 1000000ULL);
+		for (size_t idx = last; idx < host_uplinks.size(); idx++)
+		{
+			if (host_uplinks[idx].fport != 2)
+			{
+				continue;
+			}
+			uplinks++;
+			too_large += (host_uplinks[idx].data.size() > max_payload_size()) ? 1 : 0;
+			broken += decode_uplink(host_uplinks[idx], received, has_value) ? 0 : 1;
+		}
+
+		// TX slots with uplinks since the server has a value a deadband or more away from the sensor
+		for (uint8_t idx = 0; idx < TEST_CHANNELS; idx++)
+		{
+			int32_t delta = received[idx] - value[idx];
+			if (has_value[idx] && ((delta < 0 ? -delta : delta) < g_sod_deadband[test_channels[idx]]))
+			{
+				stale[idx] = 0;
+			}
+			else if (host_send_result)
+			{
+				stale[idx]++;
+			}
+			max_stale = stale[idx] > max_stale ? stale[idx] : max_stale;
+		}
+	}
+
+	printf("Report-by-exception replay, %d TX slots, max payload %d bytes, uplinks failed in %d slots\n",
+		   TEST_TRACE_SLOTS + TEST_HOLD_SLOTS, max_payload_size(), TEST_FAIL_END - TEST_FAIL_START);
+	printf("  %lu uplinks on fPort 2, %lu shed, %lu broken, %lu too large, %lu samples queued\n", (unsigned long)uplinks,
+		   (unsigned long)(plan_stats.shed - shed), (unsigned long)broken, (unsigned long)too_large, (unsigned long)sf_stats.stored);
+	printf("  changes waited up to %lu TX slots for their uplink\n", (unsigned long)max_stale);
+	for (uint8_t idx = 0; idx < TEST_CHANNELS; idx++)
+	{
+		printf("  SF channel %d: sensor %ld, server %ld\n", test_channels[idx], (long)value[idx], (long)received[idx]);
+	}
+	check(host_uplinks.size() > first, "no uplinks");
+	check(plan_stats.shed != shed, "payload planner did not leave values out");
+	check(broken == 0, "uplink is not a list of complete LPP values");
+	check(too_large == 0, "uplink larger than the max payload");
+	check(uplinks < TEST_TRACE_SLOTS + TEST_HOLD_SLOTS, "report-by-exception skipped no uplinks");
+	check(max_stale <= TEST_MAX_STALE, "change of a value not sent");
+	for (uint8_t idx = 0; idx < TEST_CHANNELS; idx++)
+	{
+		// The values of the end of the trace have to arrive while they are held
+		check(stale[idx] == 0, "last value of the trace not sent");
+	}
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
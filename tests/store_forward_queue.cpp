@@ -0,0 +1,319 @@
+/**
+ * @file store_forward_queue.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the queue of unsent samples
+ *        Runs the node with a 60 s send interval through a long
+ *        join outage and a duty cycle block, then lets it drain the
+ *        queue. Decodes the uplinks on SF_FPORT and checks that the
+ *        newest samples are kept, that each sample arrives once, in
+ *        order and with the age it had when it was sent, and that
+ *        the queue uplinks keep SF_DRAIN_INTERVAL. Also checks the
+ *        clamping of values that do not fit into a queued sample.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o store_forward_queue \
+ *            tests/store_forward_queue.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./store_forward_queue
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Send interval in s */
+#define TEST_SENDINT 60
+/** Join outage, more samples than the queue can hold */
+#define TEST_OUTAGE_MIN 120
+/** Duty cycle block, fewer samples than the queue can hold */
+#define TEST_BLOCK_MIN 20
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Sample decoded from a queue uplink */
+struct sample_t
+{
+	/** Time in ms when the sample was taken, from the uplink time and the age */
+	uint64_t time_ms;
+	int16_t temperature;
+	uint16_t battery;
+	uint8_t values;
+};
+
+/**
+ * @brief Decode the samples of a queue uplink
+ *
+ * @param uplink uplink on SF_FPORT
+ * @param samples decoded samples are added
+ * @return true if the payload is complete
+ */
+static bool decode_queue_uplink(const host_uplink_t &uplink, std::vector<sample_t> &samples)
+{
+	const std::vector<uint8_t> &data = uplink.data;
+	size_t pos = 0;
+	while (pos < data.size())
+	{
+		if ((pos + 2 > data.size()) || (data[pos] != LPP_CHANNEL_AGE) || (data[pos + 1] != LPP_GENERIC_SENSOR))
+		{
+			return false;
+		}
+		pos += 2;
+		uint32_t age = ((uint32_t)data[pos] << 24) | ((uint32_t)data[pos + 1] << 16) | ((uint32_t)data[pos + 2] << 8) | data[pos + 3];
+		pos += 4;
+		sample_t sample;
+		memset(&sample, 0, sizeof(sample));
+		sample.time_ms = uplink.time_us / 1000 - (uint64_t)age * 1000;
+		// Values up to the battery voltage, the last value of a sample
+		while (true)
+		{
+			if (pos + 2 > data.size())
+			{
+				return false;
+			}
+			uint8_t channel = data[pos];
+			uint8_t type = data[pos + 1];
+			size_t size;
+			switch (type)
+			{
+			case LPP_RELATIVE_HUMIDITY:
+				size = 1;
+				break;
+			case LPP_TEMPERATURE:
+			case LPP_BAROMETRIC_PRESSURE:
+			case LPP_ANALOG_INPUT:
+			case LPP_CONCENTRATION:
+			case LPP_VOLTAGE:
+			case LPP_VOC:
+				size = 2;
+				break;
+			default:
+				return false;
+			}
+			pos += 2;
+			if (pos + size > data.size())
+			{
+				return false;
+			}
+			if (channel == LPP_CHANNEL_TEMP_2)
+			{
+				sample.temperature = (int16_t)((data[pos] << 8) | data[pos + 1]);
+			}
+			pos += size;
+			sample.values++;
+			if (channel == LPP_CHANNEL_BATT)
+			{
+				sample.battery = (uint16_t)((data[pos - 2] << 8) | data[pos - 1]);
+				break;
+			}
+		}
+		samples.push_back(sample);
+	}
+	return true;
+}
+
+/** Queue uplinks and decoded samples since the last call */
+struct drain_result_t
+{
+	uint32_t uplinks;
+	uint32_t broken;
+	uint32_t too_large;
+	/** Shortest time between two queue uplinks in ms */
+	uint64_t min_gap_ms;
+	std::vector<sample_t> samples;
+};
+
+/**
+ * @brief Decode the queue uplinks since an index of host_uplinks
+ *
+ * @param first first uplink to check
+ * @return drain_result_t
+ */
+static drain_result_t decode_drain(size_t first)
+{
+	drain_result_t result;
+	result.uplinks = 0;
+	result.broken = 0;
+	result.too_large = 0;
+	result.min_gap_ms = UINT64_MAX;
+	uint64_t last_us = 0;
+	for (size_t idx = first; idx < host_uplinks.size(); idx++)
+	{
+		const host_uplink_t &uplink = host_uplinks[idx];
+		if (uplink.fport != SF_FPORT)
+		{
+			continue;
+		}
+		if (result.uplinks++ != 0)
+		{
+			uint64_t gap = (uplink.time_us - last_us) / 1000;
+			result.min_gap_ms = gap < result.min_gap_ms ? gap : result.min_gap_ms;
+		}
+		last_us = uplink.time_us;
+		result.broken += decode_queue_uplink(uplink, result.samples) ? 0 : 1;
+		result.too_large += (uplink.data.size() > max_payload_size()) ? 1 : 0;
+	}
+	return result;
+}
+
+/**
+ * @brief Check the samples of a drain against the sample times
+ *
+ * @param name name of the case for the report
+ * @param result decoded queue uplinks
+ * @param expected number of samples
+ * @param last_start_ms start of the loop() run that queued the newest sample
+ * @param last_end_ms end of the loop() run that queued the newest sample
+ */
+static void check_drain(const char *name, const drain_result_t &result, size_t expected, uint64_t last_start_ms, uint64_t last_end_ms)
+{
+	uint32_t out_of_order = 0;
+	uint32_t wrong_values = 0;
+	for (size_t idx = 0; idx < result.samples.size(); idx++)
+	{
+		const sample_t &sample = result.samples[idx];
+		// Ages are whole seconds, one sample per send interval
+		if ((idx != 0) && (abs((int64_t)(sample.time_ms - result.samples[idx - 1].time_ms) - TEST_SENDINT * 1000) > 1000))
+		{
+			out_of_order++;
+		}
+		// Battery is the last value, all values of the node were queued
+		if ((sample.battery != (uint16_t)(host_battery * 100.0f + 0.5f)) || (sample.values < 9) ||
+			(sample.temperature != result.samples[0].temperature))
+		{
+			wrong_values++;
+		}
+	}
+	// Ages are whole seconds
+	bool newest_kept = !result.samples.empty() && (result.samples.back().time_ms + 1000 >= last_start_ms) &&
+					   (result.samples.back().time_ms <= last_end_ms);
+	printf("  %-14s %2lu samples in %2lu uplinks, min gap %5.1f s, %lu out of order, %lu wrong, newest %s\n", name,
+		   (unsigned long)result.samples.size(), (unsigned long)result.uplinks,
+		   result.uplinks > 1 ? result.min_gap_ms / 1000.0 : 0.0, (unsigned long)out_of_order, (unsigned long)wrong_values,
+		   newest_kept ? "kept" : "missing");
+	check(result.broken == 0, "queue uplink is not a list of complete samples");
+	check(result.too_large == 0, "queue uplink larger than the max payload");
+	check(result.samples.size() == expected, "queued samples missing or sent twice");
+	check(out_of_order == 0, "queued samples out of order or with a wrong age");
+	check(wrong_values == 0, "queued sample values changed");
+	check(newest_kept, "newest sample not kept");
+	check((result.uplinks < 2) || (result.min_gap_ms + SCHED_SLACK_DRAIN >= SF_DRAIN_INTERVAL), "queue uplinks faster than SF_DRAIN_INTERVAL");
+}
+
+/**
+ * @brief Run the node until the queue is empty
+ */
+static void run_until_drained(void)
+{
+	uint64_t end = host_now_us() + 3600000000ULL;
+	while ((sf_depth() != 0) && (host_now_us() < end))
+	{
+		host_run_until(host_now_us() + 1000000ULL);
+	}
+}
+
+/**
+ * @brief Run the node and find the time of the last sample queued
+ *        One loop() run sleeps until the next job, the sample was
+ *        queued between its start and its end
+ *
+ * @param minutes run time
+ * @param last_start_ms start of the loop() run that queued the last sample
+ * @param last_end_ms end of the loop() run that queued the last sample
+ */
+static void run_minutes(uint32_t minutes, uint64_t &last_start_ms, uint64_t &last_end_ms)
+{
+	uint32_t stored = sf_stats.stored;
+	last_start_ms = last_end_ms = 0;
+	uint64_t end = host_now_us() + minutes * 60000000ULL;
+	while (host_now_us() < end)
+	{
+		uint64_t start_ms = host_now_us() / 1000;
+		host_run_until(host_now_us() + 1000ULL);
+		if (sf_stats.stored != stored)
+		{
+			stored = sf_stats.stored;
+			last_start_ms = start_ms;
+			last_end_ms = host_now_us() / 1000;
+		}
+	}
+}
+
+/**
+ * @brief Values that do not fit into a queued sample are clamped
+ */
+static void test_clamp(void)
+{
+	sensor_snapshot_t values;
+	memset(&values, 0, sizeof(values));
+	values.env_valid = true;
+	values.env_temperature = 2150;
+	values.env_humidity = 45000;
+	values.env_pressure = 101325;
+	// Clean air, above the 655 kOhm of a 16 bit value in 10 Ohm
+	values.env_gas = 2000000;
+	sf_record_t record;
+	sf_make_record(record, values, 3.9f);
+	check(sf_record_value(record, SF_CH_ENV_GAS) == UINT16_MAX, "high gas resistance not clamped");
+	values.env_gas = 123450;
+	sf_make_record(record, values, 3.9f);
+	check(sf_record_value(record, SF_CH_ENV_GAS) == 12345, "gas resistance changed");
+}
+
+int main(void)
+{
+	test_clamp();
+
+	host_default_node();
+	setup();
+	check(host_at("ATC+SENDINT=60") == AT_OK, "SENDINT failed");
+	printf("Queue of unsent samples, send interval %d s, queue size %d\n", TEST_SENDINT, SF_QUEUE_SIZE);
+
+	// Long join outage, the queue keeps the newest samples
+	host_joined = false;
+	size_t uplinks = host_uplinks.size();
+	uint64_t last_start_ms;
+	uint64_t last_end_ms;
+	run_minutes(TEST_OUTAGE_MIN, last_start_ms, last_end_ms);
+	check(host_uplinks.size() == uplinks, "uplinks sent while not joined");
+	check(sf_depth() == SF_QUEUE_SIZE, "queue not full after the outage");
+	check(sf_stats.dropped + SF_QUEUE_SIZE == sf_stats.stored, "dropped samples not counted");
+	check(host_at("ATC+SFQUEUE=?") == AT_OK, "SFQUEUE query failed");
+
+	// Joined again, the first uplink starts the drain
+	host_joined = true;
+	uplinks = host_uplinks.size();
+	run_until_drained();
+	check(sf_depth() == 0, "queue not drained after the join");
+	check_drain("join outage", decode_drain(uplinks), SF_QUEUE_SIZE, last_start_ms, last_end_ms);
+
+	// Uplinks blocked, e.g. by the duty cycle, the failed samples are queued
+	host_send_result = false;
+	uint32_t dropped = sf_stats.dropped;
+	run_minutes(TEST_BLOCK_MIN, last_start_ms, last_end_ms);
+	uint16_t blocked = sf_depth();
+	check((blocked >= TEST_BLOCK_MIN - 1) && (blocked <= TEST_BLOCK_MIN + 1), "failed uplinks not queued");
+	check(sf_stats.dropped == dropped, "samples dropped from a queue that was not full");
+	host_send_result = true;
+	uplinks = host_uplinks.size();
+	run_until_drained();
+	check(sf_depth() == 0, "queue not drained after the block");
+	check_drain("duty cycle", decode_drain(uplinks), blocked, last_start_ms, last_end_ms);
+
+	check(sf_stats.sent + sf_stats.dropped == sf_stats.stored, "samples lost in the queue");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,255 @@
+/**
+ * @file Arduino.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the Arduino core and the RUI3 API
+ *        Only the parts used by the sketch, see host_sim.h
+ *        for the simulation control
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef ARDUINO_H_STUB
+#define ARDUINO_H_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <time.h>
+#include <math.h>
+
+typedef uint8_t byte;
+#define HIGH 1
+#define LOW 0
+#define OUTPUT 1
+#define INPUT 0
+#define LED_GREEN 1
+#define LED_BLUE 2
+#define WB_IO2 3
+#define HEX 16
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void digitalWrite(int pin, int value);
+int digitalRead(int pin);
+void pinMode(int pin, int mode);
+void noInterrupts(void);
+void interrupts(void);
+
+class String
+{
+public:
+	String(const char *s = "") { set(s); }
+	String &operator=(const char *s)
+	{
+		set(s);
+		return *this;
+	}
+	void toUpperCase()
+	{
+		for (char *c = _buf; *c; c++)
+		{
+			*c = toupper(*c);
+		}
+	}
+	const char *c_str() const { return _buf; }
+
+private:
+	void set(const char *s)
+	{
+		strncpy(_buf, s, sizeof(_buf) - 1);
+		_buf[sizeof(_buf) - 1] = 0;
+	}
+	char _buf[64];
+};
+
+/** Write to the captured Serial output */
+size_t host_serial_write(const char *data, size_t len);
+
+class HardwareSerial
+{
+public:
+	void begin(long, int = 0) {}
+	int available() { return 0; }
+	int printf(const char *format, ...) __attribute__((format(printf, 2, 3)))
+	{
+		char line[512];
+		va_list args;
+		va_start(args, format);
+		int len = vsnprintf(line, sizeof(line), format, args);
+		va_end(args);
+		if (len > (int)sizeof(line) - 1)
+		{
+			len = sizeof(line) - 1;
+		}
+		return (int)host_serial_write(line, len);
+	}
+	size_t print(const char *s) { return host_serial_write(s, strlen(s)); }
+	size_t print(int value, int base = 10) { return printf(base == HEX ? "%X" : "%d", value); }
+	size_t println(const char *s) { return print(s) + println(); }
+	size_t println() { return host_serial_write("\r\n", 2); }
+	size_t write(const uint8_t *data, size_t len) { return host_serial_write((const char *)data, len); }
+	size_t write(const char *data, size_t len) { return host_serial_write(data, len); }
+	void flush() {}
+};
+extern HardwareSerial Serial;
+
+// RUI3 API subset
+#define RAK_CUSTOM_MODE 1
+typedef enum
+{
+	RAK_TIMER_0,
+	RAK_TIMER_1,
+	RAK_TIMER_2,
+	RAK_TIMER_3,
+	RAK_TIMER_4
+} RAK_TIMER_ID;
+typedef enum
+{
+	RAK_TIMER_ONESHOT,
+	RAK_TIMER_PERIODIC
+} RAK_TIMER_MODE;
+typedef void (*RAK_TIMER_HANDLER)(void *);
+typedef int SERIAL_PORT;
+typedef struct
+{
+	int argc;
+	char *argv[16];
+} stParam;
+#define AT_OK 0
+#define AT_ERROR 1
+#define AT_PARAM_ERROR 2
+#define AT_BUSY_ERROR 3
+#define RAK_REGION_EU433 0
+#define RAK_REGION_CN470 1
+#define RAK_REGION_RU864 2
+#define RAK_REGION_IN865 3
+#define RAK_REGION_EU868 4
+#define RAK_REGION_US915 5
+#define RAK_REGION_AU915 6
+#define RAK_REGION_KR920 7
+#define RAK_REGION_AS923 8
+typedef struct
+{
+	uint8_t Port;
+	uint8_t RxDatarate;
+	uint8_t *Buffer;
+	uint8_t BufferSize;
+	int16_t Rssi;
+	int8_t Snr;
+} SERVICE_LORA_RECEIVE_T;
+
+// Implemented in host_stubs.cpp
+bool host_timer_create(RAK_TIMER_ID id, RAK_TIMER_HANDLER handler);
+bool host_timer_start(RAK_TIMER_ID id, uint32_t ms);
+bool host_timer_stop(RAK_TIMER_ID id);
+bool host_flash_get(uint32_t offset, uint8_t *buf, uint32_t len);
+bool host_flash_set(uint32_t offset, uint8_t *buf, uint32_t len);
+bool host_sleep_all(void);
+float host_bat_get(void);
+bool host_at_add(const char *cmd, int (*handler)(SERIAL_PORT, char *, stParam *));
+bool host_lorawan_send(uint8_t size, uint8_t *data, uint8_t fport);
+bool host_njs_get(void);
+uint8_t host_dr_get(void);
+int32_t host_band_get(void);
+
+template <typename T>
+struct host_setting
+{
+	T value;
+	host_setting() : value() {}
+	T get() { return value; }
+	bool set(T v)
+	{
+		value = v;
+		return true;
+	}
+};
+struct host_key
+{
+	bool get(uint8_t *buf, int len)
+	{
+		memset(buf, 0, len);
+		return true;
+	}
+	bool set(uint8_t *, int) { return true; }
+};
+
+struct RakApi
+{
+	struct
+	{
+		struct
+		{
+			bool create(RAK_TIMER_ID id, RAK_TIMER_HANDLER handler, RAK_TIMER_MODE) { return host_timer_create(id, handler); }
+			bool start(RAK_TIMER_ID id, uint32_t ms, void *) { return host_timer_start(id, ms); }
+			bool stop(RAK_TIMER_ID id) { return host_timer_stop(id); }
+		} timer;
+		struct
+		{
+			bool get(uint32_t offset, uint8_t *buf, uint32_t len) { return host_flash_get(offset, buf, len); }
+			bool set(uint32_t offset, uint8_t *buf, uint32_t len) { return host_flash_set(offset, buf, len); }
+		} flash;
+		struct
+		{
+			bool all() { return host_sleep_all(); }
+			bool all(uint32_t) { return host_sleep_all(); }
+		} sleep;
+		struct
+		{
+			float get() { return host_bat_get(); }
+		} bat;
+		struct
+		{
+			bool add(char *cmd, char *, char *, int (*handler)(SERIAL_PORT, char *, stParam *), uint32_t = 0) { return host_at_add(cmd, handler); }
+		} atMode;
+		struct
+		{
+			String get() { return String("rak3172"); }
+		} modelId;
+		struct
+		{
+			String get() { return String("host"); }
+		} firmwareVersion;
+	} system;
+	struct
+	{
+		bool send(uint8_t size, uint8_t *data, uint8_t fport, bool = false, uint8_t = 0) { return host_lorawan_send(size, data, fport); }
+		bool join() { return true; }
+		bool registerRecvCallback(void (*)(SERVICE_LORA_RECEIVE_T *)) { return true; }
+		bool registerSendCallback(void (*)(int32_t)) { return true; }
+		bool registerJoinCallback(void (*)(int32_t)) { return true; }
+		struct
+		{
+			bool get() { return host_njs_get(); }
+		} njs;
+		struct
+		{
+			uint8_t get() { return host_dr_get(); }
+			bool set(uint8_t) { return true; }
+		} dr;
+		struct
+		{
+			int32_t get() { return host_band_get(); }
+			bool set(int32_t) { return true; }
+		} band;
+		host_setting<bool> adr, njm;
+		host_setting<int32_t> nwm;
+		host_setting<uint32_t> pfreq, pbr, pfdev;
+		host_setting<uint8_t> psf, pbw, pcr, ptp;
+		host_setting<uint16_t> ppl;
+		host_key deui, appeui, appkey, appskey, nwkskey, daddr;
+	} lorawan;
+};
+extern RakApi api;
+
+#include <Wire.h>
+
+#endif // ARDUINO_H_STUB
@@ -0,0 +1 @@
+// Host stub, JSON is not used by the host tests
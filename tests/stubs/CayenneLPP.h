@@ -0,0 +1,118 @@
+/**
+ * @file CayenneLPP.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the ElectronicCats CayenneLPP encoder
+ *        Subset of the types used by the sketch, same encoding
+ *        as the library: the float value is multiplied with the
+ *        type resolution and truncated, MSB first. getError()
+ *        clears the error like the library does.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef CAYENNE_LPP_H_STUB
+#define CAYENNE_LPP_H_STUB
+
+#include <Arduino.h>
+
+#define LPP_DIGITAL_INPUT 0
+#define LPP_DIGITAL_OUTPUT 1
+#define LPP_ANALOG_INPUT 2
+#define LPP_ANALOG_OUTPUT 3
+#define LPP_GENERIC_SENSOR 100
+#define LPP_LUMINOSITY 101
+#define LPP_PRESENCE 102
+#define LPP_TEMPERATURE 103
+#define LPP_RELATIVE_HUMIDITY 104
+#define LPP_BAROMETRIC_PRESSURE 115
+#define LPP_VOLTAGE 116
+#define LPP_CURRENT 117
+#define LPP_PERCENTAGE 120
+#define LPP_CONCENTRATION 125
+#define LPP_UNIXTIME 133
+
+#define LPP_DIGITAL_INPUT_SIZE 1
+#define LPP_ANALOG_INPUT_SIZE 2
+#define LPP_GENERIC_SENSOR_SIZE 4
+#define LPP_LUMINOSITY_SIZE 2
+#define LPP_TEMPERATURE_SIZE 2
+#define LPP_RELATIVE_HUMIDITY_SIZE 1
+#define LPP_BAROMETRIC_PRESSURE_SIZE 2
+#define LPP_VOLTAGE_SIZE 2
+#define LPP_PERCENTAGE_SIZE 1
+#define LPP_CONCENTRATION_SIZE 2
+#define LPP_UNIXTIME_SIZE 4
+
+#define LPP_ERROR_OK 0
+#define LPP_ERROR_OVERFLOW 1
+#define LPP_ERROR_UNKOWN_TYPE 2
+
+class CayenneLPP
+{
+public:
+	CayenneLPP(uint8_t size) : _maxsize(size) { _buffer = (uint8_t *)malloc(size); }
+	~CayenneLPP() { free(_buffer); }
+
+	void reset(void) { _cursor = 0; }
+	uint8_t getSize(void) { return _cursor; }
+	uint8_t *getBuffer(void) { return _buffer; }
+	uint8_t getError(void)
+	{
+		uint8_t error = _error;
+		_error = LPP_ERROR_OK;
+		return error;
+	}
+
+	uint8_t addDigitalInput(uint8_t channel, uint32_t value) { return addField(LPP_DIGITAL_INPUT, channel, LPP_DIGITAL_INPUT_SIZE, 1, false, value); }
+	uint8_t addAnalogInput(uint8_t channel, float value) { return addField(LPP_ANALOG_INPUT, channel, LPP_ANALOG_INPUT_SIZE, 100, true, value); }
+	uint8_t addGenericSensor(uint8_t channel, float value) { return addField(LPP_GENERIC_SENSOR, channel, LPP_GENERIC_SENSOR_SIZE, 1, false, value); }
+	uint8_t addLuminosity(uint8_t channel, uint32_t value) { return addField(LPP_LUMINOSITY, channel, LPP_LUMINOSITY_SIZE, 1, false, value); }
+	uint8_t addTemperature(uint8_t channel, float value) { return addField(LPP_TEMPERATURE, channel, LPP_TEMPERATURE_SIZE, 10, true, value); }
+	uint8_t addRelativeHumidity(uint8_t channel, float value) { return addField(LPP_RELATIVE_HUMIDITY, channel, LPP_RELATIVE_HUMIDITY_SIZE, 2, false, value); }
+	uint8_t addBarometricPressure(uint8_t channel, float value) { return addField(LPP_BAROMETRIC_PRESSURE, channel, LPP_BAROMETRIC_PRESSURE_SIZE, 10, false, value); }
+	uint8_t addVoltage(uint8_t channel, float value) { return addField(LPP_VOLTAGE, channel, LPP_VOLTAGE_SIZE, 100, false, value); }
+	uint8_t addPercentage(uint8_t channel, uint32_t value) { return addField(LPP_PERCENTAGE, channel, LPP_PERCENTAGE_SIZE, 1, false, value); }
+	uint8_t addConcentration(uint8_t channel, uint32_t value) { return addField(LPP_CONCENTRATION, channel, LPP_CONCENTRATION_SIZE, 1, false, value); }
+	uint8_t addUnixTime(uint8_t channel, uint32_t value) { return addField(LPP_UNIXTIME, channel, LPP_UNIXTIME_SIZE, 1, false, value); }
+
+protected:
+	uint8_t *_buffer;
+	uint8_t _maxsize;
+	uint8_t _cursor = 0;
+	uint8_t _error = LPP_ERROR_OK;
+
+private:
+	uint8_t addField(uint8_t type, uint8_t channel, uint8_t size, uint32_t multiplier, bool is_signed, float value)
+	{
+		if ((_cursor + size + 2) > _maxsize)
+		{
+			_error = LPP_ERROR_OVERFLOW;
+			return 0;
+		}
+		bool sign = value < 0;
+		if (sign)
+		{
+			value = -value;
+		}
+		uint32_t v = value * multiplier;
+		if (is_signed && sign)
+		{
+			uint32_t mask = (size == 4) ? 0xFFFFFFFF : ((1UL << (size * 8)) - 1);
+			v = v & mask;
+			v = mask - v + 1;
+		}
+		_buffer[_cursor++] = channel;
+		_buffer[_cursor++] = type;
+		for (uint8_t i = 1; i <= size; i++)
+		{
+			_buffer[_cursor + size - i] = (v & 0xFF);
+			v >>= 8;
+		}
+		_cursor += size;
+		return _cursor;
+	}
+};
+
+#endif // CAYENNE_LPP_H_STUB
@@ -0,0 +1,63 @@
+/**
+ * @file SensirionI2CSgp40.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the Sensirion SGP40 driver, simulated by host_sgp40
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SENSIRION_I2C_SGP40_H_STUB
+#define SENSIRION_I2C_SGP40_H_STUB
+
+#include <Arduino.h>
+#include "host_sim.h"
+
+class SensirionI2CSgp40
+{
+public:
+	void begin(TwoWire &) {}
+	uint16_t getSerialNumber(uint16_t *serialNumber, uint8_t serialNumberSize)
+	{
+		if (!host_sgp40.present)
+		{
+			return 1;
+		}
+		for (uint8_t i = 0; i < serialNumberSize; i++)
+		{
+			serialNumber[i] = 0x1234 + i;
+		}
+		return 0;
+	}
+	uint16_t executeSelfTest(uint16_t &testResult)
+	{
+		if (!host_sgp40.present)
+		{
+			return 1;
+		}
+		delay(320);
+		testResult = 0xD400;
+		return 0;
+	}
+	uint16_t measureRawSignal(uint16_t relativeHumidity, uint16_t temperature, uint16_t &srawVoc)
+	{
+		if (!host_sgp40.present)
+		{
+			return 1;
+		}
+		host_advance_us(host_sgp40.measure_us);
+		host_sgp40.last_rh = relativeHumidity;
+		host_sgp40.last_t = temperature;
+		host_sgp40.measurements++;
+		srawVoc = (host_sgp40.source != NULL) ? host_sgp40.source() : host_sgp40.sraw;
+		return 0;
+	}
+	uint16_t turnHeaterOff(void)
+	{
+		host_sgp40.heater_off++;
+		return 0;
+	}
+};
+
+#endif // SENSIRION_I2C_SGP40_H_STUB
@@ -0,0 +1,86 @@
+/**
+ * @file SparkFun_SCD30_Arduino_Library.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the SparkFun SCD30 driver, simulated by host_scd30
+ *        The sensor measures every interval seconds after the last
+ *        beginMeasuring() or interval change. Both are stored in the
+ *        non volatile memory of the sensor and counted in nv_writes.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef SPARKFUN_SCD30_H_STUB
+#define SPARKFUN_SCD30_H_STUB
+
+#include <Arduino.h>
+#include "host_sim.h"
+
+class SCD30
+{
+public:
+	bool begin(TwoWire &, bool = true, bool = true) { return host_scd30.present; }
+	bool setMeasurementInterval(uint16_t interval)
+	{
+		host_scd30.nv_writes++;
+		host_scd30.interval = interval;
+		restart();
+		return true;
+	}
+	bool setAutoSelfCalibration(bool) { return true; }
+	bool beginMeasuring(uint16_t = 0)
+	{
+		host_scd30.nv_writes++;
+		host_scd30.begin_calls++;
+		restart();
+		return true;
+	}
+	bool StopMeasurement(void) { return true; }
+	bool dataAvailable(void) { return measurement_index() > host_scd30.last_read_index; }
+	uint16_t getCO2(void)
+	{
+		read();
+		return (uint16_t)host_scd30.co2;
+	}
+	float getTemperature(void) { return host_scd30.temperature; }
+	float getHumidity(void) { return host_scd30.humidity; }
+	bool getMeasurementInterval(uint16_t *interval)
+	{
+		*interval = host_scd30.interval;
+		return true;
+	}
+
+private:
+	/** Sensor measurement period in us including the clock error */
+	static uint64_t period_us(void)
+	{
+		return (uint64_t)host_scd30.interval * 1000000ULL * (1000000LL + host_scd30.clock_ppm) / 1000000ULL;
+	}
+	/** Index of the last finished measurement of the current cycle, 0 = none yet */
+	static int64_t measurement_index(void)
+	{
+		if (host_scd30.interval == 0)
+		{
+			return 0;
+		}
+		return (int64_t)((host_now_us() - host_scd30.cycle_start_us) / period_us());
+	}
+	static void restart(void)
+	{
+		host_scd30.cycle_start_us = host_now_us();
+		host_scd30.last_read_index = 0;
+	}
+	static void read(void)
+	{
+		int64_t index = measurement_index();
+		if (index > host_scd30.last_read_index)
+		{
+			host_scd30.last_read_index = index;
+			host_scd30.last_read_done_us = host_scd30.cycle_start_us + index * period_us();
+			host_scd30.reads++;
+		}
+	}
+};
+
+#endif // SPARKFUN_SCD30_H_STUB
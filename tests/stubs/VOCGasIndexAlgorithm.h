@@ -0,0 +1,110 @@
+/**
+ * @file VOCGasIndexAlgorithm.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the Sensirion VOC gas index algorithm
+ *        Simplified model, not the Sensirion algorithm. It keeps
+ *        the properties the host tests depend on:
+ *        - 45 s blackout after the start, index 0
+ *        - mean and spread of SRAW learned with a time constant in
+ *          hours, converted to samples with the sampling interval
+ *        - get_states()/set_states() carry the learned mean and spread
+ *        - index 100 at the learned mean, higher for more VOC (lower SRAW)
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef VOC_GAS_INDEX_ALGORITHM_H_STUB
+#define VOC_GAS_INDEX_ALGORITHM_H_STUB
+
+#include <stdint.h>
+#include <math.h>
+
+class VOCGasIndexAlgorithm
+{
+public:
+	VOCGasIndexAlgorithm(float sampling_interval = 1.0f) : _interval(sampling_interval) { reset(); }
+
+	int32_t process(int32_t sraw)
+	{
+		_uptime += _interval;
+		if (_uptime <= 45.0f)
+		{
+			return 0;
+		}
+		if (!_initialized)
+		{
+			_mean = (float)sraw;
+			_initialized = true;
+		}
+		// Faster learning at the start, 12 h time constant once learned
+		float tau = _learned + 3600.0f;
+		if (tau > 12.0f * 3600.0f)
+		{
+			tau = 12.0f * 3600.0f;
+		}
+		float alpha = _interval / tau;
+		float delta = (float)sraw - _mean;
+		_mean += alpha * delta;
+		_std = sqrtf((1.0f - alpha) * _std * _std + alpha * delta * delta);
+		if (_std < 10.0f)
+		{
+			_std = 10.0f;
+		}
+		_learned += _interval;
+		float index = 100.0f + 100.0f * (_mean - (float)sraw) / _std;
+		if (index < 1.0f)
+		{
+			index = 1.0f;
+		}
+		if (index > 500.0f)
+		{
+			index = 500.0f;
+		}
+		return (int32_t)(index + 0.5f);
+	}
+	void get_states(float &state0, float &state1)
+	{
+		state0 = _mean;
+		state1 = _std;
+	}
+	void set_states(float state0, float state1)
+	{
+		_mean = state0;
+		_std = state1;
+		_initialized = true;
+		// Restored states continue with the slow learning, like the Sensirion algorithm
+		_learned = 12.0f * 3600.0f;
+	}
+	void get_tuning_parameters(int32_t &index_offset, int32_t &learning_time_offset_hours,
+							   int32_t &learning_time_gain_hours, int32_t &gating_max_duration_minutes,
+							   int32_t &std_initial, int32_t &gain_factor)
+	{
+		index_offset = 100;
+		learning_time_offset_hours = 12;
+		learning_time_gain_hours = 12;
+		gating_max_duration_minutes = 180;
+		std_initial = 50;
+		gain_factor = 230;
+	}
+	void get_sampling_interval(float &sampling_interval) { sampling_interval = _interval; }
+	void reset(void)
+	{
+		_uptime = 0.0f;
+		_learned = 0.0f;
+		_mean = 0.0f;
+		_std = 50.0f;
+		_initialized = false;
+	}
+
+private:
+	float _interval;
+	float _uptime;
+	float _learned;
+	float _mean;
+	float _std;
+	bool _initialized;
+};
+
+#endif // VOC_GAS_INDEX_ALGORITHM_H_STUB
@@ -0,0 +1,47 @@
+/**
+ * @file Wire.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host stub of the Arduino Wire library
+ *        Transactions go to the devices attached with host_i2c_attach()
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef WIRE_H_STUB
+#define WIRE_H_STUB
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** Max bytes of one transaction */
+#define HOST_WIRE_BUFFER 64
+
+class TwoWire
+{
+public:
+	void begin(void) {}
+	void setClock(uint32_t) {}
+	void beginTransmission(uint8_t address);
+	void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+	size_t write(uint8_t data);
+	size_t write(const uint8_t *data, size_t len);
+	uint8_t endTransmission(bool stop = true);
+	template <typename A, typename L>
+	uint8_t requestFrom(A address, L len, bool stop = true) { return request((uint8_t)address, (size_t)len, stop); }
+	int available(void);
+	int read(void);
+
+private:
+	uint8_t request(uint8_t address, size_t len, bool stop);
+	uint8_t _address = 0;
+	uint8_t _tx[HOST_WIRE_BUFFER];
+	size_t _tx_len = 0;
+	uint8_t _rx[HOST_WIRE_BUFFER];
+	size_t _rx_len = 0;
+	size_t _rx_pos = 0;
+};
+extern TwoWire Wire;
+
+#endif // WIRE_H_STUB
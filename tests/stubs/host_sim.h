@@ -0,0 +1,293 @@
+/**
+ * @file host_sim.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Control interface of the host stubs
+ *        The stubs replace the RUI3 API, Serial and Wire with a
+ *        simulated clock, RAM flash, recorded uplinks and a
+ *        simulated I2C bus, so the sketch modules can be
+ *        built and tested on the host.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef HOST_SIM_H
+#define HOST_SIM_H
+
+#include <Arduino.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+/** Simulated time in us since power up */
+uint64_t host_now_us(void);
+/** Advance the simulated time, time spent awake */
+void host_advance_us(uint64_t us);
+/** Set the simulated time, e.g. to test the millis() overflow */
+void host_set_time_us(uint64_t us);
+/** Time spent awake, sleep.all() does not count */
+extern uint64_t host_awake_us;
+/** Time spent in delay() */
+extern uint64_t host_delay_us;
+
+/** Captured Serial output */
+extern std::string host_serial_out;
+/** Serial output is also printed to stdout */
+extern bool host_serial_echo;
+/** Blocking UART time per byte in us, 0 = output is free. 87 us is 115200 baud */
+extern uint32_t host_serial_byte_us;
+
+/** Size of the simulated flash */
+#define HOST_FLASH_SIZE 1024
+/** Simulated flash, erased to 0xFF */
+extern uint8_t host_flash[HOST_FLASH_SIZE];
+/** Number of flash writes */
+extern uint32_t host_flash_writes;
+/** Erase the simulated flash */
+void host_flash_erase(void);
+
+/** Recorded uplink */
+struct host_uplink_t
+{
+	uint8_t fport;
+	std::vector<uint8_t> data;
+	uint64_t time_us;
+};
+/** Uplinks sent with api.lorawan.send() */
+extern std::vector<host_uplink_t> host_uplinks;
+/** Result of api.lorawan.send() */
+extern bool host_send_result;
+/** Network joined state returned by api.lorawan.njs.get() */
+extern bool host_joined;
+/** Data rate and region returned by api.lorawan.dr.get() and api.lorawan.band.get() */
+extern uint8_t host_dr;
+extern int32_t host_band;
+/** Battery voltage returned by api.system.bat.get() */
+extern float host_battery;
+
+/** Timer handlers and due times of the simulated RUI3 timers */
+extern void (*host_timer_handler[5])(void *);
+extern bool host_timer_armed[5];
+extern uint64_t host_timer_due_us[5];
+/** Number of sleep.all() calls that woke up by a timer */
+extern uint32_t host_timer_wakeups;
+/** Sleep until the next timer, returns false if no timer is armed */
+bool host_sleep_until_timer(void);
+
+/** Registered AT commands */
+struct host_at_cmd_t
+{
+	std::string name;
+	int (*handler)(SERIAL_PORT, char *, stParam *);
+};
+extern std::vector<host_at_cmd_t> host_at_cmds;
+/** Run an AT command like "ATC+PRIO=3:5" or "ATC+PRIO=?", returns the handler result, -1 if unknown */
+int host_at(const char *command);
+
+/**
+ * @brief Simulated I2C device
+ *        write() gets the bytes of one write transaction,
+ *        read() fills the bytes of one read transaction
+ */
+class host_i2c_device
+{
+public:
+	virtual ~host_i2c_device() {}
+	virtual bool write(const uint8_t *data, size_t len) = 0;
+	virtual size_t read(uint8_t *data, size_t len) = 0;
+};
+
+/** Attach a device to the simulated bus, NULL removes it */
+void host_i2c_attach(uint8_t address, host_i2c_device *device);
+/** Remove all devices from the simulated bus */
+void host_i2c_detach_all(void);
+/** Number of I2C transactions, address phase of each write and read */
+extern uint32_t host_i2c_transactions;
+/** Bus time per transaction in us, 0 = free */
+extern uint32_t host_i2c_transaction_us;
+/** Wire calls from a thread marked with host_mark_foreign_thread() */
+extern uint32_t host_bus_violations;
+/** Mark the calling thread as AT command context, Wire access from it is counted as violation */
+void host_mark_foreign_thread(void);
+
+/**
+ * @brief Device with 8 bit register addresses, auto increment on read
+ *        Writes are register/value pairs like the Bosch sensors use
+ */
+class host_register_device : public host_i2c_device
+{
+public:
+	uint8_t regs[256];
+	uint8_t pointer;
+	/** Writes are register/value pairs instead of one start register with auto increment */
+	bool pair_writes;
+	host_register_device() : pointer(0), pair_writes(false) { memset(regs, 0, sizeof(regs)); }
+	virtual bool write(const uint8_t *data, size_t len);
+	virtual size_t read(uint8_t *data, size_t len);
+	/** Called after a register was written */
+	virtual void written(uint8_t reg) { (void)reg; }
+	/** Called before a register is read */
+	virtual void reading(uint8_t reg) { (void)reg; }
+};
+
+/**
+ * @brief Sensirion style device, 16 bit commands, responses are
+ *        16 bit words with CRC
+ */
+class host_sensirion_device : public host_i2c_device
+{
+public:
+	uint16_t command;
+	std::vector<uint16_t> response;
+	host_sensirion_device() : command(0) {}
+	virtual bool write(const uint8_t *data, size_t len);
+	virtual size_t read(uint8_t *data, size_t len);
+	/** Fill response for a command, return false to NAK */
+	virtual bool execute(uint16_t cmd, const uint8_t *args, size_t len) = 0;
+	static uint8_t crc8(const uint8_t *data, size_t len);
+};
+
+/**
+ * @brief Sensirion device that answers one identification command,
+ *        e.g. the serial number of the SGP40 or the firmware version of the SCD30
+ */
+class host_sensirion_id : public host_sensirion_device
+{
+public:
+	uint16_t id_command;
+	uint8_t id_words;
+	host_sensirion_id(uint16_t cmd, uint8_t words) : id_command(cmd), id_words(words) {}
+	virtual bool execute(uint16_t cmd, const uint8_t *, size_t)
+	{
+		if (cmd == id_command)
+		{
+			response.assign(id_words, 0x0342);
+		}
+		return true;
+	}
+};
+
+/**
+ * @brief Device that acknowledges its address, reads return 0xFF
+ */
+class host_ack_device : public host_i2c_device
+{
+public:
+	virtual bool write(const uint8_t *, size_t) { return true; }
+	virtual size_t read(uint8_t *data, size_t len)
+	{
+		memset(data, 0xFF, len);
+		return len;
+	}
+};
+
+/**
+ * @brief BME680 register model
+ *        Forced mode conversions take the time given by the
+ *        oversampling and heater settings, the measuring bit is
+ *        set until then.
+ */
+class host_bme680 : public host_register_device
+{
+public:
+	/** Raw ADC values returned by the next conversions */
+	uint32_t adc_temp;
+	uint32_t adc_pres;
+	uint16_t adc_hum;
+	uint16_t adc_gas;
+	uint8_t gas_range;
+	/** Number of forced mode conversions */
+	uint32_t conversions;
+	/** Number of conversions with the heater on */
+	uint32_t gas_conversions;
+	/** End of the running conversion */
+	uint64_t conversion_end_us;
+	/** Additional conversion time, e.g. a slow sensor */
+	uint32_t extra_us;
+	/** Byte reads of the calibration area */
+	uint32_t calib_reads;
+	host_bme680(uint16_t t1 = 26185);
+	/** Conversion time in us per the datasheet for the current settings */
+	uint64_t conversion_time_us(void) const;
+	virtual void written(uint8_t reg);
+	virtual void reading(uint8_t reg);
+};
+
+/** Simulated SGP40 state, used by the SensirionI2CSgp40 stub */
+struct host_sgp40_t
+{
+	bool present;
+	uint16_t sraw;
+	uint32_t measurements;
+	uint32_t heater_off;
+	uint16_t last_rh;
+	uint16_t last_t;
+	/** Measurement time in us, the driver blocks for it */
+	uint32_t measure_us;
+	/** Optional source of the SRAW values, e.g. a recorded trace */
+	uint16_t (*source)(void);
+};
+extern host_sgp40_t host_sgp40;
+
+/** Simulated SCD30 state, used by the SCD30 stub */
+struct host_scd30_t
+{
+	bool present;
+	/** Measurement interval in s */
+	uint16_t interval;
+	/** Start of the measurement cycle, set by beginMeasuring() */
+	uint64_t cycle_start_us;
+	/** Clock error of the sensor in ppm, positive = sensor clock slow */
+	int32_t clock_ppm;
+	/** Measurements read */
+	uint32_t reads;
+	/** Index of the last measurement read */
+	int64_t last_read_index;
+	/** Completion time of the last measurement read */
+	uint64_t last_read_done_us;
+	/** Writes to the non volatile settings, interval and start commands */
+	uint32_t nv_writes;
+	uint32_t begin_calls;
+	float co2;
+	float temperature;
+	float humidity;
+};
+extern host_scd30_t host_scd30;
+
+/** Reset clock, flash, uplinks, timers, bus and sensor models */
+void host_reset(void);
+
+/**
+ * @brief Attach the modules of the air quality node to the bus,
+ *        RAK1906 on 0x76, RAK12047 on 0x59 and RAK12037 on 0x61
+ *
+ * @return host_bme680* model of the RAK1906
+ */
+host_bme680 *host_default_node(void);
+
+// Defined in the sketch, only needed by the tests that link it
+void setup(void);
+void loop(void);
+
+/**
+ * @brief Run loop() of the sketch until the simulated time is reached
+ *        or no timer is armed anymore
+ *
+ * @param end_us simulated time in us
+ */
+inline void host_run_until(uint64_t end_us)
+{
+	while (host_now_us() < end_us)
+	{
+		uint32_t wakeups = host_timer_wakeups;
+		loop();
+		if (host_timer_wakeups == wakeups)
+		{
+			// Nothing scheduled, the MCU would sleep forever
+			break;
+		}
+	}
+}
+
+#endif // HOST_SIM_H
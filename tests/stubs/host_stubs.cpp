@@ -0,0 +1,624 @@
+/**
+ * @file host_stubs.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host implementation of the Arduino, RUI3 and Wire stubs
+ *        The clock only advances with delay(), simulated bus and
+ *        UART time and sleep.all(), so the tests are deterministic.
+ *        noInterrupts()/interrupts() lock a global mutex, tests that
+ *        run AT commands from a second thread get the same exclusion
+ *        as the interrupt lock gives on the MCU.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "host_sim.h"
+#include <atomic>
+#include <mutex>
+
+HardwareSerial Serial;
+TwoWire Wire;
+RakApi api;
+
+static std::atomic<uint64_t> host_time(0);
+uint64_t host_awake_us = 0;
+uint64_t host_delay_us = 0;
+
+std::string host_serial_out;
+bool host_serial_echo = false;
+uint32_t host_serial_byte_us = 0;
+static std::mutex host_serial_lock;
+
+uint8_t host_flash[HOST_FLASH_SIZE];
+uint32_t host_flash_writes = 0;
+
+std::vector<host_uplink_t> host_uplinks;
+bool host_send_result = true;
+bool host_joined = true;
+uint8_t host_dr = 3;
+int32_t host_band = RAK_REGION_EU868;
+float host_battery = 3.9f;
+
+void (*host_timer_handler[5])(void *);
+bool host_timer_armed[5];
+uint64_t host_timer_due_us[5];
+uint32_t host_timer_wakeups = 0;
+
+std::vector<host_at_cmd_t> host_at_cmds;
+
+static host_i2c_device *host_i2c_devices[128];
+uint32_t host_i2c_transactions = 0;
+uint32_t host_i2c_transaction_us = 0;
+uint32_t host_bus_violations = 0;
+static thread_local bool host_foreign_thread = false;
+
+host_sgp40_t host_sgp40;
+host_scd30_t host_scd30;
+
+/** Interrupt lock, recursive like nested noInterrupts() calls */
+static std::recursive_mutex host_irq_lock;
+
+uint64_t host_now_us(void)
+{
+	return host_time.load();
+}
+
+void host_advance_us(uint64_t us)
+{
+	host_time += us;
+	if (!host_foreign_thread)
+	{
+		host_awake_us += us;
+	}
+}
+
+void host_set_time_us(uint64_t us)
+{
+	host_time = us;
+}
+
+unsigned long millis(void)
+{
+	return (unsigned long)(uint32_t)(host_time.load() / 1000);
+}
+
+unsigned long micros(void)
+{
+	return (unsigned long)(uint32_t)host_time.load();
+}
+
+void delay(unsigned long ms)
+{
+	host_advance_us((uint64_t)ms * 1000);
+	host_delay_us += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	host_advance_us(us);
+	host_delay_us += us;
+}
+
+void digitalWrite(int, int) {}
+int digitalRead(int) { return 0; }
+void pinMode(int, int) {}
+
+void noInterrupts(void)
+{
+	host_irq_lock.lock();
+}
+
+void interrupts(void)
+{
+	host_irq_lock.unlock();
+}
+
+size_t host_serial_write(const char *data, size_t len)
+{
+	{
+		std::lock_guard<std::mutex> guard(host_serial_lock);
+		host_serial_out.append(data, len);
+		if (host_serial_echo)
+		{
+			fwrite(data, 1, len, stdout);
+		}
+	}
+	// Blocking UART, the caller waits until the bytes are out
+	host_advance_us((uint64_t)len * host_serial_byte_us);
+	return len;
+}
+
+void host_flash_erase(void)
+{
+	memset(host_flash, 0xFF, sizeof(host_flash));
+}
+
+bool host_flash_get(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+	if (offset + len > HOST_FLASH_SIZE)
+	{
+		return false;
+	}
+	memcpy(buf, &host_flash[offset], len);
+	return true;
+}
+
+bool host_flash_set(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+	if (offset + len > HOST_FLASH_SIZE)
+	{
+		return false;
+	}
+	memcpy(&host_flash[offset], buf, len);
+	host_flash_writes++;
+	return true;
+}
+
+bool host_timer_create(RAK_TIMER_ID id, RAK_TIMER_HANDLER handler)
+{
+	host_timer_handler[id] = handler;
+	host_timer_armed[id] = false;
+	return true;
+}
+
+bool host_timer_start(RAK_TIMER_ID id, uint32_t ms)
+{
+	host_timer_armed[id] = true;
+	host_timer_due_us[id] = host_now_us() + (uint64_t)ms * 1000;
+	return true;
+}
+
+bool host_timer_stop(RAK_TIMER_ID id)
+{
+	host_timer_armed[id] = false;
+	return true;
+}
+
+bool host_sleep_until_timer(void)
+{
+	int next = -1;
+	for (int idx = 0; idx < 5; idx++)
+	{
+		if (host_timer_armed[idx] && ((next < 0) || (host_timer_due_us[idx] < host_timer_due_us[next])))
+		{
+			next = idx;
+		}
+	}
+	if (next < 0)
+	{
+		return false;
+	}
+	if (host_timer_due_us[next] > host_now_us())
+	{
+		host_time = host_timer_due_us[next];
+	}
+	host_timer_armed[next] = false;
+	host_timer_wakeups++;
+	if (host_timer_handler[next] != NULL)
+	{
+		host_timer_handler[next](NULL);
+	}
+	return true;
+}
+
+bool host_sleep_all(void)
+{
+	return host_sleep_until_timer();
+}
+
+float host_bat_get(void)
+{
+	return host_battery;
+}
+
+bool host_at_add(const char *cmd, int (*handler)(SERIAL_PORT, char *, stParam *))
+{
+	host_at_cmd_t entry;
+	entry.name = cmd;
+	entry.handler = handler;
+	host_at_cmds.push_back(entry);
+	return true;
+}
+
+int host_at(const char *command)
+{
+	std::string line(command);
+	if (line.compare(0, 4, "ATC+") == 0)
+	{
+		line = line.substr(4);
+	}
+	std::string name = line;
+	std::string args;
+	size_t split = line.find_first_of("=?");
+	if (split != std::string::npos)
+	{
+		name = line.substr(0, split);
+		args = (line[split] == '?') ? "?" : line.substr(split + 1);
+	}
+	for (size_t idx = 0; idx < host_at_cmds.size(); idx++)
+	{
+		if (host_at_cmds[idx].name != name)
+		{
+			continue;
+		}
+		static char arg_buffer[128];
+		static char cmd_buffer[32];
+		strncpy(arg_buffer, args.c_str(), sizeof(arg_buffer) - 1);
+		snprintf(cmd_buffer, sizeof(cmd_buffer), "ATC+%s", name.c_str());
+		stParam param;
+		param.argc = 0;
+		if (arg_buffer[0] != 0)
+		{
+			char *token = strtok(arg_buffer, ":");
+			while ((token != NULL) && (param.argc < 16))
+			{
+				param.argv[param.argc++] = token;
+				token = strtok(NULL, ":");
+			}
+		}
+		return host_at_cmds[idx].handler(0, cmd_buffer, &param);
+	}
+	return -1;
+}
+
+bool host_lorawan_send(uint8_t size, uint8_t *data, uint8_t fport)
+{
+	if (!host_send_result)
+	{
+		return false;
+	}
+	host_uplink_t uplink;
+	uplink.fport = fport;
+	uplink.data.assign(data, data + size);
+	uplink.time_us = host_now_us();
+	host_uplinks.push_back(uplink);
+	return true;
+}
+
+bool host_njs_get(void)
+{
+	return host_joined;
+}
+
+uint8_t host_dr_get(void)
+{
+	return host_dr;
+}
+
+int32_t host_band_get(void)
+{
+	return host_band;
+}
+
+void host_mark_foreign_thread(void)
+{
+	host_foreign_thread = true;
+}
+
+void host_i2c_attach(uint8_t address, host_i2c_device *device)
+{
+	host_i2c_devices[address & 0x7F] = device;
+}
+
+void host_i2c_detach_all(void)
+{
+	memset(host_i2c_devices, 0, sizeof(host_i2c_devices));
+}
+
+/** Count a bus transaction and its time */
+static void host_i2c_transaction(void)
+{
+	if (host_foreign_thread)
+	{
+		host_bus_violations++;
+	}
+	host_i2c_transactions++;
+	host_advance_us(host_i2c_transaction_us);
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+	_address = address;
+	_tx_len = 0;
+}
+
+size_t TwoWire::write(uint8_t data)
+{
+	if (_tx_len >= HOST_WIRE_BUFFER)
+	{
+		return 0;
+	}
+	_tx[_tx_len++] = data;
+	return 1;
+}
+
+size_t TwoWire::write(const uint8_t *data, size_t len)
+{
+	size_t written = 0;
+	while ((written < len) && (write(data[written]) == 1))
+	{
+		written++;
+	}
+	return written;
+}
+
+uint8_t TwoWire::endTransmission(bool)
+{
+	host_i2c_transaction();
+	host_i2c_device *device = host_i2c_devices[_address & 0x7F];
+	if (device == NULL)
+	{
+		return 2; // NACK on the address
+	}
+	return device->write(_tx, _tx_len) ? 0 : 3;
+}
+
+uint8_t TwoWire::request(uint8_t address, size_t len, bool)
+{
+	host_i2c_transaction();
+	_rx_len = 0;
+	_rx_pos = 0;
+	host_i2c_device *device = host_i2c_devices[address & 0x7F];
+	if ((device == NULL) || (len > HOST_WIRE_BUFFER))
+	{
+		return 0;
+	}
+	_rx_len = device->read(_rx, len);
+	return (uint8_t)_rx_len;
+}
+
+int TwoWire::available(void)
+{
+	return (int)(_rx_len - _rx_pos);
+}
+
+int TwoWire::read(void)
+{
+	if (_rx_pos >= _rx_len)
+	{
+		return -1;
+	}
+	return _rx[_rx_pos++];
+}
+
+bool host_register_device::write(const uint8_t *data, size_t len)
+{
+	if (len == 0)
+	{
+		return true;
+	}
+	pointer = data[0];
+	if (pair_writes)
+	{
+		for (size_t idx = 0; idx + 1 < len; idx += 2)
+		{
+			regs[data[idx]] = data[idx + 1];
+			written(data[idx]);
+		}
+		return true;
+	}
+	for (size_t idx = 1; idx < len; idx++)
+	{
+		regs[pointer] = data[idx];
+		written(pointer);
+		pointer++;
+	}
+	return true;
+}
+
+size_t host_register_device::read(uint8_t *data, size_t len)
+{
+	for (size_t idx = 0; idx < len; idx++)
+	{
+		reading(pointer);
+		data[idx] = regs[pointer++];
+	}
+	return len;
+}
+
+uint8_t host_sensirion_device::crc8(const uint8_t *data, size_t len)
+{
+	uint8_t crc = 0xFF;
+	for (size_t idx = 0; idx < len; idx++)
+	{
+		crc ^= data[idx];
+		for (uint8_t bit = 0; bit < 8; bit++)
+		{
+			crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x31) : (uint8_t)(crc << 1);
+		}
+	}
+	return crc;
+}
+
+bool host_sensirion_device::write(const uint8_t *data, size_t len)
+{
+	if (len < 2)
+	{
+		return len == 0;
+	}
+	command = (uint16_t)((data[0] << 8) | data[1]);
+	response.clear();
+	return execute(command, &data[2], len - 2);
+}
+
+size_t host_sensirion_device::read(uint8_t *data, size_t len)
+{
+	size_t used = 0;
+	for (size_t word = 0; (word < response.size()) && (used + 3 <= len); word++)
+	{
+		data[used] = (uint8_t)(response[word] >> 8);
+		data[used + 1] = (uint8_t)response[word];
+		data[used + 2] = crc8(&data[used], 2);
+		used += 3;
+	}
+	// Reads past the response return 0xFF like a released bus
+	memset(&data[used], 0xFF, len - used);
+	return len;
+}
+
+/** BME680 registers used by the model */
+#define BME_STATUS 0x1D
+#define BME_CTRL_GAS_0 0x70
+#define BME_CTRL_GAS_1 0x71
+#define BME_CTRL_HUM 0x72
+#define BME_CTRL_MEAS 0x74
+#define BME_GAS_WAIT_0 0x64
+
+host_bme680::host_bme680(uint16_t t1)
+	: adc_temp(488936), adc_pres(350064), adc_hum(21140), adc_gas(600), gas_range(4),
+	  conversions(0), gas_conversions(0), conversion_end_us(0), extra_us(0), calib_reads(0)
+{
+	pair_writes = true;
+	regs[0xD0] = 0x61;
+	// Coefficients, layout as in the datasheet, 22 degC, 45 %RH, 1000 hPa with the default ADC values
+	const int16_t t2 = 26366;
+	const uint16_t p1 = 36477;
+	const int16_t p2 = -10685, p4 = 6937, p5 = -91, p8 = -1893, p9 = -3034;
+	const uint16_t h1 = 766, h2 = 1006;
+	uint8_t *arr1 = &regs[0x89];
+	arr1[1] = (uint8_t)t2;
+	arr1[2] = (uint8_t)(t2 >> 8);
+	arr1[3] = 3; // T3
+	arr1[5] = (uint8_t)p1;
+	arr1[6] = (uint8_t)(p1 >> 8);
+	arr1[7] = (uint8_t)p2;
+	arr1[8] = (uint8_t)(p2 >> 8);
+	arr1[9] = 88; // P3
+	arr1[11] = (uint8_t)p4;
+	arr1[12] = (uint8_t)(p4 >> 8);
+	arr1[13] = (uint8_t)p5;
+	arr1[14] = (uint8_t)(p5 >> 8);
+	arr1[15] = 30; // P7
+	arr1[16] = 30; // P6
+	arr1[19] = (uint8_t)p8;
+	arr1[20] = (uint8_t)(p8 >> 8);
+	arr1[21] = (uint8_t)p9;
+	arr1[22] = (uint8_t)(p9 >> 8);
+	arr1[23] = 30; // P10
+	uint8_t *arr2 = &regs[0xE1];
+	arr2[0] = (uint8_t)(h2 >> 4);
+	arr2[1] = (uint8_t)(((h2 & 0x0F) << 4) | (h1 & 0x0F));
+	arr2[2] = (uint8_t)(h1 >> 4);
+	arr2[3] = 0;			  // H3
+	arr2[4] = 45;			  // H4
+	arr2[5] = 20;			  // H5
+	arr2[6] = 120;			  // H6
+	arr2[7] = (uint8_t)(-100); // H7
+	arr2[8] = (uint8_t)t1;
+	arr2[9] = (uint8_t)(t1 >> 8);
+	arr2[10] = 0x1C; // GH2
+	arr2[11] = 0xE6;
+	arr2[12] = (uint8_t)(-20); // GH1
+	arr2[13] = 18;			   // GH3
+	regs[0x00] = 0x30;		   // res_heat_val
+	regs[0x02] = 0x10;		   // res_heat_range
+	regs[0x04] = 0x00;		   // range_sw_err
+}
+
+uint64_t host_bme680::conversion_time_us(void) const
+{
+	static const uint8_t cycles[8] = {0, 1, 2, 4, 8, 16, 16, 16};
+	uint64_t meas_cycles = cycles[(regs[BME_CTRL_MEAS] >> 5) & 0x07] + cycles[(regs[BME_CTRL_MEAS] >> 2) & 0x07] + cycles[regs[BME_CTRL_HUM] & 0x07];
+	// Datasheet: 1.963 ms per conversion cycle, 4 x 0.477 ms TPH switching, 5 x 0.477 ms gas measurement, 0.5 ms wake up
+	uint64_t duration = meas_cycles * 1963 + 477 * 4 + 477 * 5 + 500;
+	if ((regs[BME_CTRL_GAS_1] & 0x10) != 0)
+	{
+		static const uint8_t factor[4] = {1, 4, 16, 64};
+		uint8_t wait = regs[BME_GAS_WAIT_0];
+		duration += (uint64_t)(wait & 0x3F) * factor[wait >> 6] * 1000;
+	}
+	return duration + extra_us;
+}
+
+void host_bme680::written(uint8_t reg)
+{
+	if ((reg == BME_CTRL_MEAS) && ((regs[BME_CTRL_MEAS] & 0x03) == 0x01))
+	{
+		conversions++;
+		if (((regs[BME_CTRL_GAS_1] & 0x10) != 0) && ((regs[BME_CTRL_GAS_0] & 0x08) == 0))
+		{
+			gas_conversions++;
+		}
+		conversion_end_us = host_now_us() + conversion_time_us();
+		regs[BME_STATUS] = 0x20; // measuring
+	}
+}
+
+void host_bme680::reading(uint8_t reg)
+{
+	if (((reg >= 0x89) && (reg <= 0xA1)) || ((reg >= 0xE1) && (reg <= 0xF0)))
+	{
+		calib_reads++;
+	}
+	if ((reg != BME_STATUS) || ((regs[BME_STATUS] & 0x20) == 0) || (host_now_us() < conversion_end_us))
+	{
+		return;
+	}
+	// Conversion finished, fill the data registers and go back to sleep
+	bool run_gas = (regs[BME_CTRL_GAS_1] & 0x10) != 0;
+	bool heater = run_gas && ((regs[BME_CTRL_GAS_0] & 0x08) == 0);
+	regs[BME_STATUS] = 0x80; // new data
+	regs[0x1F] = (uint8_t)(adc_pres >> 12);
+	regs[0x20] = (uint8_t)(adc_pres >> 4);
+	regs[0x21] = (uint8_t)(adc_pres << 4);
+	regs[0x22] = (uint8_t)(adc_temp >> 12);
+	regs[0x23] = (uint8_t)(adc_temp >> 4);
+	regs[0x24] = (uint8_t)(adc_temp << 4);
+	regs[0x25] = (uint8_t)(adc_hum >> 8);
+	regs[0x26] = (uint8_t)adc_hum;
+	regs[0x2A] = (uint8_t)(adc_gas >> 2);
+	regs[0x2B] = (uint8_t)(((adc_gas & 0x03) << 6) | (run_gas ? 0x20 : 0) | (heater ? 0x10 : 0) | (gas_range & 0x0F));
+	regs[BME_CTRL_MEAS] &= 0xFC;
+}
+
+void host_reset(void)
+{
+	host_time = 0;
+	host_awake_us = 0;
+	host_delay_us = 0;
+	host_serial_out.clear();
+	host_serial_byte_us = 0;
+	host_flash_erase();
+	host_flash_writes = 0;
+	host_uplinks.clear();
+	host_send_result = true;
+	host_joined = true;
+	host_dr = 3;
+	host_band = RAK_REGION_EU868;
+	host_battery = 3.9f;
+	memset(host_timer_armed, 0, sizeof(host_timer_armed));
+	host_timer_wakeups = 0;
+	host_at_cmds.clear();
+	host_i2c_detach_all();
+	host_i2c_transactions = 0;
+	host_i2c_transaction_us = 0;
+	host_bus_violations = 0;
+	memset(&host_sgp40, 0, sizeof(host_sgp40));
+	host_sgp40.sraw = 30000;
+	host_sgp40.measure_us = 30000;
+	memset(&host_scd30, 0, sizeof(host_scd30));
+	host_scd30.co2 = 600.0f;
+	host_scd30.temperature = 23.0f;
+	host_scd30.humidity = 40.0f;
+}
+
+host_bme680 *host_default_node(void)
+{
+	static host_bme680 bme680;
+	static host_sensirion_id sgp40(0x3682, 3);
+	static host_sensirion_id scd30(0xD100, 1);
+	bme680 = host_bme680();
+	host_i2c_attach(0x76, &bme680);
+	host_i2c_attach(0x59, &sgp40);
+	host_i2c_attach(0x61, &scd30);
+	host_sgp40.present = true;
+	host_scd30.present = true;
+	return &bme680;
+}
+
+/** Start from an erased flash like a new device */
+static struct host_init
+{
+	host_init() { host_reset(); }
+} host_init_instance;
@@ -0,0 +1 @@
+// Host stub, the RUI3 timer driver is not used on the host
@@ -0,0 +1,297 @@
+/**
+ * @file voc_burst.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the VOC burst mode
+ *        Boots the node in burst mode with an erased VOC state and
+ *        checks that the index is valid after the warm-up time, not
+ *        after a number of readings. Runs the node with a 15 minute
+ *        send interval in continuous mode after ATC+VOCMODE=0, then
+ *        in burst mode after ATC+VOCMODE=1.
+ *        Checks that the algorithm is set up for the average time
+ *        between the readings, that the learned time follows the
+ *        real time in both modes, that the state is saved every
+ *        6 hours of real time and that the index stays valid over
+ *        the mode switch. Reports the wake ups and SGP40 readings
+ *        per hour of both modes. A step of the SRAW baseline is
+ *        learned in burst mode and, in a child process, in
+ *        continuous mode. With the average time between the readings
+ *        as sampling interval both learn the same part of the step
+ *        per hour. With a long acquisition lead time
+ *        checks that the burst and the SCD30 poll are finished when
+ *        the acquisition starts.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o voc_burst \
+ *            tests/voc_burst.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./voc_burst
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include <VOCGasIndexAlgorithm.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern VOCGasIndexAlgorithm voc_algorithm;
+extern uint32_t voc_learned_time;
+
+/** Send interval in s */
+#define TEST_SENDINT 900
+/** Acquisition lead time in ms, much longer than VOC_BURST_LEAD and SCD30_POLL_LEAD */
+#define TEST_ACQ_LEAD 20000
+/** Uplinks checked with the long lead time */
+#define TEST_LEAD_UPLINKS 8
+
+/** Longest wait for the first valid VOC index after a cold boot in minutes */
+#define TEST_COLD_MAX_MINUTES 300
+
+/** SRAW baseline step and the hours it is learned */
+#define TEST_STEP 1000
+#define TEST_STEP_HOURS 6
+
+/** Hours in each mode */
+#define TEST_CONTINUOUS_HOURS 12
+#define TEST_BURST_HOURS 18
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Result of one mode */
+struct mode_result_t
+{
+	float interval;
+	uint32_t learned;
+	uint32_t checkpoints;
+	uint32_t invalid_minutes;
+	double wakeups_hour;
+	double voc_wakeups_hour;
+	double readings_hour;
+};
+
+/**
+ * @brief Run the node for some hours and count the state checkpoints
+ *
+ * @param hours run time
+ * @return mode_result_t
+ */
+static mode_result_t run_hours(int hours)
+{
+	mode_result_t result;
+	memset(&result, 0, sizeof(result));
+	uint32_t learned_start = voc_learned_time;
+	uint32_t wakeups = host_timer_wakeups;
+	uint32_t voc_wakeups = g_voc_wakeups;
+	uint32_t readings = host_sgp40.measurements;
+	uint8_t state[16];
+	memcpy(state, &host_flash[VOC_STATE_OFFSET], sizeof(state));
+	uint64_t start = host_now_us();
+	for (int minute = 0; minute < hours * 60; minute++)
+	{
+		host_run_until(start + (minute + 1) * 60000000ULL);
+		if (memcmp(state, &host_flash[VOC_STATE_OFFSET], sizeof(state)) != 0)
+		{
+			memcpy(state, &host_flash[VOC_STATE_OFFSET], sizeof(state));
+			result.checkpoints++;
+		}
+		if (!snapshot_get()->voc_valid)
+		{
+			result.invalid_minutes++;
+		}
+	}
+	voc_algorithm.get_sampling_interval(result.interval);
+	result.learned = voc_learned_time - learned_start;
+	result.wakeups_hour = (double)(host_timer_wakeups - wakeups) / hours;
+	result.voc_wakeups_hour = (double)(g_voc_wakeups - voc_wakeups) / hours;
+	result.readings_hour = (double)(host_sgp40.measurements - readings) / hours;
+	return result;
+}
+
+static void print_result(const char *name, const mode_result_t &result, int hours)
+{
+	printf("  %-11s interval %5.0f s, learned %5.1f h in %2d h, %lu checkpoints, %6.1f wakeups/h (VOC %6.1f), %6.1f readings/h\n",
+		   name, result.interval, result.learned / 3600.0, hours, (unsigned long)result.checkpoints, result.wakeups_hour,
+		   result.voc_wakeups_hour, result.readings_hour);
+}
+
+/**
+ * @brief Check that the VOC burst and the SCD30 poll are done before
+ *        the acquisition of each uplink starts
+ *
+ * @return uint32_t number of acquisitions that started too early
+ */
+static uint32_t test_lead(void)
+{
+	uint32_t early = 0;
+	uint32_t nv_writes = host_scd30.nv_writes;
+	// Let the next uplink schedule the jobs with the new lead
+	size_t uplinks = host_uplinks.size();
+	while (host_uplinks.size() == uplinks)
+	{
+		host_run_until(host_now_us() + 1000000ULL);
+	}
+	for (uint8_t idx = 0; idx < TEST_LEAD_UPLINKS; idx++)
+	{
+		uint32_t readings = host_sgp40.measurements;
+		uint32_t co2_reads = host_scd30.reads;
+		uint64_t tx_slot = host_uplinks.back().time_us + TEST_SENDINT * 1000000ULL;
+		uint64_t acquisition = tx_slot - uplink_stats.lead * 1000ULL;
+		host_run_until(acquisition - 10000);
+		// The SCD30 cycle is realigned to the earlier poll, its first measurement is after the next poll
+		if ((host_sgp40.measurements - readings != VOC_BURST_SAMPLES) || ((idx != 0) && (host_scd30.reads == co2_reads)))
+		{
+			early++;
+		}
+		uplinks = host_uplinks.size();
+		while (host_uplinks.size() == uplinks)
+		{
+			host_run_until(host_now_us() + 1000000ULL);
+		}
+	}
+	printf("  lead %d ms: %lu of %d acquisitions before the end of the VOC burst or the SCD30 poll, %lu SCD30 realignments\n",
+		   TEST_ACQ_LEAD, (unsigned long)early, TEST_LEAD_UPLINKS, (unsigned long)(host_scd30.nv_writes - nv_writes));
+	check(host_scd30.nv_writes - nv_writes <= 1, "SCD30 cycle realigned more than once for the new lead");
+	return early;
+}
+
+/**
+ * @brief Boot in burst mode without a stored VOC state
+ *
+ * @return uint32_t minutes until the VOC index is valid, 0 if it was not valid within TEST_COLD_MAX_MINUTES
+ */
+static uint32_t test_cold_boot(void)
+{
+	g_lorawan_settings.send_repeat_time = TEST_SENDINT * 1000;
+	save_at_setting(SEND_INT_OFFSET);
+	g_voc_mode = VOC_MODE_BURST;
+	save_at_setting(VOC_MODE_OFFSET);
+	host_default_node();
+	setup();
+	uint32_t valid_minute = 0;
+	uint64_t start = host_now_us();
+	for (uint32_t minute = 1; (minute <= TEST_COLD_MAX_MINUTES) && (valid_minute == 0); minute++)
+	{
+		host_run_until(start + minute * 60000000ULL);
+		if (snapshot_get()->voc_valid)
+		{
+			valid_minute = minute;
+		}
+	}
+	printf("Cold boot in burst mode, send interval %d s: VOC index valid after %lu minutes, %lu readings\n", TEST_SENDINT,
+		   (unsigned long)valid_minute, (unsigned long)host_sgp40.measurements);
+	return valid_minute;
+}
+
+/**
+ * @brief Step the SRAW baseline and let the algorithm learn it in the current mode
+ *
+ * @return float part of the step learned after TEST_STEP_HOURS
+ */
+static float learn_step(void)
+{
+	float start_mean;
+	float std;
+	voc_algorithm.get_states(start_mean, std);
+	uint16_t target = host_sgp40.sraw + TEST_STEP;
+	host_sgp40.sraw = target;
+	host_run_until(host_now_us() + TEST_STEP_HOURS * 3600000000ULL);
+	float mean;
+	voc_algorithm.get_states(mean, std);
+	return (mean - start_mean) / (target - start_mean);
+}
+
+/**
+ * @brief Learn a step of the SRAW baseline in burst mode and, in a
+ *        child process with the same state, in continuous mode
+ *
+ * @param burst part of the step learned in burst mode
+ * @param continuous part of the step learned in continuous mode
+ */
+static void test_step(float &burst, float &continuous)
+{
+	int fds[2];
+	continuous = -1.0f;
+	if (pipe(fds) != 0)
+	{
+		check(false, "pipe failed");
+		return;
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		host_at("ATC+VOCMODE=0");
+		float learned = learn_step();
+		_exit(write(fds[1], &learned, sizeof(learned)) == sizeof(learned) ? 0 : 1);
+	}
+	close(fds[1]);
+	burst = learn_step();
+	bool received = read(fds[0], &continuous, sizeof(continuous)) == sizeof(continuous);
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	check(received && WIFEXITED(status) && (WEXITSTATUS(status) == 0), "child run failed");
+}
+
+int main(void)
+{
+	uint32_t valid_minute = test_cold_boot();
+	// Warm-up time of the continuous mode, the index is valid in the second burst
+	check((valid_minute != 0) && (valid_minute * 60 <= VOC_WARMUP_TIME + TEST_SENDINT + 60), "VOC index not valid after the warm-up time");
+	check(valid_minute * 60 > VOC_WARMUP_TIME / 2, "VOC index valid before the warm-up");
+
+	check(host_at("ATC+VOCMODE=0") == AT_OK, "VOCMODE failed");
+	check(host_at("ATC+SENDINT=900") == AT_OK, "SENDINT failed");
+	mode_result_t continuous = run_hours(TEST_CONTINUOUS_HOURS);
+
+	check(host_at("ATC+VOCMODE=1") == AT_OK, "VOCMODE failed");
+	mode_result_t burst = run_hours(TEST_BURST_HOURS);
+
+	printf("VOC sampling modes, send interval %d s\n", TEST_SENDINT);
+	print_result("continuous", continuous, TEST_CONTINUOUS_HOURS);
+	print_result("burst", burst, TEST_BURST_HOURS);
+
+	check(continuous.interval == 10.0f, "continuous mode interval is not 10 s");
+	check(burst.interval == (float)(TEST_SENDINT / VOC_BURST_SAMPLES), "burst mode interval is not the send interval / burst samples");
+	// Learned time follows the real time, one burst or reading of tolerance
+	check(abs((int)continuous.learned - TEST_CONTINUOUS_HOURS * 3600) <= 20, "learned time does not follow the real time in continuous mode");
+	check(abs((int)burst.learned - TEST_BURST_HOURS * 3600) <= TEST_SENDINT, "learned time does not follow the real time in burst mode");
+	// The checkpoint at the end of a phase can fall into the next one
+	check((continuous.checkpoints + 1 >= TEST_CONTINUOUS_HOURS / 6) && (continuous.checkpoints <= TEST_CONTINUOUS_HOURS / 6),
+		  "continuous mode checkpoints are not every 6 h");
+	check((burst.checkpoints + 1 >= TEST_BURST_HOURS / 6) && (burst.checkpoints <= TEST_BURST_HOURS / 6),
+		  "burst mode checkpoints are not every 6 h");
+	check(burst.invalid_minutes == 0, "VOC index invalid after the mode switch");
+	check(burst.readings_hour <= VOC_BURST_SAMPLES * 3600.0 / TEST_SENDINT + 1, "more readings than the bursts need");
+
+	float burst_step;
+	float continuous_step;
+	test_step(burst_step, continuous_step);
+	// The 10 s between the readings of a burst as sampling interval learn 240 s instead of 3600 s per hour
+	float cadence_step = 1.0f - powf(1.0f - continuous_step, (float)(VOC_BURST_SAMPLES * 3600 / TEST_SENDINT * 10) / 3600.0f);
+	printf("  SRAW step of %d learned in %d h: continuous %.3f, burst %.3f (%.3f with the 10 s of the readings in a burst)\n",
+		   TEST_STEP, TEST_STEP_HOURS, continuous_step, burst_step, cadence_step);
+	check(fabsf(burst_step - continuous_step) <= 0.1f * continuous_step, "burst mode does not learn at the rate of the continuous mode");
+
+	char command[32];
+	snprintf(command, sizeof(command), "ATC+TXLEAD=%d", TEST_ACQ_LEAD);
+	check(host_at(command) == AT_OK, "TXLEAD failed");
+	check(test_lead() == 0, "acquisition started before the VOC burst or the SCD30 poll was finished");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,260 @@
+/**
+ * @file voc_state_replay.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host replay test of the stored VOC algorithm state
+ *        Feeds the same SRAW trace (drifting baseline, noise and
+ *        VOC events, 10 s steps) to the node three times:
+ *        - reference run without reboot
+ *        - warm reboot after TEST_REBOOT_HOUR, state from flash
+ *        - cold reboot after TEST_REBOOT_HOUR, erased flash
+ *        Each run is a child process, so a reboot starts with the
+ *        initial values of all globals like the MCU does. Reports
+ *        the time until the VOC index is valid again and the index
+ *        error against the reference run.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o voc_state_replay \
+ *            tests/voc_state_replay.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./voc_state_replay
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+#include <unistd.h>
+#include <sys/wait.h>
+
+/** Length of the trace */
+#define TEST_HOURS 14
+/** Reboot time, after the first checkpoint of the state */
+#define TEST_REBOOT_HOUR 7
+/** Time steps of the trace in s */
+#define TRACE_STEP 10
+/** Trace samples */
+#define TRACE_SAMPLES (TEST_HOURS * 3600 / TRACE_STEP + 1)
+/** VOC index is recorded every minute */
+#define RECORDS (TEST_HOURS * 60)
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/** Recorded SRAW trace */
+static uint16_t trace[TRACE_SAMPLES];
+
+/** VOC index of one minute, -1 if not valid */
+struct run_result_t
+{
+	int32_t index[RECORDS];
+	uint8_t flash[HOST_FLASH_SIZE];
+};
+
+/**
+ * @brief Synthetic SRAW trace
+ *        Baseline 30000 with a slow drift, noise and a VOC event
+ *        (lower SRAW) every 100 minutes
+ */
+static void make_trace(void)
+{
+	uint32_t seed = 12345;
+	for (int idx = 0; idx < TRACE_SAMPLES; idx++)
+	{
+		double t = idx * TRACE_STEP;
+		double sraw = 30000.0 + 600.0 * sin(2.0 * M_PI * t / (24.0 * 3600.0));
+		double event_age = fmod(t, 6000.0) - 3000.0;
+		if (event_age >= 0)
+		{
+			sraw -= 1500.0 * exp(-event_age / 600.0);
+		}
+		seed = seed * 1103515245 + 12345;
+		sraw += (double)((seed >> 16) % 61) - 30.0;
+		trace[idx] = (uint16_t)sraw;
+	}
+}
+
+/**
+ * @brief SRAW source of the simulated SGP40, replays the trace by the simulated time
+ */
+static uint16_t trace_source(void)
+{
+	uint64_t idx = host_now_us() / (TRACE_STEP * 1000000ULL);
+	return trace[idx < TRACE_SAMPLES ? idx : TRACE_SAMPLES - 1];
+}
+
+/**
+ * @brief Boot the node and record the VOC index every minute
+ *
+ * @param result index records and flash at the end
+ * @param start_minute boot time
+ * @param end_minute end of the run
+ */
+static void run_node(run_result_t &result, int start_minute, int end_minute)
+{
+	host_set_time_us(start_minute * 60000000ULL);
+	host_default_node();
+	host_sgp40.source = trace_source;
+	setup();
+	for (int minute = start_minute; minute < end_minute; minute++)
+	{
+		host_run_until((minute + 1) * 60000000ULL);
+		const sensor_snapshot_t *values = snapshot_get();
+		result.index[minute] = values->voc_valid ? values->voc_index : -1;
+	}
+	memcpy(result.flash, host_flash, HOST_FLASH_SIZE);
+}
+
+/**
+ * @brief Run the node in a child process, the globals of the sketch
+ *        start with their initial values like after a reset
+ *
+ * @param result index records of the run, records before start_minute are not changed
+ * @param flash flash content at boot, NULL for an erased flash
+ * @param start_minute boot time
+ * @param end_minute end of the run
+ */
+static void run_child(run_result_t &result, const uint8_t *flash, int start_minute, int end_minute)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+	{
+		check(false, "pipe failed");
+		return;
+	}
+	fflush(stdout);
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		close(fds[0]);
+		if (flash != NULL)
+		{
+			memcpy(host_flash, flash, HOST_FLASH_SIZE);
+		}
+		run_result_t *child_result = new run_result_t(result);
+		run_node(*child_result, start_minute, end_minute);
+		const uint8_t *data = (const uint8_t *)child_result;
+		size_t left = sizeof(run_result_t);
+		while (left > 0)
+		{
+			ssize_t written = write(fds[1], data, left);
+			if (written <= 0)
+			{
+				_exit(1);
+			}
+			data += written;
+			left -= written;
+		}
+		_exit(0);
+	}
+	close(fds[1]);
+	uint8_t *data = (uint8_t *)&result;
+	size_t left = sizeof(run_result_t);
+	while (left > 0)
+	{
+		ssize_t got = read(fds[0], data, left);
+		if (got <= 0)
+		{
+			break;
+		}
+		data += got;
+		left -= got;
+	}
+	close(fds[0]);
+	int status;
+	waitpid(pid, &status, 0);
+	check((left == 0) && WIFEXITED(status) && (WEXITSTATUS(status) == 0), "child run failed");
+}
+
+/**
+ * @brief Compare a run after the reboot with the reference run
+ *
+ * @param name name of the run
+ * @param run records of the run
+ * @param reference records of the reference run
+ * @return int minutes until the index was valid after the reboot
+ */
+static int report(const char *name, const run_result_t &run, const run_result_t &reference)
+{
+	int reboot = TEST_REBOOT_HOUR * 60;
+	int valid_after = -1;
+	int max_error = 0;
+	double sum_error = 0;
+	int compared = 0;
+	for (int minute = reboot; minute < RECORDS; minute++)
+	{
+		if (run.index[minute] < 0)
+		{
+			continue;
+		}
+		if (valid_after < 0)
+		{
+			valid_after = minute - reboot + 1;
+		}
+		if (reference.index[minute] >= 0)
+		{
+			int error = abs(run.index[minute] - reference.index[minute]);
+			max_error = (error > max_error) ? error : max_error;
+			sum_error += error;
+			compared++;
+		}
+	}
+	printf("  %-12s valid %3d min after boot, index error vs. reference: avg %.1f max %d\n", name, valid_after,
+		   compared ? sum_error / compared : 0.0, max_error);
+	return valid_after;
+}
+
+int main(void)
+{
+	make_trace();
+	int reboot = TEST_REBOOT_HOUR * 60;
+
+	static run_result_t reference;
+	run_child(reference, NULL, 0, RECORDS);
+
+	// Same trace with a reboot, the first part is the same as the reference
+	static run_result_t before;
+	run_child(before, NULL, 0, reboot);
+	static run_result_t warm;
+	warm = before;
+	run_child(warm, before.flash, reboot, RECORDS);
+	static run_result_t cold;
+	cold = before;
+	run_child(cold, NULL, reboot, RECORDS);
+
+	int reference_valid = 0;
+	while ((reference_valid < RECORDS) && (reference.index[reference_valid] < 0))
+	{
+		reference_valid++;
+	}
+	printf("VOC state replay, %d h trace, reboot after %d h\n", TEST_HOURS, TEST_REBOOT_HOUR);
+	printf("  %-12s valid %3d min after boot\n", "first boot", reference_valid + 1);
+	int warm_valid = report("warm reboot", warm, reference);
+	int cold_valid = report("cold reboot", cold, reference);
+
+	check(before.flash[VOC_STATE_OFFSET] != 0xFF, "state not saved before the reboot");
+	check((warm_valid > 0) && (warm_valid <= 2), "warm reboot does not report a VOC index within 2 minutes");
+	check(cold_valid > 15, "cold reboot skipped the warm up");
+	// After the warm reboot the index follows the reference, a cold reboot has to learn the baseline again
+	int warm_error = 0;
+	int cold_error = 0;
+	for (int minute = reboot + 20; minute < RECORDS; minute++)
+	{
+		warm_error += abs(warm.index[minute] - reference.index[minute]);
+		cold_error += abs(cold.index[minute] - reference.index[minute]);
+	}
+	check(warm_error < cold_error, "warm reboot index not closer to the reference than a cold reboot");
+
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,188 @@
+/**
+ * @file voc_th_refresh.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Host test of the T/RH refresh for the VOC compensation
+ *        Runs the node on the simulated bus and checks that the
+ *        T/RH conversions for the SGP40 compensation do not block
+ *        (no delay() after setup()), that the SGP40 gets the
+ *        compensation values and that a payload measurement
+ *        requested during a T/RH conversion is started after it.
+ *        A T/RH conversion that is not finished at its expected end
+ *        stays running until it is collected or given up.
+ *
+ *        Build and run on the host:
+ *          g++ -std=gnu++11 -O2 -D_VARIANT_RAK3172_ -Itests/stubs -I. -o voc_th_refresh \
+ *            tests/voc_th_refresh.cpp tests/stubs/host_stubs.cpp *.cpp \
+ *            -x c++ RUI3-Sensor-Node-Air-Quality.ino -lpthread
+ *          ./voc_th_refresh
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include "main.h"
+#include "host_sim.h"
+
+/** Simulated run time */
+#define TEST_HOURS 2
+
+/** Number of test failures */
+static int failures = 0;
+
+static void check(bool condition, const char *message)
+{
+	if (!condition)
+	{
+		printf("FAIL: %s\n", message);
+		failures++;
+	}
+}
+
+/**
+ * @brief Run the node with a cache max age shorter than the VOC interval,
+ *        every VOC reading needs a T/RH conversion
+ */
+static void test_node(host_bme680 *sim)
+{
+	setup();
+	g_bme_th_max_age = 5000;
+	uint64_t delay_start = host_delay_us;
+	uint64_t awake_start = host_awake_us;
+	uint32_t voc_start = host_sgp40.measurements;
+	uint32_t conversions_start = sim->conversions - sim->gas_conversions;
+	uint32_t env_failures = driver_stats[0].failures;
+	size_t uplinks_start = host_uplinks.size();
+	uint32_t hits;
+	uint32_t misses;
+	get_rak1906_cache_stats(hits, misses);
+	uint32_t misses_start = misses;
+
+	host_run_until(host_now_us() + TEST_HOURS * 3600000000ULL);
+
+	get_rak1906_cache_stats(hits, misses);
+	uint32_t voc_readings = host_sgp40.measurements - voc_start;
+	uint32_t th_conversions = sim->conversions - sim->gas_conversions - conversions_start;
+	printf("T/RH refresh, %d h, cache max age %lu s\n", TEST_HOURS, (unsigned long)(g_bme_th_max_age / 1000));
+	printf("  VOC readings:        %lu\n", (unsigned long)voc_readings);
+	printf("  T/RH conversions:    %lu (%lu cache misses)\n", (unsigned long)th_conversions, (unsigned long)(misses - misses_start));
+	printf("  delay() after setup: %.1f ms\n", (host_delay_us - delay_start) / 1000.0);
+	printf("  awake per hour:      %.1f ms\n", (host_awake_us - awake_start) / 1000.0 / TEST_HOURS);
+
+	check(host_delay_us == delay_start, "blocking wait after setup()");
+	check(voc_readings >= TEST_HOURS * 360 - 1, "VOC readings missing");
+	check(th_conversions > voc_readings / 2, "T/RH not refreshed");
+	// 22.00 degC and 44.804 %RH of the simulated sensor
+	check(host_sgp40.last_t == (uint16_t)((22.0 + 45) * 65535 / 175), "SGP40 temperature compensation wrong");
+	check(abs((int)host_sgp40.last_rh - (int)(44.804 * 65535 / 100)) <= 1, "SGP40 humidity compensation wrong");
+	check(driver_stats[0].failures == env_failures, "RAK1906 values missing in uplinks");
+	check(host_uplinks.size() - uplinks_start >= TEST_HOURS * 60 - 1, "uplinks missing");
+
+	// Sensor slower than its datasheet time, the T/RH conversions are collected on a retry
+	sim->extra_us = 3000;
+	host_serial_out.clear();
+	voc_start = host_sgp40.measurements;
+	env_failures = driver_stats[0].failures;
+	host_run_until(host_now_us() + 3600000000ULL);
+	sim->extra_us = 0;
+	voc_readings = host_sgp40.measurements - voc_start;
+	printf("  slow sensor, 1 h:    %lu VOC readings\n", (unsigned long)voc_readings);
+	check(host_serial_out.find("T/RH refresh failed") == std::string::npos, "T/RH conversion of a slow sensor given up");
+	check(voc_readings >= 360 - 1, "VOC readings missing with a slow sensor");
+	check(driver_stats[0].failures == env_failures, "RAK1906 values missing in uplinks with a slow sensor");
+}
+
+/**
+ * @brief Payload measurement requested while a T/RH conversion is running
+ */
+static void test_collision(host_bme680 *sim)
+{
+	g_bme_th_max_age = 0;
+	host_advance_us(1000000);
+
+	// T/RH conversion first, the payload measurement waits for it
+	uint32_t th_time = start_rak1906_th();
+	check(th_time != 0, "T/RH conversion not started");
+	uint32_t gas_conversions = sim->gas_conversions;
+	uint32_t payload_time = start_rak1906();
+	check(payload_time > th_time, "payload time does not include the running T/RH conversion");
+	check(sim->gas_conversions == gas_conversions, "running T/RH conversion disturbed");
+	host_advance_us(th_time * 1000ULL);
+	check(collect_rak1906_th(), "T/RH conversion not collected");
+	check(sim->gas_conversions == gas_conversions + 1, "payload measurement not started after the T/RH conversion");
+	host_advance_us((payload_time - th_time) * 1000ULL);
+	check(collect_rak1906(), "payload measurement not finished in the returned time");
+
+	// Same, but the T/RH conversion is collected by the payload job
+	th_time = start_rak1906_th();
+	payload_time = start_rak1906();
+	host_advance_us(th_time * 1000ULL);
+	check(!collect_rak1906(), "payload collected before it was started");
+	check(sim->gas_conversions == gas_conversions + 2, "payload measurement not started by collect_rak1906()");
+	host_advance_us(payload_time * 1000ULL);
+	check(collect_rak1906(), "payload measurement not finished");
+
+	// T/RH refresh during a payload measurement uses the cached values
+	start_rak1906();
+	check(start_rak1906_th() == 0, "T/RH conversion started during the payload measurement");
+	host_advance_us(payload_time * 1000ULL);
+	check(collect_rak1906(), "payload measurement not finished");
+}
+
+/**
+ * @brief T/RH conversion that is not finished at its expected end
+ *        No new conversion is started until it is collected or given up
+ */
+static void test_slow(host_bme680 *sim)
+{
+	g_bme_th_max_age = 0;
+	host_advance_us(1000000);
+	sim->extra_us = 3000;
+
+	uint32_t th_time = start_rak1906_th();
+	uint32_t conversions = sim->conversions;
+	uint32_t payload_time = start_rak1906();
+	host_advance_us(th_time * 1000ULL);
+	check(!collect_rak1906_th(), "unfinished T/RH conversion collected");
+	check(rak1906_th_running(), "unfinished T/RH conversion given up");
+	check(sim->conversions == conversions, "payload measurement started during the T/RH conversion");
+	host_advance_us(CONVERSION_RETRY_TIME * 1000ULL);
+	check(collect_rak1906_th(), "T/RH conversion not collected on the retry");
+	check(sim->conversions == conversions + 1, "payload measurement not started after the T/RH conversion");
+	host_advance_us(payload_time * 1000ULL);
+	check(collect_rak1906(), "payload measurement not finished");
+
+	// Sensor that does not finish, the conversion is given up after BME_TH_TIMEOUT
+	sim->extra_us = 1000000;
+	host_advance_us(1000000);
+	th_time = start_rak1906_th();
+	check(th_time != 0, "T/RH conversion not started");
+	conversions = sim->conversions;
+	start_rak1906();
+	host_advance_us(th_time * 1000ULL);
+	uint32_t retries = 0;
+	while (!collect_rak1906_th() && rak1906_th_running() && (retries < 100))
+	{
+		retries++;
+		host_advance_us(CONVERSION_RETRY_TIME * 1000ULL);
+	}
+	printf("T/RH conversion of a sensor that does not finish given up after %lu retries\n", (unsigned long)retries);
+	check(!rak1906_th_running(), "T/RH conversion not given up");
+	check(retries <= CONVERSION_RETRIES, "T/RH conversion given up too late");
+	check(sim->conversions == conversions + 1, "payload measurement not started after the T/RH conversion was given up");
+
+	// Let the sensor finish the payload measurement
+	sim->extra_us = 0;
+	host_advance_us(2000000);
+	check(collect_rak1906(), "payload measurement not finished");
+}
+
+int main(void)
+{
+	host_bme680 *sim = host_default_node();
+	test_node(sim);
+	test_collision(sim);
+	test_slow(sim);
+	printf("%s\n", failures == 0 ? "PASS" : "FAIL");
+	return failures == 0 ? 0 : 1;
+}
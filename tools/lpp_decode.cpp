@@ -0,0 +1,305 @@
+/**
+ * @file lpp_decode.cpp
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Bulk decoder for the LPP uplinks of the sensor node
+ *        Reads payloads from stdin and writes one CSV line per value:
+ *          record,channel,type,name,component,value
+ *
+ *        Build on the host, the benchmark corpus is encoded by
+ *        WisCayenne with the CayenneLPP stub of the host tests:
+ *          g++ -O2 -std=c++11 -Itests/stubs -I. -o lpp_decode \
+ *            tools/lpp_decode.cpp wisblock_cayenne.cpp
+ *
+ *        Usage:
+ *          lpp_decode           one hex payload per line
+ *          lpp_decode --bin     binary records, 1 byte size + payload
+ *          lpp_decode --bench [count]
+ *                               decode a corpus encoded by WisCayenne
+ *                               and print the throughput
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "lpp_decoder.h"
+#include "wisblock_cayenne.h"
+
+/** Payloads decoded in one batch */
+#define CLI_BATCH 4096
+/** Max LPP payload size */
+#define CLI_MAX_PAYLOAD 255
+/** Max values of one payload, colour has the most values per byte, 3 in 5 bytes */
+#define CLI_MAX_VALUES (CLI_MAX_PAYLOAD * 3 / 5)
+
+/** Payloads of the current batch */
+static uint8_t batch_data[CLI_BATCH][CLI_MAX_PAYLOAD];
+/** Pointers and sizes of the payloads of the current batch */
+static const uint8_t *batch_payload[CLI_BATCH];
+static size_t batch_size[CLI_BATCH];
+/** Results of the current batch */
+static int batch_error[CLI_BATCH];
+
+/**
+ * @brief Print the values of a batch as CSV, errors go to stderr
+ *
+ * @param columns decoded values
+ * @param first_record record index of the first payload
+ * @param count number of payloads
+ */
+static void print_batch(const lpp_columns_t &columns, uint32_t first_record, size_t count)
+{
+	for (size_t row = 0; row < columns.count; row++)
+	{
+		printf("%u,%u,%u,%s,%u,%.10g\n", columns.record[row], columns.channel[row], columns.type[row],
+			   lpp_type_info(columns.type[row])->name, columns.component[row], columns.value[row]);
+	}
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		if (batch_error[idx] != LPP_DECODE_OK)
+		{
+			fprintf(stderr, "record %u: %s\n", first_record + (uint32_t)idx,
+					batch_error[idx] == LPP_DECODE_UNKNOWN_TYPE ? "unknown type" : "truncated");
+		}
+	}
+}
+
+/**
+ * @brief Convert a hex line into a payload
+ *        Spaces and a trailing line end are ignored
+ *
+ * @param line hex string
+ * @param payload buffer for the payload
+ * @return int payload size, -1 if the line is not valid hex
+ */
+static int parse_hex(const char *line, uint8_t *payload)
+{
+	int size = 0;
+	int nibble = -1;
+	for (const char *pos = line; *pos != 0; pos++)
+	{
+		int digit;
+		if ((*pos >= '0') && (*pos <= '9'))
+		{
+			digit = *pos - '0';
+		}
+		else if ((*pos >= 'a') && (*pos <= 'f'))
+		{
+			digit = *pos - 'a' + 10;
+		}
+		else if ((*pos >= 'A') && (*pos <= 'F'))
+		{
+			digit = *pos - 'A' + 10;
+		}
+		else if ((*pos == ' ') || (*pos == '\r') || (*pos == '\n') || (*pos == '\t'))
+		{
+			continue;
+		}
+		else
+		{
+			return -1;
+		}
+
+		if (nibble < 0)
+		{
+			nibble = digit;
+		}
+		else
+		{
+			if (size >= CLI_MAX_PAYLOAD)
+			{
+				return -1;
+			}
+			payload[size++] = (uint8_t)((nibble << 4) | digit);
+			nibble = -1;
+		}
+	}
+	return (nibble < 0) ? size : -1;
+}
+
+/**
+ * @brief Read the payloads from stdin and decode them in batches
+ *
+ * @param binary true for binary records, false for hex lines
+ * @return int exit code
+ */
+static int decode_stream(bool binary)
+{
+	lpp_columns_t columns(CLI_BATCH * CLI_MAX_VALUES);
+	uint32_t record = 0;
+	bool done = false;
+	char line[CLI_MAX_PAYLOAD * 3 + 4];
+
+	while (!done)
+	{
+		size_t count = 0;
+		while (count < CLI_BATCH)
+		{
+			int size;
+			if (binary)
+			{
+				int length = getchar();
+				if (length == EOF)
+				{
+					done = true;
+					break;
+				}
+				size = (int)fread(batch_data[count], 1, (size_t)length, stdin);
+				if (size != length)
+				{
+					fprintf(stderr, "record %u: incomplete\n", record + (uint32_t)count);
+					done = true;
+					break;
+				}
+			}
+			else
+			{
+				if (fgets(line, sizeof(line), stdin) == NULL)
+				{
+					done = true;
+					break;
+				}
+				size = parse_hex(line, batch_data[count]);
+				if (size < 0)
+				{
+					fprintf(stderr, "record %u: invalid hex\n", record + (uint32_t)count);
+					size = 0;
+				}
+			}
+			batch_payload[count] = batch_data[count];
+			batch_size[count] = (size_t)size;
+			count++;
+		}
+
+		columns.clear();
+		lpp_decode_batch(batch_payload, batch_size, count, record, columns, batch_error);
+		print_batch(columns, record, count);
+		record += (uint32_t)count;
+	}
+	return 0;
+}
+
+/**
+ * @brief Generate a payload like the node sends it
+ *        Encoded with WisCayenne in the order and with the functions
+ *        of the encode functions of the sensor modules. Some payloads
+ *        are queued samples with their age or have a GNSS location.
+ *
+ * @param lpp encoder
+ * @param seed random state, updated
+ * @return size_t payload size
+ */
+static size_t generate_payload(WisCayenne &lpp, uint32_t &seed)
+{
+	seed = seed * 1103515245UL + 12345UL;
+	uint32_t rnd = seed >> 8;
+
+	lpp.reset();
+	if ((rnd & 0x0F) == 0)
+	{
+		// Queued sample, age in seconds
+		lpp.addGenericSensor_u32(40, rnd % 86400);
+	}
+	// RAK1906
+	lpp.addRelativeHumidity_x2(6, (uint8_t)(60 + rnd % 60));
+	lpp.addTemperature_x10(7, (int16_t)((int)(rnd % 400) - 100));
+	lpp.addBarometricPressure_x10(8, (uint16_t)(9900 + rnd % 400));
+	lpp.addAnalogInput_x100(9, (int16_t)(2000 + rnd % 20000));
+	if (rnd & 0x10)
+	{
+		// RAK12037
+		lpp.addConcentration(35, 400 + rnd % 1600);
+		lpp.addTemperature(36, (200 + rnd % 60) / 10.0f);
+		lpp.addRelativeHumidity(37, (70 + rnd % 40) / 2.0f);
+	}
+	// RAK12047
+	lpp.addVoc_index(16, rnd % 500);
+	if ((rnd & 0xE0) == 0)
+	{
+		// GNSS location in 1e-7 ° and mm like the receiver reports it
+		if (rnd & 0x100)
+		{
+			lpp.addGNSS_6(10, 145990000, 1209860000, 35000);
+		}
+		else
+		{
+			lpp.addGNSS_4(10, (uint32_t)-14599000, 120986000, 35000);
+		}
+	}
+	lpp.addVoltage(1, (330 + rnd % 90) / 100.0f);
+	return lpp.getSize();
+}
+
+/**
+ * @brief Decode a generated corpus and print the throughput
+ *
+ * @param count number of payloads in the corpus
+ * @return int exit code
+ */
+static int run_benchmark(size_t count)
+{
+	std::vector<uint8_t> corpus(count * 64);
+	std::vector<const uint8_t *> payloads(count);
+	std::vector<size_t> sizes(count);
+	WisCayenne lpp(CLI_MAX_PAYLOAD);
+	uint32_t seed = 1;
+	size_t bytes = 0;
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		sizes[idx] = generate_payload(lpp, seed);
+		memcpy(&corpus[bytes], lpp.getBuffer(), sizes[idx]);
+		bytes += sizes[idx];
+	}
+	bytes = 0;
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		payloads[idx] = &corpus[bytes];
+		bytes += sizes[idx];
+	}
+
+	lpp_columns_t columns(CLI_BATCH * CLI_MAX_VALUES);
+	size_t values = 0;
+	size_t errors = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (size_t first = 0; first < count; first += CLI_BATCH)
+	{
+		size_t batch = (count - first < CLI_BATCH) ? count - first : CLI_BATCH;
+		columns.clear();
+		lpp_decode_batch(&payloads[first], &sizes[first], batch, (uint32_t)first, columns, batch_error);
+		values += columns.count;
+		for (size_t idx = 0; idx < batch; idx++)
+		{
+			errors += (batch_error[idx] != LPP_DECODE_OK) ? 1 : 0;
+		}
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("payloads %zu, bytes %zu, values %zu, errors %zu\n", count, bytes, values, errors);
+	printf("%.3f s, %.0f payloads/s, %.0f values/s, %.1f MB/s\n",
+		   seconds, count / seconds, values / seconds, bytes / seconds / 1e6);
+	// Every payload of the encoder has to be decoded
+	return (errors == 0) ? 0 : 1;
+}
+
+int main(int argc, char **argv)
+{
+	if ((argc >= 2) && (strcmp(argv[1], "--bench") == 0))
+	{
+		size_t count = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 1000000;
+		return run_benchmark(count > 0 ? count : 1);
+	}
+	if ((argc >= 2) && (strcmp(argv[1], "--bin") == 0))
+	{
+		return decode_stream(true);
+	}
+	if (argc >= 2)
+	{
+		fprintf(stderr, "Usage: %s [--bin | --bench [count]]\n", argv[0]);
+		return 1;
+	}
+	return decode_stream(false);
+}
@@ -0,0 +1,260 @@
+/**
+ * @file lpp_decoder.h
+ * @author Bernd Giesecke (bernd@giesecke.tk)
+ * @brief Header-only Cayenne LPP decoder for the backend
+ *        Same types as WisCayenne and the decoders in decoders/,
+ *        including the custom types LPP_GPS4 (136), LPP_GPS6 (137)
+ *        and LPP_VOC (138).
+ *        Payloads are decoded into columns (record, channel, type,
+ *        component, value). The columns are allocated once, decoding
+ *        does not allocate memory.
+ * @version 0.1
+ * @date 2026-10-17
+ *
+ * @copyright Copyright (c) 2026
+ *
+ */
+#ifndef LPP_DECODER_H
+#define LPP_DECODER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+/** Results of lpp_decode() */
+#define LPP_DECODE_OK 0
+#define LPP_DECODE_UNKNOWN_TYPE -1 // Type is not in the type table
+#define LPP_DECODE_TRUNCATED -2	   // Payload ends inside a value
+#define LPP_DECODE_FULL -3		   // Not enough space in the columns
+
+/** Max number of values in one LPP type, e.g. x, y, z */
+#define LPP_MAX_COMPONENTS 3
+
+/**
+ * @brief Description of an LPP type
+ *
+ */
+typedef struct lpp_type_s
+{
+	uint8_t type;						  // LPP type
+	const char *name;					  // Name used by the JS decoders
+	uint8_t components;					  // Number of values, 0 = unknown type
+	uint8_t size[LPP_MAX_COMPONENTS];	  // Bytes per value, MSB first
+	bool is_signed;						  // Values are signed
+	uint32_t divisor[LPP_MAX_COMPONENTS]; // Resolution of the values
+} lpp_type_t;
+
+/** Known LPP types, same as lppDecode() in decoders/ */
+static const lpp_type_t lpp_types[] = {
+	{0, "digital_in", 1, {1}, false, {1}},
+	{1, "digital_out", 1, {1}, false, {1}},
+	{2, "analog_in", 1, {2}, true, {100}},
+	{3, "analog_out", 1, {2}, true, {100}},
+	{100, "generic", 1, {4}, false, {1}},
+	{101, "illuminance", 1, {2}, false, {1}},
+	{102, "presence", 1, {1}, false, {1}},
+	{103, "temperature", 1, {2}, true, {10}},
+	{104, "humidity", 1, {1}, false, {2}},
+	{113, "accelerometer", 3, {2, 2, 2}, true, {1000, 1000, 1000}},
+	{115, "barometer", 1, {2}, false, {10}},
+	{116, "voltage", 1, {2}, false, {100}},
+	{117, "current", 1, {2}, false, {1000}},
+	{118, "frequency", 1, {4}, false, {1}},
+	{120, "percentage", 1, {1}, false, {1}},
+	{121, "altitude", 1, {2}, true, {1}},
+	{125, "concentration", 1, {2}, false, {1}},
+	{128, "power", 1, {2}, false, {1}},
+	{130, "distance", 1, {4}, false, {1000}},
+	{131, "energy", 1, {4}, false, {1000}},
+	{132, "direction", 1, {2}, false, {1}},
+	{133, "time", 1, {4}, false, {1}},
+	{134, "gyrometer", 3, {2, 2, 2}, true, {100, 100, 100}},
+	{135, "colour", 3, {1, 1, 1}, false, {1, 1, 1}},
+	{136, "gps", 3, {3, 3, 3}, true, {10000, 10000, 100}},		// LPP_GPS4
+	{137, "gps", 3, {4, 4, 3}, true, {1000000, 1000000, 100}}, // LPP_GPS6
+	{138, "voc", 1, {2}, false, {1}},							// LPP_VOC
+	{142, "switch", 1, {1}, false, {1}},
+};
+
+/**
+ * @brief Lookup table type -> description, unknown types have 0 components
+ *
+ */
+typedef struct lpp_type_lookup_s
+{
+	const lpp_type_t *entry[256];
+
+	lpp_type_lookup_s(void)
+	{
+		static const lpp_type_t unknown = {0, "unknown", 0, {0}, false, {1}};
+		for (int idx = 0; idx < 256; idx++)
+		{
+			entry[idx] = &unknown;
+		}
+		for (size_t idx = 0; idx < sizeof(lpp_types) / sizeof(lpp_types[0]); idx++)
+		{
+			entry[lpp_types[idx].type] = &lpp_types[idx];
+		}
+	}
+} lpp_type_lookup_t;
+
+/**
+ * @brief Get the description of an LPP type
+ *        The lookup table is built on the first call
+ *
+ * @param type LPP type
+ * @return const lpp_type_t* description, components is 0 if the type is unknown
+ */
+static inline const lpp_type_t *lpp_type_info(uint8_t type)
+{
+	static const lpp_type_lookup_t lookup;
+	return lookup.entry[type];
+}
+
+/**
+ * @brief Decoded values, one row per value
+ *        Multi value types like GPS have one row per component
+ *
+ */
+typedef struct lpp_columns_s
+{
+	std::vector<uint32_t> record;	// Index of the payload in the batch
+	std::vector<uint8_t> channel;	// LPP channel
+	std::vector<uint8_t> type;		// LPP type
+	std::vector<uint8_t> component; // 0 or x/y/z, lat/long/alt, r/g/b
+	std::vector<int32_t> raw;		// Value as sent, 4 byte unsigned values can wrap
+	std::vector<double> value;		// Value scaled by the type resolution
+	size_t count;					// Used rows
+
+	/**
+	 * @brief Allocate the columns
+	 *
+	 * @param capacity max number of rows
+	 */
+	explicit lpp_columns_s(size_t capacity)
+		: record(capacity), channel(capacity), type(capacity), component(capacity),
+		  raw(capacity), value(capacity), count(0)
+	{
+	}
+
+	/**
+	 * @brief Remove all rows, the memory is kept
+	 *
+	 */
+	void clear(void)
+	{
+		count = 0;
+	}
+
+	/**
+	 * @brief Max number of rows
+	 *
+	 * @return size_t capacity
+	 */
+	size_t capacity(void) const
+	{
+		return record.size();
+	}
+} lpp_columns_t;
+
+/**
+ * @brief Decode one payload and append its values to the columns
+ *        If the payload cannot be decoded completely none of its
+ *        values are added
+ *
+ * @param payload LPP payload
+ * @param size payload size in bytes
+ * @param record index of the payload, stored with each value
+ * @param columns columns for the values
+ * @return int number of values added or LPP_DECODE_xxx error
+ */
+static inline int lpp_decode(const uint8_t *payload, size_t size, uint32_t record, lpp_columns_t &columns)
+{
+	size_t start_count = columns.count;
+	size_t capacity = columns.capacity();
+	size_t pos = 0;
+
+	while (pos < size)
+	{
+		if (pos + 2 > size)
+		{
+			columns.count = start_count;
+			return LPP_DECODE_TRUNCATED;
+		}
+		uint8_t channel = payload[pos++];
+		const lpp_type_t *info = lpp_type_info(payload[pos++]);
+		if (info->components == 0)
+		{
+			columns.count = start_count;
+			return LPP_DECODE_UNKNOWN_TYPE;
+		}
+		if (columns.count + info->components > capacity)
+		{
+			columns.count = start_count;
+			return LPP_DECODE_FULL;
+		}
+
+		for (uint8_t part = 0; part < info->components; part++)
+		{
+			uint8_t part_size = info->size[part];
+			if (pos + part_size > size)
+			{
+				columns.count = start_count;
+				return LPP_DECODE_TRUNCATED;
+			}
+			uint32_t raw = 0;
+			for (uint8_t idx = 0; idx < part_size; idx++)
+			{
+				raw = (raw << 8) | payload[pos++];
+			}
+			int32_t value = (int32_t)raw;
+			if (info->is_signed && (part_size < 4) && (raw & (1UL << (part_size * 8 - 1))))
+			{
+				// Sign extension of 1 to 3 byte values
+				value = (int32_t)(raw | (0xFFFFFFFFUL << (part_size * 8)));
+			}
+
+			size_t row = columns.count++;
+			columns.record[row] = record;
+			columns.channel[row] = channel;
+			columns.type[row] = info->type;
+			columns.component[row] = part;
+			columns.raw[row] = value;
+			// Unsigned 4 byte values are kept unsigned in the scaled column
+			columns.value[row] = (info->is_signed ? (double)value : (double)raw) / info->divisor[part];
+		}
+	}
+	return (int)(columns.count - start_count);
+}
+
+/**
+ * @brief Decode a batch of payloads into the columns
+ *
+ * @param payloads pointers to the payloads
+ * @param sizes sizes of the payloads
+ * @param count number of payloads
+ * @param first_record record index of the first payload
+ * @param columns columns for the values
+ * @param errors set to the LPP_DECODE_xxx result per payload, can be NULL
+ * @return size_t number of payloads decoded, stops at the first payload
+ *         that does not fit into the columns anymore
+ */
+static inline size_t lpp_decode_batch(const uint8_t *const *payloads, const size_t *sizes, size_t count,
+									  uint32_t first_record, lpp_columns_t &columns, int *errors)
+{
+	for (size_t idx = 0; idx < count; idx++)
+	{
+		int result = lpp_decode(payloads[idx], sizes[idx], first_record + (uint32_t)idx, columns);
+		if (errors != NULL)
+		{
+			errors[idx] = (result < 0) ? result : LPP_DECODE_OK;
+		}
+		if (result == LPP_DECODE_FULL)
+		{
+			return idx;
+		}
+	}
+	return count;
+}
+
+#endif // LPP_DECODER_H
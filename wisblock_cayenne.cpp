@@ -1,187 +1,280 @@
-/**
- * @file wisblock_cayenne.cpp
- * @author Bernd Giesecke (bernd.giesecke@rakwireless.com)
- * @brief Extend CayenneLPP class with custom channels
- * @version 0.1
- * @date 2022-04-10
- *
- * @copyright Copyright (c) 2022
- *
- */
-#include "wisblock_cayenne.h"
-
-/** uint16_t level union */
-union int_union_s
-{
-	uint16_t val16 = 0;
-	uint8_t val8[2];
-};
-/** Latitude/Longitude value union */
-union latLong_s
-{
-	uint32_t val32;
-	uint8_t val8[4];
-};
-
-/**
- * @brief Add GNSS data in Cayenne LPP standard format
- *
- * @param channel LPP channel
- * @param latitude Latitude as read from the GNSS receiver
- * @param longitude Longitude as read from the GNSS receiver
- * @param altitude Altitude as read from the GNSS receiver
- * @return uint8_t bytes added to the data packet
- */
-uint8_t WisCayenne::addGNSS_4(uint8_t channel, uint32_t latitude, uint32_t longitude, uint32_t altitude)
-{
-	// check buffer overflow
-	if ((_cursor + LPP_GPS4_SIZE + 2) > _maxsize)
-	{
-		_error = LPP_ERROR_OVERFLOW;
-		return 0;
-	}
-	_buffer[_cursor++] = channel;
-	_buffer[_cursor++] = LPP_GPS4;
-
-	latLong_s pos_union;
-
-	// Save default Cayenne LPP precision
-	pos_union.val32 = latitude / 1000; // Cayenne LPP 0.0001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	pos_union.val32 = longitude / 1000; // Cayenne LPP 0.0001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	pos_union.val32 = altitude / 10; // Cayenne LPP 0.01 meter Signed MSB
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	return _cursor;
-}
-
-/**
- * @brief Add GNSS data in custom Cayenne LPP format
- *        Requires changed decoder in LNS and visualization
- *        Does not work with Cayenne LPP MyDevices
- *
- * @param channel LPP channel
- * @param latitude Latitude as read from the GNSS receiver
- * @param longitude Longitude as read from the GNSS receiver
- * @param altitude Altitude as read from the GNSS receiver
- * @return uint8_t bytes added to the data packet
- */
-uint8_t WisCayenne::addGNSS_6(uint8_t channel, uint32_t latitude, uint32_t longitude, uint32_t altitude)
-{
-	// check buffer overflow
-	if ((_cursor + LPP_GPS6_SIZE + 2) > _maxsize)
-	{
-		_error = LPP_ERROR_OVERFLOW;
-		return 0;
-	}
-	_buffer[_cursor++] = channel;
-	_buffer[_cursor++] = LPP_GPS6;
-
-	latLong_s pos_union;
-
-	pos_union.val32 = latitude / 10; // Custom 0.000001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[3];
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	pos_union.val32 = longitude / 10; // Custom 0.000001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[3];
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	pos_union.val32 = altitude / 10; // Cayenne LPP 0.01 meter Signed MSB
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[0];
-
-	return _cursor;
-}
-
-/**
- * @brief Add GNSS data in Helium Mapper format
- *
- * @param channel LPP channel
- * @param latitude Latitude as read from the GNSS receiver
- * @param longitude Longitude as read from the GNSS receiver
- * @param altitude Altitude as read from the GNSS receiver
- * @param accuracy Accuracy of reading from the GNSS receiver
- * @param battery Device battery voltage in V
- * @return uint8_t bytes added to the data packet
- */
-uint8_t WisCayenne::addGNSS_H(uint32_t latitude, uint32_t longitude, uint16_t altitude, uint16_t accuracy, uint16_t battery)
-{
-	// check buffer overflow
-	if ((_cursor + LPP_GPSH_SIZE) > _maxsize)
-	{
-		_error = LPP_ERROR_OVERFLOW;
-		return 0;
-	}
-
-	latLong_s pos_union;
-
-	pos_union.val32 = latitude / 100; // Custom 0.00001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[0];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[3];
-
-	pos_union.val32 = longitude / 100; // Custom 0.00001 ° Signed MSB
-	_buffer[_cursor++] = pos_union.val8[0];
-	_buffer[_cursor++] = pos_union.val8[1];
-	_buffer[_cursor++] = pos_union.val8[2];
-	_buffer[_cursor++] = pos_union.val8[3];
-
-	pos_union.val32 = altitude / 1000;
-	_buffer[_cursor++] = pos_union.val8[0];
-	_buffer[_cursor++] = pos_union.val8[1];
-
-	pos_union.val32 = accuracy;
-	_buffer[_cursor++] = pos_union.val8[0];
-	_buffer[_cursor++] = pos_union.val8[1];
-
-	int_union_s batt_level;
-
-	batt_level.val16 = battery;
-	_buffer[_cursor++] = batt_level.val8[0];
-	_buffer[_cursor++] = batt_level.val8[1];
-
-	return _cursor;
-}
-
-/**
- * @brief Add the VOC index
- *
- * @param channel VOC channel
- * @param voc_index VOC index
- * @return uint8_t bytes added to the data packet
- */
-uint8_t WisCayenne::addVoc_index(uint8_t channel, uint32_t voc_index)
-{
-	// check buffer overflow
-	if ((_cursor + LPP_VOC_SIZE + 2) > _maxsize)
-	{
-		_error = LPP_ERROR_OVERFLOW;
-		return 0;
-	}
-	_buffer[_cursor++] = channel;
-	_buffer[_cursor++] = LPP_VOC;
-
-	int_union_s voc_union;
-
-	voc_union.val16 = voc_index; // VOC index
-	_buffer[_cursor++] = voc_union.val8[1];
-	_buffer[_cursor++] = voc_union.val8[0];
-
-	return _cursor;
-}
\ No newline at end of file
+/**
+ * @file wisblock_cayenne.cpp
+ * @author Bernd Giesecke (bernd.giesecke@rakwireless.com)
+ * @brief Extend CayenneLPP class with custom channels
+ * @version 0.1
+ * @date 2022-04-10
+ *
+ * @copyright Copyright (c) 2022
+ *
+ */
+#include "wisblock_cayenne.h"
+
+/**
+ * @brief Append a value MSB first
+ *        Uses shifts, the byte order does not depend on the MCU
+ *
+ * @param buffer payload buffer
+ * @param cursor next free byte, updated
+ * @param value value, negative values are sent as two's complement
+ * @param size number of bytes
+ */
+static void put_msb(uint8_t *buffer, uint8_t &cursor, uint32_t value, uint8_t size)
+{
+	while (size != 0)
+	{
+		size--;
+		buffer[cursor++] = (uint8_t)(value >> (size * 8));
+	}
+}
+
+/**
+ * @brief Append a value LSB first
+ *
+ * @param buffer payload buffer
+ * @param cursor next free byte, updated
+ * @param value value
+ * @param size number of bytes
+ */
+static void put_lsb(uint8_t *buffer, uint8_t &cursor, uint32_t value, uint8_t size)
+{
+	for (uint8_t idx = 0; idx < size; idx++)
+	{
+		buffer[cursor++] = (uint8_t)(value >> (idx * 8));
+	}
+}
+
+/**
+ * @brief Add GNSS data in Cayenne LPP standard format
+ *
+ * @param channel LPP channel
+ * @param latitude Latitude as read from the GNSS receiver
+ * @param longitude Longitude as read from the GNSS receiver
+ * @param altitude Altitude as read from the GNSS receiver
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addGNSS_4(uint8_t channel, uint32_t latitude, uint32_t longitude, uint32_t altitude)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_GPS4_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_GPS4;
+
+	// Save default Cayenne LPP precision, the values are signed, scale them before they are sent
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)latitude / 1000), 3);	 // Cayenne LPP 0.0001 ° Signed MSB
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)longitude / 1000), 3); // Cayenne LPP 0.0001 ° Signed MSB
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)altitude / 10), 3);	 // Cayenne LPP 0.01 meter Signed MSB
+
+	return _cursor;
+}
+
+/**
+ * @brief Add GNSS data in custom Cayenne LPP format
+ *        Requires changed decoder in LNS and visualization
+ *        Does not work with Cayenne LPP MyDevices
+ *
+ * @param channel LPP channel
+ * @param latitude Latitude as read from the GNSS receiver
+ * @param longitude Longitude as read from the GNSS receiver
+ * @param altitude Altitude as read from the GNSS receiver
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addGNSS_6(uint8_t channel, uint32_t latitude, uint32_t longitude, uint32_t altitude)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_GPS6_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_GPS6;
+
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)latitude / 10), 4);	// Custom 0.000001 ° Signed MSB
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)longitude / 10), 4); // Custom 0.000001 ° Signed MSB
+	put_msb(_buffer, _cursor, (uint32_t)((int32_t)altitude / 10), 3);	// Cayenne LPP 0.01 meter Signed MSB
+
+	return _cursor;
+}
+
+/**
+ * @brief Add GNSS data in Helium Mapper format
+ *
+ * @param channel LPP channel
+ * @param latitude Latitude as read from the GNSS receiver
+ * @param longitude Longitude as read from the GNSS receiver
+ * @param altitude Altitude as read from the GNSS receiver
+ * @param accuracy Accuracy of reading from the GNSS receiver
+ * @param battery Device battery voltage in V
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addGNSS_H(uint32_t latitude, uint32_t longitude, uint16_t altitude, uint16_t accuracy, uint16_t battery)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_GPSH_SIZE) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+
+	put_lsb(_buffer, _cursor, (uint32_t)((int32_t)latitude / 100), 4);	// Custom 0.00001 ° Signed LSB
+	put_lsb(_buffer, _cursor, (uint32_t)((int32_t)longitude / 100), 4); // Custom 0.00001 ° Signed LSB
+	put_lsb(_buffer, _cursor, altitude / 1000, 2);
+	put_lsb(_buffer, _cursor, accuracy, 2);
+	put_lsb(_buffer, _cursor, battery, 2);
+
+	return _cursor;
+}
+
+/**
+ * @brief Add the VOC index
+ *
+ * @param channel VOC channel
+ * @param voc_index VOC index
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addVoc_index(uint8_t channel, uint32_t voc_index)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_VOC_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_VOC;
+
+	// VOC index 0 .. 500, larger values are clamped to the 2 bytes
+	put_msb(_buffer, _cursor, voc_index > 0xFFFF ? 0xFFFF : voc_index, LPP_VOC_SIZE);
+
+	return _cursor;
+}
+
+/**
+ * @brief Add a temperature without float conversion
+ *
+ * @param channel LPP channel
+ * @param temperature temperature in 0.1 °C
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addTemperature_x10(uint8_t channel, int16_t temperature)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_TEMPERATURE_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_TEMPERATURE;
+	put_msb(_buffer, _cursor, (uint16_t)temperature, LPP_TEMPERATURE_SIZE);
+
+	return _cursor;
+}
+
+/**
+ * @brief Add a relative humidity without float conversion
+ *
+ * @param channel LPP channel
+ * @param humidity humidity in 0.5 %RH
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addRelativeHumidity_x2(uint8_t channel, uint8_t humidity)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_RELATIVE_HUMIDITY_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_RELATIVE_HUMIDITY;
+	_buffer[_cursor++] = humidity;
+
+	return _cursor;
+}
+
+/**
+ * @brief Add a barometric pressure without float conversion
+ *
+ * @param channel LPP channel
+ * @param pressure pressure in 0.1 hPa
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addBarometricPressure_x10(uint8_t channel, uint16_t pressure)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_BAROMETRIC_PRESSURE_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_BAROMETRIC_PRESSURE;
+	put_msb(_buffer, _cursor, pressure, LPP_BAROMETRIC_PRESSURE_SIZE);
+
+	return _cursor;
+}
+
+/**
+ * @brief Add an analog value without float conversion
+ *
+ * @param channel LPP channel
+ * @param value value in 0.01 units
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addAnalogInput_x100(uint8_t channel, int16_t value)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_ANALOG_INPUT_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_ANALOG_INPUT;
+	put_msb(_buffer, _cursor, (uint16_t)value, LPP_ANALOG_INPUT_SIZE);
+
+	return _cursor;
+}
+
+/**
+ * @brief Add a generic sensor value without float conversion
+ *
+ * @param channel LPP channel
+ * @param value unsigned value
+ * @return uint8_t bytes added to the data packet
+ */
+uint8_t WisCayenne::addGenericSensor_u32(uint8_t channel, uint32_t value)
+{
+	// check buffer overflow
+	if ((_cursor + LPP_GENERIC_SENSOR_SIZE + 2) > _maxsize)
+	{
+		_error = LPP_ERROR_OVERFLOW;
+		return 0;
+	}
+	_buffer[_cursor++] = channel;
+	_buffer[_cursor++] = LPP_GENERIC_SENSOR;
+	put_msb(_buffer, _cursor, value, LPP_GENERIC_SENSOR_SIZE);
+
+	return _cursor;
+}
+
+/**
+ * @brief Remove the values that were added after a given size
+ *        and clear an overflow error
+ *
+ * @param size payload size to go back to
+ */
+void WisCayenne::rewind(uint8_t size)
+{
+	if (size < _cursor)
+	{
+		_cursor = size;
+	}
+	_error = LPP_ERROR_OK;
+}